@@ -6,18 +6,101 @@
 #include <errno.h>
 #include <poll.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "raw_input_text.h"
+
+// Size of the input buffer, enough for a large paste to be taken in a few reads
+#define INPUT_BUFFER_SIZE 65536
+
+// Results of waiting for an input byte
+#define INPUT_READY 0
+#define INPUT_TIMEOUT 1
+#define INPUT_EOF 2
+#define INPUT_ERROR -1
+
+// Result of decoding a malformed UTF-8 sequence
+#define KEY_INVALID -2
+
+// Bracketed paste mode, the terminal then wraps pasted text in ESC [ 200 ~ and ESC [ 201 ~
+#define PASTE_MODE_ON "\x1b[?2004h"
+#define PASTE_MODE_OFF "\x1b[?2004l"
+#define PASTE_END "\x1b[201~"
+#define PASTE_END_SIZE 6
+
+// Keys the reader thread can queue ahead of the consumer, a power of two
+#define KEY_QUEUE_SIZE 1024
 
 // Static storage for original terminal settings
 static struct termios orig_termios;
 // Flag to track whether we are in raw mode
 static int raw_mode = 0;
+// Descriptor keys are read from, stdin unless set with setInputFd
+static int input_fd = STDIN_FILENO;
+// Bytes read from input_fd and not decoded yet, from input_head to input_tail
+static unsigned char input_buffer[INPUT_BUFFER_SIZE];
+static size_t input_head = 0;
+static size_t input_tail = 0;
+// Text of the bracketed paste being read
+static unsigned char *paste_buffer = NULL;
+static size_t paste_length = 0;
+static size_t paste_capacity = 0;
+// Set when a paste was read, until its text is attached to a key
+static bool paste_pending = false;
+// Text of the last paste key delivered, valid UTF-8, until taken with takePaste
+static unsigned char *ready_paste = NULL;
+static size_t ready_paste_length = 0;
+
+// A decoded key, as getRawUtf8 returns it
+typedef struct
+{
+    int length;           // Bytes of the key, 0 on EOF, -1 on error, KEY_INVALID on malformed UTF-8
+    unsigned char bytes[4];
+    unsigned char *paste; // Text of a paste key, passed on to takePaste when the key is delivered
+    size_t paste_length;
+} KeyEvent;
+
+// Keys decoded by the reader thread, see setInputThread. A single-producer single-consumer
+// ring: only the reader thread advances queue_write, only the thread taking keys queue_read.
+static KeyEvent key_queue[KEY_QUEUE_SIZE];
+static atomic_size_t queue_read = 0;
+static atomic_size_t queue_write = 0;
+// Flags to track whether the reader thread is wanted while in raw mode, and running
+static bool reader_enabled = false;
+static bool reader_running = false;
+// Set by the reader thread when it stops at EOF or an error
+static atomic_bool reader_done = false;
+static atomic_bool reader_stop = false;
+static pthread_t reader_thread;
+// Written after each queued key to wake the consumer, and to stop the reader thread
+static int wake_pipe[2] = {-1, -1};
+static int stop_pipe[2] = {-1, -1};
 
 void exitRaw();
+static void startReaderThread();
+static void stopReaderThread();
+
+/**
+ * Writes a control sequence to the terminal, if stdout is one.
+ */
+static void writeTerminal(const char *sequence)
+{
+    if (isatty(STDOUT_FILENO))
+    {
+        ssize_t written = write(STDOUT_FILENO, sequence, strlen(sequence));
+        (void)written;
+    }
+}
 
 /**
  * Enters raw input mode.
  * - Disables ICANON (line buffering)
  * - Disables ECHO (character echoing)
+ * - Turns on bracketed paste, see takePaste
  * - Sets VMIN=1, VTIME=0 (return immediately after one byte)
  * - Uses cfmakeraw() for base raw settings, then disables ECHO explicitly
  *
@@ -53,9 +136,11 @@ int enterRaw()
         {
             return -1;
         }
+        writeTerminal(PASTE_MODE_ON); // Terminals without bracketed paste ignore it
         raw_mode = 1;
     }
 
+    startReaderThread();
     return 0;
 }
 
@@ -67,6 +152,9 @@ void exitRaw()
 {
     if (raw_mode)
     {
+        // Stdin goes back to whoever runs next, such as an interactive shell command
+        stopReaderThread();
+        writeTerminal(PASTE_MODE_OFF);
         tcsetattr(STDIN_FILENO, TCSANOW, &orig_termios);
         raw_mode = 0;
     }
@@ -88,57 +176,172 @@ static bool hasInputTimeout(int fd, int timeout_ms)
 }
 
 /**
- * Reads a byte asynchronously from stdin with a timeout.
+ * Refills the input buffer with everything pending on stdin, once it is drained.
+ * poll() reports the input ready, so a single read() takes all of it without waiting for more.
  *
- * @param byte Output buffer for the byte
- * @param timeout Timeout in milliseconds (0 for infinite)
- * @return 0 on success, 1 on timeout, -1 on error
+ * @param timeout_ms Timeout in milliseconds (-1 for infinite)
+ * @return INPUT_READY, INPUT_TIMEOUT, INPUT_EOF or INPUT_ERROR, also when asked to stop
  */
-static int asyncGetRawByte(unsigned char *bytePtr, int timeout_ms)
+static int fillInputBuffer(int timeout_ms)
 {
-    if (!hasInputTimeout(STDIN_FILENO, timeout_ms))
+    // The stop pipe ends the wait of the reader thread, see stopReaderThread
+    struct pollfd pfds[2] = {
+        {.fd = input_fd, .events = POLLIN, .revents = 0},
+        {.fd = stop_pipe[0], .events = POLLIN, .revents = 0}};
+    int ret;
+    do
     {
-        return 1;
+        ret = poll(pfds, stop_pipe[0] >= 0 ? 2 : 1, timeout_ms);
+    } while (ret < 0 && errno == EINTR && timeout_ms < 0); // Signals such as SIGWINCH are not input
+    if (ret == 0)
+    {
+        return INPUT_TIMEOUT;
     }
-    if (read(STDIN_FILENO, bytePtr, 1) == 1)
+    if (ret < 0)
     {
-        return 0;
+        return errno == EINTR ? INPUT_TIMEOUT : INPUT_ERROR;
     }
-    else
+    if (pfds[1].revents & POLLIN)
     {
-        return -1;
+        return INPUT_ERROR;
     }
+
+    ssize_t n = read(input_fd, input_buffer, INPUT_BUFFER_SIZE);
+    if (n == 0)
+    {
+        return INPUT_EOF;
+    }
+    if (n < 0)
+    {
+        return (errno == EINTR || errno == EAGAIN) ? INPUT_TIMEOUT : INPUT_ERROR;
+    }
+    input_head = 0;
+    input_tail = (size_t)n;
+    return INPUT_READY;
 }
 
-bool checkHasInput(uint32_t timeout_ms)
+/**
+ * Gets the next input byte without consuming it, reading stdin only when the buffer is drained.
+ *
+ * @param bytePtr Output for the byte
+ * @param timeout_ms Timeout in milliseconds (-1 for infinite)
+ * @return INPUT_READY, INPUT_TIMEOUT, INPUT_EOF or INPUT_ERROR
+ */
+static int peekInputByte(unsigned char *bytePtr, int timeout_ms)
 {
-    return hasInputTimeout(STDIN_FILENO, (timeout_ms == 0) ? -1 : (int)timeout_ms);
+    if (input_head == input_tail)
+    {
+        int ret = fillInputBuffer(timeout_ms);
+        if (ret != INPUT_READY)
+        {
+            return ret;
+        }
+    }
+    *bytePtr = input_buffer[input_head];
+    return INPUT_READY;
 }
 
-int getByte(uint32_t timeout, uint16_t *keyCode)
+/**
+ * Takes the next input byte, see peekInputByte.
+ */
+static int takeInputByte(unsigned char *bytePtr, int timeout_ms)
 {
-    unsigned char c;
-    int ret = asyncGetRawByte(&c, (timeout == 0) ? -1 : (int)timeout);
-    if (ret == 0)
+    int ret = peekInputByte(bytePtr, timeout_ms);
+    if (ret == INPUT_READY)
     {
-        if (c <= 0x7F)
+        input_head++;
+    }
+    return ret;
+}
+
+/**
+ * Takes the next byte of a sequence, waiting as long as needed for it.
+ * @return true on success, false on EOF or error
+ */
+static bool nextInputByte(unsigned char *bytePtr)
+{
+    return takeInputByte(bytePtr, -1) == INPUT_READY;
+}
+
+/**
+ * Appends bytes to the paste buffer, growing it as needed.
+ * @return true on success, false if out of memory
+ */
+static bool appendPaste(const unsigned char *data, size_t len)
+{
+    if (paste_length + len > paste_capacity)
+    {
+        size_t capacity = paste_capacity ? paste_capacity : INPUT_BUFFER_SIZE;
+        while (capacity < paste_length + len)
         {
-            *keyCode = (uint16_t)c;
-            return 1;
+            capacity *= 2;
         }
-        else
+        unsigned char *grown = (unsigned char *)realloc(paste_buffer, capacity);
+        if (grown == NULL)
         {
-            return 2;
+            return false;
         }
+        paste_buffer = grown;
+        paste_capacity = capacity;
     }
-    else if (ret == 1)
-    {
-        return 0;
-    }
-    else
+    memcpy(paste_buffer + paste_length, data, len);
+    paste_length += len;
+    return true;
+}
+
+/**
+ * Reads the text of a bracketed paste up to ESC [ 201 ~, after ESC [ 200 ~ was read.
+ * The buffered input is copied in runs up to the next ESC, so a paste costs a few
+ * reads and copies rather than a step per byte.
+ *
+ * @return true on success, false if the input ended or memory ran out
+ */
+static bool readPaste()
+{
+    size_t matched = 0; // Bytes of PASTE_END matched so far
+    paste_length = 0;
+
+    while (matched < PASTE_END_SIZE)
     {
-        return -1;
+        if (input_head == input_tail && fillInputBuffer(-1) != INPUT_READY)
+        {
+            return false;
+        }
+        if (matched == 0)
+        {
+            size_t available = input_tail - input_head;
+            unsigned char *start = &input_buffer[input_head];
+            unsigned char *esc = (unsigned char *)memchr(start, 0x1b, available);
+            size_t run = esc ? (size_t)(esc - start) : available;
+            if (!appendPaste(start, run))
+            {
+                return false;
+            }
+            input_head += run;
+            if (esc == NULL)
+            {
+                continue;
+            }
+        }
+
+        unsigned char c = input_buffer[input_head];
+        if (c == (unsigned char)PASTE_END[matched])
+        {
+            matched++;
+            input_head++;
+        }
+        else
+        {
+            // Not the end marker after all, the bytes matched so far are text.
+            // c is looked at again, it may start the marker itself.
+            if (!appendPaste((const unsigned char *)PASTE_END, matched))
+            {
+                return false;
+            }
+            matched = 0;
+        }
     }
+    return normalizePasteText(&paste_buffer, &paste_length, &paste_capacity);
 }
 
 /**
@@ -146,23 +349,18 @@ int getByte(uint32_t timeout, uint16_t *keyCode)
  */
 static int parseEscapeSequence(unsigned char *bytes)
 {
-    int n = 0;
     unsigned char c = 0;
 
-    if (!hasInputTimeout(STDIN_FILENO, 10))
-    { // Just ESC
+    if (takeInputByte(&c, 10) != INPUT_READY)
+    { // Just ESC, or error
         return 1;
     }
-    n = read(STDIN_FILENO, &c, 1);
-    if (n <= 0)
-        return 1; // Error, just return the first ESC
     bytes[1] = c; // Save the byte
 
     // CSI: ESC [
     if (c == 0x5b)
     {
-        n = read(STDIN_FILENO, &c, 1);
-        if (n <= 0)
+        if (!nextInputByte(&c))
             return 1; // Error, just return the first ESC
         bytes[2] = c;
 
@@ -202,8 +400,7 @@ static int parseEscapeSequence(unsigned char *bytes)
             return 1;
 
         case '3': // DELETE → U+2326 (⌦ ERASE TO THE RIGHT)
-            n = read(STDIN_FILENO, &c, 1);
-            if (n <= 0)
+            if (!nextInputByte(&c))
                 return 1;
             if (c != '~')
                 return 1;
@@ -213,15 +410,12 @@ static int parseEscapeSequence(unsigned char *bytes)
             return 3;
 
         case '1':                          // Modified keys: ESC [ 1 ; <modifier> <key>
-            n = read(STDIN_FILENO, &c, 1); // Read ';'
-            if (n <= 0 || c != ';')
+            if (!nextInputByte(&c) || c != ';') // Read ';'
                 return 1;
-            n = read(STDIN_FILENO, &c, 1); // Read modifier (2=Shift, 3=Alt, 5=Ctrl, etc.)
-            if (n <= 0)
+            if (!nextInputByte(&c)) // Read modifier (2=Shift, 3=Alt, 5=Ctrl, etc.)
                 return 1;
             unsigned char modifier = c;
-            n = read(STDIN_FILENO, &c, 1); // Read key (A/B/C/D)
-            if (n <= 0)
+            if (!nextInputByte(&c)) // Read key (A/B/C/D)
                 return 1;
 
             // Only handle Ctrl (5) + Left/Right for now
@@ -246,11 +440,28 @@ static int parseEscapeSequence(unsigned char *bytes)
             // just return ESC to avoid crashes
             return 1;
 
-        case '2': // Insert: ESC [ 2 ~
+        case '2': // Insert: ESC [ 2 ~, or bracketed paste: ESC [ 200 ~ ... ESC [ 201 ~
+            if (!nextInputByte(&c))
+                return 1;
+            if (c == '0')
+            {
+                unsigned char kind = 0;
+                if (!nextInputByte(&kind) || !nextInputByte(&c) || c != '~')
+                    return 1;
+                if (kind != '0' || !readPaste())
+                    return 1; // Stray end marker, or a paste cut short
+                paste_pending = true;
+                bytes[0] = 0xEE; // UTF-8 for U+E000, the paste key
+                bytes[1] = 0x80;
+                bytes[2] = 0x80;
+                return 3;
+            }
+            // Currently not handled, just return ESC
+            return 1;
+
         case '5': // PageUp: ESC [ 5 ~
         case '6': // PageDown: ESC [ 6 ~
-            n = read(STDIN_FILENO, &c, 1); // Read '~'
-            if (n <= 0 || c != '~')
+            if (!nextInputByte(&c) || c != '~') // Read '~'
                 return 1;
             // Currently not handled, just return ESC
             return 1;
@@ -266,22 +477,23 @@ static int parseEscapeSequence(unsigned char *bytes)
 }
 
 /**
- * Reads input and returns:
- * - Normal UTF-8 characters as-is
- * - Arrow keys mapped to Unicode arrow symbols (U+2190-U+2193) in UTF-8
+ * Decodes the next key from the input buffer, as described for getRawUtf8.
+ * A malformed sequence consumes its bytes up to the first one that does not continue it.
  *
  * @param bytes Output buffer (at least 4 bytes)
- * @return Number of bytes written, 0 on EOF, -1 on error
+ * @return Number of bytes written, 0 on EOF, -1 on error, KEY_INVALID on malformed UTF-8
  */
-int getRawUtf8(unsigned char *bytes)
+static int decodeKey(unsigned char *bytes)
 {
     unsigned char c = 0;
-    int n = 0;
+    int len = 0;
 
     // Read first byte
-    n = read(STDIN_FILENO, &c, 1);
-    if (n <= 0)
-        return n;
+    int ret = takeInputByte(&c, -1);
+    if (ret == INPUT_EOF)
+        return 0;
+    if (ret != INPUT_READY)
+        return -1;
     bytes[0] = c;
 
     // --- 0. Escape Sequence (Special Keys) ---
@@ -296,44 +508,485 @@ int getRawUtf8(unsigned char *bytes)
         return 1;
     }
 
-    // --- 2. 2-byte UTF-8 ---
+    // --- 2. Multi-byte UTF-8 (2 to 4 bytes) ---
     if ((c & 0xE0) == 0xC0)
+        len = 2;
+    else if ((c & 0xF0) == 0xE0)
+        len = 3;
+    else if ((c & 0xF8) == 0xF0)
+        len = 4;
+    else
+        return KEY_INVALID; // Invalid start byte
+
+    for (int i = 1; i < len; i++)
     {
-        n = read(STDIN_FILENO, &bytes[1], 1);
-        if (n <= 0)
+        if (peekInputByte(&bytes[i], -1) != INPUT_READY)
             return -1;
-        if ((bytes[1] & 0xC0) != 0x80)
-            return -1;
-        return 2;
+        if ((bytes[i] & 0xC0) != 0x80)
+            return KEY_INVALID; // Left in the buffer, it may start the next key
+        input_head++;
+    }
+    return len;
+}
+
+/**
+ * Decodes the next key into an event, taking the text of a paste key along.
+ */
+static void decodeKeyEvent(KeyEvent *event)
+{
+    event->length = decodeKey(event->bytes);
+    event->paste = NULL;
+    event->paste_length = 0;
+    if (paste_pending)
+    {
+        event->paste = paste_buffer;
+        event->paste_length = paste_length;
+        paste_buffer = NULL;
+        paste_length = 0;
+        paste_capacity = 0;
+        paste_pending = false;
+    }
+}
+
+/**
+ * Queues a key for the consumer, waiting while the queue is full.
+ * Called by the reader thread only.
+ * @return true on success, false if asked to stop
+ */
+static bool pushKey(const KeyEvent *event)
+{
+    size_t write_index = atomic_load_explicit(&queue_write, memory_order_relaxed);
+    while (write_index - atomic_load_explicit(&queue_read, memory_order_acquire) == KEY_QUEUE_SIZE)
+    {
+        if (hasInputTimeout(stop_pipe[0], 1))
+        {
+            return false;
+        }
+    }
+    key_queue[write_index & (KEY_QUEUE_SIZE - 1)] = *event;
+    atomic_store_explicit(&queue_write, write_index + 1, memory_order_release);
+
+    unsigned char wake = 1;
+    ssize_t written = write(wake_pipe[1], &wake, 1); // Full pipe: the consumer is awake anyway
+    (void)written;
+    return true;
+}
+
+/**
+ * Takes the oldest queued key without waiting. Called by the consumer only.
+ * @return true on success, false if the queue is empty
+ */
+static bool popKey(KeyEvent *event)
+{
+    size_t read_index = atomic_load_explicit(&queue_read, memory_order_relaxed);
+    if (read_index == atomic_load_explicit(&queue_write, memory_order_acquire))
+    {
+        return false;
+    }
+    *event = key_queue[read_index & (KEY_QUEUE_SIZE - 1)];
+    atomic_store_explicit(&queue_read, read_index + 1, memory_order_release);
+    return true;
+}
+
+static bool queueEmpty()
+{
+    return atomic_load_explicit(&queue_read, memory_order_relaxed) ==
+           atomic_load_explicit(&queue_write, memory_order_acquire);
+}
+
+/**
+ * Checks whether keys come from the queue: while the reader thread runs,
+ * and after it stopped until the keys it queued are taken.
+ */
+static bool queueMode()
+{
+    return reader_running || !queueEmpty();
+}
+
+/**
+ * Waits for a queued key.
+ * @param timeout_ms Timeout in milliseconds (-1 for infinite)
+ * @return true if a key is queued, false on timeout or once the reader thread is done
+ */
+static bool waitKeyQueued(int timeout_ms)
+{
+    while (queueEmpty())
+    {
+        if (!reader_running || atomic_load(&reader_done))
+        {
+            return false;
+        }
+        if (!hasInputTimeout(wake_pipe[0], timeout_ms))
+        {
+            return !queueEmpty();
+        }
+        unsigned char sink[64];
+        ssize_t n = read(wake_pipe[0], sink, sizeof(sink));
+        (void)n;
+    }
+    return true;
+}
+
+/**
+ * Takes the next key, from the queue or decoded in place. Waits as long as needed.
+ */
+static void nextKeyEvent(KeyEvent *event)
+{
+    if (queueMode())
+    {
+        if (!waitKeyQueued(-1) || !popKey(event))
+        {
+            // The reader thread stopped at EOF or an error and its keys are taken
+            event->length = atomic_load(&reader_done) ? 0 : -1;
+            event->paste = NULL;
+        }
+        return;
+    }
+    decodeKeyEvent(event);
+}
+
+/**
+ * Checks whether a key can be taken without waiting.
+ */
+static bool keyPending()
+{
+    if (queueMode())
+    {
+        return !queueEmpty();
+    }
+    return input_head != input_tail || fillInputBuffer(0) == INPUT_READY;
+}
+
+/**
+ * Writes a key to the caller's buffer and hands the text of a paste key on to takePaste.
+ * @return Length of the key, as in KeyEvent
+ */
+static int deliverKey(const KeyEvent *event, unsigned char *bytes)
+{
+    if (event->length > 0)
+    {
+        memcpy(bytes, event->bytes, event->length);
+    }
+    if (event->paste != NULL)
+    {
+        free(ready_paste); // Not taken, replaced by the newer paste
+        ready_paste = event->paste;
+        ready_paste_length = event->paste_length;
+    }
+    return event->length;
+}
+
+static void *readerMain(void *arg)
+{
+    (void)arg;
+    while (!atomic_load(&reader_stop))
+    {
+        KeyEvent event;
+        decodeKeyEvent(&event);
+        if (event.length == -1 && atomic_load(&reader_stop))
+        {
+            break; // Woken up by stopReaderThread, not a read error
+        }
+        if (!pushKey(&event))
+        {
+            free(event.paste);
+            break;
+        }
+        if (event.length == 0 || event.length == -1)
+        {
+            atomic_store(&reader_done, true);
+            break;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Creates a pipe with non-blocking ends, once.
+ * @return true on success
+ */
+static bool openPipe(int fds[2])
+{
+    if (fds[0] >= 0)
+    {
+        return true;
+    }
+    if (pipe(fds) != 0)
+    {
+        return false;
+    }
+    for (int i = 0; i < 2; i++)
+    {
+        fcntl(fds[i], F_SETFL, fcntl(fds[i], F_GETFL) | O_NONBLOCK);
+        fcntl(fds[i], F_SETFD, FD_CLOEXEC); // Not inherited by shell commands
+    }
+    return true;
+}
+
+static void drainPipe(int fd)
+{
+    unsigned char sink[64];
+    while (read(fd, sink, sizeof(sink)) > 0)
+    {
+    }
+}
+
+/**
+ * Starts the reader thread if it is enabled and not running yet.
+ */
+static void startReaderThread()
+{
+    if (!reader_enabled || reader_running)
+    {
+        return;
+    }
+    if (!openPipe(wake_pipe) || !openPipe(stop_pipe))
+    {
+        return;
+    }
+    atomic_store(&reader_stop, false);
+    atomic_store(&reader_done, false);
+    if (pthread_create(&reader_thread, NULL, readerMain, NULL) == 0)
+    {
+        reader_running = true;
+    }
+}
+
+/**
+ * Stops the reader thread and waits for it. Keys it queued are still taken first.
+ */
+static void stopReaderThread()
+{
+    if (!reader_running)
+    {
+        return;
+    }
+    atomic_store(&reader_stop, true);
+    unsigned char stop = 1;
+    ssize_t written = write(stop_pipe[1], &stop, 1);
+    (void)written;
+    pthread_join(reader_thread, NULL);
+    drainPipe(stop_pipe[0]);
+    reader_running = false;
+}
+
+/**
+ * Turns the reader thread on or off. While on and in raw mode, a thread blocks on stdin,
+ * decodes keys as they arrive and queues them, so checking for a key costs no system call.
+ * exitRaw stops the thread so stdin can be handed to other programs, enterRaw restarts it.
+ * Keys must then be taken by one thread at a time.
+ *
+ * @param enabled Whether to run the reader thread
+ */
+void setInputThread(bool enabled)
+{
+    reader_enabled = enabled;
+    if (enabled && raw_mode)
+    {
+        startReaderThread();
+    }
+    else if (!enabled)
+    {
+        stopReaderThread();
+    }
+}
+
+/**
+ * Reads keys from another descriptor than stdin, such as a pipe of scripted input.
+ * Input buffered from the previous descriptor is dropped. Not for use while the
+ * reader thread runs.
+ *
+ * @param fd Descriptor to read from
+ */
+void setInputFd(int fd)
+{
+    input_fd = fd;
+    input_head = 0;
+    input_tail = 0;
+}
+
+bool checkHasInput(uint32_t timeout_ms)
+{
+    if (queueMode())
+    {
+        return waitKeyQueued((timeout_ms == 0) ? -1 : (int)timeout_ms);
     }
+    if (input_head != input_tail)
+    {
+        return true;
+    }
+    return hasInputTimeout(input_fd, (timeout_ms == 0) ? -1 : (int)timeout_ms);
+}
 
-    // --- 3. 3-byte UTF-8 ---
-    if ((c & 0xF0) == 0xE0)
+/**
+ * Gets a decoded key as a byte, as getByte returns it.
+ */
+static int keyToByte(const KeyEvent *event, uint16_t *keyCode)
+{
+    free(event->paste); // A paste is not a byte
+    if (event->length == 1 && event->bytes[0] <= 0x7F)
     {
-        for (int i = 1; i <= 2; i++)
+        *keyCode = (uint16_t)event->bytes[0];
+        return 1;
+    }
+    return (event->length > 0 || event->length == KEY_INVALID) ? 2 : -1;
+}
+
+int getByte(uint32_t timeout, uint16_t *keyCode)
+{
+    if (queueMode())
+    { // Keys are decoded by the reader thread, so ESC means the ESC key only
+        KeyEvent event;
+        if (!waitKeyQueued((timeout == 0) ? -1 : (int)timeout))
         {
-            n = read(STDIN_FILENO, &bytes[i], 1);
-            if (n <= 0)
-                return -1;
-            if ((bytes[i] & 0xC0) != 0x80)
-                return -1;
+            return atomic_load(&reader_done) ? -1 : 0;
         }
-        return 3;
+        if (!popKey(&event))
+        {
+            return 0;
+        }
+        return keyToByte(&event, keyCode);
     }
 
-    // --- 4. 4-byte UTF-8 ---
-    if ((c & 0xF8) == 0xF0)
+    // Wait for the first byte only, then decode the whole key as the reader thread would,
+    // so an arrow key or a bracketed paste never surfaces as a bare ESC
+    unsigned char c;
+    int ret = peekInputByte(&c, (timeout == 0) ? -1 : (int)timeout);
+    if (ret == INPUT_TIMEOUT)
     {
-        for (int i = 1; i <= 3; i++)
+        return 0;
+    }
+    if (ret != INPUT_READY)
+    {
+        return -1;
+    }
+    KeyEvent event;
+    decodeKeyEvent(&event);
+    return keyToByte(&event, keyCode);
+}
+
+/**
+ * Takes a key the reader thread already queued, without waiting or any system call.
+ *
+ * @param keyCode Output for an ASCII key
+ * @return As getByte, 0 if no key is queued, -2 if the reader thread is not running
+ */
+int getQueuedByte(uint16_t *keyCode)
+{
+    KeyEvent event;
+    if (!queueMode())
+    {
+        return -2;
+    }
+    if (!popKey(&event))
+    {
+        return atomic_load(&reader_done) ? -1 : 0;
+    }
+    return keyToByte(&event, keyCode);
+}
+
+/**
+ * Reads input and returns:
+ * - Normal UTF-8 characters as-is
+ * - Arrow keys mapped to Unicode arrow symbols (U+2190-U+2193) in UTF-8
+ * - A bracketed paste as U+E000, its text is taken with takePaste
+ *
+ * @param bytes Output buffer (at least 4 bytes)
+ * @return Number of bytes written, 0 on EOF, -1 on error
+ */
+int getRawUtf8(unsigned char *bytes)
+{
+    KeyEvent event;
+    nextKeyEvent(&event);
+    int size = deliverKey(&event, bytes);
+    return size == KEY_INVALID ? -1 : size;
+}
+
+/**
+ * Reads every key already typed or pasted in one call, each decoded as by getRawUtf8
+ * and written back to back. Waits for the first key only, then stops once the pending
+ * input is drained, buf is full or a paste key was written. Malformed UTF-8 is written
+ * as U+FFFD.
+ *
+ * @param buf Output buffer (at least 4 bytes)
+ * @param cap Size of buf
+ * @param out_count Output for the number of keys written
+ * @return Number of bytes written, 0 on EOF, -1 on error
+ */
+intptr_t getRawUtf8Batch(unsigned char *buf, size_t cap, size_t *out_count)
+{
+    size_t length = 0;
+    size_t count = 0;
+
+    if (buf == NULL || out_count == NULL || cap < 4)
+    {
+        return -1;
+    }
+    *out_count = 0;
+
+    while (cap - length >= 4)
+    {
+        // After the first key, only take input that is already there
+        if (count > 0 && !keyPending())
+        {
+            break;
+        }
+        KeyEvent event;
+        nextKeyEvent(&event);
+        int size = deliverKey(&event, &buf[length]);
+        if (size == KEY_INVALID)
+        {
+            buf[length] = 0xEF; // U+FFFD REPLACEMENT CHARACTER
+            buf[length + 1] = 0xBF;
+            buf[length + 2] = 0xBD;
+            size = 3;
+        }
+        else if (size <= 0)
+        {
+            if (count == 0)
+            {
+                return size;
+            }
+            break; // Keep the keys read so far, the next call reports the EOF or error
+        }
+        length += (size_t)size;
+        count++;
+        if (event.paste != NULL)
         {
-            n = read(STDIN_FILENO, &bytes[i], 1);
-            if (n <= 0)
-                return -1;
-            if ((bytes[i] & 0xC0) != 0x80)
-                return -1;
+            break; // One paste per batch, takePaste holds a single text
         }
-        return 4;
     }
 
-    return -1; // Invalid start byte
-}
\ No newline at end of file
+    *out_count = count;
+    return (intptr_t)length;
+}
+
+/**
+ * Gets the length of the text of the last bracketed paste, once its key was read.
+ * @return Length in bytes, 0 if there is none
+ */
+size_t getPasteLength()
+{
+    return ready_paste_length;
+}
+
+/**
+ * Copies the text of the last bracketed paste and releases it.
+ * The text is valid UTF-8 with LF line endings.
+ *
+ * @param buf Output buffer, getPasteLength() bytes
+ * @param cap Size of buf
+ * @return Number of bytes copied
+ */
+size_t takePaste(unsigned char *buf, size_t cap)
+{
+    size_t len = ready_paste_length < cap ? ready_paste_length : cap;
+    if (buf != NULL && len > 0)
+    {
+        memcpy(buf, ready_paste, len);
+    }
+    free(ready_paste);
+    ready_paste = NULL;
+    ready_paste_length = 0;
+    return buf != NULL ? len : 0;
+}
@@ -0,0 +1,144 @@
+#ifndef RAW_INPUT_TEXT_H
+#define RAW_INPUT_TEXT_H
+
+// Text helpers shared by the raw input readers of each platform
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define RAW_INPUT_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define RAW_INPUT_NEON
+#include <arm_neon.h>
+#endif
+
+/**
+ * Gets the length of a well-formed UTF-8 sequence, rejecting overlong forms,
+ * surrogates and code points above U+10FFFF.
+ * @return Length of the sequence, 0 if it is malformed or cut short
+ */
+static size_t utf8SequenceLength(const unsigned char *s, size_t n)
+{
+    unsigned char c = s[0];
+    if (c < 0x80)
+        return 1;
+    if (c >= 0xC2 && c <= 0xDF)
+        return (n >= 2 && (s[1] & 0xC0) == 0x80) ? 2 : 0;
+    if (c >= 0xE0 && c <= 0xEF)
+    {
+        unsigned char lo = (c == 0xE0) ? 0xA0 : 0x80;
+        unsigned char hi = (c == 0xED) ? 0x9F : 0xBF;
+        return (n >= 3 && s[1] >= lo && s[1] <= hi && (s[2] & 0xC0) == 0x80) ? 3 : 0;
+    }
+    if (c >= 0xF0 && c <= 0xF4)
+    {
+        unsigned char lo = (c == 0xF0) ? 0x90 : 0x80;
+        unsigned char hi = (c == 0xF4) ? 0x8F : 0xBF;
+        return (n >= 4 && s[1] >= lo && s[1] <= hi && (s[2] & 0xC0) == 0x80 && (s[3] & 0xC0) == 0x80) ? 4 : 0;
+    }
+    return 0;
+}
+
+/**
+ * Gets the length of the run of ASCII bytes other than CR at the start of a text,
+ * which pastes are mostly made of. Scans 16 bytes at a time where SSE2 or NEON is available.
+ * @return Length of the run
+ */
+static size_t plainAsciiLength(const unsigned char *s, size_t n)
+{
+    size_t i = 0;
+#if defined(RAW_INPUT_SSE2)
+    const __m128i cr = _mm_set1_epi8('\r');
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+        if (_mm_movemask_epi8(_mm_or_si128(v, _mm_cmpeq_epi8(v, cr))) != 0)
+            break;
+    }
+#elif defined(RAW_INPUT_NEON)
+    const uint8x16_t cr = vdupq_n_u8('\r');
+    for (; i + 16 <= n; i += 16)
+    {
+        uint8x16_t v = vld1q_u8(s + i);
+        uint8x16_t stop = vorrq_u8(vcgeq_u8(v, vdupq_n_u8(0x80)), vceqq_u8(v, cr));
+        if (vmaxvq_u8(stop) != 0)
+            break;
+    }
+#endif
+    while (i < n && s[i] < 0x80 && s[i] != '\r')
+        i++;
+    return i;
+}
+
+/**
+ * Makes a pasted text valid UTF-8 with LF line endings, as terminals send CR for newlines.
+ * Malformed sequences become U+FFFD. Text that needs neither is left in place,
+ * otherwise it is copied to a new buffer that replaces the old one.
+ *
+ * @param text Buffer of the text, allocated with malloc
+ * @param length Length of the text
+ * @param capacity Capacity of the buffer
+ * @return true on success, false if out of memory
+ */
+static bool normalizePasteText(unsigned char **text, size_t *length, size_t *capacity)
+{
+    const unsigned char *s = *text;
+    size_t size = *length;
+    size_t i = plainAsciiLength(s, size);
+    while (i < size && s[i] != '\r')
+    {
+        size_t len = utf8SequenceLength(&s[i], size - i);
+        if (len == 0)
+        {
+            break;
+        }
+        i += len;
+        i += plainAsciiLength(&s[i], size - i);
+    }
+    if (i == size)
+    {
+        return true;
+    }
+
+    // Each malformed byte may become 3, the text up to i is copied as is
+    size_t out_capacity = i + (size - i) * 3;
+    unsigned char *out = (unsigned char *)malloc(out_capacity);
+    if (out == NULL)
+    {
+        return false;
+    }
+    memcpy(out, s, i);
+    size_t n = i;
+    while (i < size)
+    {
+        if (s[i] == '\r')
+        {
+            out[n++] = '\n';
+            i += (i + 1 < size && s[i + 1] == '\n') ? 2 : 1;
+            continue;
+        }
+        size_t len = utf8SequenceLength(&s[i], size - i);
+        if (len == 0)
+        {
+            out[n++] = 0xEF; // U+FFFD REPLACEMENT CHARACTER
+            out[n++] = 0xBF;
+            out[n++] = 0xBD;
+            i++;
+            continue;
+        }
+        memcpy(&out[n], &s[i], len);
+        n += len;
+        i += len;
+    }
+    free(*text);
+    *text = out;
+    *length = n;
+    *capacity = out_capacity;
+    return true;
+}
+
+#endif // RAW_INPUT_TEXT_H
@@ -3,6 +3,10 @@
 #include <stdbool.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+
+#include "raw_input_text.h"
 
 #define VK_BACK 0x08
 #define VK_TAB 0x09
@@ -16,6 +20,22 @@
 #define VK_HOME 0x24
 #define VK_END 0x23
 #define INFINITE_VALUE 0xFFFFFFFF
+#ifndef ENABLE_VIRTUAL_TERMINAL_INPUT
+#define ENABLE_VIRTUAL_TERMINAL_INPUT 0x0200
+#endif
+#ifndef ENABLE_VIRTUAL_TERMINAL_PROCESSING
+#define ENABLE_VIRTUAL_TERMINAL_PROCESSING 0x0004
+#endif
+
+// Bracketed paste mode, the terminal then wraps pasted text in ESC [ 200 ~ and ESC [ 201 ~
+#define PASTE_MODE_ON "\x1b[?2004h"
+#define PASTE_MODE_OFF "\x1b[?2004l"
+#define PASTE_END "\x1b[201~"
+#define PASTE_END_SIZE 6
+#define PASTE_INITIAL_CAPACITY 65536
+
+// Keys the reader thread can queue ahead of the consumer, a power of two
+#define KEY_QUEUE_SIZE 1024
 
 // Static storage for original terminal settings
 static HANDLE h_console = 0;
@@ -23,64 +43,97 @@ static HANDLE h_console = 0;
 static int flag = 0;
 static DWORD origin_mode = 0;
 static UINT code_page_id = 65001;
+// Flag to track whether bracketed paste mode was turned on
+static int paste_mode = 0;
+// Text of the bracketed paste being read
+static BYTE *paste_buffer = NULL;
+static size_t paste_length = 0;
+static size_t paste_capacity = 0;
+// Set when a paste was read, until its text is attached to a key
+static bool paste_pending = false;
+// Text of the last paste key delivered, valid UTF-8, until taken with takePaste
+static BYTE *ready_paste = NULL;
+static size_t ready_paste_length = 0;
+
+// A decoded key, as getRawUtf8 returns it
+typedef struct
+{
+    int length;   // Bytes of the key, 0 for an unknown sequence, -1 on error
+    BYTE bytes[4];
+    BYTE *paste;  // Text of a paste key, passed on to takePaste when the key is delivered
+    size_t paste_length;
+} KeyEvent;
 
-const BYTE VK_UP_UTF8[] = {0x1B, 0x5B, 0x41};           // ESC [ A
-const BYTE VK_DOWN_UTF8[] = {0x1B, 0x5B, 0x42};         // ESC [ B
-const BYTE VK_LEFT_UTF8[] = {0x1B, 0x5B, 0x44};         // ESC [ D
-const BYTE VK_RIGHT_UTF8[] = {0x1B, 0x5B, 0x43};        // ESC [ C
-const BYTE VK_ESCAPE_UTF8[] = {0x1B};                   // ESC
-const BYTE VK_BACK_UTF8[] = {0x08};                     // Backspace
-const BYTE VK_DELETE_UTF8[] = {0x1B, 0x5B, 0x33, 0x7E}; // ESC [ 3 ~
-const BYTE VK_HOME_UTF8[] = {0x1B, 0x5B, 0x48};         // ESC [ H
-const BYTE VK_END_UTF8[] = {0x1B, 0x5B, 0x46};          // ESC [ F
-const BYTE VK_TAB_UTF8[] = {0x09};                      // Tab
-const BYTE VK_ENTER_UTF8[] = {0x0A};                    // LF
+// Keys decoded by the reader thread, see setInputThread. A single-producer single-consumer
+// ring: only the reader thread advances queue_write, only the thread taking keys queue_read.
+static KeyEvent key_queue[KEY_QUEUE_SIZE];
+static atomic_size_t queue_read = 0;
+static atomic_size_t queue_write = 0;
+// Flags to track whether the reader thread is wanted while in raw mode, and running
+static bool reader_enabled = false;
+static bool reader_running = false;
+// Set by the reader thread when it stops at an error
+static atomic_bool reader_done = false;
+static HANDLE reader_thread = NULL;
+// Set after each queued key to wake the consumer, and to stop the reader thread
+static HANDLE wake_event = NULL;
+static HANDLE stop_event = NULL;
+
+// Console input records read ahead, handed out one at a time
+#define INPUT_RECORD_BATCH 512
+static INPUT_RECORD input_records[INPUT_RECORD_BATCH];
+static DWORD record_head = 0;
+static DWORD record_count = 0;
+// High surrogate waiting for its low half, which may come with the next batch
+static WORD pending_high_surrogate = 0;
 
 typedef struct
 {
-    WORD vk_code;
-    const BYTE *utf8_buf;
-    size_t buf_len;
+    BYTE buf_len;
+    BYTE utf8_buf[4];
 } VkToUtf8Map;
 
-const VkToUtf8Map vk_utf8_map[] = {
-    {VK_UP, VK_UP_UTF8, sizeof(VK_UP_UTF8)},
-    {VK_DOWN, VK_DOWN_UTF8, sizeof(VK_DOWN_UTF8)},
-    {VK_LEFT, VK_LEFT_UTF8, sizeof(VK_LEFT_UTF8)},
-    {VK_RIGHT, VK_RIGHT_UTF8, sizeof(VK_RIGHT_UTF8)},
-    {VK_BACK, VK_BACK_UTF8, sizeof(VK_BACK_UTF8)},
-    {VK_TAB, VK_TAB_UTF8, sizeof(VK_TAB_UTF8)},
-    {VK_ESCAPE, VK_ESCAPE_UTF8, sizeof(VK_ESCAPE_UTF8)},
-    {VK_DELETE, VK_DELETE_UTF8, sizeof(VK_DELETE_UTF8)},
-    {VK_HOME, VK_HOME_UTF8, sizeof(VK_HOME_UTF8)},
-    {VK_END, VK_END_UTF8, sizeof(VK_END_UTF8)},
-    {VK_ENTER, VK_ENTER_UTF8, sizeof(VK_ENTER_UTF8)},
+// Bytes sent for the common virtual keys, indexed by virtual key code
+static const VkToUtf8Map vk_utf8_table[256] = {
+    [VK_UP] = {3, {0x1B, 0x5B, 0x41}},           // ESC [ A
+    [VK_DOWN] = {3, {0x1B, 0x5B, 0x42}},         // ESC [ B
+    [VK_LEFT] = {3, {0x1B, 0x5B, 0x44}},         // ESC [ D
+    [VK_RIGHT] = {3, {0x1B, 0x5B, 0x43}},        // ESC [ C
+    [VK_ESCAPE] = {1, {0x1B}},                   // ESC
+    [VK_BACK] = {1, {0x08}},                     // Backspace
+    [VK_DELETE] = {4, {0x1B, 0x5B, 0x33, 0x7E}}, // ESC [ 3 ~
+    [VK_HOME] = {3, {0x1B, 0x5B, 0x48}},         // ESC [ H
+    [VK_END] = {3, {0x1B, 0x5B, 0x46}},          // ESC [ F
+    [VK_TAB] = {1, {0x09}},                      // Tab
+    [VK_ENTER] = {1, {0x0A}},                    // LF
 };
 
-static int vk_map_count = sizeof(vk_utf8_map) / sizeof(VkToUtf8Map);
-
 BOOL isCommonVirtualKey(WORD vkCode)
 {
-    switch (vkCode)
-    {
-    case VK_BACK:
-    case VK_TAB:
-    case VK_ENTER:
-    case VK_ESCAPE:
-    case VK_DELETE:
-    case VK_UP:
-    case VK_DOWN:
-    case VK_LEFT:
-    case VK_RIGHT:
-    case VK_HOME:
-    case VK_END:
-        return TRUE;
-    default:
-        return 0;
-    }
+    return vkCode < 256 && vk_utf8_table[vkCode].buf_len != 0;
 }
 
 BOOL WINAPI CtrlHandler(DWORD fdwCtrlType);
+static bool waitConsoleKey(DWORD dwTimeoutMs);
+static void startReaderThread();
+static void stopReaderThread();
+
+/**
+ * Writes a control sequence to the console, if it processes VT sequences.
+ * @return TRUE if written
+ */
+static BOOL writeTerminal(const char *sequence)
+{
+    HANDLE h_output = GetStdHandle(STD_OUTPUT_HANDLE);
+    DWORD output_mode = 0;
+    if (h_output == INVALID_HANDLE_VALUE || !GetConsoleMode(h_output, &output_mode) ||
+        !(output_mode & ENABLE_VIRTUAL_TERMINAL_PROCESSING))
+    {
+        return FALSE;
+    }
+    DWORD written = 0;
+    return WriteFile(h_output, sequence, (DWORD)strlen(sequence), &written, NULL);
+}
 
 int enterRaw()
 {
@@ -103,7 +156,13 @@ int enterRaw()
         raw_mode &= ~ENABLE_LINE_INPUT;
         raw_mode &= ~ENABLE_MOUSE_INPUT;
         raw_mode &= ~ENABLE_WINDOW_INPUT;
-        if (!SetConsoleMode(h_console, raw_mode))
+        // Keys then arrive as VT sequences, which is how bracketed paste markers are sent.
+        // Consoles without VT input keep sending virtual keys, and get no paste markers.
+        if (SetConsoleMode(h_console, raw_mode | ENABLE_VIRTUAL_TERMINAL_INPUT))
+        {
+            paste_mode = writeTerminal(PASTE_MODE_ON);
+        }
+        else if (!SetConsoleMode(h_console, raw_mode))
         {
             return FALSE;
         }
@@ -114,6 +173,7 @@ int enterRaw()
         }
         flag = 1;
     }
+    startReaderThread();
     return TRUE;
 }
 
@@ -121,6 +181,13 @@ void exitRaw()
 {
     if (flag)
     {
+        // Console input goes back to whoever runs next, such as an interactive shell command
+        stopReaderThread();
+        if (paste_mode)
+        {
+            writeTerminal(PASTE_MODE_OFF);
+            paste_mode = 0;
+        }
         SetConsoleMode(h_console, origin_mode);
         SetConsoleCtrlHandler(CtrlHandler, FALSE);
         flag = 0;
@@ -143,6 +210,63 @@ BOOL WINAPI CtrlHandler(DWORD fdwCtrlType)
     }
 }
 
+/**
+ * Takes the next console input record. Once the records read ahead are drained,
+ * every pending event, up to INPUT_RECORD_BATCH, is read with one call.
+ * Waits for an event only when none is pending.
+ *
+ * @param record Output for the record
+ * @return TRUE on success, FALSE on error or when asked to stop
+ */
+static BOOL nextInputRecord(INPUT_RECORD *record)
+{
+    if (record_head == record_count)
+    {
+        // The stop event ends the wait of the reader thread, see stopReaderThread
+        if (stop_event != NULL)
+        {
+            HANDLE handles[2] = {h_console, stop_event};
+            if (WaitForMultipleObjects(2, handles, FALSE, INFINITE) != WAIT_OBJECT_0)
+            {
+                return FALSE;
+            }
+        }
+        DWORD pending = 0;
+        if (!GetNumberOfConsoleInputEvents(h_console, &pending) || pending == 0)
+        {
+            pending = 1; // Wait for the next one
+        }
+        if (pending > INPUT_RECORD_BATCH)
+        {
+            pending = INPUT_RECORD_BATCH;
+        }
+        DWORD eventsRead = 0;
+        if (!ReadConsoleInputW(h_console, input_records, pending, &eventsRead) || eventsRead == 0)
+        {
+            return FALSE;
+        }
+        record_head = 0;
+        record_count = eventsRead;
+    }
+    *record = input_records[record_head++];
+    return TRUE;
+}
+
+/**
+ * Checks whether a record is a key down that produces input.
+ * Key-up events and other non-input events are skipped by reads.
+ */
+static bool isInputKey(const INPUT_RECORD *record)
+{
+    if (record->EventType != KEY_EVENT || !record->Event.KeyEvent.bKeyDown)
+    {
+        return false;
+    }
+    KEY_EVENT_RECORD keyEvent = record->Event.KeyEvent;
+    // Check if it's an actual character or common virtual key
+    return keyEvent.uChar.UnicodeChar != 0 || isCommonVirtualKey(keyEvent.wVirtualKeyCode);
+}
+
 /*
  *Function: Reads console input characters, compatible with both ASCII and wide characters, and returns results via pointers.
  *Parameter Description:
@@ -159,9 +283,8 @@ BOOL getConsoleChar(WORD *charValuePtr, BOOL *isVirtualPtr)
         return FALSE;
     }
     INPUT_RECORD inputRecord;
-    DWORD eventsRead;
 
-    if (!ReadConsoleInputW(h_console, &inputRecord, 1, &eventsRead) || eventsRead != 1)
+    if (!nextInputRecord(&inputRecord))
     {
         return FALSE;
     }
@@ -240,7 +363,8 @@ int get_codepoint(WORD wchar, DWORD *out_codepoint, WORD *high_surrogate)
         return -1;
     }
 
-    // SINGLE SURROGATE
+    // SINGLE SURROGATE, a high surrogate without its low half is dropped
+    *high_surrogate = 0;
     *out_codepoint = (DWORD)wchar;
     return 0;
 }
@@ -293,18 +417,12 @@ int codepoint_to_utf8(DWORD codepoint, BYTE *out_buf)
 
 int find_vk_utf8(WORD vk_code, BYTE *out_buf)
 {
-    if (out_buf == NULL)
+    if (out_buf == NULL || !isCommonVirtualKey(vk_code))
         return -1;
 
-    for (size_t i = 0; i < vk_map_count; i++)
-    {
-        if (vk_utf8_map[i].vk_code == vk_code)
-        {
-            memcpy(out_buf, vk_utf8_map[i].utf8_buf, vk_utf8_map[i].buf_len);
-            return vk_utf8_map[i].buf_len;
-        }
-    }
-    return -1;
+    const VkToUtf8Map *entry = &vk_utf8_table[vk_code];
+    memcpy(out_buf, entry->utf8_buf, entry->buf_len);
+    return entry->buf_len;
 }
 
 /**
@@ -316,13 +434,11 @@ int rawGetBytes(BYTE *out_bytes)
 {
     if (out_bytes == NULL) return -1;
 
-    WORD high_surrogate = 0;
     while (1)
     {
         INPUT_RECORD inputRecord;
-        DWORD eventsRead;
 
-        if (!ReadConsoleInputW(h_console, &inputRecord, 1, &eventsRead) || eventsRead != 1)
+        if (!nextInputRecord(&inputRecord))
         {
             return -1;
         }
@@ -361,7 +477,7 @@ int rawGetBytes(BYTE *out_bytes)
         if (wchar == 0) continue;
 
         DWORD codepoint;
-        int res = get_codepoint(wchar, &codepoint, &high_surrogate);
+        int res = get_codepoint(wchar, &codepoint, &pending_high_surrogate);
         if (res == 2 || res == 0)
         {
             int size = codepoint_to_utf8(codepoint, out_bytes);
@@ -372,41 +488,129 @@ int rawGetBytes(BYTE *out_bytes)
 }
 
 /**
- * Reads input and returns:
- * - Normal UTF-8 characters as-is
- * - Arrow keys mapped to Unicode arrow symbols (U+2190-U+2193) in UTF-8
- *
- * @param bytes Output buffer (at least 4 bytes)
- * @return Number of bytes written, TRUE on EOF, FALSE on error
+ * Appends bytes to the paste buffer, growing it as needed.
+ * @return true on success, false if out of memory
  */
-int getRawUtf8(BYTE *bytes)
+static bool appendPaste(const BYTE *data, size_t len)
 {
-    if (bytes == NULL)
+    if (paste_length + len > paste_capacity)
     {
-        return -1;
+        size_t capacity = paste_capacity ? paste_capacity : PASTE_INITIAL_CAPACITY;
+        while (capacity < paste_length + len)
+        {
+            capacity *= 2;
+        }
+        BYTE *grown = (BYTE *)realloc(paste_buffer, capacity);
+        if (grown == NULL)
+        {
+            return false;
+        }
+        paste_buffer = grown;
+        paste_capacity = capacity;
     }
-    int size = rawGetBytes(bytes);
-    if (size < 0)
+    memcpy(paste_buffer + paste_length, data, len);
+    paste_length += len;
+    return true;
+}
+
+/**
+ * Reads the text of a bracketed paste up to ESC [ 201 ~, after ESC [ 200 ~ was read.
+ * @return TRUE on success, FALSE on error or if memory ran out
+ */
+static BOOL readPaste()
+{
+    size_t matched = 0; // Bytes of PASTE_END matched so far
+    BYTE chunk[8];
+    paste_length = 0;
+
+    while (matched < PASTE_END_SIZE)
     {
-        return -1;
+        int size = rawGetBytes(chunk);
+        if (size < 0)
+        {
+            return FALSE;
+        }
+        for (int i = 0; i < size && matched < PASTE_END_SIZE; i++)
+        {
+            if (chunk[i] == (BYTE)PASTE_END[matched])
+            {
+                matched++;
+                continue;
+            }
+            // Not the end marker after all, the bytes matched so far are text
+            if (!appendPaste((const BYTE *)PASTE_END, matched))
+            {
+                return FALSE;
+            }
+            matched = chunk[i] == 0x1b ? 1 : 0;
+            if (matched == 0 && !appendPaste(&chunk[i], 1))
+            {
+                return FALSE;
+            }
+        }
     }
+    return normalizePasteText(&paste_buffer, &paste_length, &paste_capacity);
+}
+
+/**
+ * Reads the rest of a VT escape sequence after its ESC, as sent with
+ * ENABLE_VIRTUAL_TERMINAL_INPUT. Waits up to 10ms for the byte after ESC,
+ * so a lone ESC stays a key.
+ *
+ * @param seq Output for the sequence, starting with ESC
+ * @param cap Size of seq
+ * @return Length of the sequence, 1 for a lone ESC or an unknown sequence
+ */
+static int readVtSequence(BYTE *seq, int cap)
+{
+    BYTE chunk[8];
+    int len = 1;
+    seq[0] = 0x1b;
 
-    BYTE c = bytes[0];
+    if (!waitConsoleKey(10))
+    { // Just ESC
+        return 1;
+    }
+    if (rawGetBytes(chunk) != 1 || chunk[0] != 0x5b)
+    {
+        return 1; // Unknown escaped chars
+    }
+    seq[len++] = 0x5b;
 
-    // --- 0. Escape Sequence (Special Keys) ---
-    if (c == 0x1b)
-    { // ESC
-        if (size == 1)
-        { // Just ESC
+    // CSI: parameter bytes, then a final byte in 0x40-0x7E
+    while (len < cap)
+    {
+        if (rawGetBytes(chunk) != 1)
+        {
             return 1;
         }
-        c = bytes[1];
-        if (c != 0x5b)
+        seq[len++] = chunk[0];
+        if (chunk[0] >= 0x40 && chunk[0] <= 0x7E)
         {
-            return 1; // Just ESC
+            return len;
         }
-        c = bytes[2];
-        switch (c)
+    }
+    return 1;
+}
+
+/**
+ * Maps an escape sequence, from a virtual key or VT input, to the key returned by getRawUtf8.
+ * @param seq Escape sequence, starting with ESC
+ * @param size Length of seq
+ * @param bytes Output buffer (at least 4 bytes)
+ * @return Number of bytes written, 0 for an unknown sequence
+ */
+static int decodeEscapeSequence(const BYTE *seq, int size, BYTE *bytes)
+{
+    bytes[0] = 0x1b;
+    if (size < 3 || seq[1] != 0x5b)
+    {
+        return 1; // Just ESC
+    }
+
+    if (size == 3)
+    {
+        switch (seq[2])
         {
         case 'A':            // Up Arrow → U+2191 ↑
             bytes[0] = 0xE2; // UTF-8 for U+2191
@@ -440,26 +644,131 @@ int getRawUtf8(BYTE *bytes)
             bytes[0] = 0x05;
             return 1;
 
-        case '3':                              // Delete key: ESC [ 3 ~ → U+2326 (⌦ ERASE TO THE RIGHT)
-            if (size >= 4 && bytes[3] == 0x7E) // Verify it's ESC [ 3 ~
-            {
-                bytes[0] = 0xE2; // UTF-8 encoding of U+2326
-                bytes[1] = 0x8C;
-                bytes[2] = 0xA6;
-                return 3;
-            }
-            return 0; // Invalid sequence
-
         default:
             return 0; // Unknown CSI
         }
     }
 
+    if (size == 4 && seq[2] == '3' && seq[3] == 0x7E)
+    {                    // Delete key: ESC [ 3 ~ → U+2326 (⌦ ERASE TO THE RIGHT)
+        bytes[0] = 0xE2; // UTF-8 encoding of U+2326
+        bytes[1] = 0x8C;
+        bytes[2] = 0xA6;
+        return 3;
+    }
+
+    if (size == 6 && memcmp(&seq[2], "1;5", 3) == 0)
+    { // Ctrl+Arrow from VT input: ESC [ 1 ; 5 C/D
+        if (seq[5] == 'C')
+        { // Ctrl+Right → U+27A1
+            bytes[0] = 0xE2;
+            bytes[1] = 0x9E;
+            bytes[2] = 0xA1;
+            return 3;
+        }
+        if (seq[5] == 'D')
+        { // Ctrl+Left → U+2B05
+            bytes[0] = 0xE2;
+            bytes[1] = 0xAC;
+            bytes[2] = 0x85;
+            return 3;
+        }
+        return 0;
+    }
+
+    if (size == 6 && memcmp(&seq[2], "200~", 4) == 0)
+    { // Bracketed paste: ESC [ 200 ~ ... ESC [ 201 ~
+        if (!readPaste())
+        {
+            return 0;
+        }
+        paste_pending = true;
+        bytes[0] = 0xEE; // UTF-8 for U+E000, the paste key
+        bytes[1] = 0x80;
+        bytes[2] = 0x80;
+        return 3;
+    }
+
+    return 0; // Unknown CSI
+}
+
+/**
+ * Decodes the next key from the console, as described for getRawUtf8.
+ *
+ * @param bytes Output buffer (at least 4 bytes)
+ * @return Number of bytes written, 0 for an unknown sequence, -1 on error
+ */
+static int decodeKey(BYTE *bytes)
+{
+    int size = rawGetBytes(bytes);
+    if (size < 0)
+    {
+        return -1;
+    }
+
+    // --- 0. Escape Sequence (Special Keys) ---
+    if (bytes[0] == 0x1b)
+    { // ESC, either a whole sequence from a virtual key or the start of a VT one
+        BYTE seq[16];
+        if (size == 1)
+        {
+            size = readVtSequence(seq, sizeof(seq));
+        }
+        else
+        {
+            memcpy(seq, bytes, size);
+        }
+        return decodeEscapeSequence(seq, size, bytes);
+    }
+
     return size;
 }
 
-bool checkHasInput(uint32_t dwTimeoutMs)
+/**
+ * Checks the records read ahead, then the pending console events, for a key down
+ * that produces input, without waiting.
+ */
+static bool hasPendingKey()
+{
+    for (DWORD i = record_head; i < record_count; i++)
+    {
+        if (isInputKey(&input_records[i]))
+        {
+            return true;
+        }
+    }
+
+    INPUT_RECORD inputRecords[128];
+    DWORD eventsRead;
+
+    if (!PeekConsoleInputW(h_console, inputRecords, 128, &eventsRead) || eventsRead == 0)
+    {
+        return false;
+    }
+
+    for (DWORD i = 0; i < eventsRead; i++)
+    {
+        if (isInputKey(&inputRecords[i]))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Waits for a console key that produces input.
+ * @param dwTimeoutMs Timeout in milliseconds (0 for infinite)
+ */
+static bool waitConsoleKey(DWORD dwTimeoutMs)
 {
+    // Records read ahead no longer signal the console handle
+    if (hasPendingKey())
+    {
+        return true;
+    }
+
     DWORD waitTime = (dwTimeoutMs == 0) ? INFINITE_VALUE : dwTimeoutMs;
     DWORD waitResult = WaitForSingleObject(h_console, waitTime);
 
@@ -468,31 +777,330 @@ bool checkHasInput(uint32_t dwTimeoutMs)
         return false;
     }
 
-    // Peek at console input to check for valid key events
-    // We need to filter out key-up events and other non-input events
-    INPUT_RECORD inputRecords[128];
-    DWORD eventsRead;
+    return hasPendingKey();
+}
 
-    if (!PeekConsoleInputW(h_console, inputRecords, 128, &eventsRead) || eventsRead == 0)
+/**
+ * Decodes the next key into an event, taking the text of a paste key along.
+ */
+static void decodeKeyEvent(KeyEvent *event)
+{
+    event->length = decodeKey(event->bytes);
+    event->paste = NULL;
+    event->paste_length = 0;
+    if (paste_pending)
+    {
+        event->paste = paste_buffer;
+        event->paste_length = paste_length;
+        paste_buffer = NULL;
+        paste_length = 0;
+        paste_capacity = 0;
+        paste_pending = false;
+    }
+}
+
+/**
+ * Queues a key for the consumer, waiting while the queue is full.
+ * Called by the reader thread only.
+ * @return TRUE on success, FALSE if asked to stop
+ */
+static BOOL pushKey(const KeyEvent *event)
+{
+    size_t write_index = atomic_load_explicit(&queue_write, memory_order_relaxed);
+    while (write_index - atomic_load_explicit(&queue_read, memory_order_acquire) == KEY_QUEUE_SIZE)
+    {
+        if (WaitForSingleObject(stop_event, 1) == WAIT_OBJECT_0)
+        {
+            return FALSE;
+        }
+    }
+    key_queue[write_index & (KEY_QUEUE_SIZE - 1)] = *event;
+    atomic_store_explicit(&queue_write, write_index + 1, memory_order_release);
+    SetEvent(wake_event);
+    return TRUE;
+}
+
+/**
+ * Takes the oldest queued key without waiting. Called by the consumer only.
+ * @return true on success, false if the queue is empty
+ */
+static bool popKey(KeyEvent *event)
+{
+    size_t read_index = atomic_load_explicit(&queue_read, memory_order_relaxed);
+    if (read_index == atomic_load_explicit(&queue_write, memory_order_acquire))
     {
         return false;
     }
+    *event = key_queue[read_index & (KEY_QUEUE_SIZE - 1)];
+    atomic_store_explicit(&queue_read, read_index + 1, memory_order_release);
+    return true;
+}
 
-    // Check if there's any valid key down event with actual input
-    for (DWORD i = 0; i < eventsRead; i++)
+static bool queueEmpty()
+{
+    return atomic_load_explicit(&queue_read, memory_order_relaxed) ==
+           atomic_load_explicit(&queue_write, memory_order_acquire);
+}
+
+/**
+ * Checks whether keys come from the queue: while the reader thread runs,
+ * and after it stopped until the keys it queued are taken.
+ */
+static bool queueMode()
+{
+    return reader_running || !queueEmpty();
+}
+
+/**
+ * Waits for a queued key.
+ * @param dwTimeoutMs Timeout in milliseconds (INFINITE_VALUE for infinite)
+ * @return true if a key is queued, false on timeout or once the reader thread is done
+ */
+static bool waitKeyQueued(DWORD dwTimeoutMs)
+{
+    while (queueEmpty())
+    {
+        if (!reader_running || atomic_load(&reader_done))
+        {
+            return false;
+        }
+        if (WaitForSingleObject(wake_event, dwTimeoutMs) != WAIT_OBJECT_0)
+        {
+            return !queueEmpty();
+        }
+    }
+    return true;
+}
+
+/**
+ * Takes the next key, from the queue or decoded in place. Waits as long as needed.
+ */
+static void nextKeyEvent(KeyEvent *event)
+{
+    if (queueMode())
+    {
+        if (!waitKeyQueued(INFINITE_VALUE) || !popKey(event))
+        {
+            // The reader thread stopped at an error and its keys are taken
+            event->length = -1;
+            event->paste = NULL;
+        }
+        return;
+    }
+    decodeKeyEvent(event);
+}
+
+/**
+ * Checks whether a key can be taken without waiting.
+ */
+static bool keyPending()
+{
+    return queueMode() ? !queueEmpty() : hasPendingKey();
+}
+
+/**
+ * Writes a key to the caller's buffer and hands the text of a paste key on to takePaste.
+ * @return Length of the key, as in KeyEvent
+ */
+static int deliverKey(const KeyEvent *event, BYTE *bytes)
+{
+    if (event->length > 0)
+    {
+        memcpy(bytes, event->bytes, event->length);
+    }
+    if (event->paste != NULL)
+    {
+        free(ready_paste); // Not taken, replaced by the newer paste
+        ready_paste = event->paste;
+        ready_paste_length = event->paste_length;
+    }
+    return event->length;
+}
+
+static DWORD WINAPI readerMain(LPVOID arg)
+{
+    (void)arg;
+    while (WaitForSingleObject(stop_event, 0) != WAIT_OBJECT_0)
+    {
+        KeyEvent event;
+        decodeKeyEvent(&event);
+        if (event.length == 0)
+        {
+            continue; // Unknown sequence, skipped
+        }
+        if (event.length == -1 && WaitForSingleObject(stop_event, 0) == WAIT_OBJECT_0)
+        {
+            break; // Woken up by stopReaderThread, not a read error
+        }
+        if (!pushKey(&event))
+        {
+            free(event.paste);
+            break;
+        }
+        if (event.length == -1)
+        {
+            atomic_store(&reader_done, true);
+            break;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Starts the reader thread if it is enabled and not running yet.
+ */
+static void startReaderThread()
+{
+    if (!reader_enabled || reader_running)
+    {
+        return;
+    }
+    if (wake_event == NULL)
+    {
+        wake_event = CreateEventW(NULL, FALSE, FALSE, NULL);
+    }
+    if (stop_event == NULL)
+    {
+        stop_event = CreateEventW(NULL, TRUE, FALSE, NULL);
+    }
+    if (wake_event == NULL || stop_event == NULL)
+    {
+        return;
+    }
+    atomic_store(&reader_done, false);
+    reader_thread = CreateThread(NULL, 0, readerMain, NULL, 0, NULL);
+    reader_running = reader_thread != NULL;
+}
+
+/**
+ * Stops the reader thread and waits for it. Keys it queued are still taken first.
+ */
+static void stopReaderThread()
+{
+    if (!reader_running)
+    {
+        return;
+    }
+    SetEvent(stop_event);
+    WaitForSingleObject(reader_thread, INFINITE);
+    CloseHandle(reader_thread);
+    ResetEvent(stop_event); // Direct reads wait on it too
+    reader_thread = NULL;
+    reader_running = false;
+}
+
+/**
+ * Turns the reader thread on or off. While on and in raw mode, a thread blocks on the
+ * console, decodes keys as they arrive and queues them, so checking for a key costs no
+ * system call. exitRaw stops the thread so console input can be handed to other programs,
+ * enterRaw restarts it. Keys must then be taken by one thread at a time.
+ *
+ * @param enabled Whether to run the reader thread
+ */
+void setInputThread(bool enabled)
+{
+    reader_enabled = enabled;
+    if (enabled && flag)
+    {
+        startReaderThread();
+    }
+    else if (!enabled)
+    {
+        stopReaderThread();
+    }
+}
+
+/**
+ * Reads input and returns:
+ * - Normal UTF-8 characters as-is
+ * - Arrow keys mapped to Unicode arrow symbols (U+2190-U+2193) in UTF-8
+ * - A bracketed paste as U+E000, its text is taken with takePaste
+ *
+ * @param bytes Output buffer (at least 4 bytes)
+ * @return Number of bytes written, TRUE on EOF, FALSE on error
+ */
+int getRawUtf8(BYTE *bytes)
+{
+    if (bytes == NULL)
+    {
+        return -1;
+    }
+    KeyEvent event;
+    nextKeyEvent(&event);
+    return deliverKey(&event, bytes);
+}
+
+bool checkHasInput(uint32_t dwTimeoutMs)
+{
+    if (queueMode())
+    {
+        return waitKeyQueued((dwTimeoutMs == 0) ? INFINITE_VALUE : dwTimeoutMs);
+    }
+    return waitConsoleKey(dwTimeoutMs);
+}
+
+/**
+ * Reads every key already typed or pasted in one call, each decoded as by getRawUtf8
+ * and written back to back. Waits for the first key only, then stops once no key is
+ * pending, buf is full or a paste key was written.
+ *
+ * @param buf Output buffer (at least 4 bytes)
+ * @param cap Size of buf
+ * @param out_count Output for the number of keys written
+ * @return Number of bytes written, -1 on error
+ */
+intptr_t getRawUtf8Batch(BYTE *buf, size_t cap, size_t *out_count)
+{
+    size_t length = 0;
+    size_t count = 0;
+
+    if (buf == NULL || out_count == NULL || cap < 4)
+    {
+        return -1;
+    }
+    *out_count = 0;
+
+    while (cap - length >= 4 && (count == 0 || keyPending()))
     {
-        if (inputRecords[i].EventType == KEY_EVENT && inputRecords[i].Event.KeyEvent.bKeyDown)
+        KeyEvent event;
+        nextKeyEvent(&event);
+        int size = deliverKey(&event, &buf[length]);
+        if (size < 0)
         {
-            KEY_EVENT_RECORD keyEvent = inputRecords[i].Event.KeyEvent;
-            // Check if it's an actual character or common virtual key
-            if (keyEvent.uChar.UnicodeChar != 0 || isCommonVirtualKey(keyEvent.wVirtualKeyCode))
+            if (count == 0)
             {
-                return true;
+                return -1;
             }
+            break; // Keep the keys read so far, the next call reports the error
+        }
+        if (size == 0)
+        {
+            continue; // Unknown sequence, skipped
+        }
+        length += (size_t)size;
+        count++;
+        if (event.paste != NULL)
+        {
+            break; // One paste per batch, takePaste holds a single text
         }
     }
 
-    return false;
+    *out_count = count;
+    return (intptr_t)length;
+}
+
+/**
+ * Gets a decoded key as a byte, as getByte returns it.
+ */
+static int keyToByte(const KeyEvent *event, WORD *keyCode)
+{
+    free(event->paste); // A paste is not a byte
+    if (event->length == 1 && event->bytes[0] <= 0x7F)
+    {
+        *keyCode = (WORD)event->bytes[0];
+        return 1;
+    }
+    return event->length > 0 ? 2 : -1;
 }
 
 /**
@@ -504,18 +1112,73 @@ bool checkHasInput(uint32_t dwTimeoutMs)
  */
 int getByte(DWORD dwTimeoutMs, WORD *keyCode)
 {
-    if (!checkHasInput(dwTimeoutMs))
+    if (queueMode())
+    { // Keys are decoded by the reader thread, so ESC means the ESC key only
+        KeyEvent event;
+        if (!waitKeyQueued((dwTimeoutMs == 0) ? INFINITE_VALUE : dwTimeoutMs) || !popKey(&event))
+        {
+            return -1;
+        }
+        return keyToByte(&event, keyCode);
+    }
+
+    if (!waitConsoleKey(dwTimeoutMs))
     {
         return -1;
     }
-    BOOL isVirtual = FALSE;
-    if (!getConsoleChar(keyCode, &isVirtual))
+    // Decoded as the reader thread would, so with VT input an arrow key or a
+    // bracketed paste never surfaces as a bare ESC
+    KeyEvent event;
+    decodeKeyEvent(&event);
+    return keyToByte(&event, keyCode);
+}
+
+/**
+ * Takes a key the reader thread already queued, without waiting or any system call.
+ *
+ * @param keyCode Output for an ASCII key
+ * @return As getByte, 0 if no key is queued, -2 if the reader thread is not running
+ */
+int getQueuedByte(WORD *keyCode)
+{
+    KeyEvent event;
+    if (!queueMode())
     {
-        return -1;
+        return -2;
     }
-    if (is_high_surrogate(*keyCode) || is_low_surrogate(*keyCode))
+    if (!popKey(&event))
     {
-        return 2;
+        return atomic_load(&reader_done) ? -1 : 0;
     }
-    return 1;
-}
\ No newline at end of file
+    return keyToByte(&event, keyCode);
+}
+
+/**
+ * Gets the length of the text of the last bracketed paste, once its key was read.
+ * @return Length in bytes, 0 if there is none
+ */
+size_t getPasteLength()
+{
+    return ready_paste_length;
+}
+
+/**
+ * Copies the text of the last bracketed paste and releases it.
+ * The text is valid UTF-8 with LF line endings.
+ *
+ * @param buf Output buffer, getPasteLength() bytes
+ * @param cap Size of buf
+ * @return Number of bytes copied
+ */
+size_t takePaste(BYTE *buf, size_t cap)
+{
+    size_t len = ready_paste_length < cap ? ready_paste_length : cap;
+    if (buf != NULL && len > 0)
+    {
+        memcpy(buf, ready_paste, len);
+    }
+    free(ready_paste);
+    ready_paste = NULL;
+    ready_paste_length = 0;
+    return buf != NULL ? len : 0;
+}
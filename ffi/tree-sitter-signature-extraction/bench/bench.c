@@ -0,0 +1,509 @@
+// Throughput and latency benchmark of the signature extraction library.
+// Runs every benchmark over a sample corpus plus generated large Java and Python files and
+// prints one JSON object per benchmark, so results of two commits can be compared line by line.
+//
+//   bench [--corpus DIR] [--work DIR] [--synthetic-lines N] [--iterations N] [--label TEXT] [--output FILE]
+
+#include "signature_extractor.h"
+#include "extractor_context.h"
+#include "skeleton_batch.h"
+#include "skeleton_cache.h"
+#include "skeleton_doc.h"
+#include "syntax_check.h"
+#include "utils.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+// A file of the benchmark set
+typedef struct {
+    char* path;
+    const char* language;
+    size_t size;
+} bench_file_t;
+
+typedef struct {
+    bench_file_t* files;
+    int count;
+    int capacity;
+    uint64_t total_bytes;
+} bench_set_t;
+
+// Latencies and volume of one benchmark
+typedef struct {
+    const char* name;
+    double* samples;                 // Seconds per call
+    size_t count;
+    size_t capacity;
+    uint64_t files;
+    uint64_t bytes;
+    double seconds;
+} bench_result_t;
+
+typedef struct {
+    const char* corpus;
+    const char* work;
+    int synthetic_lines;
+    int iterations;
+    const char* label;
+    FILE* output;
+} bench_options_t;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static long peak_rss_kb(void) {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#if defined(__APPLE__)
+    return usage.ru_maxrss / 1024; // Bytes on macOS
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+static int add_file(bench_set_t* set, const char* path) {
+    const char* language = get_language_for_path(path);
+    if (!language) {
+        return 0;
+    }
+    size_t size = 0;
+    char* data = read_file(path, &size);
+    if (!data) {
+        fprintf(stderr, "Cannot read %s\n", path);
+        return -1;
+    }
+    free(data);
+
+    if (set->count == set->capacity) {
+        int capacity = set->capacity ? set->capacity * 2 : 16;
+        bench_file_t* files = (bench_file_t*)realloc(set->files, capacity * sizeof(bench_file_t));
+        if (!files) {
+            return -1;
+        }
+        set->files = files;
+        set->capacity = capacity;
+    }
+    bench_file_t* file = &set->files[set->count++];
+    file->path = (char*)malloc(strlen(path) + 1);
+    if (!file->path) {
+        set->count--;
+        return -1;
+    }
+    strcpy(file->path, path);
+    file->language = language;
+    file->size = size;
+    set->total_bytes += size;
+    return 0;
+}
+
+static int add_corpus(bench_set_t* set, const char* directory) {
+    DIR* dir = opendir(directory);
+    if (!dir) {
+        fprintf(stderr, "Cannot open corpus %s\n", directory);
+        return -1;
+    }
+    struct dirent* entry;
+    char path[4096];
+    int status = 0;
+    while (status == 0 && (entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+        snprintf(path, sizeof(path), "%s/%s", directory, entry->d_name);
+        status = add_file(set, path);
+    }
+    closedir(dir);
+    return status;
+}
+
+// Write a Java file of about lines lines: classes of methods with a nested class and a lambda each
+static int write_synthetic_java(const char* path, int lines) {
+    FILE* out = fopen(path, "w");
+    if (!out) {
+        return -1;
+    }
+    fprintf(out, "package bench.synthetic;\n\nimport java.util.List;\nimport java.util.function.Supplier;\n\n");
+    int written = 5;
+    for (int c = 0; written < lines; c++) {
+        fprintf(out, "public class Generated%d<T extends Comparable<T>> extends Base implements Runnable {\n", c);
+        fprintf(out, "    private final List<T> items;\n\n");
+        written += 3;
+        for (int m = 0; m < 20 && written < lines; m++) {
+            fprintf(out, "    @Override\n    public synchronized <R> R method%d(List<T> input, int limit) throws Exception {\n", m);
+            fprintf(out, "        int total = 0;\n        for (int i = 0; i < limit; i++) {\n");
+            fprintf(out, "            total += input.get(i).hashCode() * %d;\n        }\n", m + 1);
+            fprintf(out, "        Supplier<Integer> supplier = () -> total;\n        return null;\n    }\n\n");
+            written += 11;
+        }
+        fprintf(out, "    static class Nested%d {\n        void run() {\n        }\n    }\n}\n\n", c);
+        written += 6;
+    }
+    return fclose(out) == 0 ? 0 : -1;
+}
+
+// Write a Python file of about lines lines: classes of methods with a nested function each
+static int write_synthetic_python(const char* path, int lines) {
+    FILE* out = fopen(path, "w");
+    if (!out) {
+        return -1;
+    }
+    fprintf(out, "import os\nfrom typing import List, Optional\n\n\n");
+    int written = 4;
+    for (int c = 0; written < lines; c++) {
+        fprintf(out, "class Generated%d(Base, metaclass=Meta):\n    \"\"\"Generated class %d.\"\"\"\n\n", c, c);
+        written += 3;
+        for (int m = 0; m < 20 && written < lines; m++) {
+            fprintf(out, "    def method%d(self, items: List[int], limit: Optional[int] = None) -> int:\n", m);
+            fprintf(out, "        total = 0\n        for item in items[:limit]:\n            total += item * %d\n", m + 1);
+            fprintf(out, "        def helper(value):\n            return value + total\n");
+            fprintf(out, "        return helper(total)\n\n");
+            written += 9;
+        }
+        fprintf(out, "\n");
+        written++;
+    }
+    return fclose(out) == 0 ? 0 : -1;
+}
+
+static void record(bench_result_t* result, double seconds, uint64_t files, uint64_t bytes) {
+    if (result->count == result->capacity) {
+        size_t capacity = result->capacity ? result->capacity * 2 : 256;
+        double* samples = (double*)realloc(result->samples, capacity * sizeof(double));
+        if (!samples) {
+            return;
+        }
+        result->samples = samples;
+        result->capacity = capacity;
+    }
+    result->samples[result->count++] = seconds;
+    result->files += files;
+    result->bytes += bytes;
+    result->seconds += seconds;
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+// Nearest-rank percentile of sorted samples
+static double percentile(const double* sorted, size_t count, double q) {
+    if (count == 0) {
+        return 0;
+    }
+    size_t rank = (size_t)(q * (double)count + 0.999999);
+    if (rank < 1) {
+        rank = 1;
+    }
+    return sorted[(rank > count ? count : rank) - 1];
+}
+
+static void print_json_string(FILE* out, const char* text) {
+    fputc('"', out);
+    for (const char* c = text; c && *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            fputc('\\', out);
+        }
+        if ((unsigned char)*c >= 0x20) {
+            fputc(*c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+static void report(const bench_options_t* options, bench_result_t* result) {
+    qsort(result->samples, result->count, sizeof(double), compare_doubles);
+    double seconds = result->seconds > 0 ? result->seconds : 1e-9;
+    FILE* out = options->output;
+    fprintf(out, "{\"label\":");
+    print_json_string(out, options->label);
+    fprintf(out, ",\"benchmark\":");
+    print_json_string(out, result->name);
+    fprintf(out, ",\"calls\":%zu,\"files\":%llu,\"bytes\":%llu,\"seconds\":%.6f", result->count,
+            (unsigned long long)result->files, (unsigned long long)result->bytes, result->seconds);
+    fprintf(out, ",\"files_per_sec\":%.1f,\"mb_per_sec\":%.2f", (double)result->files / seconds,
+            (double)result->bytes / (1024.0 * 1024.0) / seconds);
+    fprintf(out, ",\"p50_ms\":%.3f,\"p99_ms\":%.3f,\"peak_rss_kb\":%ld}\n",
+            percentile(result->samples, result->count, 0.50) * 1000.0,
+            percentile(result->samples, result->count, 0.99) * 1000.0, peak_rss_kb());
+    fflush(out);
+    free(result->samples);
+    result->samples = NULL;
+}
+
+// Every call parses, the cache is emptied before each one
+static void bench_cold(const bench_options_t* options, const bench_set_t* set, const char* name, int ranged) {
+    bench_result_t result = { .name = name };
+    for (int iteration = 0; iteration < options->iterations; iteration++) {
+        for (int i = 0; i < set->count; i++) {
+            const bench_file_t* file = &set->files[i];
+            clear_skeleton_cache();
+            double start = now_seconds();
+            char* xml = ranged ? get_skeleton_xml_range(file->path, file->language, 1, 200)
+                               : get_skeleton_xml_with_errors(file->path, file->language, -1, -1);
+            record(&result, now_seconds() - start, 1, file->size);
+            free(xml);
+        }
+    }
+    report(options, &result);
+}
+
+// Every call after the first one of a file is a cache hit
+static void bench_warm(const bench_options_t* options, const bench_set_t* set, const char* name, int ranged) {
+    bench_result_t result = { .name = name };
+    clear_skeleton_cache();
+    for (int i = 0; i < set->count; i++) {
+        free(get_skeleton_xml_with_errors(set->files[i].path, set->files[i].language, -1, -1));
+    }
+    for (int iteration = 0; iteration < options->iterations * 10; iteration++) {
+        for (int i = 0; i < set->count; i++) {
+            const bench_file_t* file = &set->files[i];
+            double start = now_seconds();
+            char* xml = ranged ? get_skeleton_xml_range(file->path, file->language, 1, 200)
+                               : get_skeleton_xml_with_errors(file->path, file->language, -1, -1);
+            record(&result, now_seconds() - start, 1, file->size);
+            free(xml);
+        }
+    }
+    report(options, &result);
+}
+
+// The whole set in one call of the worker pool, cold
+static void bench_batch(const bench_options_t* options, const bench_set_t* set) {
+    bench_result_t result = { .name = "batch_cold" };
+    const char** paths = (const char**)malloc(set->count * sizeof(const char*));
+    if (!paths) {
+        return;
+    }
+    for (int i = 0; i < set->count; i++) {
+        paths[i] = set->files[i].path;
+    }
+    for (int iteration = 0; iteration < options->iterations; iteration++) {
+        clear_skeleton_cache();
+        double start = now_seconds();
+        char** results = get_skeleton_xml_batch_array(paths, NULL, set->count, 0);
+        record(&result, now_seconds() - start, set->count, set->total_bytes);
+        free_skeleton_xml_batch(results, set->count);
+    }
+    free(paths);
+    report(options, &result);
+}
+
+// Typing one character in the middle of each file and rendering the updated skeleton
+static void bench_incremental(const bench_options_t* options, const bench_set_t* set) {
+    bench_result_t result = { .name = "incremental_edit" };
+    extractor_ctx_t* ctx = extractor_ctx_create();
+    for (int i = 0; ctx && i < set->count; i++) {
+        const bench_file_t* file = &set->files[i];
+        size_t size = 0;
+        char* source = read_file(file->path, &size);
+        char* edited = source ? (char*)malloc(size + 2) : NULL;
+        skeleton_doc_t* doc = edited ? skeleton_doc_open_source(ctx, source, size, file->language) : NULL;
+        if (!doc) {
+            free(source);
+            free(edited);
+            continue;
+        }
+
+        // Insert a space at the start of the middle line, then take it out again
+        const char* middle = memchr(source + size / 2, '\n', size - size / 2);
+        size_t at = middle ? (size_t)(middle - source) + 1 : size;
+        memcpy(edited, source, at);
+        edited[at] = ' ';
+        memcpy(edited + at + 1, source + at, size - at);
+        for (int iteration = 0; iteration < options->iterations * 4; iteration++) {
+            int insert = iteration % 2 == 0;
+            double start = now_seconds();
+            skeleton_doc_apply_edits(ctx, doc, insert ? edited : source, insert ? size + 1 : size, NULL, 0);
+            char* xml = skeleton_doc_get_skeleton_xml(doc, -1, -1);
+            record(&result, now_seconds() - start, 1, file->size);
+            free(xml);
+        }
+        skeleton_doc_close(doc);
+        free(source);
+        free(edited);
+    }
+    extractor_ctx_destroy(ctx);
+    report(options, &result);
+}
+
+// Checking each file for parse errors only, nothing cached. The check of the next file replaces
+// the one kept by the context, so every call parses.
+static void bench_check_cold(const bench_options_t* options, const bench_set_t* set) {
+    bench_result_t result = { .name = "check_errors_cold" };
+    for (int iteration = 0; iteration < options->iterations; iteration++) {
+        for (int i = 0; i < set->count; i++) {
+            const bench_file_t* file = &set->files[i];
+            clear_skeleton_cache();
+            char* errors = NULL;
+            double start = now_seconds();
+            check_syntax_errors(file->path, file->language, &errors);
+            record(&result, now_seconds() - start, 1, file->size);
+            free(errors);
+        }
+    }
+    report(options, &result);
+}
+
+static int write_source(const char* path, const char* source, size_t size) {
+    FILE* out = fopen(path, "wb");
+    if (!out) {
+        return -1;
+    }
+    size_t written = fwrite(source, 1, size, out);
+    return fclose(out) == 0 && written == size ? 0 : -1;
+}
+
+// The fixer loop: a one-character edit in the middle of each file saved to disk, then the file
+// checked again, either for errors only or through the skeleton with errors
+static void bench_check_edit(const bench_options_t* options, const bench_set_t* set, const char* name,
+                             int errors_only) {
+    bench_result_t result = { .name = name };
+    char path[4096];
+    for (int i = 0; i < set->count; i++) {
+        const bench_file_t* file = &set->files[i];
+        const char* extension = strrchr(file->path, '.');
+        snprintf(path, sizeof(path), "%s/check_edit%s", options->work, extension ? extension : "");
+        size_t size = 0;
+        char* source = read_file(file->path, &size);
+        char* edited = source ? (char*)malloc(size + 1) : NULL;
+        if (!edited || write_source(path, source, size) != 0) {
+            free(source);
+            free(edited);
+            continue;
+        }
+
+        // Insert a space at the start of the middle line, then take it out again
+        const char* middle = memchr(source + size / 2, '\n', size - size / 2);
+        size_t at = middle ? (size_t)(middle - source) + 1 : size;
+        memcpy(edited, source, at);
+        edited[at] = ' ';
+        memcpy(edited + at + 1, source + at, size - at);
+        clear_skeleton_cache();
+        char* output = NULL;
+        if (errors_only) {
+            check_syntax_errors(path, file->language, &output);
+        } else {
+            output = get_skeleton_xml_with_errors(path, file->language, -1, -1);
+        }
+        free(output);
+        for (int iteration = 0; iteration < options->iterations * 4; iteration++) {
+            int insert = iteration % 2 == 0;
+            if (write_source(path, insert ? edited : source, insert ? size + 1 : size) != 0) {
+                break;
+            }
+            output = NULL;
+            double start = now_seconds();
+            if (errors_only) {
+                check_syntax_errors(path, file->language, &output);
+            } else {
+                output = get_skeleton_xml_with_errors(path, file->language, -1, -1);
+            }
+            record(&result, now_seconds() - start, 1, file->size);
+            free(output);
+        }
+        remove(path);
+        free(source);
+        free(edited);
+    }
+    report(options, &result);
+}
+
+static int parse_options(int argc, char** argv, bench_options_t* options) {
+    options->corpus = "bench/corpus";
+    options->work = ".";
+    options->synthetic_lines = 100000;
+    options->iterations = 5;
+    options->label = "";
+    options->output = stdout;
+    for (int i = 1; i < argc; i++) {
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!value) {
+            fprintf(stderr, "Missing value for %s\n", argv[i]);
+            return -1;
+        }
+        if (strcmp(argv[i], "--corpus") == 0) {
+            options->corpus = value;
+        } else if (strcmp(argv[i], "--work") == 0) {
+            options->work = value;
+        } else if (strcmp(argv[i], "--synthetic-lines") == 0) {
+            options->synthetic_lines = atoi(value);
+        } else if (strcmp(argv[i], "--iterations") == 0) {
+            options->iterations = atoi(value) > 0 ? atoi(value) : 1;
+        } else if (strcmp(argv[i], "--label") == 0) {
+            options->label = value;
+        } else if (strcmp(argv[i], "--output") == 0) {
+            options->output = fopen(value, "w");
+            if (!options->output) {
+                fprintf(stderr, "Cannot write %s\n", value);
+                return -1;
+            }
+        } else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return -1;
+        }
+        i++;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    bench_options_t options;
+    if (parse_options(argc, argv, &options) != 0) {
+        return 2;
+    }
+
+    bench_set_t set = {0};
+    if (options.corpus[0] && add_corpus(&set, options.corpus) != 0) {
+        return 1;
+    }
+    if (options.synthetic_lines > 0) {
+        char java_path[4096];
+        char python_path[4096];
+        snprintf(java_path, sizeof(java_path), "%s/SyntheticLarge.java", options.work);
+        snprintf(python_path, sizeof(python_path), "%s/synthetic_large.py", options.work);
+        if (write_synthetic_java(java_path, options.synthetic_lines) != 0 ||
+            write_synthetic_python(python_path, options.synthetic_lines) != 0 ||
+            add_file(&set, java_path) != 0 || add_file(&set, python_path) != 0) {
+            fprintf(stderr, "Cannot write synthetic files to %s\n", options.work);
+            return 1;
+        }
+    }
+    if (set.count == 0) {
+        fprintf(stderr, "No Java or Python files to benchmark\n");
+        return 1;
+    }
+
+    bench_cold(&options, &set, "range_cold", 1);
+    bench_cold(&options, &set, "with_errors_cold", 0);
+    bench_warm(&options, &set, "range_warm", 1);
+    bench_warm(&options, &set, "with_errors_warm", 0);
+    set_signature_query_mode(1);
+    bench_cold(&options, &set, "with_errors_cold_query", 0);
+    set_signature_query_mode(0);
+    bench_batch(&options, &set);
+    bench_incremental(&options, &set);
+    bench_check_cold(&options, &set);
+    bench_check_edit(&options, &set, "check_errors_edit", 1);
+    bench_check_edit(&options, &set, "with_errors_edit", 0);
+
+    for (int i = 0; i < set.count; i++) {
+        free(set.files[i].path);
+    }
+    free(set.files);
+    if (options.output != stdout) {
+        fclose(options.output);
+    }
+    return 0;
+}
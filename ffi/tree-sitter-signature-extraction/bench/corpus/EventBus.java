@@ -0,0 +1,54 @@
+package org.example.events;
+
+import java.util.ArrayList;
+import java.util.List;
+import java.util.concurrent.ConcurrentHashMap;
+import java.util.concurrent.CopyOnWriteArrayList;
+
+public final class EventBus {
+    public interface Listener<E> {
+        void onEvent(E event);
+    }
+
+    private final ConcurrentHashMap<Class<?>, List<Listener<?>>> listeners = new ConcurrentHashMap<>();
+
+    public <E> void subscribe(Class<E> type, Listener<? super E> listener) {
+        listeners.computeIfAbsent(type, t -> new CopyOnWriteArrayList<>()).add(listener);
+    }
+
+    public <E> boolean unsubscribe(Class<E> type, Listener<? super E> listener) {
+        List<Listener<?>> current = listeners.get(type);
+        return current != null && current.remove(listener);
+    }
+
+    @SuppressWarnings("unchecked")
+    public <E> int publish(E event) {
+        int delivered = 0;
+        for (Class<?> type = event.getClass(); type != null; type = type.getSuperclass()) {
+            List<Listener<?>> current = listeners.get(type);
+            if (current == null) {
+                continue;
+            }
+            for (Listener<?> listener : current) {
+                ((Listener<E>) listener).onEvent(event);
+                delivered++;
+            }
+        }
+        return delivered;
+    }
+
+    public List<Class<?>> registeredTypes() {
+        return new ArrayList<>(listeners.keySet());
+    }
+
+    public static void main(String[] args) {
+        EventBus bus = new EventBus();
+        bus.subscribe(String.class, new Listener<String>() {
+            @Override
+            public void onEvent(String event) {
+                System.out.println("received " + event);
+            }
+        });
+        bus.publish("hello");
+    }
+}
@@ -0,0 +1,119 @@
+package org.example.cache;
+
+import java.util.HashMap;
+import java.util.Map;
+import java.util.function.Function;
+
+/**
+ * A least recently used cache with a fixed capacity.
+ */
+public class LruCache<K, V> implements Cache<K, V> {
+    private final int capacity;
+    private final Map<K, Node<K, V>> entries = new HashMap<>();
+    private Node<K, V> head;
+    private Node<K, V> tail;
+
+    private static final class Node<K, V> {
+        final K key;
+        V value;
+        Node<K, V> previous;
+        Node<K, V> next;
+
+        Node(K key, V value) {
+            this.key = key;
+            this.value = value;
+        }
+    }
+
+    public LruCache(int capacity) {
+        if (capacity <= 0) {
+            throw new IllegalArgumentException("capacity must be positive");
+        }
+        this.capacity = capacity;
+    }
+
+    @Override
+    public synchronized V get(K key) {
+        Node<K, V> node = entries.get(key);
+        if (node == null) {
+            return null;
+        }
+        moveToFront(node);
+        return node.value;
+    }
+
+    @Override
+    public synchronized void put(K key, V value) {
+        Node<K, V> node = entries.get(key);
+        if (node != null) {
+            node.value = value;
+            moveToFront(node);
+            return;
+        }
+        node = new Node<>(key, value);
+        entries.put(key, node);
+        pushFront(node);
+        if (entries.size() > capacity) {
+            entries.remove(tail.key);
+            unlink(tail);
+        }
+    }
+
+    public synchronized V computeIfAbsent(K key, Function<? super K, ? extends V> loader) {
+        V value = get(key);
+        if (value == null) {
+            value = loader.apply(key);
+            put(key, value);
+        }
+        return value;
+    }
+
+    public synchronized int size() {
+        return entries.size();
+    }
+
+    private void moveToFront(Node<K, V> node) {
+        unlink(node);
+        pushFront(node);
+    }
+
+    private void pushFront(Node<K, V> node) {
+        node.next = head;
+        node.previous = null;
+        if (head != null) {
+            head.previous = node;
+        }
+        head = node;
+        if (tail == null) {
+            tail = node;
+        }
+    }
+
+    private void unlink(Node<K, V> node) {
+        if (node.previous != null) {
+            node.previous.next = node.next;
+        } else {
+            head = node.next;
+        }
+        if (node.next != null) {
+            node.next.previous = node.previous;
+        } else {
+            tail = node.previous;
+        }
+    }
+}
+
+interface Cache<K, V> {
+    V get(K key);
+
+    void put(K key, V value);
+}
+
+enum EvictionPolicy {
+    LRU,
+    LFU;
+
+    public boolean tracksFrequency() {
+        return this == LFU;
+    }
+}
@@ -0,0 +1,24 @@
+import json
+import os
+
+
+class ConfigLoader:
+    def __init__(self, path):
+        self.path = path
+        self.values = {}
+
+    def load(self):
+        with open(self.path) as handle:
+            self.values = json.load(handle)
+        return self.values
+
+    def get(self, key, default=None)
+        return self.values.get(key, default)
+
+    def environment_override(self, key):
+        value = os.environ.get(key.upper(
+        return value if value is not None else self.get(key)
+
+
+def load_default():
+    return ConfigLoader(os.path.expanduser("~/.config/example.json")).load()
@@ -0,0 +1,86 @@
+"""A small tokenizer for arithmetic expressions."""
+
+from dataclasses import dataclass
+from typing import Iterator, List, Optional
+
+
+@dataclass
+class Token:
+    kind: str
+    text: str
+    offset: int
+
+
+class TokenizeError(Exception):
+    def __init__(self, message: str, offset: int) -> None:
+        super().__init__(f"{message} at offset {offset}")
+        self.offset = offset
+
+
+class Tokenizer:
+    OPERATORS = "+-*/()"
+
+    def __init__(self, source: str) -> None:
+        self.source = source
+        self.offset = 0
+
+    def tokens(self) -> Iterator[Token]:
+        while True:
+            token = self.next_token()
+            if token is None:
+                return
+            yield token
+
+    def next_token(self) -> Optional[Token]:
+        self.skip_whitespace()
+        if self.offset >= len(self.source):
+            return None
+        start = self.offset
+        char = self.source[start]
+        if char.isdigit():
+            while self.offset < len(self.source) and self.source[self.offset].isdigit():
+                self.offset += 1
+            return Token("number", self.source[start:self.offset], start)
+        if char in self.OPERATORS:
+            self.offset += 1
+            return Token("operator", char, start)
+        raise TokenizeError(f"unexpected character {char!r}", start)
+
+    def skip_whitespace(self) -> None:
+        while self.offset < len(self.source) and self.source[self.offset].isspace():
+            self.offset += 1
+
+
+def tokenize(source: str) -> List[Token]:
+    return list(Tokenizer(source).tokens())
+
+
+def evaluate(source: str) -> int:
+    def parse_expression(tokens, index):
+        value, index = parse_term(tokens, index)
+        while index < len(tokens) and tokens[index].text in "+-":
+            operator = tokens[index].text
+            right, index = parse_term(tokens, index + 1)
+            value = value + right if operator == "+" else value - right
+        return value, index
+
+    def parse_term(tokens, index):
+        value, index = parse_factor(tokens, index)
+        while index < len(tokens) and tokens[index].text in "*/":
+            operator = tokens[index].text
+            right, index = parse_factor(tokens, index + 1)
+            value = value * right if operator == "*" else value // right
+        return value, index
+
+    def parse_factor(tokens, index):
+        token = tokens[index]
+        if token.text == "(":
+            value, index = parse_expression(tokens, index + 1)
+            return value, index + 1
+        return int(token.text), index + 1
+
+    return parse_expression(tokenize(source), 0)[0]
+
+
+if __name__ == "__main__":
+    print(evaluate("2 * (3 + 4)"))
@@ -0,0 +1,40 @@
+// Skeleton extraction service shared by the processes of a machine, see run_skeleton_service.
+// Clients reach it through SKELETON_SERVICE_SOCKET or set_skeleton_service_path.
+//
+//   skeleton-service SOCKET [--threads N] [--index FILE]
+
+#include "skeleton_service.h"
+#include "skeleton_store.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int main(int argc, char** argv) {
+    const char* socket_path = NULL;
+    const char* index_path = NULL;
+    int threads = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--index") == 0 && i + 1 < argc) {
+            index_path = argv[++i];
+        } else if (argv[i][0] != '-' && !socket_path) {
+            socket_path = argv[i];
+        } else {
+            socket_path = NULL;
+            break;
+        }
+    }
+    if (!socket_path) {
+        fprintf(stderr, "Usage: %s SOCKET [--threads N] [--index FILE]\n", argv[0]);
+        return 2;
+    }
+
+    // The persistent index seeds the shared cache and symbol table
+    if (index_path && set_skeleton_index_path(index_path) != 0) {
+        fprintf(stderr, "Cannot open skeleton index %s\n", index_path);
+        return 1;
+    }
+    return run_skeleton_service(socket_path, threads) == 0 ? 0 : 1;
+}
@@ -0,0 +1,95 @@
+#include "arena.h"
+#include "extractor_stats.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_ALIGNMENT 16
+#define ARENA_MIN_BLOCK_SIZE (4 * 1024)
+#define ARENA_MAX_BLOCK_SIZE (1024 * 1024)
+
+struct arena_block {
+    arena_block_t* next;             // Previously filled block
+    size_t size;                     // Usable bytes in data
+    size_t used;                     // Bytes handed out from data
+    _Alignas(ARENA_ALIGNMENT) unsigned char data[];
+};
+
+void arena_init(arena_t* arena) {
+    arena->head = NULL;
+    arena->next_block_size = ARENA_MIN_BLOCK_SIZE;
+    arena->footprint = 0;
+}
+
+static arena_block_t* new_block(arena_t* arena, size_t min_size) {
+    size_t size = arena->next_block_size;
+    while (size < min_size) {
+        size *= 2;
+    }
+    arena_block_t* block = (arena_block_t*)malloc(sizeof(arena_block_t) + size);
+    if (!block) {
+        return NULL;
+    }
+    block->size = size;
+    block->used = 0;
+    STATS_ADD(STATS_ALLOCATIONS, 1);
+    arena->footprint += sizeof(arena_block_t) + size;
+    // Small files stay small, large files do not pay for many blocks
+    if (arena->next_block_size < ARENA_MAX_BLOCK_SIZE) {
+        arena->next_block_size *= 2;
+    }
+    return block;
+}
+
+void* arena_alloc(arena_t* arena, size_t size) {
+    if (!arena) {
+        STATS_ADD(STATS_ALLOCATIONS, 1);
+        return malloc(size);
+    }
+
+    size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+    arena_block_t* block = arena->head;
+    if (!block || block->size - block->used < size) {
+        arena_block_t* fresh = new_block(arena, size);
+        if (!fresh) {
+            return NULL;
+        }
+        if (block && size > arena->next_block_size / 4) {
+            // Keep bumping into the current block after an oversized allocation
+            fresh->next = block->next;
+            block->next = fresh;
+        } else {
+            fresh->next = block;
+            arena->head = fresh;
+        }
+        block = fresh;
+    }
+
+    void* memory = block->data + block->used;
+    block->used += size;
+    return memory;
+}
+
+char* arena_strndup(arena_t* arena, const char* text, size_t length) {
+    char* copy = (char*)arena_alloc(arena, length + 1);
+    if (!copy) {
+        return NULL;
+    }
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+char* arena_strdup(arena_t* arena, const char* text) {
+    return text ? arena_strndup(arena, text, strlen(text)) : NULL;
+}
+
+void arena_release(arena_t* arena) {
+    arena_block_t* block = arena->head;
+    while (block) {
+        arena_block_t* next = block->next;
+        free(block);
+        block = next;
+    }
+    arena_init(arena);
+}
@@ -0,0 +1,62 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Forward declaration
+typedef struct arena_block arena_block_t;
+
+// Bump allocator whose allocations are all released together.
+// Functions taking an arena accept NULL to allocate from the heap instead.
+typedef struct {
+    arena_block_t* head;             // Block currently bumped into
+    size_t next_block_size;          // Size of the next block, doubling up to a limit
+    size_t footprint;                // Bytes held in blocks
+} arena_t;
+
+/**
+ * Initialize an empty arena, no memory is taken until the first allocation
+ * @param arena Arena to initialize
+ */
+void arena_init(arena_t* arena);
+
+/**
+ * Allocate uninitialized memory, aligned for any type
+ * @param arena Arena, or NULL for malloc
+ * @param size Size in bytes
+ * @return Pointer valid until the arena is released, or NULL on failure
+ */
+void* arena_alloc(arena_t* arena, size_t size);
+
+/**
+ * Copy a string of known length and NUL-terminate it
+ * @param arena Arena, or NULL for malloc
+ * @param text Text to copy
+ * @param length Number of bytes to copy
+ * @return Copy of the text, or NULL on failure
+ */
+char* arena_strndup(arena_t* arena, const char* text, size_t length);
+
+/**
+ * Copy a NUL-terminated string
+ * @param arena Arena, or NULL for malloc
+ * @param text Text to copy, may be NULL
+ * @return Copy of the text, or NULL if text is NULL or on failure
+ */
+char* arena_strdup(arena_t* arena, const char* text);
+
+/**
+ * Release every allocation at once, the arena can be reused afterwards
+ * @param arena Arena to release
+ */
+void arena_release(arena_t* arena);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ARENA_H
@@ -0,0 +1,59 @@
+#ifndef BYTE_BUFFER_H
+#define BYTE_BUFFER_H
+
+#include "xml_writer.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Binary encoding shared by the skeleton store and service, integers in host byte order
+
+// Bounds-checked reader over a buffer, reads past the end fail and set failed
+typedef struct {
+    const char* data;
+    const char* end;
+    int failed;
+} byte_reader_t;
+
+static inline const char* byte_reader_bytes(byte_reader_t* reader, size_t length) {
+    if (reader->failed || (size_t)(reader->end - reader->data) < length) {
+        reader->failed = 1;
+        return NULL;
+    }
+    const char* bytes = reader->data;
+    reader->data += length;
+    return bytes;
+}
+
+static inline uint32_t byte_reader_u32(byte_reader_t* reader) {
+    uint32_t value = 0;
+    const char* bytes = byte_reader_bytes(reader, sizeof(value));
+    if (bytes) memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+static inline uint64_t byte_reader_u64(byte_reader_t* reader) {
+    uint64_t value = 0;
+    const char* bytes = byte_reader_bytes(reader, sizeof(value));
+    if (bytes) memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+static inline void byte_writer_u32(xml_writer_t* writer, uint32_t value) {
+    xml_writer_write(writer, (const char*)&value, sizeof(value));
+}
+
+static inline void byte_writer_u64(xml_writer_t* writer, uint64_t value) {
+    xml_writer_write(writer, (const char*)&value, sizeof(value));
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BYTE_BUFFER_H
@@ -0,0 +1,139 @@
+#include "entity_index.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Count the entities and the non-empty sibling lists of a forest
+static void count_forest(signature_node_t* node, uint32_t* entries, uint32_t* spans) {
+    if (!node) {
+        return;
+    }
+    (*spans)++;
+    for (; node; node = node->next_sibling) {
+        (*entries)++;
+        count_forest(node->children, entries, spans);
+    }
+}
+
+static int compare_entries(const void* a, const void* b) {
+    const entity_entry_t* left = (const entity_entry_t*)a;
+    const entity_entry_t* right = (const entity_entry_t*)b;
+    return (left->start_line > right->start_line) - (left->start_line < right->start_line);
+}
+
+// Lay out a sibling list as a span followed by the spans of its children
+static int32_t fill_span(entity_index_t* index, signature_node_t* node) {
+    if (!node) {
+        return -1;
+    }
+    int32_t span_id = (int32_t)index->span_count++;
+    entity_span_t* span = &index->spans[span_id];
+    span->first = index->entry_count;
+    span->count = 0;
+    for (signature_node_t* sibling = node; sibling; sibling = sibling->next_sibling) {
+        entity_entry_t* entry = &index->entries[index->entry_count++];
+        entry->node = sibling;
+        entry->start_line = sibling->start_line;
+        entry->end_line = sibling->end_line;
+        span->count++;
+    }
+
+    // Siblings are in source order already, sorting only guards against hand-built forests
+    entity_entry_t* entries = index->entries + span->first;
+    for (uint32_t i = 1; i < span->count; i++) {
+        if (entries[i].start_line < entries[i - 1].start_line) {
+            qsort(entries, span->count, sizeof(entity_entry_t), compare_entries);
+            break;
+        }
+    }
+    int max_end_line = 0;
+    for (uint32_t i = 0; i < span->count; i++) {
+        if (i == 0 || entries[i].end_line > max_end_line) {
+            max_end_line = entries[i].end_line;
+        }
+        entries[i].max_end_line = max_end_line;
+    }
+
+    for (uint32_t i = 0; i < span->count; i++) {
+        int32_t children = fill_span(index, entries[i].node->children);
+        index->entries[span->first + i].children = children;
+    }
+    return span_id;
+}
+
+entity_index_t* entity_index_build(arena_t* arena, signature_node_t* forest) {
+    uint32_t entry_count = 0;
+    uint32_t span_count = 0;
+    count_forest(forest, &entry_count, &span_count);
+
+    entity_index_t* index = (entity_index_t*)arena_alloc(arena, sizeof(entity_index_t));
+    if (!index) {
+        return NULL;
+    }
+    memset(index, 0, sizeof(entity_index_t));
+    if (span_count == 0) {
+        return index;
+    }
+
+    index->entries = (entity_entry_t*)arena_alloc(arena, sizeof(entity_entry_t) * entry_count);
+    index->spans = (entity_span_t*)arena_alloc(arena, sizeof(entity_span_t) * span_count);
+    if (!index->entries || !index->spans) {
+        if (!arena) {
+            free(index->entries);
+            free(index->spans);
+            free(index);
+        }
+        return NULL;
+    }
+    fill_span(index, forest);
+    return index;
+}
+
+void entity_index_free(entity_index_t* index) {
+    if (!index) {
+        return;
+    }
+    free(index->entries);
+    free(index->spans);
+    free(index);
+}
+
+uint32_t entity_span_lower_bound(const entity_index_t* index, int32_t span_id, int start_line) {
+    if (span_id < 0 || (uint32_t)span_id >= index->span_count) {
+        return 0;
+    }
+    const entity_span_t* span = &index->spans[span_id];
+
+    // The running maximum of end lines is sorted, so the first entry reaching the range is found by bisection
+    uint32_t low = span->first;
+    uint32_t high = span->first + span->count;
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        if (index->entries[mid].max_end_line < start_line) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+signature_node_t* entity_index_enclosing(const entity_index_t* index, int line) {
+    signature_node_t* enclosing = NULL;
+    int32_t span_id = index && index->span_count > 0 ? 0 : -1;
+    while (span_id >= 0) {
+        const entity_span_t* span = &index->spans[span_id];
+        uint32_t end = span->first + span->count;
+        int32_t next = -1;
+        for (uint32_t i = entity_span_lower_bound(index, span_id, line);
+             i < end && index->entries[i].start_line <= line; i++) {
+            if (index->entries[i].end_line >= line) {
+                enclosing = index->entries[i].node;
+                next = index->entries[i].children;
+                break;
+            }
+        }
+        span_id = next;
+    }
+    return enclosing;
+}
@@ -0,0 +1,72 @@
+#ifndef ENTITY_INDEX_H
+#define ENTITY_INDEX_H
+
+#include "signature_node.h"
+#include "arena.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// An entity of the forest with its line range copied out for locality
+typedef struct {
+    signature_node_t* node;          // Entity
+    int start_line;                  // First line of the entity
+    int end_line;                    // Last line of the entity
+    int max_end_line;                // Largest end line of this entry and the ones before it in its span
+    int32_t children;                // Span of the children, -1 if there are none
+} entity_entry_t;
+
+// Contiguous siblings sorted by start line
+typedef struct {
+    uint32_t first;                  // Index of the first entry
+    uint32_t count;                  // Number of entries
+} entity_span_t;
+
+// Interval index over a signature forest. Every sibling list is a span sorted by start
+// line and augmented with the running maximum of end lines, so a line range query
+// binary-searches each level and only visits the overlapping entities.
+typedef struct {
+    entity_entry_t* entries;         // Entries of all spans
+    uint32_t entry_count;
+    entity_span_t* spans;            // spans[0] holds the top-level entities
+    uint32_t span_count;
+} entity_index_t;
+
+/**
+ * Build the index of a forest
+ * @param arena Arena the index comes from, or NULL for the heap
+ * @param forest Top-level signature nodes
+ * @return New index, or NULL on allocation failure
+ */
+entity_index_t* entity_index_build(arena_t* arena, signature_node_t* forest);
+
+/**
+ * Free an index built on the heap
+ * @param index Index, may be NULL
+ */
+void entity_index_free(entity_index_t* index);
+
+/**
+ * Find the first entry of a span that may overlap a line range.
+ * Overlapping entries are among the following ones up to the first that starts after end_line.
+ * @param index Index
+ * @param span Span id
+ * @param start_line First line of the range
+ * @return Index of the entry, or the end of the span if none overlaps
+ */
+uint32_t entity_span_lower_bound(const entity_index_t* index, int32_t span, int start_line);
+
+/**
+ * Find the innermost entity whose lines contain a line
+ * @param index Index
+ * @param line Line number
+ * @return Enclosing entity, or NULL if the line is outside every entity
+ */
+signature_node_t* entity_index_enclosing(const entity_index_t* index, int line);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ENTITY_INDEX_H
@@ -0,0 +1,270 @@
+#include "extractor_context.h"
+#include "signature_extractor.h"
+#include "parsed_file.h"
+#include "mapped_file.h"
+#include "skeleton_cache.h"
+#include "syntax_check.h"
+#include "platform.h"
+#include "utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct extractor_ctx {
+    TSParser* parsers[EXTRACTOR_LANG_COUNT];  // Warm parser per language, created lazily
+    char* source_buffer;                      // Reusable buffer for file contents
+    size_t source_capacity;                   // Capacity of source_buffer
+    skeleton_cache_t* cache;                  // Shared skeleton cache, NULL when disabled
+    int map_files;                            // Map large files for transient parses
+    syntax_check_state_t check;               // Last file checked by ctx_check_syntax_errors
+#ifdef EXTRACTOR_ENABLE_STATS
+    extractor_stats_t stats;                  // Counters of the calls made with the context
+#endif
+};
+
+// Default context of each thread, used by the free functions
+static THREAD_LOCAL extractor_ctx_t* default_ctx = NULL;
+// Slot holding the default context too, so it is destroyed when its thread exits
+static platform_tls_key_t default_ctx_key;
+static int default_ctx_key_state;  // 0 not created yet, 1 created, -1 failed, guarded by default_ctx_lock
+static platform_mutex_t default_ctx_lock = PLATFORM_MUTEX_INITIALIZER;
+
+extractor_language_t extractor_language_from_name(const char* language) {
+    return language_table_find(language);
+}
+
+extractor_language_t extractor_language_from_path(const char* path) {
+    return language_table_for_path(path);
+}
+
+const char* extractor_language_name(extractor_language_t lang) {
+    return language_table_name(lang);
+}
+
+static void PLATFORM_TLS_CALLBACK destroy_default_ctx(void* ctx) {
+    extractor_ctx_destroy((extractor_ctx_t*)ctx);
+}
+
+// Create the slot of the default contexts on first use
+static int default_ctx_key_ready(void) {
+    platform_mutex_lock(&default_ctx_lock);
+    if (default_ctx_key_state == 0) {
+        default_ctx_key_state = platform_tls_create(&default_ctx_key, destroy_default_ctx) == 0 ? 1 : -1;
+    }
+    int ready = default_ctx_key_state == 1;
+    platform_mutex_unlock(&default_ctx_lock);
+    return ready;
+}
+
+extractor_ctx_t* extractor_ctx_create(void) {
+    extractor_ctx_t* ctx = (extractor_ctx_t*)calloc(1, sizeof(extractor_ctx_t));
+    if (!ctx) {
+        return NULL;
+    }
+    ctx->cache = skeleton_cache_global();
+    ctx->map_files = 1;
+    return ctx;
+}
+
+void extractor_ctx_destroy(extractor_ctx_t* ctx) {
+    if (!ctx) {
+        return;
+    }
+
+    for (int i = 0; i < EXTRACTOR_LANG_COUNT; i++) {
+        if (ctx->parsers[i]) {
+            ts_parser_delete(ctx->parsers[i]);
+        }
+    }
+    free(ctx->source_buffer);
+    syntax_check_state_clear(&ctx->check);
+
+#ifdef EXTRACTOR_ENABLE_STATS
+    if (extractor_stats_active == &ctx->stats) {
+        extractor_stats_active = NULL;
+    }
+#endif
+    if (ctx == default_ctx) {
+        // The slot was set when this thread created its default context
+        default_ctx = NULL;
+        if (default_ctx_key_state == 1) {
+            platform_tls_set(default_ctx_key, NULL);
+        }
+    }
+    free(ctx);
+}
+
+extractor_ctx_t* extractor_ctx_default(void) {
+    // The default context lives until the thread exits. Should the slot fail, it stays
+    // allocated past the thread instead.
+    if (!default_ctx) {
+        default_ctx = extractor_ctx_create();
+        if (default_ctx && default_ctx_key_ready()) {
+            platform_tls_set(default_ctx_key, default_ctx);
+        }
+    }
+    return default_ctx;
+}
+
+TSParser* extractor_ctx_parser(extractor_ctx_t* ctx, extractor_language_t lang) {
+    if (!ctx || lang < 0 || lang >= EXTRACTOR_LANG_COUNT) {
+        return NULL;
+    }
+    // Every call that parses goes through here, what follows on this thread counts for ctx
+    extractor_ctx_stats(ctx);
+
+    if (!ctx->parsers[lang]) {
+        // The grammar of the language is loaded with its table
+        const language_table_t* table = language_table_get(lang);
+        if (!table) {
+            return NULL;
+        }
+        TSParser* parser = ts_parser_new();
+        if (!parser) {
+            return NULL;
+        }
+        if (!ts_parser_set_language(parser, table->language)) {
+            fprintf(stderr, "Incompatible grammar for %s\n", language_table_name(lang));
+            ts_parser_delete(parser);
+            return NULL;
+        }
+        ctx->parsers[lang] = parser;
+    } else {
+        // Drop any state left over from an interrupted parse
+        ts_parser_reset(ctx->parsers[lang]);
+    }
+
+    return ctx->parsers[lang];
+}
+
+const char* extractor_ctx_read_file(extractor_ctx_t* ctx, const char* filename, size_t* size) {
+    if (!ctx) {
+        return NULL;
+    }
+    if (read_file_into(filename, &ctx->source_buffer, &ctx->source_capacity, size) != 0) {
+        return NULL;
+    }
+    return ctx->source_buffer;
+}
+
+extractor_stats_t* extractor_ctx_stats(extractor_ctx_t* ctx) {
+#ifdef EXTRACTOR_ENABLE_STATS
+    if (ctx) {
+        extractor_stats_active = &ctx->stats;
+        return &ctx->stats;
+    }
+#else
+    (void)ctx;
+#endif
+    return NULL;
+}
+
+void extractor_ctx_set_cache_enabled(extractor_ctx_t* ctx, int enabled) {
+    if (ctx) {
+        ctx->cache = enabled ? skeleton_cache_global() : NULL;
+    }
+}
+
+void extractor_ctx_set_mmap_enabled(extractor_ctx_t* ctx, int enabled) {
+    if (ctx) {
+        ctx->map_files = enabled;
+    }
+}
+
+parsed_file_t* extractor_ctx_acquire_file(extractor_ctx_t* ctx, const char* filename, extractor_language_t lang) {
+    TSParser* parser = extractor_ctx_parser(ctx, lang);
+    if (!parser) {
+        return NULL;
+    }
+
+    if (ctx->cache) {
+        return skeleton_cache_acquire(ctx->cache, parser, filename, lang);
+    }
+
+    // Without a cache, parse straight from a mapping or the reusable buffer of the context.
+    // The mapping is owned by the transient file and closed when it is released.
+    mapped_file_t* mapping = ctx->map_files ? mapped_file_map(filename) : NULL;
+    if (mapping) {
+        return parsed_file_create_mapped(parser, lang, mapping);
+    }
+
+    size_t source_size;
+    const char* source_code = extractor_ctx_read_file(ctx, filename, &source_size);
+    if (!source_code) {
+        return NULL;
+    }
+    return parsed_file_create(parser, lang, ctx->source_buffer, source_size, 0);
+}
+
+parsed_file_t* extractor_ctx_lookup_file(extractor_ctx_t* ctx, const char* filename, extractor_language_t lang,
+                                         int64_t mtime_ns, uint64_t size) {
+    if (!ctx || !ctx->cache) {
+        return NULL;
+    }
+    return skeleton_cache_lookup(ctx->cache, filename, lang, mtime_ns, size);
+}
+
+syntax_check_state_t* extractor_ctx_check_state(extractor_ctx_t* ctx) {
+    return ctx ? &ctx->check : NULL;
+}
+
+void extractor_ctx_release_file(extractor_ctx_t* ctx, parsed_file_t* file) {
+    (void)ctx;
+    if (!file) {
+        return;
+    }
+    if (file->ref_count == 0) {
+        // Transient file that never went through the cache
+        parsed_file_free(file);
+    } else {
+        skeleton_cache_release(skeleton_cache_global(), file);
+    }
+}
+
+signature_node_t* ctx_extract_signatures_from_file(extractor_ctx_t* ctx, const char* filename, const char* language) {
+    return ctx_extract_signatures_from_file_range(ctx, filename, language, -1, -1);
+}
+
+signature_node_t* ctx_extract_signatures_from_file_range(extractor_ctx_t* ctx, const char* filename,
+                                                         const char* language, int start_line, int end_line) {
+    extractor_language_t lang = extractor_language_from_name(language);
+    if (lang == EXTRACTOR_LANG_UNKNOWN) {
+        fprintf(stderr, "Unsupported language: %s\n", language ? language : "(null)");
+        return NULL;
+    }
+
+    TSParser* parser = extractor_ctx_parser(ctx, lang);
+    if (!parser) {
+        return NULL;
+    }
+
+    size_t source_size;
+    const char* source_code;
+    mapped_file_t* mapping = ctx->map_files ? mapped_file_map(filename) : NULL;
+    if (mapping) {
+        source_code = mapping->data;
+        source_size = mapping->size;
+    } else {
+        source_code = extractor_ctx_read_file(ctx, filename, &source_size);
+        if (!source_code) {
+            return NULL;
+        }
+    }
+
+    // Parse the source code
+    STATS_PHASE_BEGIN(parse);
+    TSTree* tree = ts_parser_parse_string(parser, NULL, source_code, source_size);
+    STATS_PHASE_END(STATS_PHASE_PARSE, parse);
+    signature_node_t* signatures = NULL;
+    if (tree) {
+        // Extract signatures, they own copies of their text so the mapping can go
+        STATS_PHASE_BEGIN(extract);
+        signatures = extract_signatures_in_lines(tree, source_code, language, start_line, end_line);
+        STATS_PHASE_END(STATS_PHASE_EXTRACT, extract);
+        ts_tree_delete(tree);
+    }
+
+    mapped_file_close(mapping);
+    return signatures;
+}
@@ -0,0 +1,163 @@
+#ifndef EXTRACTOR_CONTEXT_H
+#define EXTRACTOR_CONTEXT_H
+
+#include "signature_node.h"
+#include "xml_writer.h"
+#include "extractor_stats.h"
+#include "tree_sitter/api.h"
+#include "dll_export.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Languages supported by the extractor, ids from EXTRACTOR_LANG_BUILTIN_COUNT on are
+// handed out by language_table_register
+typedef enum {
+    EXTRACTOR_LANG_UNKNOWN = -1,
+    EXTRACTOR_LANG_JAVA = 0,
+    EXTRACTOR_LANG_PYTHON,
+    EXTRACTOR_LANG_BUILTIN_COUNT,
+    EXTRACTOR_LANG_COUNT = 16        // Capacity of the registry, built in languages included
+} extractor_language_t;
+
+// Forward declarations
+typedef struct parsed_file parsed_file_t;
+typedef struct syntax_check_state syntax_check_state_t;
+
+// Opaque extraction context holding warm parsers, scratch buffers and stats.
+// A context must not be used by more than one thread at a time; keep one per thread.
+typedef struct extractor_ctx extractor_ctx_t;
+
+/**
+ * Resolve a language name ("java", "python" or a registered grammar)
+ * @param language Language name
+ * @return Language id, or EXTRACTOR_LANG_UNKNOWN if unsupported
+ */
+extractor_language_t extractor_language_from_name(const char* language);
+
+/**
+ * Resolve the language of a file from its extension
+ * @param path Path of the file
+ * @return Language id, or EXTRACTOR_LANG_UNKNOWN if unsupported
+ */
+extractor_language_t extractor_language_from_path(const char* path);
+
+/**
+ * Get the name of a language
+ * @param lang Language id
+ * @return Language name, or NULL if unknown
+ */
+const char* extractor_language_name(extractor_language_t lang);
+
+/**
+ * Create a new extraction context
+ * @return New context, or NULL on allocation failure
+ */
+DLL_EXPORT extractor_ctx_t* extractor_ctx_create(void);
+
+/**
+ * Destroy a context and release its parsers and buffers
+ * @param ctx Context to destroy
+ */
+DLL_EXPORT void extractor_ctx_destroy(extractor_ctx_t* ctx);
+
+/**
+ * Get the default context of the calling thread, creating it on first use.
+ * The free functions in signature_extractor.h are wrappers over this context,
+ * which is destroyed when the thread exits.
+ * @return Thread-local default context, or NULL if it cannot be created
+ */
+DLL_EXPORT extractor_ctx_t* extractor_ctx_default(void);
+
+/**
+ * Get the parser of a language, creating and configuring it on first use
+ * @param ctx Context
+ * @param lang Language id
+ * @return Parser owned by the context, or NULL on failure
+ */
+TSParser* extractor_ctx_parser(extractor_ctx_t* ctx, extractor_language_t lang);
+
+/**
+ * Read a file into the reusable source buffer of the context.
+ * The returned buffer is owned by the context and valid until the next read.
+ * @param ctx Context
+ * @param filename Path of the file
+ * @param size Output size of the file in bytes
+ * @return NUL-terminated file contents, or NULL on failure
+ */
+const char* extractor_ctx_read_file(extractor_ctx_t* ctx, const char* filename, size_t* size);
+
+/**
+ * Enable or disable the shared skeleton cache for a context (enabled by default)
+ * @param ctx Context
+ * @param enabled Non-zero to look files up in the cache
+ */
+DLL_EXPORT void extractor_ctx_set_cache_enabled(extractor_ctx_t* ctx, int enabled);
+
+/**
+ * Enable or disable memory mapping of large files parsed outside the cache (enabled by default).
+ * A mapped file lives until its parsed file is released with extractor_ctx_release_file.
+ * @param ctx Context
+ * @param enabled Non-zero to map files of at least MAPPED_FILE_MIN_SIZE bytes
+ */
+DLL_EXPORT void extractor_ctx_set_mmap_enabled(extractor_ctx_t* ctx, int enabled);
+
+/**
+ * Get the stats of a context, and make them the ones updated by the calling thread
+ * @param ctx Context
+ * @return Stats owned by the context, or NULL if the library was built without EXTRACTOR_ENABLE_STATS
+ */
+extractor_stats_t* extractor_ctx_stats(extractor_ctx_t* ctx);
+
+/**
+ * Get the parsed form of a file, from the skeleton cache when enabled
+ * @param ctx Context
+ * @param filename Path of the file
+ * @param lang Language of the file
+ * @return Parsed file to be released with extractor_ctx_release_file, or NULL on failure
+ */
+parsed_file_t* extractor_ctx_acquire_file(extractor_ctx_t* ctx, const char* filename, extractor_language_t lang);
+
+/**
+ * Get the parsed form of a file if the skeleton cache holds a current one, without parsing it
+ * @param ctx Context
+ * @param filename Path of the file
+ * @param lang Language of the file
+ * @param mtime_ns Current modification time of the file
+ * @param size Current size of the file
+ * @return Parsed file to be released with extractor_ctx_release_file, or NULL if it is not cached
+ *         or the cache is disabled
+ */
+parsed_file_t* extractor_ctx_lookup_file(extractor_ctx_t* ctx, const char* filename, extractor_language_t lang,
+                                         int64_t mtime_ns, uint64_t size);
+
+/**
+ * Get the state of the last syntax check made with a context
+ * @param ctx Context
+ * @return State owned by the context, or NULL without a context
+ */
+syntax_check_state_t* extractor_ctx_check_state(extractor_ctx_t* ctx);
+
+/**
+ * Release a parsed file returned by extractor_ctx_acquire_file
+ * @param ctx Context
+ * @param file Parsed file
+ */
+void extractor_ctx_release_file(extractor_ctx_t* ctx, parsed_file_t* file);
+
+DLL_EXPORT signature_node_t* ctx_extract_signatures_from_file(extractor_ctx_t* ctx, const char* filename, const char* language);
+DLL_EXPORT signature_node_t* ctx_extract_signatures_from_file_range(extractor_ctx_t* ctx, const char* filename,
+                                                                    const char* language, int start_line, int end_line);
+DLL_EXPORT char* ctx_get_skeleton_xml_range(extractor_ctx_t* ctx, const char* filename, const char* language, int start_line, int end_line);
+DLL_EXPORT char* ctx_get_skeleton_xml_with_errors(extractor_ctx_t* ctx, const char* filename, const char* language, int start_line, int end_line);
+DLL_EXPORT char* ctx_get_skeleton_xml_budget(extractor_ctx_t* ctx, const char* filename, const char* language,
+                                             int start_line, int end_line, size_t max_bytes);
+DLL_EXPORT int ctx_get_skeleton_xml_stream(extractor_ctx_t* ctx, const char* filename, const char* language,
+                                           int start_line, int end_line, xml_chunk_fn callback, void* user_data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EXTRACTOR_CONTEXT_H
@@ -0,0 +1,73 @@
+#include "extractor_stats.h"
+#include "extractor_context.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef EXTRACTOR_ENABLE_STATS
+THREAD_LOCAL extractor_stats_t* extractor_stats_active = NULL;
+#endif
+
+// JSON names of stats_phase_t and stats_counter_t, in enum order
+static const char* const phase_names[STATS_PHASE_COUNT] = {
+    "read", "parse", "extract", "errors", "render"
+};
+static const char* const counter_names[STATS_COUNTER_COUNT] = {
+    "bytes_read", "nodes_visited", "entities", "output_bytes", "allocations", "cache_hits", "cache_misses"
+};
+
+void extractor_stats_merge(extractor_stats_t* into, const extractor_stats_t* from) {
+    if (!into || !from) {
+        return;
+    }
+    for (int i = 0; i < STATS_COUNTER_COUNT; i++) {
+        into->counters[i] += from->counters[i];
+    }
+    for (int i = 0; i < STATS_PHASE_COUNT; i++) {
+        into->phase_ns[i] += from->phase_ns[i];
+        into->phase_calls[i] += from->phase_calls[i];
+    }
+}
+
+char* ctx_get_extractor_stats(extractor_ctx_t* ctx) {
+    const extractor_stats_t* stats = extractor_ctx_stats(ctx);
+    if (!stats) {
+        return NULL;
+    }
+
+    // Every field is a name and a 64-bit number, so the size is bounded
+    size_t capacity = 64 * (2 * STATS_PHASE_COUNT + STATS_COUNTER_COUNT) + 3;
+    char* json = (char*)malloc(capacity);
+    if (!json) {
+        return NULL;
+    }
+    size_t length = 0;
+    json[length++] = '{';
+    for (int i = 0; i < STATS_PHASE_COUNT; i++) {
+        length += snprintf(json + length, capacity - length, "%s\"%s_ms\":%.3f,\"%s_calls\":%llu",
+                           i ? "," : "", phase_names[i], (double)stats->phase_ns[i] / 1e6,
+                           phase_names[i], (unsigned long long)stats->phase_calls[i]);
+    }
+    for (int i = 0; i < STATS_COUNTER_COUNT; i++) {
+        length += snprintf(json + length, capacity - length, ",\"%s\":%llu",
+                           counter_names[i], (unsigned long long)stats->counters[i]);
+    }
+    snprintf(json + length, capacity - length, "}");
+    return json;
+}
+
+void ctx_reset_extractor_stats(extractor_ctx_t* ctx) {
+    extractor_stats_t* stats = extractor_ctx_stats(ctx);
+    if (stats) {
+        memset(stats, 0, sizeof(extractor_stats_t));
+    }
+}
+
+char* get_extractor_stats(void) {
+    return ctx_get_extractor_stats(extractor_ctx_default());
+}
+
+void reset_extractor_stats(void) {
+    ctx_reset_extractor_stats(extractor_ctx_default());
+}
@@ -0,0 +1,114 @@
+#ifndef EXTRACTOR_STATS_H
+#define EXTRACTOR_STATS_H
+
+#include "platform.h"
+#include "dll_export.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Timed phases of a skeleton call
+typedef enum {
+    STATS_PHASE_READ = 0,            // Reading or mapping source files
+    STATS_PHASE_PARSE,               // Tree-sitter parses, full and incremental
+    STATS_PHASE_EXTRACT,             // Building the signature forest and entity index
+    STATS_PHASE_ERRORS,              // Collecting parse errors
+    STATS_PHASE_RENDER,              // Writing XML or records
+    STATS_PHASE_COUNT
+} stats_phase_t;
+
+// Event counters
+typedef enum {
+    STATS_BYTES_READ = 0,            // Source bytes read or mapped
+    STATS_NODES_VISITED,             // Syntax nodes visited by extraction, or query matches
+    STATS_ENTITIES,                  // Signature nodes created
+    STATS_OUTPUT_BYTES,              // Bytes of XML or records produced
+    STATS_ALLOCATIONS,               // Arena blocks, source buffers and output buffer growth
+    STATS_CACHE_HITS,
+    STATS_CACHE_MISSES,
+    STATS_COUNTER_COUNT
+} stats_counter_t;
+
+// Counters and phase timers of one extraction context
+typedef struct {
+    uint64_t counters[STATS_COUNTER_COUNT];
+    uint64_t phase_ns[STATS_PHASE_COUNT];
+    uint64_t phase_calls[STATS_PHASE_COUNT];
+} extractor_stats_t;
+
+// Forward declaration, see extractor_context.h
+struct extractor_ctx;
+
+#ifdef EXTRACTOR_ENABLE_STATS
+
+// Stats of the context last used by the calling thread, NULL if none.
+// Contexts are used by one thread at a time, so updates need no atomics.
+extern THREAD_LOCAL extractor_stats_t* extractor_stats_active;
+
+static inline void extractor_stats_add(stats_counter_t counter, uint64_t amount) {
+    if (extractor_stats_active) {
+        extractor_stats_active->counters[counter] += amount;
+    }
+}
+
+static inline void extractor_stats_phase(stats_phase_t phase, uint64_t start_ns) {
+    if (extractor_stats_active) {
+        extractor_stats_active->phase_ns[phase] += platform_monotonic_ns() - start_ns;
+        extractor_stats_active->phase_calls[phase]++;
+    }
+}
+
+#define STATS_ADD(counter, amount) extractor_stats_add((counter), (uint64_t)(amount))
+#define STATS_PHASE_BEGIN(name) uint64_t name##_start_ns = platform_monotonic_ns()
+#define STATS_PHASE_END(phase, name) extractor_stats_phase((phase), name##_start_ns)
+
+#else
+
+#define STATS_ADD(counter, amount) ((void)0)
+#define STATS_PHASE_BEGIN(name) ((void)0)
+#define STATS_PHASE_END(phase, name) ((void)0)
+
+#endif // EXTRACTOR_ENABLE_STATS
+
+/**
+ * Add the stats of one context to another, e.g. those of batch workers to the caller
+ * @param into Stats to add to
+ * @param from Stats to add
+ */
+void extractor_stats_merge(extractor_stats_t* into, const extractor_stats_t* from);
+
+/**
+ * Get the stats of a context as a JSON object of phase times in milliseconds, phase call
+ * counts and counters, e.g. {"parse_ms":1.250,"parse_calls":3,...,"cache_hits":2}
+ * @param ctx Context
+ * @return JSON text to be freed by the caller, or NULL if the library was built
+ *         without EXTRACTOR_ENABLE_STATS
+ */
+DLL_EXPORT char* ctx_get_extractor_stats(struct extractor_ctx* ctx);
+
+/**
+ * Reset the stats of a context to zero
+ * @param ctx Context
+ */
+DLL_EXPORT void ctx_reset_extractor_stats(struct extractor_ctx* ctx);
+
+/**
+ * Get the stats of the default context of the calling thread, see ctx_get_extractor_stats.
+ * Work done by the workers of a batch is added to the context of the thread calling it.
+ * @return JSON text to be freed by the caller, or NULL if stats are compiled out
+ */
+DLL_EXPORT char* get_extractor_stats(void);
+
+/**
+ * Reset the stats of the default context of the calling thread
+ */
+DLL_EXPORT void reset_extractor_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EXTRACTOR_STATS_H
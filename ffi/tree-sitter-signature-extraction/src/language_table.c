@@ -0,0 +1,494 @@
+#include "language_table.h"
+#include "signature_extractor.h"
+#include "platform.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const kind_name_t java_kind_names[] = {
+    { "class_declaration", NODE_KIND_CLASS },
+    { "interface_declaration", NODE_KIND_INTERFACE },
+    { "enum_declaration", NODE_KIND_ENUM },
+    { "method_declaration", NODE_KIND_METHOD },
+    { "constructor_declaration", NODE_KIND_CONSTRUCTOR },
+    { "field_declaration", NODE_KIND_MEMBER_CODE },
+    { "static_initializer", NODE_KIND_MEMBER_CODE },
+    { NULL, NODE_KIND_OTHER }
+};
+
+static const kind_name_t python_kind_names[] = {
+    { "class_definition", NODE_KIND_CLASS },
+    { "function_definition", NODE_KIND_FUNCTION },
+    { "expression_statement", NODE_KIND_EXPRESSION },
+    { NULL, NODE_KIND_OTHER }
+};
+
+// Anonymous classes start with new
+static const char* const java_declaration_keywords[] = { "class", "interface", "enum", "new", NULL };
+static const char* const python_declaration_keywords[] = { "def", "class", NULL };
+
+// Signature queries, one pattern per captured part so that every part is optional.
+// Only fields the walking extractors read are captured, so both ways agree.
+static const char java_query[] =
+    "(class_declaration name: (_) @name) @class\n"
+    "(class_declaration (modifiers) @modifiers) @class\n"
+    "(class_declaration type_parameters: (_) @type_parameters) @class\n"
+    "(class_declaration superclass: (_) @superclass) @class\n"
+    "(class_declaration interfaces: (_) @interfaces) @class\n"
+    "(interface_declaration name: (_) @name) @interface\n"
+    "(interface_declaration (modifiers) @modifiers) @interface\n"
+    "(interface_declaration type_parameters: (_) @type_parameters) @interface\n"
+    "(enum_declaration name: (_) @name) @enum\n"
+    "(enum_declaration (modifiers) @modifiers) @enum\n"
+    "(enum_declaration interfaces: (_) @interfaces) @enum\n"
+    "(method_declaration name: (_) @name) @method\n"
+    "(method_declaration (modifiers) @modifiers) @method\n"
+    "(method_declaration type_parameters: (_) @type_parameters) @method\n"
+    "(method_declaration type: (_) @type) @method\n"
+    "(method_declaration parameters: (_) @parameters) @method\n";
+
+static const char python_query[] =
+    "(class_definition name: (_) @name) @class\n"
+    "(class_definition superclasses: (_) @superclass) @class\n"
+    "(function_definition name: (_) @name) @function\n"
+    "(function_definition parameters: (_) @parameters) @function\n"
+    "(function_definition return_type: (_) @return_type) @function\n";
+
+// Capture names of the query parts, in query_part_t order
+static const char* const query_part_names[QUERY_PART_COUNT] = {
+    "name", "modifiers", "type_parameters", "type", "parameters", "throws", "superclass", "interfaces", "return_type"
+};
+
+static const char* const java_extensions[] = { ".java", NULL };
+static const char* const python_extensions[] = { ".py", NULL };
+
+static const TSLanguage* load_java(void) {
+    return tree_sitter_java();
+}
+
+static const TSLanguage* load_python(void) {
+    return tree_sitter_python();
+}
+
+// Languages linked into the library, in extractor_language_t order
+static const language_def_t builtin_defs[EXTRACTOR_LANG_BUILTIN_COUNT] = {
+    {
+        .name = "java",
+        .extensions = java_extensions,
+        .load = load_java,
+        .kind_names = java_kind_names,
+        .extract = {
+            [NODE_KIND_CLASS] = extract_java_class,
+            [NODE_KIND_INTERFACE] = extract_java_interface,
+            [NODE_KIND_ENUM] = extract_java_enum,
+            [NODE_KIND_METHOD] = extract_java_method,
+        },
+        .declaration_keywords = java_declaration_keywords,
+        .query = java_query,
+        .query_extract = {
+            [NODE_KIND_CLASS] = query_java_class,
+            [NODE_KIND_INTERFACE] = query_java_interface,
+            [NODE_KIND_ENUM] = query_java_enum,
+            [NODE_KIND_METHOD] = query_java_method,
+        },
+    },
+    {
+        .name = "python",
+        .extensions = python_extensions,
+        .load = load_python,
+        .kind_names = python_kind_names,
+        .extract = {
+            [NODE_KIND_CLASS] = extract_python_class,
+            [NODE_KIND_FUNCTION] = extract_python_function,
+        },
+        .declaration_keywords = python_declaration_keywords,
+        .query = python_query,
+        .query_extract = {
+            [NODE_KIND_CLASS] = query_python_class,
+            [NODE_KIND_FUNCTION] = query_python_function,
+        },
+    },
+};
+
+// Kinds that can be named in the kinds of a registered grammar
+static const kind_name_t generic_kinds[] = {
+    { "class", NODE_KIND_CLASS },
+    { "interface", NODE_KIND_INTERFACE },
+    { "enum", NODE_KIND_ENUM },
+    { "method", NODE_KIND_METHOD },
+    { "function", NODE_KIND_FUNCTION },
+    { NULL, NODE_KIND_OTHER }
+};
+
+// Registry guarded by tables_lock, definitions are never removed so ids stay valid
+static const language_def_t* defs[EXTRACTOR_LANG_COUNT] = { &builtin_defs[0], &builtin_defs[1] };
+static int def_count = EXTRACTOR_LANG_BUILTIN_COUNT;
+
+static language_table_t tables[EXTRACTOR_LANG_COUNT];
+static int tables_ready[EXTRACTOR_LANG_COUNT];   // 1 once built, -1 if the grammar failed to load
+static int queries_ready[EXTRACTOR_LANG_COUNT];  // 1 once compiled, -1 if there is no usable query
+static platform_mutex_t tables_lock = PLATFORM_MUTEX_INITIALIZER;
+
+// Get the grammar of a definition, opening its shared object if needed
+static const TSLanguage* load_grammar(const language_def_t* def) {
+    if (def->load) {
+        return def->load();
+    }
+
+    void* library = platform_library_open(def->library);
+    if (!library) {
+        fprintf(stderr, "Cannot load grammar library: %s\n", def->library);
+        return NULL;
+    }
+    typedef const TSLanguage* (*grammar_fn)(void);
+    grammar_fn grammar = (grammar_fn)platform_library_symbol(library, def->symbol);
+    if (!grammar) {
+        fprintf(stderr, "Grammar library %s does not export %s\n", def->library, def->symbol);
+        return NULL;
+    }
+    return grammar();
+}
+
+// Resolve the kinds of every symbol by name, so aliases of a node name map to the same kind
+static int build_table(language_table_t* table, extractor_language_t lang) {
+    const language_def_t* def = defs[lang];
+    memset(table, 0, sizeof(language_table_t));
+    table->lang = lang;
+    table->language = load_grammar(def);
+    if (!table->language) {
+        return -1;
+    }
+    memcpy(table->extract, def->extract, sizeof(table->extract));
+    table->declaration_keywords = def->declaration_keywords;
+    table->query_extract = def->query_extract;
+
+    table->symbol_count = ts_language_symbol_count(table->language);
+    table->kinds = (uint8_t*)calloc(table->symbol_count ? table->symbol_count : 1, sizeof(uint8_t));
+    if (!table->kinds) {
+        return -1;
+    }
+    for (uint32_t symbol = 0; symbol < table->symbol_count; symbol++) {
+        if (ts_language_symbol_type(table->language, (TSSymbol)symbol) != TSSymbolTypeRegular) {
+            continue;
+        }
+        const char* symbol_name = ts_language_symbol_name(table->language, (TSSymbol)symbol);
+        for (const kind_name_t* entry = def->kind_names; symbol_name && entry->name; entry++) {
+            if (strcmp(symbol_name, entry->name) == 0) {
+                table->kinds[symbol] = (uint8_t)entry->kind;
+                break;
+            }
+        }
+    }
+    table->body_field = ts_language_field_id_for_name(table->language, "body", 4);
+    return 0;
+}
+
+const language_table_t* language_table_get(extractor_language_t lang) {
+    if (lang < 0 || lang >= EXTRACTOR_LANG_COUNT) {
+        return NULL;
+    }
+
+    // Taken once per extraction, not per node
+    platform_mutex_lock(&tables_lock);
+    if (lang < def_count && !tables_ready[lang]) {
+        tables_ready[lang] = build_table(&tables[lang], lang) == 0 ? 1 : -1;
+    }
+    const language_table_t* table = lang < def_count && tables_ready[lang] == 1 ? &tables[lang] : NULL;
+    platform_mutex_unlock(&tables_lock);
+    return table;
+}
+
+// Compile the query of a table and map its capture ids to kinds and parts
+static int compile_query(language_table_t* table, const char* source) {
+    uint32_t error_offset = 0;
+    TSQueryError error_type = TSQueryErrorNone;
+    TSQuery* query = ts_query_new(table->language, source, (uint32_t)strlen(source), &error_offset, &error_type);
+    if (!query) {
+        fprintf(stderr, "Signature query of %s does not compile at offset %u (error %d)\n",
+                defs[table->lang]->name, error_offset, (int)error_type);
+        return -1;
+    }
+
+    uint32_t capture_count = ts_query_capture_count(query);
+    uint8_t* kinds = (uint8_t*)calloc(capture_count ? capture_count : 1, 2);
+    if (!kinds) {
+        ts_query_delete(query);
+        return -1;
+    }
+    uint8_t* parts = kinds + (capture_count ? capture_count : 1);
+    for (uint32_t id = 0; id < capture_count; id++) {
+        uint32_t length;
+        const char* capture = ts_query_capture_name_for_id(query, id, &length);
+        parts[id] = QUERY_PART_COUNT;
+        for (const kind_name_t* entry = generic_kinds; entry->name; entry++) {
+            if (strlen(entry->name) == length && memcmp(capture, entry->name, length) == 0) {
+                kinds[id] = (uint8_t)entry->kind;
+            }
+        }
+        for (int part = 0; part < QUERY_PART_COUNT; part++) {
+            if (strlen(query_part_names[part]) == length && memcmp(capture, query_part_names[part], length) == 0) {
+                parts[id] = (uint8_t)part;
+            }
+        }
+    }
+    table->query = query;
+    table->capture_kinds = kinds;
+    table->capture_parts = parts;
+    return 0;
+}
+
+int language_table_query(const language_table_t* table) {
+    if (!table) {
+        return 0;
+    }
+
+    extractor_language_t lang = table->lang;
+    platform_mutex_lock(&tables_lock);
+    if (!queries_ready[lang]) {
+        const char* source = defs[lang]->query;
+        queries_ready[lang] = source && compile_query(&tables[lang], source) == 0 ? 1 : -1;
+    }
+    int ready = queries_ready[lang] == 1;
+    platform_mutex_unlock(&tables_lock);
+    return ready;
+}
+
+static extractor_language_t find_locked(const char* name) {
+    for (int i = 0; i < def_count; i++) {
+        if (strcmp(defs[i]->name, name) == 0) {
+            return (extractor_language_t)i;
+        }
+    }
+    return EXTRACTOR_LANG_UNKNOWN;
+}
+
+extractor_language_t language_table_find(const char* name) {
+    if (!name) {
+        return EXTRACTOR_LANG_UNKNOWN;
+    }
+    platform_mutex_lock(&tables_lock);
+    extractor_language_t lang = find_locked(name);
+    platform_mutex_unlock(&tables_lock);
+    return lang;
+}
+
+extractor_language_t language_table_for_path(const char* path) {
+    const char* dot = path ? strrchr(path, '.') : NULL;
+    if (!dot) {
+        return EXTRACTOR_LANG_UNKNOWN;
+    }
+
+    extractor_language_t lang = EXTRACTOR_LANG_UNKNOWN;
+    platform_mutex_lock(&tables_lock);
+    for (int i = 0; i < def_count && lang == EXTRACTOR_LANG_UNKNOWN; i++) {
+        for (const char* const* extension = defs[i]->extensions; *extension; extension++) {
+            if (strcmp(dot, *extension) == 0) {
+                lang = (extractor_language_t)i;
+                break;
+            }
+        }
+    }
+    platform_mutex_unlock(&tables_lock);
+    return lang;
+}
+
+const char* language_table_name(extractor_language_t lang) {
+    platform_mutex_lock(&tables_lock);
+    const char* name = lang >= 0 && lang < def_count ? defs[lang]->name : NULL;
+    platform_mutex_unlock(&tables_lock);
+    return name;
+}
+
+static char* copy_string(const char* text) {
+    size_t length = strlen(text);
+    char* copy = (char*)malloc(length + 1);
+    if (copy) {
+        memcpy(copy, text, length + 1);
+    }
+    return copy;
+}
+
+// Split a list into a NULL-terminated array of copies, items are trimmed and empty ones dropped
+static char** split_list(const char* list, char separator) {
+    size_t count = 1;
+    for (const char* c = list; *c; c++) {
+        count += *c == separator;
+    }
+    char** items = (char**)calloc(count + 1, sizeof(char*));
+    if (!items) {
+        return NULL;
+    }
+
+    size_t n = 0;
+    const char* start = list;
+    for (;;) {
+        const char* end = strchr(start, separator);
+        if (!end) {
+            end = start + strlen(start);
+        }
+        const char* first = start;
+        const char* last = end;
+        while (first < last && (*first == ' ' || *first == '\t')) {
+            first++;
+        }
+        while (last > first && (last[-1] == ' ' || last[-1] == '\t')) {
+            last--;
+        }
+        if (last > first) {
+            items[n] = (char*)malloc((size_t)(last - first) + 1);
+            if (!items[n]) {
+                break;
+            }
+            memcpy(items[n], first, (size_t)(last - first));
+            items[n][last - first] = '\0';
+            n++;
+        }
+        if (!*end) {
+            return items;
+        }
+        start = end + 1;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        free(items[i]);
+    }
+    free(items);
+    return NULL;
+}
+
+static void free_list(char** items) {
+    for (char** item = items; item && *item; item++) {
+        free(*item);
+    }
+    free(items);
+}
+
+// Parse "kind=node,node;kind=node" into kind names, NULL if a kind is unknown
+static kind_name_t* parse_kinds(const char* kinds) {
+    char** groups = split_list(kinds, ';');
+    if (!groups) {
+        return NULL;
+    }
+
+    size_t capacity = 1;
+    for (const char* c = kinds; *c; c++) {
+        capacity += *c == ',' || *c == ';';
+    }
+    kind_name_t* names = (kind_name_t*)calloc(capacity + 1, sizeof(kind_name_t));
+    size_t count = 0;
+    int failed = !names;
+    for (char** group = groups; !failed && *group; group++) {
+        char* equals = strchr(*group, '=');
+        node_kind_t kind = NODE_KIND_OTHER;
+        if (equals) {
+            *equals = '\0';
+            for (const kind_name_t* entry = generic_kinds; entry->name; entry++) {
+                if (strcmp(*group, entry->name) == 0) {
+                    kind = entry->kind;
+                }
+            }
+        }
+        if (kind == NODE_KIND_OTHER) {
+            fprintf(stderr, "Unknown kind in grammar kinds: %s\n", *group);
+            failed = 1;
+            break;
+        }
+
+        char** nodes = split_list(equals + 1, ',');
+        if (!nodes) {
+            failed = 1;
+            break;
+        }
+        for (char** node = nodes; *node; node++) {
+            names[count].name = *node;
+            names[count].kind = kind;
+            count++;
+        }
+        free(nodes); // The names now own the strings
+    }
+    free_list(groups);
+
+    if (failed) {
+        for (size_t i = 0; names && i < count; i++) {
+            free((char*)names[i].name);
+        }
+        free(names);
+        return NULL;
+    }
+    return names;
+}
+
+extractor_language_t language_table_register(const char* name, const char* extensions, const char* library,
+                                             const char* symbol, const char* kinds) {
+    if (!name || !*name || !extensions || !library || !kinds) {
+        return EXTRACTOR_LANG_UNKNOWN;
+    }
+
+    // Definitions live for the lifetime of the process, like the tables built from them
+    language_def_t* def = (language_def_t*)calloc(1, sizeof(language_def_t));
+    char* symbol_copy = symbol ? copy_string(symbol) : (char*)malloc(strlen(name) + sizeof("tree_sitter_"));
+    if (symbol_copy && !symbol) {
+        strcpy(symbol_copy, "tree_sitter_");
+        strcat(symbol_copy, name);
+    }
+    char* name_copy = copy_string(name);
+    char* library_copy = copy_string(library);
+    char** extension_list = split_list(extensions, ',');
+    kind_name_t* kind_names = parse_kinds(kinds);
+    if (!def || !symbol_copy || !name_copy || !library_copy || !extension_list || !kind_names) {
+        goto fail;
+    }
+    def->name = name_copy;
+    def->extensions = (const char* const*)extension_list;
+    def->library = library_copy;
+    def->symbol = symbol_copy;
+    def->kind_names = kind_names;
+    def->extract[NODE_KIND_CLASS] = extract_generic_class;
+    def->extract[NODE_KIND_INTERFACE] = extract_generic_interface;
+    def->extract[NODE_KIND_ENUM] = extract_generic_enum;
+    def->extract[NODE_KIND_METHOD] = extract_generic_function;
+    def->extract[NODE_KIND_FUNCTION] = extract_generic_function;
+
+    platform_mutex_lock(&tables_lock);
+    extractor_language_t lang = EXTRACTOR_LANG_UNKNOWN;
+    if (find_locked(name) != EXTRACTOR_LANG_UNKNOWN) {
+        fprintf(stderr, "Language already registered: %s\n", name);
+    } else if (def_count >= EXTRACTOR_LANG_COUNT) {
+        fprintf(stderr, "Too many languages registered\n");
+    } else {
+        lang = (extractor_language_t)def_count;
+        defs[def_count++] = def;
+    }
+    platform_mutex_unlock(&tables_lock);
+    if (lang != EXTRACTOR_LANG_UNKNOWN) {
+        return lang;
+    }
+
+fail:
+    if (kind_names) {
+        for (const kind_name_t* entry = kind_names; entry->name; entry++) {
+            free((char*)entry->name);
+        }
+        free(kind_names);
+    }
+    free_list(extension_list);
+    free(library_copy);
+    free(name_copy);
+    free(symbol_copy);
+    free(def);
+    return EXTRACTOR_LANG_UNKNOWN;
+}
+
+int register_grammar(const char* name, const char* extensions, const char* library,
+                     const char* symbol, const char* kinds) {
+    return (int)language_table_register(name, extensions, library, symbol, kinds);
+}
+
+const char* get_language_for_path(const char* path) {
+    return language_table_name(language_table_for_path(path));
+}
+
+int is_language_supported(const char* name) {
+    return language_table_find(name) != EXTRACTOR_LANG_UNKNOWN;
+}
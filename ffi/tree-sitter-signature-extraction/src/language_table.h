@@ -0,0 +1,183 @@
+#ifndef LANGUAGE_TABLE_H
+#define LANGUAGE_TABLE_H
+
+#include "extractor_context.h"
+#include "signature_node.h"
+#include "tree_sitter/api.h"
+#include "dll_export.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Forward declaration
+struct extract_state;
+
+// Kinds of nodes the extractor looks at, every other node is NODE_KIND_OTHER
+typedef enum {
+    NODE_KIND_OTHER = 0,
+    NODE_KIND_CLASS,                 // Java class_declaration, Python class_definition
+    NODE_KIND_INTERFACE,             // Java interface_declaration
+    NODE_KIND_ENUM,                  // Java enum_declaration
+    NODE_KIND_METHOD,                // Java method_declaration
+    NODE_KIND_CONSTRUCTOR,           // Java constructor_declaration
+    NODE_KIND_FUNCTION,              // Python function_definition
+    NODE_KIND_MEMBER_CODE,           // Java field_declaration and static_initializer
+    NODE_KIND_EXPRESSION,            // Python expression_statement
+    NODE_KIND_COUNT
+} node_kind_t;
+
+// Builds the signature node of a declaration
+typedef signature_node_t* (*entity_extract_fn)(struct extract_state* state, TSNode node);
+
+// Parts of a declaration captured by a signature query, named like their capture
+typedef enum {
+    QUERY_PART_NAME = 0,             // @name
+    QUERY_PART_MODIFIERS,            // @modifiers
+    QUERY_PART_TYPE_PARAMETERS,      // @type_parameters
+    QUERY_PART_TYPE,                 // @type, the return type of a Java method
+    QUERY_PART_PARAMETERS,           // @parameters
+    QUERY_PART_THROWS,               // @throws
+    QUERY_PART_SUPERCLASS,           // @superclass, the superclasses of a Python class
+    QUERY_PART_INTERFACES,           // @interfaces
+    QUERY_PART_RETURN_TYPE,          // @return_type
+    QUERY_PART_COUNT
+} query_part_t;
+
+// Builds the signature node of a declaration from the parts a query captured, null if absent
+typedef signature_node_t* (*entity_query_fn)(struct extract_state* state, TSNode node, const TSNode* parts);
+
+// Grammar node name of a kind
+typedef struct {
+    const char* name;
+    node_kind_t kind;
+} kind_name_t;
+
+// Definition of a language: where its grammar comes from and how its declarations are extracted.
+// Nothing of the grammar is touched until the first file of the language is parsed.
+typedef struct {
+    const char* name;                            // Language name, e.g. "java"
+    const char* const* extensions;               // File extensions with their dot, NULL-terminated
+    const TSLanguage* (*load)(void);             // Grammar linked into the library, NULL to open library
+    const char* library;                         // Shared object exporting the grammar
+    const char* symbol;                          // Function of library returning the grammar
+    const kind_name_t* kind_names;               // Node names of each kind, terminated by a NULL name
+    entity_extract_fn extract[NODE_KIND_COUNT];  // Handler of each kind, NULL if nothing is extracted
+    const char* const* declaration_keywords;     // Words a nested declaration cannot be written without,
+                                                 // NULL to visit every function body
+    const char* query;                           // Signature query, NULL to always walk the tree
+    entity_query_fn query_extract[NODE_KIND_COUNT]; // Handler of each kind captured by the query
+} language_def_t;
+
+// Node kinds and handlers of a language, resolved once from its grammar
+typedef struct {
+    extractor_language_t lang;                   // Language id
+    const TSLanguage* language;                  // Grammar the symbols belong to
+    uint8_t* kinds;                              // node_kind_t of each symbol
+    uint32_t symbol_count;                       // Number of entries in kinds
+    TSFieldId body_field;                        // Id of the "body" field, 0 if absent
+    entity_extract_fn extract[NODE_KIND_COUNT];  // Handler of each kind, NULL if nothing is extracted
+    const char* const* declaration_keywords;     // Words a nested declaration cannot be written without
+    const TSQuery* query;                        // Compiled signature query, see language_table_query
+    uint8_t* capture_kinds;                      // node_kind_t of each capture of the query, 0 for parts
+    uint8_t* capture_parts;                      // query_part_t of each capture, QUERY_PART_COUNT for entities
+    const entity_query_fn* query_extract;        // Handler of each kind captured by the query
+} language_table_t;
+
+/**
+ * Register a language loaded from a grammar shared object. Its declarations are extracted by
+ * the generic handlers: the name is the "name" field and the signature is the text before the
+ * "body" field.
+ * @param name Language name, must not be registered yet
+ * @param extensions File extensions separated by commas, e.g. ".go" or ".ts,.tsx"
+ * @param library Path of the grammar shared object, opened on first use
+ * @param symbol Function returning the grammar, NULL for tree_sitter_<name>
+ * @param kinds Node names of each kind, e.g. "class=type_declaration;function=function_declaration,method_declaration".
+ *              Kinds are class, interface, enum, method (nested in classes) and function.
+ * @return Language id, or EXTRACTOR_LANG_UNKNOWN on failure
+ */
+extractor_language_t language_table_register(const char* name, const char* extensions, const char* library,
+                                             const char* symbol, const char* kinds);
+
+/**
+ * Look a language up by name
+ * @param name Language name
+ * @return Language id, or EXTRACTOR_LANG_UNKNOWN if not registered
+ */
+extractor_language_t language_table_find(const char* name);
+
+/**
+ * Look the language of a file up by its extension
+ * @param path Path of the file
+ * @return Language id, or EXTRACTOR_LANG_UNKNOWN if no language claims the extension
+ */
+extractor_language_t language_table_for_path(const char* path);
+
+/**
+ * Get the name of a registered language
+ * @param lang Language id
+ * @return Name valid for the lifetime of the process, or NULL if not registered
+ */
+const char* language_table_name(extractor_language_t lang);
+
+/**
+ * Get the table of a language, loading its grammar and building the table on first use
+ * @param lang Language id
+ * @return Table valid for the lifetime of the process, or NULL if unsupported or the grammar cannot be loaded
+ */
+const language_table_t* language_table_get(extractor_language_t lang);
+
+/**
+ * Get the signature query of a language, compiling it on first use
+ * @param table Table of the language
+ * @return Non-zero if table->query and its capture maps are ready, 0 if the language has no
+ *         query or it does not compile against the grammar
+ */
+int language_table_query(const language_table_t* table);
+
+/**
+ * Register a grammar shared object, see language_table_register
+ * @return Language id, or -1 on failure
+ */
+DLL_EXPORT int register_grammar(const char* name, const char* extensions, const char* library,
+                                const char* symbol, const char* kinds);
+
+/**
+ * Get the language of a file from its extension
+ * @param path Path of the file
+ * @return Language name owned by the library, or NULL if no language claims the extension
+ */
+DLL_EXPORT const char* get_language_for_path(const char* path);
+
+/**
+ * Whether a language is built in or registered
+ * @param name Language name
+ * @return Non-zero if files of the language can be extracted
+ */
+DLL_EXPORT int is_language_supported(const char* name);
+
+/**
+ * Get the kind of a node with a single array lookup
+ * @param table Table of the language the node was parsed with
+ * @param node Node
+ * @return Kind of the node
+ */
+static inline node_kind_t language_table_kind(const language_table_t* table, TSNode node) {
+    TSSymbol symbol = ts_node_symbol(node);
+    return symbol < table->symbol_count ? (node_kind_t)table->kinds[symbol] : NODE_KIND_OTHER;
+}
+
+/**
+ * Whether a kind is a function or constructor whose body can be skipped
+ * @param kind Node kind
+ * @return Non-zero for function-like kinds
+ */
+static inline int node_kind_is_function(node_kind_t kind) {
+    return kind == NODE_KIND_METHOD || kind == NODE_KIND_CONSTRUCTOR || kind == NODE_KIND_FUNCTION;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LANGUAGE_TABLE_H
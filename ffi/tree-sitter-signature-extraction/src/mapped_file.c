@@ -0,0 +1,113 @@
+#include "mapped_file.h"
+#include "extractor_stats.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#if defined(_WIN32) || defined(__CYGWIN__)
+  #ifndef WIN32_LEAN_AND_MEAN
+    #define WIN32_LEAN_AND_MEAN
+  #endif
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+// Tree-sitter takes 32-bit lengths, larger files cannot be parsed anyway
+static int mappable_size(uint64_t size) {
+    return size >= MAPPED_FILE_MIN_SIZE && size <= UINT32_MAX && size <= SIZE_MAX;
+}
+
+#if defined(_WIN32) || defined(__CYGWIN__)
+
+mapped_file_t* mapped_file_map(const char* path) {
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return NULL;
+    }
+
+    LARGE_INTEGER size;
+    if (GetFileType(file) != FILE_TYPE_DISK || !GetFileSizeEx(file, &size) || !mappable_size((uint64_t)size.QuadPart)) {
+        CloseHandle(file);
+        return NULL;
+    }
+
+    // The view keeps the mapping and the file alive once both handles are closed
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (!mapping) {
+        return NULL;
+    }
+    void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!data) {
+        return NULL;
+    }
+
+    mapped_file_t* mapped = (mapped_file_t*)malloc(sizeof(mapped_file_t));
+    if (!mapped) {
+        UnmapViewOfFile(data);
+        return NULL;
+    }
+    mapped->data = (const char*)data;
+    mapped->size = (size_t)size.QuadPart;
+    STATS_ADD(STATS_BYTES_READ, mapped->size);
+    return mapped;
+}
+
+void mapped_file_close(mapped_file_t* mapping) {
+    if (!mapping) {
+        return;
+    }
+    UnmapViewOfFile((void*)mapping->data);
+    free(mapping);
+}
+
+#else
+
+mapped_file_t* mapped_file_map(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || !mappable_size((uint64_t)st.st_size)) {
+        close(fd);
+        return NULL;
+    }
+
+    // The mapping holds its own reference to the file
+    void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return NULL;
+    }
+#ifdef MADV_SEQUENTIAL
+    madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+#endif
+
+    mapped_file_t* mapped = (mapped_file_t*)malloc(sizeof(mapped_file_t));
+    if (!mapped) {
+        munmap(data, (size_t)st.st_size);
+        return NULL;
+    }
+    mapped->data = (const char*)data;
+    mapped->size = (size_t)st.st_size;
+    STATS_ADD(STATS_BYTES_READ, mapped->size);
+    return mapped;
+}
+
+void mapped_file_close(mapped_file_t* mapping) {
+    if (!mapping) {
+        return;
+    }
+    munmap((void*)mapping->data, mapping->size);
+    free(mapping);
+}
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Files smaller than this are cheaper to read than to map
+#define MAPPED_FILE_MIN_SIZE (64 * 1024)
+
+// Read-only view of a whole file, not NUL-terminated
+typedef struct {
+    const char* data;                // First byte of the file
+    size_t size;                     // Size of the file in bytes
+} mapped_file_t;
+
+/**
+ * Map a file read-only into memory.
+ * Only regular files of at least MAPPED_FILE_MIN_SIZE bytes are mapped; pipes,
+ * devices and small files return NULL so the caller falls back to a buffered read.
+ * The view must not outlive a truncation of the file, reading past the new end faults.
+ * @param path Path of the file
+ * @return Mapping to be closed with mapped_file_close, or NULL if not mapped
+ */
+mapped_file_t* mapped_file_map(const char* path);
+
+/**
+ * Unmap a file and free its mapping
+ * @param mapping Mapping, may be NULL
+ */
+void mapped_file_close(mapped_file_t* mapping);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MAPPED_FILE_H
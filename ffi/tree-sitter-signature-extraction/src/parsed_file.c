@@ -0,0 +1,495 @@
+#include "parsed_file.h"
+#include "signature_extractor.h"
+#include "skeleton_store.h"
+#include "extractor_stats.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+uint64_t content_hash(const char* data, size_t size) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Position of a byte offset within a buffer
+static TSPoint point_at(const char* source, size_t offset) {
+    TSPoint point = {0, 0};
+    const char* line_start = source;
+    const char* end = source + offset;
+    const char* newline;
+    while ((newline = memchr(line_start, '\n', end - line_start)) != NULL) {
+        point.row++;
+        line_start = newline + 1;
+    }
+    point.column = (uint32_t)(end - line_start);
+    return point;
+}
+
+int compute_source_edit(const char* old_source, size_t old_size,
+                        const char* new_source, size_t new_size, TSInputEdit* edit) {
+    size_t prefix = 0;
+    size_t max_prefix = old_size < new_size ? old_size : new_size;
+    while (prefix < max_prefix && old_source[prefix] == new_source[prefix]) {
+        prefix++;
+    }
+    if (prefix == old_size && prefix == new_size) {
+        return 0;
+    }
+
+    size_t suffix = 0;
+    size_t max_suffix = max_prefix - prefix;
+    while (suffix < max_suffix && old_source[old_size - 1 - suffix] == new_source[new_size - 1 - suffix]) {
+        suffix++;
+    }
+
+    edit->start_byte = (uint32_t)prefix;
+    edit->old_end_byte = (uint32_t)(old_size - suffix);
+    edit->new_end_byte = (uint32_t)(new_size - suffix);
+    edit->start_point = point_at(new_source, prefix);
+    edit->old_end_point = point_at(old_source, old_size - suffix);
+    edit->new_end_point = point_at(new_source, new_size - suffix);
+    return 1;
+}
+
+// Map a byte offset of the new source back through the edits, UINT32_MAX if it was edited in.
+// row_delta receives how many lines the offset moved by.
+static uint32_t unmap_offset(uint32_t offset, const TSInputEdit* edits, uint32_t edit_count, int* row_delta) {
+    int delta = 0;
+    for (uint32_t i = edit_count; i-- > 0;) {
+        if (offset >= edits[i].new_end_byte) {
+            offset = offset - edits[i].new_end_byte + edits[i].old_end_byte;
+            delta += (int)edits[i].new_end_point.row - (int)edits[i].old_end_point.row;
+        } else if (offset > edits[i].start_byte) {
+            return UINT32_MAX;
+        }
+    }
+    if (row_delta) *row_delta = delta;
+    return offset;
+}
+
+// Whether a byte range intersects any of the changed ranges
+static int intersects_changes(uint32_t start_byte, uint32_t end_byte, const TSRange* changes, uint32_t change_count) {
+    for (uint32_t i = 0; i < change_count; i++) {
+        if (changes[i].start_byte < end_byte && changes[i].end_byte > start_byte) {
+            return 1;
+        }
+        if (changes[i].start_byte == changes[i].end_byte && changes[i].start_byte == start_byte) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Column of a byte offset, found by scanning back to the start of its line
+static uint32_t column_at(const char* source, uint32_t offset) {
+    uint32_t start = offset;
+    while (start > 0 && source[start - 1] != '\n') {
+        start--;
+    }
+    return offset - start;
+}
+
+// Move a copied signature to its place in the new source
+static void shift_signature_node(signature_node_t* node, const char* source, int line_delta, int64_t byte_delta) {
+    node->start_line += line_delta;
+    node->end_line += line_delta;
+    node->start_byte = (uint32_t)(node->start_byte + byte_delta);
+    node->end_byte = (uint32_t)(node->end_byte + byte_delta);
+    if (node->source) {
+        // The parts were copied with the node, so they can be rebased in place
+        node->source = source;
+        node->name_slice.offset = (uint32_t)(node->name_slice.offset + byte_delta);
+        for (uint32_t i = 0; i < node->part_count; i++) {
+            if (!node->parts[i].literal) {
+                node->parts[i].slice.offset = (uint32_t)(node->parts[i].slice.offset + byte_delta);
+            }
+        }
+    }
+    for (signature_node_t* child = node->children; child; child = child->next_sibling) {
+        shift_signature_node(child, source, line_delta, byte_delta);
+    }
+}
+
+// Signature nodes of the previous version in pre-order, which is also byte order
+typedef struct {
+    signature_node_t** nodes;
+    uint32_t count;
+    uint32_t capacity;
+} signature_index_t;
+
+static int index_signatures(signature_index_t* index, signature_node_t* node) {
+    for (; node; node = node->next_sibling) {
+        if (index->count == index->capacity) {
+            uint32_t capacity = index->capacity ? index->capacity * 2 : 64;
+            signature_node_t** nodes = (signature_node_t**)realloc(index->nodes, capacity * sizeof(signature_node_t*));
+            if (!nodes) {
+                return -1;
+            }
+            index->nodes = nodes;
+            index->capacity = capacity;
+        }
+        index->nodes[index->count++] = node;
+        if (index_signatures(index, node->children) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// State of an incremental extraction
+typedef struct {
+    const parsed_file_t* previous;
+    signature_index_t index;
+    const TSInputEdit* edits;
+    uint32_t edit_count;
+    const TSRange* changes;
+    uint32_t change_count;
+    const char* source;
+    arena_t* arena;
+    extract_state_t extract;
+} reparse_state_t;
+
+// Copy the previous signatures of an unchanged node under parent.
+// Returns 0 if the node cannot be proven unchanged and must be extracted again.
+static int reuse_signatures(reparse_state_t* state, TSNode node, signature_node_t* parent) {
+    uint32_t start_byte = ts_node_start_byte(node);
+    uint32_t end_byte = ts_node_end_byte(node);
+    if (intersects_changes(start_byte, end_byte, state->changes, state->change_count)) {
+        return 0;
+    }
+
+    int line_delta = 0;
+    uint32_t old_start = unmap_offset(start_byte, state->edits, state->edit_count, &line_delta);
+    uint32_t old_end = unmap_offset(end_byte, state->edits, state->edit_count, NULL);
+    if (old_start == UINT32_MAX || old_end == UINT32_MAX || old_end - old_start != end_byte - start_byte) {
+        return 0;
+    }
+
+    // Same text at the same column means the same signatures
+    const char* old_source = state->previous->source;
+    if (column_at(old_source, old_start) != ts_node_start_point(node).column ||
+        memcmp(old_source + old_start, state->source + start_byte, end_byte - start_byte) != 0) {
+        return 0;
+    }
+
+    // Binary search the first previous signature starting at the node
+    signature_node_t** nodes = state->index.nodes;
+    uint32_t lo = 0;
+    uint32_t hi = state->index.count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (nodes[mid]->start_byte < old_start) lo = mid + 1;
+        else hi = mid;
+    }
+
+    // Copy the outermost signatures inside the node, their descendants come along
+    int64_t byte_delta = (int64_t)start_byte - (int64_t)old_start;
+    uint32_t covered_end = old_start;
+    int covered = 0;
+    for (uint32_t i = lo; i < state->index.count && nodes[i]->start_byte < old_end; i++) {
+        signature_node_t* old_node = nodes[i];
+        if (old_node->end_byte > old_end || (covered && old_node->start_byte < covered_end)) {
+            continue; // An ancestor of the node, or a descendant of a copied signature
+        }
+        signature_node_t* clone = clone_signature_node_in(state->arena, old_node);
+        if (clone) {
+            shift_signature_node(clone, state->source, line_delta, byte_delta);
+            add_child_signature_node(parent, clone);
+        }
+        covered_end = old_node->end_byte;
+        covered = 1;
+    }
+    return 1;
+}
+
+// Extract the subtree at the cursor, copying what did not change, and leave the cursor where it was
+static void reparse_traverse(reparse_state_t* state, TSTreeCursor* cursor, signature_node_t* parent) {
+    TSNode node = ts_tree_cursor_current_node(cursor);
+    STATS_ADD(STATS_NODES_VISITED, 1);
+    if (reuse_signatures(state, node, parent)) {
+        return;
+    }
+
+    signature_node_t* sig_node = extract_node_signature(&state->extract, node);
+    if (sig_node) {
+        add_child_signature_node(parent, sig_node);
+    }
+
+    signature_node_t* current_parent = sig_node ? sig_node : parent;
+    if (ts_tree_cursor_goto_first_child(cursor)) {
+        int in_function = node_kind_is_function(language_table_kind(state->extract.table, node));
+        do {
+            if (extract_should_visit(&state->extract, cursor, in_function)) {
+                reparse_traverse(state, cursor, current_parent);
+            }
+        } while (ts_tree_cursor_goto_next_sibling(cursor));
+        ts_tree_cursor_goto_parent(cursor);
+    }
+}
+
+// Extract the forest, copying signatures of subtrees unchanged since the previous version if any.
+// Signatures extracted in another body mode are not copied, the whole forest is extracted again.
+static int build_forest(parsed_file_t* file, const parsed_file_t* previous,
+                        const TSInputEdit* edits, uint32_t edit_count,
+                        const TSRange* changes, uint32_t change_count) {
+    TSNode root = ts_tree_root_node(file->tree);
+
+    if (!previous || previous->body_mode != file->body_mode) {
+        file->forest = extract_signatures_in_node(root, file->source, extractor_language_name(file->lang),
+                                                  &file->arena);
+        return 0;
+    }
+
+    const language_table_t* table = language_table_get(file->lang);
+    if (!table) {
+        return -1;
+    }
+    reparse_state_t state = {
+        .previous = previous,
+        .edits = edits,
+        .edit_count = edit_count,
+        .changes = changes,
+        .change_count = change_count,
+        .source = file->source,
+        .arena = &file->arena,
+    };
+    if (index_signatures(&state.index, previous->forest) != 0) {
+        free(state.index.nodes);
+        return -1;
+    }
+
+    // Dummy root to collect the top-level signatures, as in extract_signatures
+    signature_node_t* root_container = create_signature_node_in(&file->arena, ENTITY_UNKNOWN,
+                                                                "root", 4, "root", 4, 0, 0, 0, 0);
+    if (!root_container) {
+        free(state.index.nodes);
+        return -1;
+    }
+    extract_state_init(&state.extract, file->source, &file->arena);
+    state.extract.table = table;
+    state.extract.body_mode = file->body_mode;
+    TSTreeCursor cursor = ts_tree_cursor_new(root);
+    reparse_traverse(&state, &cursor, root_container);
+    ts_tree_cursor_delete(&cursor);
+    extract_state_finish(&state.extract);
+    free(state.index.nodes);
+
+    file->forest = root_container->children;
+    for (signature_node_t* node = file->forest; node; node = node->next_sibling) {
+        node->parent = NULL;
+    }
+    return 0;
+}
+
+// Extract errors and estimate the footprint once the forest is built
+static void finish_parsed_file(parsed_file_t* file) {
+    STATS_PHASE_BEGIN(errors);
+    file->errors = extract_parse_errors_in(file->tree, file->source, file->source_size,
+                                           &file->error_count, &file->arena);
+    STATS_PHASE_END(STATS_PHASE_ERRORS, errors);
+    STATS_PHASE_BEGIN(index);
+    file->entities = entity_index_build(&file->arena, file->forest);
+    STATS_PHASE_END(STATS_PHASE_EXTRACT, index);
+
+    // A Tree-sitter tree takes a few times the size of its source, mapped pages are not heap
+    file->memory_size = sizeof(parsed_file_t)
+                      + (file->owns_source ? file->source_size + 1 : 0)
+                      + file->source_size * 3
+                      + file->arena.footprint;
+}
+
+// Wrap a source buffer, or a mapping when source is NULL
+static parsed_file_t* parsed_file_new(extractor_language_t lang, char* source, size_t source_size, int owns_source,
+                                      mapped_file_t* mapping) {
+    parsed_file_t* file = (parsed_file_t*)calloc(1, sizeof(parsed_file_t));
+    if (!file) {
+        if (owns_source) free(source);
+        mapped_file_close(mapping);
+        return NULL;
+    }
+
+    arena_init(&file->arena);
+    file->lang = lang;
+    file->body_mode = get_signature_body_mode();
+    if (mapping) {
+        file->source = (char*)mapping->data;
+        file->source_size = mapping->size;
+        file->mapping = mapping;
+    } else {
+        file->source = source;
+        file->source_size = source_size;
+        file->owns_source = owns_source;
+    }
+    return file;
+}
+
+void parsed_file_hash(parsed_file_t* file) {
+    if (file && !file->hashed && file->source) {
+        file->content_hash = content_hash(file->source, file->source_size);
+        file->hashed = 1;
+    }
+}
+
+static parsed_file_t* create_parsed_file(TSParser* parser, extractor_language_t lang,
+                                         char* source, size_t source_size, int owns_source,
+                                         mapped_file_t* mapping) {
+    parsed_file_t* file = parsed_file_new(lang, source, source_size, owns_source, mapping);
+    if (!file) {
+        return NULL;
+    }
+
+    // Parse the source code
+    STATS_PHASE_BEGIN(parse);
+    file->tree = ts_parser_parse_string(parser, NULL, file->source, file->source_size);
+    STATS_PHASE_END(STATS_PHASE_PARSE, parse);
+    if (!file->tree) {
+        parsed_file_free(file);
+        return NULL;
+    }
+    STATS_PHASE_BEGIN(extract);
+    int status = build_forest(file, NULL, NULL, 0, NULL, 0);
+    STATS_PHASE_END(STATS_PHASE_EXTRACT, extract);
+    if (status != 0) {
+        parsed_file_free(file);
+        return NULL;
+    }
+
+    finish_parsed_file(file);
+    return file;
+}
+
+parsed_file_t* parsed_file_create(TSParser* parser, extractor_language_t lang,
+                                  char* source, size_t source_size, int owns_source) {
+    return create_parsed_file(parser, lang, source, source_size, owns_source, NULL);
+}
+
+parsed_file_t* parsed_file_create_mapped(TSParser* parser, extractor_language_t lang, mapped_file_t* mapping) {
+    return create_parsed_file(parser, lang, NULL, 0, 0, mapping);
+}
+
+static parsed_file_t* reparse_parsed_file(TSParser* parser, const parsed_file_t* previous,
+                                          char* source, size_t source_size, int owns_source,
+                                          mapped_file_t* mapping,
+                                          const TSInputEdit* edits, uint32_t edit_count) {
+    if (!previous || !previous->tree) {
+        return create_parsed_file(parser, previous ? previous->lang : EXTRACTOR_LANG_UNKNOWN,
+                                  source, source_size, owns_source, mapping);
+    }
+
+    parsed_file_t* file = parsed_file_new(previous->lang, source, source_size, owns_source, mapping);
+    if (!file) {
+        return NULL;
+    }
+    source = file->source;
+    source_size = file->source_size;
+
+    TSInputEdit diff_edit;
+    if (!edits) {
+        edit_count = compute_source_edit(previous->source, previous->source_size, source, source_size, &diff_edit);
+        edits = &diff_edit;
+    }
+
+    // Edit a copy of the previous tree so the previous version stays usable
+    TSTree* old_tree = ts_tree_copy(previous->tree);
+    for (uint32_t i = 0; i < edit_count; i++) {
+        ts_tree_edit(old_tree, &edits[i]);
+    }
+
+    STATS_PHASE_BEGIN(parse);
+    file->tree = ts_parser_parse_string(parser, old_tree, source, source_size);
+    STATS_PHASE_END(STATS_PHASE_PARSE, parse);
+    if (!file->tree) {
+        ts_tree_delete(old_tree);
+        parsed_file_free(file);
+        return NULL;
+    }
+
+    uint32_t change_count = 0;
+    TSRange* changes = ts_tree_get_changed_ranges(old_tree, file->tree, &change_count);
+    STATS_PHASE_BEGIN(extract);
+    int status = build_forest(file, previous, edits, edit_count, changes, change_count);
+    STATS_PHASE_END(STATS_PHASE_EXTRACT, extract);
+    free(changes);
+    ts_tree_delete(old_tree);
+    if (status != 0) {
+        parsed_file_free(file);
+        return NULL;
+    }
+
+    finish_parsed_file(file);
+    return file;
+}
+
+parsed_file_t* parsed_file_reparse(TSParser* parser, const parsed_file_t* previous,
+                                   char* source, size_t source_size, int owns_source,
+                                   const TSInputEdit* edits, uint32_t edit_count) {
+    return reparse_parsed_file(parser, previous, source, source_size, owns_source, NULL, edits, edit_count);
+}
+
+parsed_file_t* parsed_file_reparse_mapped(TSParser* parser, const parsed_file_t* previous, mapped_file_t* mapping) {
+    return reparse_parsed_file(parser, previous, NULL, 0, 0, mapping, NULL, 0);
+}
+
+parsed_file_t* parsed_file_restore(extractor_language_t lang, int body_mode, uint64_t hash,
+                                   const char* data, size_t size) {
+    parsed_file_t* file = (parsed_file_t*)calloc(1, sizeof(parsed_file_t));
+    if (!file) {
+        return NULL;
+    }
+    arena_init(&file->arena);
+    file->lang = lang;
+    file->body_mode = body_mode;
+    file->content_hash = hash;
+    file->hashed = 1;
+    if (skeleton_store_decode(data, size, &file->arena, &file->forest, &file->errors, &file->error_count) != 0) {
+        parsed_file_free(file);
+        return NULL;
+    }
+
+    // Only the forest is kept, there is no source or tree to account for
+    file->entities = entity_index_build(&file->arena, file->forest);
+    file->memory_size = sizeof(parsed_file_t) + file->arena.footprint;
+    return file;
+}
+
+signature_node_t* parsed_file_enclosing_entity(const parsed_file_t* file, int line) {
+    if (!file) {
+        return NULL;
+    }
+    if (file->entities) {
+        return entity_index_enclosing(file->entities, line);
+    }
+
+    // Without an index, walk down the forest
+    signature_node_t* enclosing = NULL;
+    for (signature_node_t* node = file->forest; node; ) {
+        if (node->start_line <= line && node->end_line >= line) {
+            enclosing = node;
+            node = node->children;
+        } else {
+            node = node->next_sibling;
+        }
+    }
+    return enclosing;
+}
+
+void parsed_file_free(parsed_file_t* file) {
+    if (!file) {
+        return;
+    }
+
+    // The forest and the errors live in the arena
+    arena_release(&file->arena);
+    if (file->tree) {
+        ts_tree_delete(file->tree);
+    }
+    if (file->owns_source) {
+        free(file->source);
+    }
+    mapped_file_close(file->mapping);
+    free(file);
+}
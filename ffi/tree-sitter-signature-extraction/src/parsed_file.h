@@ -0,0 +1,145 @@
+#ifndef PARSED_FILE_H
+#define PARSED_FILE_H
+
+#include "extractor_context.h"
+#include "signature_node.h"
+#include "arena.h"
+#include "mapped_file.h"
+#include "entity_index.h"
+#include "tree_sitter/api.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Forward declaration
+typedef struct skeleton_cache skeleton_cache_t;
+
+// A parsed source file together with everything derived from it
+typedef struct parsed_file {
+    extractor_language_t lang;       // Language of the file
+    char* source;                    // Source code, NUL-terminated unless mapped, NULL for restored files
+    size_t source_size;              // Size of the source in bytes
+    int owns_source;                 // Whether source is freed with the file
+    mapped_file_t* mapping;          // Mapping the source points into, or NULL
+    uint64_t content_hash;           // FNV-1a hash of the source, once hashed is set
+    int hashed;                      // Whether content_hash is computed, see parsed_file_hash
+    TSTree* tree;                    // Parsed Tree-sitter tree, NULL for restored files
+    int body_mode;                   // extract_body_mode_t the forest was extracted with
+    arena_t arena;                   // Holds the forest and the errors
+    signature_node_t* forest;        // Top-level signature nodes
+    entity_index_t* entities;        // Interval index of the forest, NULL if it could not be built
+    parse_error_t* errors;           // Parse errors
+    int error_count;                 // Number of parse errors
+    size_t memory_size;              // Approximate heap footprint in bytes
+    skeleton_cache_t* cache;         // Owning cache, NULL for transient files
+    int ref_count;                   // References held, guarded by the cache lock
+} parsed_file_t;
+
+/**
+ * Parse a source buffer and extract its signatures and errors
+ * @param parser Parser already configured for the language
+ * @param lang Language of the source
+ * @param source NUL-terminated source code
+ * @param source_size Size of the source in bytes
+ * @param owns_source Whether the parsed file takes ownership of source
+ * @return New parsed file, or NULL on failure (source is freed if owned)
+ */
+parsed_file_t* parsed_file_create(TSParser* parser, extractor_language_t lang,
+                                  char* source, size_t source_size, int owns_source);
+
+/**
+ * Parse a mapped file, the source is read straight from the mapping
+ * @param parser Parser already configured for the language
+ * @param lang Language of the source
+ * @param mapping Mapping of the file, owned by the parsed file (closed on failure)
+ * @return New parsed file, or NULL on failure
+ */
+parsed_file_t* parsed_file_create_mapped(TSParser* parser, extractor_language_t lang, mapped_file_t* mapping);
+
+/**
+ * Parse a new version of a file incrementally from a previous version.
+ * The previous tree is edited and reused by the parser, and signatures are only
+ * re-extracted along the changed ranges; unchanged subtrees take a copy of their
+ * previous signatures. If the body mode changed since previous, all signatures are
+ * extracted again.
+ * @param parser Parser configured for the language of previous
+ * @param previous Previous version, left untouched
+ * @param source New NUL-terminated source code
+ * @param source_size Size of the new source in bytes
+ * @param owns_source Whether the parsed file takes ownership of source
+ * @param edits Edits turning the previous source into the new one, or NULL to diff them
+ * @param edit_count Number of edits
+ * @return New parsed file, or NULL on failure (source is freed if owned)
+ */
+parsed_file_t* parsed_file_reparse(TSParser* parser, const parsed_file_t* previous,
+                                   char* source, size_t source_size, int owns_source,
+                                   const TSInputEdit* edits, uint32_t edit_count);
+
+/**
+ * Reparse a new version of a file from a mapping, diffing it against the previous version
+ * @param parser Parser configured for the language of previous
+ * @param previous Previous version, left untouched
+ * @param mapping Mapping of the new contents, owned by the parsed file (closed on failure)
+ * @return New parsed file, or NULL on failure
+ */
+parsed_file_t* parsed_file_reparse_mapped(TSParser* parser, const parsed_file_t* previous, mapped_file_t* mapping);
+
+/**
+ * Rebuild a parsed file from a serialized forest, without source or tree
+ * @param lang Language of the file
+ * @param body_mode extract_body_mode_t the forest was extracted with
+ * @param content_hash Hash of the contents the forest was extracted from
+ * @param data Serialized forest and errors, see skeleton_store_decode
+ * @param size Size of data
+ * @return New parsed file, or NULL if the data is malformed
+ */
+parsed_file_t* parsed_file_restore(extractor_language_t lang, int body_mode, uint64_t content_hash,
+                                   const char* data, size_t size);
+
+/**
+ * Compute the single edit turning one buffer into another from their common prefix and suffix
+ * @param old_source Previous contents
+ * @param old_size Size of previous contents
+ * @param new_source New contents
+ * @param new_size Size of new contents
+ * @param edit Output edit
+ * @return 1 if the buffers differ, 0 if they are identical
+ */
+int compute_source_edit(const char* old_source, size_t old_size,
+                        const char* new_source, size_t new_size, TSInputEdit* edit);
+
+/**
+ * Find the innermost entity whose lines contain a line
+ * @param file Parsed file
+ * @param line Line number
+ * @return Entity owned by the file, or NULL if no entity encloses the line
+ */
+signature_node_t* parsed_file_enclosing_entity(const parsed_file_t* file, int line);
+
+/**
+ * Free a parsed file and everything derived from it
+ * @param file File to free
+ */
+void parsed_file_free(parsed_file_t* file);
+
+/**
+ * Compute the content hash of a parsed file once. Parsing leaves it out, since only hash
+ * verification and the persistent index use it.
+ * @param file File with its source, not yet shared with other threads
+ */
+void parsed_file_hash(parsed_file_t* file);
+
+/**
+ * Compute the FNV-1a hash of a buffer
+ * @param data Buffer
+ * @param size Size of the buffer in bytes
+ * @return 64-bit hash
+ */
+uint64_t content_hash(const char* data, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PARSED_FILE_H
@@ -0,0 +1,422 @@
+#include "platform.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(_WIN32) && !defined(__CYGWIN__)
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <time.h>
+#include <sched.h>
+#include <sys/resource.h>
+#if defined(__APPLE__)
+#include <pthread/qos.h>
+#elif defined(__linux__)
+#include <sys/syscall.h>
+// Arguments of ioprio_set, which has no libc wrapper: the idle class for the calling thread
+#define PLATFORM_IOPRIO_WHO_PROCESS 1
+#define PLATFORM_IOPRIO_IDLE (3 << 13)
+#endif
+#else
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+// Function and argument handed to a new thread
+typedef struct {
+    platform_thread_fn fn;
+    void* arg;
+} thread_start_t;
+
+#if defined(_WIN32) || defined(__CYGWIN__)
+
+void platform_mutex_init(platform_mutex_t* mutex) {
+    InitializeSRWLock(mutex);
+}
+
+void platform_mutex_destroy(platform_mutex_t* mutex) {
+    // SRW locks need no cleanup
+    (void)mutex;
+}
+
+void platform_mutex_lock(platform_mutex_t* mutex) {
+    AcquireSRWLockExclusive(mutex);
+}
+
+void platform_mutex_unlock(platform_mutex_t* mutex) {
+    ReleaseSRWLockExclusive(mutex);
+}
+
+void platform_cond_init(platform_cond_t* cond) {
+    InitializeConditionVariable(cond);
+}
+
+void platform_cond_destroy(platform_cond_t* cond) {
+    // Condition variables need no cleanup
+    (void)cond;
+}
+
+void platform_cond_wait(platform_cond_t* cond, platform_mutex_t* mutex) {
+    SleepConditionVariableSRW(cond, mutex, INFINITE, 0);
+}
+
+void platform_cond_broadcast(platform_cond_t* cond) {
+    WakeAllConditionVariable(cond);
+}
+
+static DWORD WINAPI thread_main(LPVOID param) {
+    thread_start_t start = *(thread_start_t*)param;
+    free(param);
+    start.fn(start.arg);
+    return 0;
+}
+
+int platform_thread_create(platform_thread_t* thread, platform_thread_fn fn, void* arg) {
+    thread_start_t* start = (thread_start_t*)malloc(sizeof(thread_start_t));
+    if (!start) {
+        return -1;
+    }
+    start->fn = fn;
+    start->arg = arg;
+    *thread = CreateThread(NULL, 0, thread_main, start, 0, NULL);
+    if (!*thread) {
+        free(start);
+        return -1;
+    }
+    return 0;
+}
+
+void platform_thread_join(platform_thread_t thread) {
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+}
+
+void platform_thread_set_background(void) {
+    // Also lowers the I/O and memory priorities of the thread
+    SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+}
+
+int platform_tls_create(platform_tls_key_t* key, platform_tls_destructor_t destructor) {
+    // Fiber-local storage, unlike TlsAlloc, calls back when the thread exits
+    DWORD index = FlsAlloc(destructor);
+    if (index == FLS_OUT_OF_INDEXES) {
+        return -1;
+    }
+    *key = index;
+    return 0;
+}
+
+int platform_tls_set(platform_tls_key_t key, void* value) {
+    return FlsSetValue(key, value) ? 0 : -1;
+}
+
+int platform_cpu_count(void) {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+}
+
+int platform_file_stat(const char* path, int64_t* mtime_ns, uint64_t* size) {
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExA(path, GetFileExInfoStandard, &data)) {
+        return -1;
+    }
+    // FILETIME counts 100ns intervals
+    uint64_t ticks = ((uint64_t)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+    *mtime_ns = (int64_t)(ticks * 100);
+    *size = ((uint64_t)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+    return 0;
+}
+
+int platform_file_prefetch(const char* path) {
+    // There is no read-ahead hint for a whole file, reading it through once fills the file cache
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+                              OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return -1;
+    }
+    char buffer[65536];
+    DWORD read = 0;
+    while (ReadFile(file, buffer, sizeof(buffer), &read, NULL) && read > 0) {
+    }
+    CloseHandle(file);
+    return 0;
+}
+
+int platform_file_replace(const char* from, const char* to) {
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) ? 0 : -1;
+}
+
+FILE* platform_temp_file(const char* path, char** temp_path) {
+    static volatile LONG counter;
+    size_t length = strlen(path) + 32;
+    char* name = (char*)malloc(length);
+    if (!name) {
+        return NULL;
+    }
+    // CREATE_NEW fails on a name in use, so another one is tried
+    for (int attempt = 0; attempt < 100; attempt++) {
+        snprintf(name, length, "%s.%lu.%ld.tmp", path, (unsigned long)GetCurrentProcessId(),
+                 (long)InterlockedIncrement(&counter));
+        HANDLE file = CreateFileA(name, GENERIC_WRITE, 0, NULL, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE) {
+            if (GetLastError() == ERROR_FILE_EXISTS) {
+                continue;
+            }
+            break;
+        }
+        int fd = _open_osfhandle((intptr_t)file, _O_BINARY | _O_WRONLY);
+        FILE* out = fd >= 0 ? _fdopen(fd, "wb") : NULL;
+        if (!out) {
+            if (fd >= 0) {
+                _close(fd);
+            } else {
+                CloseHandle(file);
+            }
+            DeleteFileA(name);
+            break;
+        }
+        *temp_path = name;
+        return out;
+    }
+    free(name);
+    return NULL;
+}
+
+int platform_file_lock(const char* path, platform_file_lock_t* lock) {
+    HANDLE file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                              OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return -1;
+    }
+    OVERLAPPED overlapped = { 0 };
+    if (!LockFileEx(file, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &overlapped)) {
+        CloseHandle(file);
+        return -1;
+    }
+    *lock = file;
+    return 0;
+}
+
+void platform_file_unlock(platform_file_lock_t lock) {
+    OVERLAPPED overlapped = { 0 };
+    UnlockFileEx(lock, 0, 1, 0, &overlapped);
+    CloseHandle(lock);
+}
+
+void* platform_library_open(const char* path) {
+    return (void*)LoadLibraryA(path);
+}
+
+void* platform_library_symbol(void* library, const char* name) {
+    return (void*)GetProcAddress((HMODULE)library, name);
+}
+
+uint64_t platform_monotonic_ns(void) {
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)(counter.QuadPart / frequency.QuadPart) * 1000000000ULL +
+           (uint64_t)(counter.QuadPart % frequency.QuadPart) * 1000000000ULL / (uint64_t)frequency.QuadPart;
+}
+
+#else
+
+void platform_mutex_init(platform_mutex_t* mutex) {
+    pthread_mutex_init(mutex, NULL);
+}
+
+void platform_mutex_destroy(platform_mutex_t* mutex) {
+    pthread_mutex_destroy(mutex);
+}
+
+void platform_mutex_lock(platform_mutex_t* mutex) {
+    pthread_mutex_lock(mutex);
+}
+
+void platform_mutex_unlock(platform_mutex_t* mutex) {
+    pthread_mutex_unlock(mutex);
+}
+
+void platform_cond_init(platform_cond_t* cond) {
+    pthread_cond_init(cond, NULL);
+}
+
+void platform_cond_destroy(platform_cond_t* cond) {
+    pthread_cond_destroy(cond);
+}
+
+void platform_cond_wait(platform_cond_t* cond, platform_mutex_t* mutex) {
+    pthread_cond_wait(cond, mutex);
+}
+
+void platform_cond_broadcast(platform_cond_t* cond) {
+    pthread_cond_broadcast(cond);
+}
+
+static void* thread_main(void* param) {
+    thread_start_t start = *(thread_start_t*)param;
+    free(param);
+    start.fn(start.arg);
+    return NULL;
+}
+
+int platform_thread_create(platform_thread_t* thread, platform_thread_fn fn, void* arg) {
+    thread_start_t* start = (thread_start_t*)malloc(sizeof(thread_start_t));
+    if (!start) {
+        return -1;
+    }
+    start->fn = fn;
+    start->arg = arg;
+    if (pthread_create(thread, NULL, thread_main, start) != 0) {
+        free(start);
+        return -1;
+    }
+    return 0;
+}
+
+void platform_thread_join(platform_thread_t thread) {
+    pthread_join(thread, NULL);
+}
+
+void platform_thread_set_background(void) {
+#if defined(__APPLE__)
+    // The background class also throttles the disk reads of the thread
+    pthread_set_qos_class_self_np(QOS_CLASS_BACKGROUND, 0);
+#elif defined(__linux__)
+    // Linux keeps a nice value and an I/O priority per thread, ioprio_set taking 0 for the calling one
+    pid_t tid = (pid_t)syscall(SYS_gettid);
+    setpriority(PRIO_PROCESS, (id_t)tid, 19);
+#ifdef SYS_ioprio_set
+    syscall(SYS_ioprio_set, PLATFORM_IOPRIO_WHO_PROCESS, 0, PLATFORM_IOPRIO_IDLE);
+#endif
+#else
+    int policy;
+    struct sched_param param;
+    if (pthread_getschedparam(pthread_self(), &policy, &param) == 0) {
+        param.sched_priority = sched_get_priority_min(policy);
+        pthread_setschedparam(pthread_self(), policy, &param);
+    }
+#endif
+}
+
+int platform_tls_create(platform_tls_key_t* key, platform_tls_destructor_t destructor) {
+    return pthread_key_create(key, destructor) == 0 ? 0 : -1;
+}
+
+int platform_tls_set(platform_tls_key_t key, void* value) {
+    return pthread_setspecific(key, value) == 0 ? 0 : -1;
+}
+
+int platform_cpu_count(void) {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+}
+
+int platform_file_stat(const char* path, int64_t* mtime_ns, uint64_t* size) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        return -1;
+    }
+#if defined(__APPLE__)
+    *mtime_ns = (int64_t)st.st_mtimespec.tv_sec * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+    *mtime_ns = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+    *size = (uint64_t)st.st_size;
+    return 0;
+}
+
+int platform_file_prefetch(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    int result = -1;
+#if defined(__APPLE__)
+    struct stat st;
+    if (fstat(fd, &st) == 0) {
+        struct radvisory advice = { 0, st.st_size > INT_MAX ? INT_MAX : (int)st.st_size };
+        result = fcntl(fd, F_RDADVISE, &advice) == 0 ? 0 : -1;
+    }
+#elif defined(POSIX_FADV_WILLNEED)
+    // Starts the reads in the background and returns at once
+    result = posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED) == 0 ? 0 : -1;
+#endif
+    close(fd);
+    return result;
+}
+
+int platform_file_replace(const char* from, const char* to) {
+    return rename(from, to) == 0 ? 0 : -1;
+}
+
+FILE* platform_temp_file(const char* path, char** temp_path) {
+    size_t length = strlen(path);
+    char* name = (char*)malloc(length + 8);
+    if (!name) {
+        return NULL;
+    }
+    memcpy(name, path, length);
+    memcpy(name + length, ".XXXXXX", 8);
+    int fd = mkstemp(name);
+    FILE* out = fd >= 0 ? fdopen(fd, "wb") : NULL;
+    if (!out) {
+        if (fd >= 0) {
+            close(fd);
+            unlink(name);
+        }
+        free(name);
+        return NULL;
+    }
+    *temp_path = name;
+    return out;
+}
+
+int platform_file_lock(const char* path, platform_file_lock_t* lock) {
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        return -1;
+    }
+    int status;
+    do {
+        status = flock(fd, LOCK_EX);
+    } while (status != 0 && errno == EINTR);
+    if (status != 0) {
+        close(fd);
+        return -1;
+    }
+    *lock = fd;
+    return 0;
+}
+
+void platform_file_unlock(platform_file_lock_t lock) {
+    // Closing the descriptor releases the lock
+    close(lock);
+}
+
+void* platform_library_open(const char* path) {
+    // Grammar symbols are only ever looked up through the handle
+    return dlopen(path, RTLD_NOW | RTLD_LOCAL);
+}
+
+void* platform_library_symbol(void* library, const char* name) {
+    return dlsym(library, name);
+}
+
+uint64_t platform_monotonic_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+#endif
@@ -0,0 +1,197 @@
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#if defined(_WIN32) || defined(__CYGWIN__)
+  #ifndef WIN32_LEAN_AND_MEAN
+    #define WIN32_LEAN_AND_MEAN
+  #endif
+  #include <windows.h>
+#else
+  #include <pthread.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Thread-local storage qualifier
+#if defined(_MSC_VER)
+  #define THREAD_LOCAL __declspec(thread)
+#else
+  #define THREAD_LOCAL __thread
+#endif
+
+// Mutex that can be statically initialized with PLATFORM_MUTEX_INITIALIZER
+#if defined(_WIN32) || defined(__CYGWIN__)
+  typedef SRWLOCK platform_mutex_t;
+  #define PLATFORM_MUTEX_INITIALIZER SRWLOCK_INIT
+#else
+  typedef pthread_mutex_t platform_mutex_t;
+  #define PLATFORM_MUTEX_INITIALIZER PTHREAD_MUTEX_INITIALIZER
+#endif
+
+void platform_mutex_init(platform_mutex_t* mutex);
+void platform_mutex_destroy(platform_mutex_t* mutex);
+void platform_mutex_lock(platform_mutex_t* mutex);
+void platform_mutex_unlock(platform_mutex_t* mutex);
+
+// Condition variable used together with a platform_mutex_t, statically initialized with PLATFORM_COND_INITIALIZER
+#if defined(_WIN32) || defined(__CYGWIN__)
+  typedef CONDITION_VARIABLE platform_cond_t;
+  #define PLATFORM_COND_INITIALIZER CONDITION_VARIABLE_INIT
+#else
+  typedef pthread_cond_t platform_cond_t;
+  #define PLATFORM_COND_INITIALIZER PTHREAD_COND_INITIALIZER
+#endif
+
+void platform_cond_init(platform_cond_t* cond);
+void platform_cond_destroy(platform_cond_t* cond);
+void platform_cond_wait(platform_cond_t* cond, platform_mutex_t* mutex);
+void platform_cond_broadcast(platform_cond_t* cond);
+
+// Joinable thread running a platform_thread_fn
+#if defined(_WIN32) || defined(__CYGWIN__)
+  typedef HANDLE platform_thread_t;
+#else
+  typedef pthread_t platform_thread_t;
+#endif
+
+typedef void (*platform_thread_fn)(void* arg);
+
+/**
+ * Start a thread
+ * @param thread Output thread handle
+ * @param fn Function run by the thread
+ * @param arg Argument passed to fn
+ * @return 0 on success, -1 on failure
+ */
+int platform_thread_create(platform_thread_t* thread, platform_thread_fn fn, void* arg);
+
+/**
+ * Wait for a thread to finish and release its handle
+ * @param thread Thread handle
+ */
+void platform_thread_join(platform_thread_t thread);
+
+/**
+ * Lower the calling thread to background priority, for both its CPU time and its disk reads,
+ * so it only runs when nothing else wants the processor or the disk. It cannot be raised back.
+ */
+void platform_thread_set_background(void);
+
+// Thread-local slot whose value is passed to a destructor when its thread exits
+#if defined(_WIN32) || defined(__CYGWIN__)
+  typedef DWORD platform_tls_key_t;
+  #define PLATFORM_TLS_CALLBACK WINAPI
+#else
+  typedef pthread_key_t platform_tls_key_t;
+  #define PLATFORM_TLS_CALLBACK
+#endif
+
+typedef void (PLATFORM_TLS_CALLBACK *platform_tls_destructor_t)(void* value);
+
+/**
+ * Create a thread-local slot, NULL in every thread until set
+ * @param key Output slot
+ * @param destructor Called with the value of a thread when it exits, unless NULL
+ * @return 0 on success, -1 on failure
+ */
+int platform_tls_create(platform_tls_key_t* key, platform_tls_destructor_t destructor);
+
+/**
+ * Set the value of a thread-local slot for the calling thread
+ * @param key Slot created by platform_tls_create
+ * @param value New value
+ * @return 0 on success, -1 on failure
+ */
+int platform_tls_set(platform_tls_key_t key, void* value);
+
+/**
+ * Get the number of online processors
+ * @return Processor count, at least 1
+ */
+int platform_cpu_count(void);
+
+/**
+ * Get the identity of a file
+ * @param path Path of the file
+ * @param mtime_ns Output modification time in nanoseconds
+ * @param size Output size in bytes
+ * @return 0 on success, -1 if the file cannot be stated
+ */
+int platform_file_stat(const char* path, int64_t* mtime_ns, uint64_t* size);
+
+/**
+ * Ask the system to read a file into its file cache ahead of use, without copying it here
+ * @param path Path of the file
+ * @return 0 on success, -1 if the file cannot be opened or read ahead
+ */
+int platform_file_prefetch(const char* path);
+
+/**
+ * Atomically replace a file with another one
+ * @param from Path of the new file
+ * @param to Path of the file to replace
+ * @return 0 on success, -1 on failure
+ */
+int platform_file_replace(const char* from, const char* to);
+
+/**
+ * Create a new file next to another one, under a name no other process or thread is using
+ * @param path Path the name is derived from
+ * @param temp_path Output path of the new file, to be freed by the caller
+ * @return File open for binary writing, or NULL on failure
+ */
+FILE* platform_temp_file(const char* path, char** temp_path);
+
+// Exclusive lock on a file, held across processes
+#if defined(_WIN32) || defined(__CYGWIN__)
+  typedef HANDLE platform_file_lock_t;
+#else
+  typedef int platform_file_lock_t;
+#endif
+
+/**
+ * Take an exclusive lock on a lock file, waiting while another process holds it
+ * @param path Path of the lock file, created if missing
+ * @param lock Output lock, released with platform_file_unlock
+ * @return 0 on success, -1 on failure
+ */
+int platform_file_lock(const char* path, platform_file_lock_t* lock);
+
+/**
+ * Release a lock taken by platform_file_lock
+ * @param lock Lock to release
+ */
+void platform_file_unlock(platform_file_lock_t lock);
+
+/**
+ * Load a shared library, which stays loaded for the lifetime of the process
+ * @param path Path of the library
+ * @return Library handle, or NULL on failure
+ */
+void* platform_library_open(const char* path);
+
+/**
+ * Look a function up in a shared library
+ * @param library Handle returned by platform_library_open
+ * @param name Name of the function
+ * @return Address of the function, or NULL if the library does not export it
+ */
+void* platform_library_symbol(void* library, const char* name);
+
+/**
+ * Read a monotonic clock
+ * @return Nanoseconds since an arbitrary fixed point
+ */
+uint64_t platform_monotonic_ns(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PLATFORM_H
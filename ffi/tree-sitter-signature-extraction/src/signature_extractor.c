@@ -1,11 +1,24 @@
 #include "signature_extractor.h"
+#include "extractor_context.h"
+#include "parsed_file.h"
+#include "skeleton_service.h"
 #include "utils.h"
 
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-int MAX_XML_SIZE = 3 * 1024 * 1024;
+static int node_in_range(const signature_node_t* node, int start_line, int end_line);
+static signature_node_t* clone_single_node(arena_t* arena, signature_node_t* node);
+static void write_piece(const char* text, size_t length, void* arg);
+static void print_span(xml_writer_t* writer, const entity_index_t* index, int32_t span_id, int indent_level,
+                       int start_line, int end_line, const uint8_t* selected);
+static void write_skeleton(xml_writer_t* writer, const char *filename, signature_node_t* root,
+                           const entity_index_t* index, parse_error_t* errors, int error_count,
+                           int start_line, int end_line, const uint8_t* selected, int truncated);
+static void error_run(const parse_error_t* errors, int error_count, int start_line, int end_line,
+                      int* first_error, int* last_error);
 
 // Helper function to get error context directly from source code
 void get_error_context(const char* source_code, int error_line_number, 
@@ -17,240 +30,211 @@ void get_error_context(const char* source_code, int error_line_number,
 // Extended helper function to get error context with configurable context lines
 void get_error_context_ext(const char* source_code, int error_line_number, int context_lines,
                           char** error_line, char** above_lines, char** below_lines) {
-    if (!source_code || error_line_number < 1) {
-        *error_line = NULL;
-        *above_lines = NULL;
-        *below_lines = NULL;
-        return;
+    get_error_context_in(NULL, source_code, source_code ? strlen(source_code) : 0, error_line_number, context_lines,
+                         error_line, above_lines, below_lines);
+}
+
+// Offsets of the first byte of every line of a source, built once per file
+typedef struct {
+    uint32_t* starts;
+    uint32_t count;
+} line_index_t;
+
+static int line_index_build(line_index_t* index, const char* source_code, size_t source_size) {
+    uint32_t capacity = 256;
+    index->starts = (uint32_t*)malloc(sizeof(uint32_t) * capacity);
+    index->count = 0;
+    if (!index->starts) {
+        return -1;
     }
-    
-    // Count total lines in the source
-    int total_lines = 1;
+    index->starts[index->count++] = 0;
+
     const char* ptr = source_code;
-    while (*ptr) {
-        if (*ptr == '\n') {
-            total_lines++;
-        }
+    const char* source_end = source_code + source_size;
+    while (ptr < source_end && (ptr = (const char*)memchr(ptr, '\n', (size_t)(source_end - ptr))) != NULL) {
         ptr++;
+        if (index->count == capacity) {
+            capacity *= 2;
+            uint32_t* starts = (uint32_t*)realloc(index->starts, sizeof(uint32_t) * capacity);
+            if (!starts) {
+                free(index->starts);
+                index->starts = NULL;
+                return -1;
+            }
+            index->starts = starts;
+        }
+        index->starts[index->count++] = (uint32_t)(ptr - source_code);
     }
-    
-    // Check if the requested line exists
-    if (error_line_number > total_lines) {
-        *error_line = NULL;
-        *above_lines = NULL;
-        *below_lines = NULL;
-        return;
-    }
-    
-    // Allocate array to store line start positions
-    const char** line_starts = malloc(sizeof(char*) * (total_lines + 1));
-    if (!line_starts) {
-        *error_line = NULL;
-        *above_lines = NULL;
-        *below_lines = NULL;
+    return 0;
+}
+
+// Offset just past the text of a 0-based line, before its newline
+static size_t line_index_end(const line_index_t* index, uint32_t line, size_t source_size) {
+    return line + 1 < index->count ? index->starts[line + 1] - 1 : source_size;
+}
+
+// Copy the error line and its context out of a source through its line index
+static void error_context_from_index(arena_t* arena, const char* source_code, size_t source_size,
+                                     const line_index_t* index, int error_line_number, int context_lines,
+                                     char** error_line, char** above_lines, char** below_lines) {
+    *error_line = NULL;
+    *above_lines = NULL;
+    *below_lines = NULL;
+    int total_lines = (int)index->count;
+    if (error_line_number < 1 || error_line_number > total_lines) {
         return;
     }
-    
-    // Fill the line start positions
-    line_starts[0] = source_code;
-    int current_line = 1;
-    ptr = source_code;
-    while (*ptr) {
-        if (*ptr == '\n') {
-            current_line++;
-            line_starts[current_line-1] = ptr + 1;
-        }
-        ptr++;
-    }
-    
-    // For a more accurate error line, we'll look at the reported line and nearby lines
-    // to try to identify the actual problematic line
-    int actual_error_line = error_line_number;
-    
+
     // Get the actual error line (the reported line)
-    const char* error_line_start = line_starts[error_line_number - 1];
-    const char* error_line_end = error_line_start;
-    
-    // Find end of error line
-    while (*error_line_end && *error_line_end != '\n') {
-        error_line_end++;
-    }
-    
-    size_t error_line_len = error_line_end - error_line_start;
-    *error_line = malloc(error_line_len + 1);
-    if (*error_line) {
-        strncpy(*error_line, error_line_start, error_line_len);
-        (*error_line)[error_line_len] = '\0';
-    }
-    
-    // Get context lines above the error line
+    uint32_t line = (uint32_t)(error_line_number - 1);
+    size_t error_line_start = index->starts[line];
+    size_t error_line_end = line_index_end(index, line, source_size);
+    *error_line = arena_strndup(arena, source_code + error_line_start, error_line_end - error_line_start);
+
+    // Context lines above the error line, without the newline that ends them
     if (error_line_number > 1) {
-        // Determine start line for above context (at most context_lines or to start of file)
-        int above_start_line = (error_line_number - 1 - context_lines) > 0 ? 
-                              (error_line_number - 1 - context_lines) : 0;
-        
-        const char* above_start = line_starts[above_start_line];
-        const char* above_end = error_line_start;
-        
-        // Make sure we don't include the newline before the error line
-        if (above_end > above_start && *(above_end - 1) == '\n') {
-            above_end--;
-        }
-        
-        size_t above_len = above_end - above_start;
-        *above_lines = malloc(above_len + 1);
-        if (*above_lines) {
-            strncpy(*above_lines, above_start, above_len);
-            (*above_lines)[above_len] = '\0';
-        }
-    } else {
-        *above_lines = NULL;
+        int above_start_line = (error_line_number - 1 - context_lines) > 0 ?
+                               (error_line_number - 1 - context_lines) : 0;
+        size_t above_start = index->starts[above_start_line];
+        size_t above_end = error_line_start - 1 > above_start ? error_line_start - 1 : above_start;
+        *above_lines = arena_strndup(arena, source_code + above_start, above_end - above_start);
     }
-    
-    // Get context lines below the error line
+
+    // Context lines below the error line, including the newline of the last one
     if (error_line_number < total_lines) {
-        // Determine end line for below context (at most context_lines or to end of file)
-        int below_end_line = (error_line_number + context_lines) < total_lines ? 
-                            (error_line_number + context_lines) : (total_lines - 1);
-        
-        const char* below_start = error_line_end;
-        // Skip the newline character
-        if (*below_start == '\n') {
-            below_start++;
-        }
-        const char* below_end = line_starts[below_end_line] ;
-        
-        // Find the end of the below_end_line
-        while (*below_end && *below_end != '\n') {
+        int below_end_line = (error_line_number + context_lines) < total_lines ?
+                             (error_line_number + context_lines) : (total_lines - 1);
+        size_t below_start = error_line_end + 1;
+        size_t below_end = line_index_end(index, (uint32_t)below_end_line, source_size);
+        if (below_end < source_size) {
             below_end++;
         }
-        if (*below_end == '\n') {
-            below_end++; // Include the last newline
-        }
-        
-        size_t below_len = below_end - below_start;
-        *below_lines = malloc(below_len + 1);
-        if (*below_lines) {
-            strncpy(*below_lines, below_start, below_len);
-            (*below_lines)[below_len] = '\0';
-        }
-    } else {
-        *below_lines = NULL;
+        *below_lines = arena_strndup(arena, source_code + below_start, below_end - below_start);
     }
-    
-    free(line_starts);
+}
+
+// Get error context with the copies allocated from an arena (or the heap if NULL).
+// The source is bounded by its size, it does not need to be NUL-terminated.
+void get_error_context_in(arena_t* arena, const char* source_code, size_t source_size,
+                          int error_line_number, int context_lines,
+                          char** error_line, char** above_lines, char** below_lines) {
+    *error_line = NULL;
+    *above_lines = NULL;
+    *below_lines = NULL;
+    line_index_t index;
+    if (!source_code || error_line_number < 1 || line_index_build(&index, source_code, source_size) != 0) {
+        return;
+    }
+    error_context_from_index(arena, source_code, source_size, &index, error_line_number, context_lines,
+                             error_line, above_lines, below_lines);
+    free(index.starts);
 }
 
 // Extract parse errors from the tree
 parse_error_t* extract_parse_errors(TSTree* tree, const char* source_code, int* error_count) {
+    return extract_parse_errors_in(tree, source_code, source_code ? strlen(source_code) : 0, error_count, NULL);
+}
+
+// Errors collected by one walk of a tree
+typedef struct {
+    parse_error_t* errors;
+    int count;
+    int capacity;
+    int last_line;                   // Line of the last error kept, errors are found in source order
+    const char* source_code;
+    size_t source_size;
+    line_index_t index;
+    arena_t* arena;
+} error_collector_t;
+
+static void collect_error(error_collector_t* collector, TSNode node, const char* message) {
+    int line = (int)ts_node_start_point(node).row + 1; // 1-indexed
+    if (line <= collector->last_line) {
+        return; // One error per line
+    }
+    if (collector->count >= collector->capacity) {
+        int capacity = collector->capacity ? collector->capacity * 2 : 16;
+        parse_error_t* errors = (parse_error_t*)realloc(collector->errors, sizeof(parse_error_t) * capacity);
+        if (!errors) {
+            return;
+        }
+        collector->errors = errors;
+        collector->capacity = capacity;
+    }
+
+    parse_error_t* error = &collector->errors[collector->count++];
+    error->line = line;
+    error->message = arena_strdup(collector->arena, message);
+    
+    // Get error context directly from source code with 2 lines of context
+    error_context_from_index(collector->arena, collector->source_code, collector->source_size, &collector->index,
+                             line, 2, &error->error_line, &error->code_above_error_line,
+                             &error->code_below_error_line);
+    collector->last_line = line;
+}
+
+// Extract parse errors with their strings allocated from an arena (or the heap if NULL).
+// The walk only enters subtrees that contain an error, and visits them in source order.
+parse_error_t* extract_parse_errors_in(TSTree* tree, const char* source_code, size_t source_size,
+                                       int* error_count, arena_t* arena) {
     *error_count = 0;
-    
-    // Get the root node
     TSNode root_node = ts_tree_root_node(tree);
-    
-    // Count total nodes to pre-allocate errors array
-    // We'll do a simple traversal to find ERROR nodes
-    parse_error_t* errors = NULL;
-    int capacity = 0;
-    
-    // Create a queue for breadth-first traversal
-    TSNode queue[1024];
-    int front = 0, rear = 0;
-    
-    // Enqueue root node
-    queue[rear++] = root_node;
-    
-    // Traverse the tree using breadth-first search
-    while (front < rear && *error_count < 1024) {
-        // Dequeue node
-        TSNode node = queue[front++];
-        
-        // Check if this is an ERROR node
-        if (!ts_node_is_null(node)) {
-            const char* node_type = ts_node_type(node);
-            if (strcmp(node_type, "ERROR") == 0) {
-                // Found an error node, add it to our list
-                if (*error_count >= capacity) {
-                    capacity = (capacity == 0) ? 10 : capacity * 2;
-                    parse_error_t* temp = realloc(errors, sizeof(parse_error_t) * capacity);
-                    if (!temp) {
-                        // Clean up and return what we have
-                        break;
-                    }
-                    errors = temp;
-                }
-                
-                TSPoint start_point = ts_node_start_point(node);
-                errors[*error_count].line = start_point.row + 1; // 1-indexed
-                errors[*error_count].message = strdup("Syntax error detected");
-                
-                // Get error context directly from source code with 2 lines of context
-                get_error_context_ext(source_code, start_point.row + 1, 2,
-                                &errors[*error_count].error_line,
-                                &errors[*error_count].code_above_error_line,
-                                &errors[*error_count].code_below_error_line);
-                
-                (*error_count)++;
+    if (!source_code || !ts_node_has_error(root_node)) {
+        return NULL;
+    }
+
+    error_collector_t collector = {
+        .source_code = source_code,
+        .source_size = source_size,
+        .arena = arena,
+    };
+    if (line_index_build(&collector.index, source_code, source_size) != 0) {
+        return NULL;
+    }
+
+    TSTreeCursor cursor = ts_tree_cursor_new(root_node);
+    for (;;) {
+        TSNode node = ts_tree_cursor_current_node(&cursor);
+        if (ts_node_has_error(node)) {
+            if (ts_node_is_error(node)) {
+                collect_error(&collector, node, "Syntax error detected");
             }
-            
-            // Check for missing nodes (indicated by ts_node_is_missing)
             if (ts_node_is_missing(node)) {
-                if (*error_count >= capacity) {
-                    capacity = (capacity == 0) ? 10 : capacity * 2;
-                    parse_error_t* temp = realloc(errors, sizeof(parse_error_t) * capacity);
-                    if (!temp) {
-                        // Clean up and return what we have
-                        break;
-                    }
-                    errors = temp;
-                }
-                
-                TSPoint start_point = ts_node_start_point(node);
-                errors[*error_count].line = start_point.row + 1; // 1-indexed
-                errors[*error_count].message = strdup("Missing token or construct");
-                
-                // Get error context directly from source code with 2 lines of context
-                get_error_context_ext(source_code, start_point.row + 1, 2,
-                                &errors[*error_count].error_line,
-                                &errors[*error_count].code_above_error_line,
-                                &errors[*error_count].code_below_error_line);
-                
-                (*error_count)++;
+                collect_error(&collector, node, "Missing token or construct");
+            }
+            if (ts_tree_cursor_goto_first_child(&cursor)) {
+                continue;
             }
         }
-        
-        // Add children to queue for further processing
-        uint32_t child_count = ts_node_child_count(node);
-        for (uint32_t i = 0; i < child_count && rear < 1024; i++) {
-            TSNode child = ts_node_child(node, i);
-            if (!ts_node_is_null(child)) {
-                queue[rear++] = child;
+
+        // Move on to the next subtree, climbing back up as far as needed
+        int done = 0;
+        while (!ts_tree_cursor_goto_next_sibling(&cursor)) {
+            if (!ts_tree_cursor_goto_parent(&cursor)) {
+                done = 1;
+                break;
             }
         }
+        if (done) {
+            break;
+        }
     }
-    
-    // Remove duplicate errors (same line number)
-    if (errors && *error_count > 1) {
-        for (int i = 0; i < *error_count; i++) {
-            for (int j = i + 1; j < *error_count; j++) {
-                if (errors[i].line == errors[j].line) {
-                    // Found duplicate, remove the later one
-                    // Free the strings in the duplicate entry
-                    if (errors[j].message) free(errors[j].message);
-                    if (errors[j].error_line) free(errors[j].error_line);
-                    if (errors[j].code_above_error_line) free(errors[j].code_above_error_line);
-                    if (errors[j].code_below_error_line) free(errors[j].code_below_error_line);
-                    
-                    // Shift all entries after j one position to the left
-                    for (int k = j; k < *error_count - 1; k++) {
-                        errors[k] = errors[k + 1];
-                    }
-                    
-                    // Decrement the count and adjust indices
-                    (*error_count)--;
-                    j--; // Check the same index again as elements have shifted
-                }
-            }
+    ts_tree_cursor_delete(&cursor);
+    free(collector.index.starts);
+
+    parse_error_t* errors = collector.errors;
+    *error_count = collector.count;
+    
+    // Move the array into the arena so it is released with the strings
+    if (arena && errors) {
+        parse_error_t* moved = (parse_error_t*)arena_alloc(arena, sizeof(parse_error_t) * *error_count);
+        if (moved) {
+            memcpy(moved, errors, sizeof(parse_error_t) * *error_count);
+        }
+        free(errors);
+        errors = moved;
+        if (!errors) {
+            *error_count = 0;
         }
     }
     
@@ -271,35 +255,156 @@ void free_parse_errors(parse_error_t* errors, int error_count) {
     free(errors);
 }
 
-// Recursive function to traverse the AST and extract signatures
-signature_node_t* traverse_and_extract(TSNode node, const char* source_code, const char* language, signature_node_t* parent) {
-    if (ts_node_is_null(node)) {
-        return NULL;
+// Traversal mode of function bodies for later extractions
+static volatile int signature_body_mode = EXTRACT_BODIES_DECLARATIONS;
+
+void set_signature_body_mode(int mode) {
+    if (mode >= EXTRACT_BODIES_SKIP && mode <= EXTRACT_BODIES_ALL) {
+        signature_body_mode = mode;
+    }
+}
+
+extract_body_mode_t get_signature_body_mode(void) {
+    return (extract_body_mode_t)signature_body_mode;
+}
+
+void extract_state_init(extract_state_t* state, const char* source_code, arena_t* arena) {
+    state->source_code = source_code;
+    state->arena = arena;
+    signature_builder_init(&state->scratch, source_code);
+    state->table = NULL;
+    state->body_mode = get_signature_body_mode();
+}
+
+void extract_state_set_language(extract_state_t* state, const char* language) {
+    state->table = language_table_get(extractor_language_from_name(language));
+}
+
+void extract_state_finish(extract_state_t* state) {
+    signature_builder_free(&state->scratch);
+}
+
+// Create the node of an entity from the signature parts in the scratch builder
+signature_node_t* create_entity_node(extract_state_t* state, entity_type_t type, TSNode node, TSNode name_node) {
+    uint32_t start_byte = ts_node_start_byte(node);
+    uint32_t end_byte = ts_node_end_byte(node);
+    source_slice_t name = { ts_node_start_byte(name_node), ts_node_end_byte(name_node) - ts_node_start_byte(name_node) };
+    
+    // Fall back to the whole declaration if no signature could be assembled
+    signature_builder_t* parts = &state->scratch;
+    if (parts->length == 0) {
+        signature_builder_reset(parts);
+        if (end_byte > start_byte) {
+            signature_builder_slice(parts, start_byte, end_byte - start_byte);
+        }
     }
     
-    const char* node_type = ts_node_type(node);
-    signature_node_t* sig_node = NULL;
+    TSPoint start_point = ts_node_start_point(node);
+    TSPoint end_point = ts_node_end_point(node);
     
-    // Java specific processing
-    if (strcmp(language, "java") == 0) {
-        if (strcmp(node_type, "class_declaration") == 0) {
-            sig_node = process_java_class(node, source_code);
-        } else if (strcmp(node_type, "method_declaration") == 0) {
-            sig_node = process_java_method(node, source_code);
-        } else if (strcmp(node_type, "interface_declaration") == 0) {
-            sig_node = process_java_interface(node, source_code);
-        } else if (strcmp(node_type, "enum_declaration") == 0) {
-            sig_node = process_java_enum(node, source_code);
+    signature_node_t* sig_node;
+    if (state->arena) {
+        sig_node = create_signature_node_sliced(
+            state->arena, type, state->source_code, name, parts,
+            start_point.row + 1, start_point.column + 1,
+            end_point.row + 1, end_point.column + 1
+        );
+    } else {
+        sig_node = create_signature_node_in(
+            NULL, type,
+            name.length ? state->source_code + name.offset : NULL, name.length,
+            NULL, 0,
+            start_point.row + 1, start_point.column + 1,
+            end_point.row + 1, end_point.column + 1
+        );
+        if (sig_node && parts->count > 0) {
+            sig_node->signature = signature_builder_to_string(parts, NULL);
         }
     }
-    // Python specific processing
-    else if (strcmp(language, "python") == 0) {
-        if (strcmp(node_type, "class_definition") == 0) {
-            sig_node = process_python_class(node, source_code);
-        } else if (strcmp(node_type, "function_definition") == 0) {
-            sig_node = process_python_function(node, source_code);
+    if (sig_node) {
+        sig_node->start_byte = start_byte;
+        sig_node->end_byte = end_byte;
+        STATS_ADD(STATS_ENTITIES, 1);
+    }
+    return sig_node;
+}
+
+// Build the signature of a single node if it declares an entity we are interested in
+signature_node_t* extract_node_signature(extract_state_t* state, TSNode node) {
+    if (!state->table) {
+        return NULL;
+    }
+    entity_extract_fn extract = state->table->extract[language_table_kind(state->table, node)];
+    return extract ? extract(state, node) : NULL;
+}
+
+static int is_identifier_char(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '$';
+}
+
+// Whether a range of source holds one of the keywords as a whole word. A match in a string
+// or a comment only costs a visit of the subtree, a miss proves it declares nothing.
+static int contains_keyword(const char* text, size_t length, const char* const* keywords) {
+    size_t i = 0;
+    while (i < length) {
+        if (!is_identifier_char(text[i])) {
+            i++;
+            continue;
+        }
+        size_t start = i;
+        while (i < length && is_identifier_char(text[i])) {
+            i++;
         }
+        for (const char* const* keyword = keywords; *keyword; keyword++) {
+            if ((*keyword)[0] == text[start] && strlen(*keyword) == i - start &&
+                memcmp(*keyword, text + start, i - start) == 0) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+int extract_should_visit(extract_state_t* state, TSTreeCursor* cursor, int in_function) {
+    if (state->body_mode == EXTRACT_BODIES_ALL || !state->table) {
+        return 1;
     }
+
+    // Bodies of functions, and code run outside of any function
+    TSNode node = ts_tree_cursor_current_node(cursor);
+    if (in_function) {
+        if (ts_tree_cursor_current_field_id(cursor) != state->table->body_field) {
+            return 1;
+        }
+    } else {
+        node_kind_t kind = language_table_kind(state->table, node);
+        if (kind == NODE_KIND_EXPRESSION) {
+            return 0; // Python expressions cannot hold a def or a class
+        }
+        if (kind != NODE_KIND_MEMBER_CODE) {
+            return 1;
+        }
+    }
+
+    if (state->body_mode == EXTRACT_BODIES_SKIP) {
+        return 0;
+    }
+    if (!state->table->declaration_keywords) {
+        return 1;
+    }
+    uint32_t start_byte = ts_node_start_byte(node);
+    uint32_t end_byte = ts_node_end_byte(node);
+    return contains_keyword(state->source_code + start_byte, end_byte - start_byte,
+                            state->table->declaration_keywords);
+}
+
+// Extract the subtree at the cursor, leaving the cursor where it was
+static signature_node_t* traverse_cursor(extract_state_t* state, TSTreeCursor* cursor, signature_node_t* parent) {
+    TSNode node = ts_tree_cursor_current_node(cursor);
+    STATS_ADD(STATS_NODES_VISITED, 1);
+    node_kind_t kind = language_table_kind(state->table, node);
+    entity_extract_fn extract = state->table->extract[kind];
+    signature_node_t* sig_node = extract ? extract(state, node) : NULL;
     
     // If we created a signature node, set its parent
     if (sig_node && parent) {
@@ -309,29 +414,66 @@ signature_node_t* traverse_and_extract(TSNode node, const char* source_code, con
     // For the root node or when we don't have a signature node, continue with the same parent
     signature_node_t* current_parent = sig_node ? sig_node : parent;
     
-    // Recursively process children
-    uint32_t child_count = ts_node_child_count(node);
-    for (uint32_t i = 0; i < child_count; i++) {
-        TSNode child = ts_node_child(node, i);
-        traverse_and_extract(child, source_code, language, current_parent);
+    // Visit the children that may hold declarations
+    if (ts_tree_cursor_goto_first_child(cursor)) {
+        int in_function = node_kind_is_function(kind);
+        do {
+            if (extract_should_visit(state, cursor, in_function)) {
+                traverse_cursor(state, cursor, current_parent);
+            }
+        } while (ts_tree_cursor_goto_next_sibling(cursor));
+        ts_tree_cursor_goto_parent(cursor);
     }
     
     return sig_node;
 }
 
-signature_node_t* extract_signatures(TSTree* tree, const char* source_code, const char* language) {
-    if (!tree || !source_code || !language) {
+// Traverse the AST with a cursor and extract signatures, skipping subtrees that declare nothing
+signature_node_t* traverse_and_extract(extract_state_t* state, TSNode node, const char* language, signature_node_t* parent) {
+    if (ts_node_is_null(node)) {
         return NULL;
     }
+    // The language is resolved once, the walk only compares symbol ids
+    if (!state->table) {
+        extract_state_set_language(state, language);
+        if (!state->table) {
+            return NULL;
+        }
+    }
     
-    TSNode root_node = ts_tree_root_node(tree);
+    TSTreeCursor cursor = ts_tree_cursor_new(node);
+    signature_node_t* sig_node = traverse_cursor(state, &cursor, parent);
+    ts_tree_cursor_delete(&cursor);
+    return sig_node;
+}
+
+signature_node_t* extract_signatures(TSTree* tree, const char* source_code, const char* language) {
+    if (!tree) {
+        return NULL;
+    }
+    return extract_signatures_in_node(ts_tree_root_node(tree), source_code, language, NULL);
+}
+
+signature_node_t* extract_signatures_in_node(TSNode node, const char* source_code, const char* language, arena_t* arena) {
+    if (ts_node_is_null(node) || !source_code || !language) {
+        return NULL;
+    }
     
     // Create a dummy root node to hold all top-level signatures
-    signature_node_t* root_container = create_signature_node(
-        ENTITY_UNKNOWN, "root", "root", 0, 0, 0, 0
+    signature_node_t* root_container = create_signature_node_in(
+        arena, ENTITY_UNKNOWN, "root", 4, "root", 4, 0, 0, 0, 0
     );
+    if (!root_container) {
+        return NULL;
+    }
     
-    traverse_and_extract(root_node, source_code, language, root_container);
+    extract_state_t state;
+    extract_state_init(&state, source_code, arena);
+    extract_state_set_language(&state, language);
+    if (!get_signature_query_mode() || query_and_extract(&state, node, -1, -1, root_container) != 0) {
+        traverse_and_extract(&state, node, language, root_container);
+    }
+    extract_state_finish(&state);
     
     // Return the children of the dummy root (the actual top-level signatures)
     signature_node_t* result = root_container->children;
@@ -345,389 +487,319 @@ signature_node_t* extract_signatures(TSTree* tree, const char* source_code, cons
         }
     }
     
-    // Free the dummy root but not its children
+    // Free the dummy root but not its children, arena nodes go with the arena
     root_container->children = NULL;
-    free_signature_node(root_container);
+    root_container->last_child = NULL;
+    if (!arena) {
+        free_signature_node(root_container);
+    }
     
     return result;
 }
 
 signature_node_t* extract_signatures_from_file(const char *filepath, const char *language) {
-    size_t source_size;
-    char *source_code = read_file(filepath, &source_size);
-    if (!source_code) {
-        return NULL;
-    }
+    return ctx_extract_signatures_from_file(extractor_ctx_default(), filepath, language);
+}
 
-    // Create a parser
-    TSParser *parser = ts_parser_new();
-    
-    // Set the language
-    TSLanguage *lang = NULL;
-    if (strcmp(language, "java") == 0) {
-        lang = tree_sitter_java();
-    } else if (strcmp(language, "python") == 0) {
-        lang = tree_sitter_python();
-    } else {
-        fprintf(stderr, "Unsupported language: %s\n", language);
-        free(source_code);
-        ts_parser_delete(parser);
-        return NULL;
-    }
-    
-    ts_parser_set_language(parser, lang);
-    
-    // Parse the source code
-    TSTree *tree = ts_parser_parse_string(parser, NULL, source_code, source_size);
-    
-    // Extract signatures
-    signature_node_t* signatures = extract_signatures(tree, source_code, language);
-    
-    // Clean up
-    ts_tree_delete(tree);
-    ts_parser_delete(parser);
-    free(source_code);
-    
-    return signatures;
+signature_node_t* extract_signatures_from_file_range(const char *filepath, const char *language,
+                                                     int start_line, int end_line) {
+    return ctx_extract_signatures_from_file_range(extractor_ctx_default(), filepath, language, start_line, end_line);
 }
 
-// Helper function to escape XML special characters for attributes
+// Helper function to escape XML special characters for attributes, which escape the same set as text
 char* escape_xml_attr(const char* input) {
-    if (!input) return NULL;
-    
-    // Calculate the length needed for the escaped string
-    size_t len = strlen(input);
-    size_t escaped_len = len;
-    
-    for (size_t i = 0; i < len; i++) {
-        switch (input[i]) {
-            case '&':  escaped_len += 5; break;  // &amp;
-            case '<':  escaped_len += 4; break;  // &lt;
-            case '>':  escaped_len += 4; break;  // &gt;
-            case '"':  escaped_len += 6; break;  // &quot;
-            case '\'': escaped_len += 6; break;
-            case '\n': escaped_len += 5; break;  // &#10;
-            case '\r': escaped_len += 5; break;  // &#13;
-            case '\t': escaped_len += 5; break;  // &#9;
-            default:   break;
-        }
-    }
-    
-    // Allocate memory for the escaped string
-    char* escaped = (char*)malloc(escaped_len + 1);
-    if (!escaped) return NULL;
-    
-    // Perform the escaping
-    size_t j = 0;
-    for (size_t i = 0; i < len; i++) {
-        switch (input[i]) {
-            case '&':
-                strcpy(escaped + j, "&amp;");
-                j += 5;
-                break;
-            case '<':
-                strcpy(escaped + j, "&lt;");
-                j += 4;
-                break;
-            case '>':
-                strcpy(escaped + j, "&gt;");
-                j += 4;
-                break;
-            case '"':
-                strcpy(escaped + j, "&quot;");
-                j += 6;
-                break;
-            case '\'':
-                strcpy(escaped + j, "&apos;");
-                j += 6;
-                break;
-            case '\n':
-                strcpy(escaped + j, "&#10;");
-                j += 5;
-                break;
-            case '\r':
-                strcpy(escaped + j, "&#13;");
-                j += 5;
-                break;
-            case '\t':
-                strcpy(escaped + j, "&#9;");
-                j += 5;
-                break;
-            default:
-                escaped[j++] = input[i];
-                break;
-        }
+    return escape_xml(input);
+}
+
+// The free functions ask the skeleton service when one is running, and the default context otherwise
+static char* default_skeleton_xml(const char *filename, const char *language, int start_line, int end_line,
+                                  size_t max_bytes) {
+    char* result;
+    if (skeleton_service_skeleton(SERVICE_SKELETON_XML, filename, language, start_line, end_line, max_bytes,
+                                  &result, NULL) == 0) {
+        return result;
     }
-    
-    escaped[j] = '\0';
-    return escaped;
+    return ctx_get_skeleton_xml_budget(extractor_ctx_default(), filename, language, start_line, end_line, max_bytes);
 }
 
 char* get_skeleton_xml_range(const char *filename, const char *language, int start_line, int end_line) {
-    return get_skeleton_xml_with_errors(filename, language, start_line, end_line);
+    return default_skeleton_xml(filename, language, start_line, end_line, 0);
 }
 
 char* get_skeleton_xml(const char *filename, const char *language) {
-    return get_skeleton_xml_with_errors(filename, language, -1, -1);
+    return default_skeleton_xml(filename, language, -1, -1, 0);
 }
 
 char* get_skeleton_xml_with_errors(const char *filename, const char *language, int start_line, int end_line) {
-    // Extract signatures from the file
-    size_t source_size;
-    char *source_code = read_file(filename, &source_size);
-    if (!source_code) {
+    return default_skeleton_xml(filename, language, start_line, end_line, 0);
+}
+
+char* ctx_get_skeleton_xml_range(extractor_ctx_t* ctx, const char *filename, const char *language, int start_line, int end_line) {
+    return ctx_get_skeleton_xml_with_errors(ctx, filename, language, start_line, end_line);
+}
+
+char* get_skeleton_xml_budget(const char *filename, const char *language, int start_line, int end_line,
+                              size_t max_bytes) {
+    return default_skeleton_xml(filename, language, start_line, end_line, max_bytes);
+}
+
+char* ctx_get_skeleton_xml_with_errors(extractor_ctx_t* ctx, const char *filename, const char *language, int start_line, int end_line) {
+    return ctx_get_skeleton_xml_budget(ctx, filename, language, start_line, end_line, 0);
+}
+
+char* ctx_get_skeleton_xml_budget(extractor_ctx_t* ctx, const char *filename, const char *language,
+                                  int start_line, int end_line, size_t max_bytes) {
+    extractor_language_t lang = extractor_language_from_name(language);
+    if (lang == EXTRACTOR_LANG_UNKNOWN) {
+        fprintf(stderr, "Unsupported language: %s\n", language ? language : "(null)");
         return NULL;
     }
 
-    // Create a parser
-    TSParser *parser = ts_parser_new();
-    
-    // Set the language
-    TSLanguage *lang = NULL;
-    if (strcmp(language, "java") == 0) {
-        lang = tree_sitter_java();
-    } else if (strcmp(language, "python") == 0) {
-        lang = tree_sitter_python();
-    } else {
-        fprintf(stderr, "Unsupported language: %s\n", language);
-        free(source_code);
-        ts_parser_delete(parser);
+    // Parsed files come from the skeleton cache, so a hit only filters and prints
+    parsed_file_t* file = extractor_ctx_acquire_file(ctx, filename, lang);
+    if (!file) {
         return NULL;
     }
-    
-    ts_parser_set_language(parser, lang);
-    
-    // Parse the source code
-    TSTree *tree = ts_parser_parse_string(parser, NULL, source_code, source_size);
-    
-    // Extract signatures
-    signature_node_t* root = extract_signatures(tree, source_code, language);
-    
-    // Extract errors
-    int error_count = 0;
-    parse_error_t* errors = extract_parse_errors(tree, source_code, &error_count);
-    
-    // Filter errors based on line range if specified
-    parse_error_t* filtered_errors = NULL;
-    int filtered_error_count = 0;
-    
-    if (start_line != -1 && end_line != -1 && errors && error_count > 0) {
-        // Allocate memory for filtered errors
-        filtered_errors = malloc(sizeof(parse_error_t) * error_count);
-        if (filtered_errors) {
-            for (int i = 0; i < error_count; i++) {
-                // Check if error is within the specified range
-                if (errors[i].line >= start_line && errors[i].line <= end_line) {
-                    filtered_errors[filtered_error_count] = errors[i];
-                    // Since we're copying the struct, we need to duplicate the strings
-                    if (filtered_errors[filtered_error_count].message) {
-                        filtered_errors[filtered_error_count].message = strdup(filtered_errors[filtered_error_count].message);
-                    }
-                    if (filtered_errors[filtered_error_count].error_line) {
-                        filtered_errors[filtered_error_count].error_line = strdup(filtered_errors[filtered_error_count].error_line);
-                    }
-                    if (filtered_errors[filtered_error_count].code_above_error_line) {
-                        filtered_errors[filtered_error_count].code_above_error_line = strdup(filtered_errors[filtered_error_count].code_above_error_line);
-                    }
-                    if (filtered_errors[filtered_error_count].code_below_error_line) {
-                        filtered_errors[filtered_error_count].code_below_error_line = strdup(filtered_errors[filtered_error_count].code_below_error_line);
-                    }
-                    filtered_error_count++;
-                }
-            }
-        }
-    } else {
-        // Use all errors if no range is specified
-        filtered_errors = errors;
-        filtered_error_count = error_count;
-        errors = NULL; // Prevent double-free
-    }
-    
-    // Filter code entities based on line range if specified
-    signature_node_t* filtered_root = NULL;
-    if (start_line != -1 && end_line != -1 && root) {
-        // Create a new root container for filtered nodes
-        filtered_root = create_signature_node(
-            ENTITY_UNKNOWN, "root", "root", 0, 0, 0, 0
-        );
-        
-        // Iterate through all top-level nodes
-        signature_node_t* current = root;
-        while (current) {
-            // Check if this node overlaps with the range
-            // entity.endLine >= target_startLine && entity.startLine <= target_endLine
-            if ((current->end_line >= start_line && current->start_line <= end_line)) {
-                // Add node to filtered results with range-based filtering of children
-                signature_node_t* cloned_node = clone_signature_node_with_range(current, start_line, end_line);
-                if (cloned_node) {
-                    add_child_signature_node(filtered_root, cloned_node);
-                }
-            }
-            current = current->next_sibling;
-        }
-    } else {
-        filtered_root = root;
+
+    char* xml_buffer = render_skeleton_xml_budget(filename, file->forest, file->entities, file->errors,
+                                                  file->error_count, start_line, end_line, max_bytes);
+
+    extractor_ctx_release_file(ctx, file);
+    return xml_buffer;
+}
+
+int get_skeleton_xml_stream(const char *filename, const char *language, int start_line, int end_line,
+                            xml_chunk_fn callback, void* user_data) {
+    return ctx_get_skeleton_xml_stream(extractor_ctx_default(), filename, language, start_line, end_line,
+                                       callback, user_data);
+}
+
+int ctx_get_skeleton_xml_stream(extractor_ctx_t* ctx, const char *filename, const char *language,
+                                int start_line, int end_line, xml_chunk_fn callback, void* user_data) {
+    extractor_language_t lang = extractor_language_from_name(language);
+    if (lang == EXTRACTOR_LANG_UNKNOWN) {
+        fprintf(stderr, "Unsupported language: %s\n", language ? language : "(null)");
+        return -1;
     }
-    
-    // Calculate approximate buffer size needed
-    // Start with a reasonable base size for XML structure
-    size_t buffer_size = 8192; // Increased base size
-    signature_node_t* current = (start_line != -1 && end_line != -1) ? filtered_root->children : filtered_root;
-    
-    // Roughly estimate space needed for all signatures
-    while (current) {
-        if (current->signature) {
-            buffer_size += strlen(current->signature) + 500; // Extra for XML tags
-        }
-        // Also account for children recursively
-        signature_node_t* child = current ? current->children : NULL;
-        while (child) {
-            buffer_size += calculate_node_size_recursive(child);
-            child = child->next_sibling;
-        }
-        current = current->next_sibling;
+    if (!callback) {
+        return -1;
     }
-    
-    // Account for errors
-    buffer_size += filtered_error_count * 2048; // More space for the detailed error info
-    if (buffer_size > MAX_XML_SIZE) {
-        buffer_size = MAX_XML_SIZE;
+
+    parsed_file_t* file = extractor_ctx_acquire_file(ctx, filename, lang);
+    if (!file) {
+        return -1;
     }
-    
-    // Allocate buffer
-    char* xml_buffer = (char*)malloc(buffer_size);
-    if (!xml_buffer) {
-        free_parse_errors(filtered_errors, filtered_error_count);
-        if (errors) free_parse_errors(errors, error_count);
-        if (root && (start_line == -1 || end_line == -1)) {
-            free_signature_node(root);
-        } else if (filtered_root) {
-            free_signature_node(filtered_root);
-        }
-        free(source_code);
-        ts_tree_delete(tree);
-        ts_parser_delete(parser);
+
+    int status = stream_skeleton_xml(filename, file->forest, file->entities, file->errors, file->error_count,
+                                     start_line, end_line, callback, user_data);
+
+    extractor_ctx_release_file(ctx, file);
+    return status;
+}
+
+char* get_enclosing_signature(const char *filename, const char *language, int line) {
+    extractor_language_t lang = extractor_language_from_name(language);
+    if (lang == EXTRACTOR_LANG_UNKNOWN) {
+        fprintf(stderr, "Unsupported language: %s\n", language ? language : "(null)");
         return NULL;
     }
-    
-    // Start building XML
-    int offset = 0;
-    char* escaped_filename = escape_xml_attr(filename);
-    if (escaped_filename) {
-        if (start_line != -1 && end_line != -1) {
-            offset += snprintf(xml_buffer + offset, buffer_size - offset, 
-                               "<code-skeleton path=\"%s\" range=\"%d-%d\">\n", escaped_filename, start_line, end_line);
-        } else {
-            offset += snprintf(xml_buffer + offset, buffer_size - offset, 
-                               "<code-skeleton path=\"%s\">\n", escaped_filename);
+
+    extractor_ctx_t* ctx = extractor_ctx_default();
+    parsed_file_t* file = extractor_ctx_acquire_file(ctx, filename, lang);
+    if (!file) {
+        return NULL;
+    }
+
+    char* signature = NULL;
+    signature_node_t* entity = parsed_file_enclosing_entity(file, line);
+    if (entity) {
+        xml_writer_t writer;
+        xml_writer_init(&writer, signature_node_signature_length(entity));
+        signature_node_each_piece(entity, write_piece, &writer);
+        signature = xml_writer_finish(&writer);
+    }
+
+    extractor_ctx_release_file(ctx, file);
+    return signature;
+}
+
+// Render the XML skeleton of a parsed file. The forest and errors are borrowed and never copied,
+// a line range only selects what gets printed.
+char* render_skeleton_xml(const char *filename, signature_node_t* root, const entity_index_t* index,
+                          parse_error_t* errors, int error_count, int start_line, int end_line) {
+    STATS_PHASE_BEGIN(render);
+    xml_writer_t writer;
+    xml_writer_init(&writer, 0);
+    write_skeleton_xml(&writer, filename, root, index, errors, error_count, start_line, end_line);
+    STATS_ADD(STATS_OUTPUT_BYTES, writer.length);
+    char* xml = xml_writer_finish(&writer);
+    STATS_PHASE_END(STATS_PHASE_RENDER, render);
+    return xml;
+}
+
+// Render the XML skeleton of a parsed file within max_bytes, see get_skeleton_xml_budget
+char* render_skeleton_xml_budget(const char *filename, signature_node_t* root, const entity_index_t* index,
+                                 parse_error_t* errors, int error_count, int start_line, int end_line,
+                                 size_t max_bytes) {
+    if (max_bytes == 0) {
+        return render_skeleton_xml(filename, root, index, errors, error_count, start_line, end_line);
+    }
+
+    STATS_PHASE_BEGIN(render);
+    entity_index_t* own_index = index ? NULL : entity_index_build(NULL, root);
+    if (!index && !own_index) {
+        return NULL;
+    }
+    const entity_index_t* entities = index ? index : own_index;
+
+    int first_error;
+    int last_error;
+    error_run(errors, error_count, start_line, end_line, &first_error, &last_error);
+    size_t overhead = skeleton_budget_overhead(filename, start_line, end_line, errors, first_error, last_error);
+    int truncated = 0;
+    uint8_t* selected = skeleton_budget_select(entities, start_line, end_line,
+                                               max_bytes > overhead ? max_bytes - overhead : 0, &truncated);
+    char* xml = NULL;
+    if (selected) {
+        xml_writer_t writer;
+        xml_writer_init(&writer, 0);
+        write_skeleton(&writer, filename, root, entities, errors, error_count, start_line, end_line,
+                       selected, truncated);
+        STATS_ADD(STATS_OUTPUT_BYTES, writer.length);
+        xml = xml_writer_finish(&writer);
+    }
+    free(selected);
+    entity_index_free(own_index);
+    STATS_PHASE_END(STATS_PHASE_RENDER, render);
+    return xml;
+}
+
+// Stream the XML skeleton of a parsed file to a callback in chunks
+int stream_skeleton_xml(const char *filename, signature_node_t* root, const entity_index_t* index,
+                        parse_error_t* errors, int error_count, int start_line, int end_line,
+                        xml_chunk_fn callback, void* user_data) {
+    STATS_PHASE_BEGIN(render);
+    xml_writer_t writer;
+    xml_writer_init_stream(&writer, callback, user_data);
+    write_skeleton_xml(&writer, filename, root, index, errors, error_count, start_line, end_line);
+    STATS_ADD(STATS_OUTPUT_BYTES, writer.flushed + writer.length);
+    int status = xml_writer_finish_stream(&writer);
+    STATS_PHASE_END(STATS_PHASE_RENDER, render);
+    return status;
+}
+
+// Write an element of an error holding escaped text
+static void write_error_field(xml_writer_t* writer, const char* tag, const char* text) {
+    xml_writer_puts(writer, "      <");
+    xml_writer_puts(writer, tag);
+    xml_writer_puts(writer, ">");
+    if (text) {
+        xml_writer_escaped(writer, text, strlen(text));
+    }
+    xml_writer_puts(writer, "</");
+    xml_writer_puts(writer, tag);
+    xml_writer_puts(writer, ">\n");
+}
+
+// Find the errors in a line range (-1 for no range), they are sorted by line so they are a contiguous run
+static void error_run(const parse_error_t* errors, int error_count, int start_line, int end_line,
+                      int* first_error, int* last_error) {
+    *first_error = 0;
+    *last_error = errors ? error_count : 0;
+    if (start_line != -1 && end_line != -1) {
+        while (*first_error < *last_error && errors[*first_error].line < start_line) {
+            (*first_error)++;
         }
-        free(escaped_filename);
-    } else {
-        if (start_line != -1 && end_line != -1) {
-            offset += snprintf(xml_buffer + offset, buffer_size - offset, 
-                               "<code-skeleton path=\"%s\" range=\"%d-%d\">\n", filename, start_line, end_line);
-        } else {
-            offset += snprintf(xml_buffer + offset, buffer_size - offset, 
-                               "<code-skeleton path=\"%s\">\n", filename);
+        while (*last_error > *first_error && errors[*last_error - 1].line > end_line) {
+            (*last_error)--;
         }
     }
+}
+
+void write_skeleton_xml(xml_writer_t* writer, const char *filename, signature_node_t* root,
+                        const entity_index_t* index, parse_error_t* errors, int error_count,
+                        int start_line, int end_line) {
+    write_skeleton(writer, filename, root, index, errors, error_count, start_line, end_line, NULL, 0);
+}
+
+// Write a skeleton, only the index entries flagged in selected if it is not NULL
+static void write_skeleton(xml_writer_t* writer, const char *filename, signature_node_t* root,
+                           const entity_index_t* index, parse_error_t* errors, int error_count,
+                           int start_line, int end_line, const uint8_t* selected, int truncated) {
+    // Errors and entities are filtered while printing, the parsed file is only read
+    int has_range = start_line != -1 && end_line != -1;
+    if (!has_range) {
+        start_line = end_line = -1;
+    }
+
+    int first_error;
+    int last_error;
+    error_run(errors, error_count, start_line, end_line, &first_error, &last_error);
+    int filtered_error_count = last_error - first_error;
+    
+    // Start building XML
+    xml_writer_puts(writer, "<code-skeleton path=\"");
+    if (filename) {
+        xml_writer_escaped(writer, filename, strlen(filename));
+    }
+    if (has_range) {
+        xml_writer_puts(writer, "\" range=\"");
+        xml_writer_int(writer, start_line);
+        xml_writer_puts(writer, "-");
+        xml_writer_int(writer, end_line);
+    }
+    if (truncated) {
+        xml_writer_puts(writer, SKELETON_TRUNCATED_ATTR);
+    }
+    xml_writer_puts(writer, "\">\n");
     
-    // Process all top-level nodes
-    current = (start_line != -1 && end_line != -1) ? filtered_root->children : filtered_root;
-    while (current) {
-        if (current->signature) {
-            offset = print_node_recursive(xml_buffer, buffer_size, current, offset, 1);
+    // Process all top-level nodes, through the interval index when there is one
+    if (index && index->span_count > 0) {
+        print_span(writer, index, 0, 1, has_range ? start_line : INT_MIN, has_range ? end_line : INT_MAX, selected);
+    } else {
+        for (signature_node_t* current = root; current; current = current->next_sibling) {
+            if (signature_node_has_signature(current)) {
+                print_node_in_range(writer, current, 1, start_line, end_line);
+            }
         }
-        current = current->next_sibling;
     }
     
     // Process errors if any
-    if (filtered_error_count > 0 && filtered_errors) {
-        offset += snprintf(xml_buffer + offset, buffer_size - offset,
-                           "  <code-errors>\n");
+    if (filtered_error_count > 0) {
+        xml_writer_puts(writer, "  <code-errors>\n");
                            
-        for (int i = 0; i < filtered_error_count; i++) {
-            offset += snprintf(xml_buffer + offset, buffer_size - offset,
-                               "    <error line=%d>\n", filtered_errors[i].line);
-                               
-            char* escaped_message = escape_xml(filtered_errors[i].message);
-            if (escaped_message) {
-                offset += snprintf(xml_buffer + offset, buffer_size - offset,
-                                   "      <message>%s</message>\n", escaped_message);
-                free(escaped_message);
-            } else {
-                offset += snprintf(xml_buffer + offset, buffer_size - offset,
-                                   "      <message>%s</message>\n", filtered_errors[i].message);
-            }
+        for (int e = first_error; e < last_error; e++) {
+            parse_error_t* error = &errors[e];
+            xml_writer_puts(writer, "    <error line=");
+            xml_writer_int(writer, error->line);
+            xml_writer_puts(writer, ">\n");
+            write_error_field(writer, "message", error->message);
             
             // Add the detailed error context
-            if (filtered_errors[i].error_line) {
-                char* escaped_error_line = escape_xml(filtered_errors[i].error_line);
-                if (escaped_error_line) {
-                    offset += snprintf(xml_buffer + offset, buffer_size - offset,
-                                       "      <error-line>%s</error-line>\n", escaped_error_line);
-                    free(escaped_error_line);
-                } else {
-                    offset += snprintf(xml_buffer + offset, buffer_size - offset,
-                                       "      <error-line>%s</error-line>\n", filtered_errors[i].error_line);
-                }
+            if (error->error_line) {
+                write_error_field(writer, "error-line", error->error_line);
             }
-            
-            if (filtered_errors[i].code_above_error_line) {
-                char* escaped_above_line = escape_xml(filtered_errors[i].code_above_error_line);
-                if (escaped_above_line) {
-                    offset += snprintf(xml_buffer + offset, buffer_size - offset,
-                                       "      <code-above-error-line>%s</code-above-error-line>\n", escaped_above_line);
-                    free(escaped_above_line);
-                } else {
-                    offset += snprintf(xml_buffer + offset, buffer_size - offset,
-                                       "      <code-above-error-line>%s</code-above-error-line>\n", filtered_errors[i].code_above_error_line);
-                }
+            if (error->code_above_error_line) {
+                write_error_field(writer, "code-above-error-line", error->code_above_error_line);
             }
-            
-            if (filtered_errors[i].code_below_error_line) {
-                char* escaped_below_line = escape_xml(filtered_errors[i].code_below_error_line);
-                if (escaped_below_line) {
-                    offset += snprintf(xml_buffer + offset, buffer_size - offset,
-                                       "      <code-below-error-line>%s</code-below-error-line>\n", escaped_below_line);
-                    free(escaped_below_line);
-                } else {
-                    offset += snprintf(xml_buffer + offset, buffer_size - offset,
-                                       "      <code-below-error-line>%s</code-below-error-line>\n", filtered_errors[i].code_below_error_line);
-                }
+            if (error->code_below_error_line) {
+                write_error_field(writer, "code-below-error-line", error->code_below_error_line);
             }
             
-            offset += snprintf(xml_buffer + offset, buffer_size - offset,
-                               "    </error>\n");
+            xml_writer_puts(writer, "    </error>\n");
         }
         
-        offset += snprintf(xml_buffer + offset, buffer_size - offset,
-                           "  </code-errors>\n");
-    }
-    
-    offset += snprintf(xml_buffer + offset, buffer_size - offset, 
-                       "</code-skeleton>");
-    
-    // Clean up
-    free_parse_errors(filtered_errors, filtered_error_count);
-    if (errors) free_parse_errors(errors, error_count);
-    if (root && (start_line == -1 || end_line == -1)) {
-        free_signature_node(root);
-    } else if (filtered_root) {
-        free_signature_node(filtered_root);
+        xml_writer_puts(writer, "  </code-errors>\n");
     }
-    free(source_code);
-    ts_tree_delete(tree);
-    ts_parser_delete(parser);
     
-    return xml_buffer;
+    xml_writer_puts(writer, "</code-skeleton>");
 }
 
 // Helper function to calculate the size needed for a node and all its descendants
 size_t calculate_node_size_recursive(signature_node_t* node) {
-    if (!node || !node->signature) return 0;
+    if (!node || !signature_node_has_signature(node)) return 0;
     
-    size_t size = strlen(node->signature) + 100; // Base size for this node
+    size_t size = signature_node_signature_length(node) + 100; // Base size for this node
     
     // Add size for all children recursively
     signature_node_t* child = node->children;
@@ -739,72 +811,138 @@ size_t calculate_node_size_recursive(signature_node_t* node) {
     return size;
 }
 
+// Write a piece of a signature XML-escaped
+static void write_escaped_piece(const char* text, size_t length, void* arg) {
+    xml_writer_escaped((xml_writer_t*)arg, text, length);
+}
+
+// Write a piece of a signature as is
+static void write_piece(const char* text, size_t length, void* arg) {
+    xml_writer_write((xml_writer_t*)arg, text, length);
+}
+
+// Whether an entity overlaps a line range
+// entity.endLine >= target_startLine && entity.startLine <= target_endLine
+static int node_in_range(const signature_node_t* node, int start_line, int end_line) {
+    return start_line == -1 || (node->end_line >= start_line && node->start_line <= end_line);
+}
+
 // Helper function to recursively print a node and all its descendants
-int print_node_recursive(char* buffer, size_t buffer_size, signature_node_t* node, int offset, int indent_level) {
-    if (!node || !node->signature) return offset;
-    
-    // Print indentation
-    for (int i = 0; i < indent_level; i++) {
-        offset += snprintf(buffer + offset, buffer_size - offset, "    ");
-    }
+void print_node_recursive(xml_writer_t* writer, signature_node_t* node, int indent_level) {
+    print_node_in_range(writer, node, indent_level, -1, -1);
+}
+
+// Print a node and its descendants overlapping a line range (-1 for no range)
+void print_node_in_range(xml_writer_t* writer, signature_node_t* node, int indent_level,
+                         int start_line, int end_line) {
+    if (!node || !signature_node_has_signature(node) || !node_in_range(node, start_line, end_line)) return;
     
     // Print the code entity
-    offset += snprintf(buffer + offset, buffer_size - offset,
-                       "<code-entity start=%d end=%d>\n", 
-                       node->start_line, node->end_line);
-    
-    // Print indentation for signature
-    for (int i = 0; i < indent_level + 1; i++) {
-        offset += snprintf(buffer + offset, buffer_size - offset, "    ");
-    }
-    
-    // Escape special XML characters in signature
-    char* escaped_signature = escape_xml(node->signature);
-    if (escaped_signature) {
-        offset += snprintf(buffer + offset, buffer_size - offset,
-                           "<signature>%s</signature>\n", 
-                           escaped_signature);
-        free(escaped_signature);
-    } else {
-        offset += snprintf(buffer + offset, buffer_size - offset,
-                           "<signature>%s</signature>\n", 
-                           node->signature);
+    xml_writer_indent(writer, indent_level);
+    xml_writer_puts(writer, "<code-entity start=");
+    xml_writer_int(writer, node->start_line);
+    xml_writer_puts(writer, " end=");
+    xml_writer_int(writer, node->end_line);
+    xml_writer_puts(writer, ">\n");
+    
+    // Escape special XML characters in signature, piece by piece straight into the output
+    xml_writer_indent(writer, indent_level + 1);
+    xml_writer_puts(writer, "<signature>");
+    signature_node_each_piece(node, write_escaped_piece, writer);
+    xml_writer_puts(writer, "</signature>\n");
+    
+    // Process children if any of them is in range
+    signature_node_t* first_child = node->children;
+    while (first_child && !node_in_range(first_child, start_line, end_line)) {
+        first_child = first_child->next_sibling;
+    }
+    if (first_child) {
+        xml_writer_indent(writer, indent_level + 1);
+        xml_writer_puts(writer, "<member>\n");
+        for (signature_node_t* child = first_child; child; child = child->next_sibling) {
+            print_node_in_range(writer, child, indent_level + 2, start_line, end_line);
+        }
+        xml_writer_indent(writer, indent_level + 1);
+        xml_writer_puts(writer, "</member>\n");
     }
     
-    // Process children if they exist
-    if (node->children) {
-        // Print indentation for member
-        for (int i = 0; i < indent_level + 1; i++) {
-            offset += snprintf(buffer + offset, buffer_size - offset, "    ");
+    xml_writer_indent(writer, indent_level);
+    xml_writer_puts(writer, "</code-entity>\n");
+}
+
+// Print the entities of an index span overlapping a line range (-1 for no range), visiting
+// only the overlapping entries of each level. Matches print_node_in_range on the same forest.
+void print_span_in_range(xml_writer_t* writer, const entity_index_t* index, int32_t span_id, int indent_level,
+                         int start_line, int end_line) {
+    if (start_line == -1) {
+        start_line = INT_MIN;
+        end_line = INT_MAX;
+    }
+    print_span(writer, index, span_id, indent_level, start_line, end_line, NULL);
+}
+
+// Print a span for a range without -1, skipping the entries not flagged in selected and
+// ending with a marker that counts them
+static void print_span(xml_writer_t* writer, const entity_index_t* index, int32_t span_id, int indent_level,
+                       int start_line, int end_line, const uint8_t* selected) {
+    const entity_span_t* span = &index->spans[span_id];
+    uint32_t span_end = span->first + span->count;
+    int elided = 0;
+    for (uint32_t i = entity_span_lower_bound(index, span_id, start_line);
+         i < span_end && index->entries[i].start_line <= end_line; i++) {
+        const entity_entry_t* entry = &index->entries[i];
+        signature_node_t* node = entry->node;
+        if (entry->end_line < start_line || !signature_node_has_signature(node)) {
+            continue;
         }
-        
-        offset += snprintf(buffer + offset, buffer_size - offset,
-                           "<member>\n");
-        
-        signature_node_t* child = node->children;
-        while (child) {
-            offset = print_node_recursive(buffer, buffer_size, child, offset, indent_level + 2);
-            child = child->next_sibling;
+        if (selected && !selected[i]) {
+            elided++;
+            continue;
         }
-        
-        // Print indentation for closing member tag
-        for (int i = 0; i < indent_level + 1; i++) {
-            offset += snprintf(buffer + offset, buffer_size - offset, "    ");
+
+        xml_writer_indent(writer, indent_level);
+        xml_writer_puts(writer, "<code-entity start=");
+        xml_writer_int(writer, node->start_line);
+        xml_writer_puts(writer, " end=");
+        xml_writer_int(writer, node->end_line);
+        xml_writer_puts(writer, ">\n");
+
+        xml_writer_indent(writer, indent_level + 1);
+        xml_writer_puts(writer, "<signature>");
+        signature_node_each_piece(node, write_escaped_piece, writer);
+        xml_writer_puts(writer, "</signature>\n");
+
+        // Members only if one of the children overlaps the range
+        if (entry->children >= 0) {
+            const entity_span_t* children = &index->spans[entry->children];
+            uint32_t first = entity_span_lower_bound(index, entry->children, start_line);
+            int any = 0;
+            for (uint32_t c = first; c < children->first + children->count &&
+                                     index->entries[c].start_line <= end_line; c++) {
+                if (index->entries[c].end_line >= start_line) {
+                    any = 1;
+                    break;
+                }
+            }
+            if (any) {
+                xml_writer_indent(writer, indent_level + 1);
+                xml_writer_puts(writer, "<member>\n");
+                print_span(writer, index, entry->children, indent_level + 2, start_line, end_line, selected);
+                xml_writer_indent(writer, indent_level + 1);
+                xml_writer_puts(writer, "</member>\n");
+            }
         }
-        
-        offset += snprintf(buffer + offset, buffer_size - offset,
-                           "</member>\n");
+
+        xml_writer_indent(writer, indent_level);
+        xml_writer_puts(writer, "</code-entity>\n");
     }
-    
-    // Print indentation for closing code-entity tag
-    for (int i = 0; i < indent_level; i++) {
-        offset += snprintf(buffer + offset, buffer_size - offset, "    ");
+
+    if (elided > 0) {
+        xml_writer_indent(writer, indent_level);
+        xml_writer_puts(writer, "<elided entities=");
+        xml_writer_int(writer, elided);
+        xml_writer_puts(writer, "/>\n");
     }
-    
-    offset += snprintf(buffer + offset, buffer_size - offset,
-                       "</code-entity>\n");
-    
-    return offset;
 }
 
 // Helper function to clone a signature node and its children with range filtering
@@ -817,12 +955,7 @@ signature_node_t* clone_signature_node_with_range(signature_node_t* node, int st
         return NULL; // Node doesn't overlap with range, don't include it
     }
     
-    signature_node_t* clone = create_signature_node(
-        node->type, node->name, node->signature,
-        node->start_line, node->start_column,
-        node->end_line, node->end_column
-    );
-    
+    signature_node_t* clone = clone_single_node(NULL, node);
     if (!clone) return NULL;
     
     // Clone children that also overlap with the range
@@ -840,20 +973,53 @@ signature_node_t* clone_signature_node_with_range(signature_node_t* node, int st
 
 // Helper function to clone a signature node and its children (without range filtering)
 signature_node_t* clone_signature_node(signature_node_t* node) {
-    if (!node) return NULL;
+    return clone_signature_node_in(NULL, node);
+}
+
+// Clone a signature node without its children into an arena (or the heap if NULL).
+// Heap clones get string copies, arena clones share the slices of the original.
+static signature_node_t* clone_single_node(arena_t* arena, signature_node_t* node) {
+    signature_node_t* clone;
+    if (arena && node->source) {
+        signature_builder_t parts = { node->source, node->parts, node->part_count, node->part_count, 0 };
+        clone = create_signature_node_sliced(
+            arena, node->type, node->source, node->name_slice, &parts,
+            node->start_line, node->start_column,
+            node->end_line, node->end_column
+        );
+    } else {
+        size_t name_length;
+        const char* name = signature_node_name(node, &name_length);
+        clone = create_signature_node_in(
+            arena, node->type, name, name_length, node->signature,
+            node->signature ? strlen(node->signature) : 0,
+            node->start_line, node->start_column,
+            node->end_line, node->end_column
+        );
+        if (clone && !node->signature && node->part_count > 0) {
+            signature_builder_t parts = { node->source, node->parts, node->part_count, node->part_count,
+                                          signature_node_signature_length(node) };
+            clone->signature = signature_builder_to_string(&parts, arena);
+        }
+    }
     
-    signature_node_t* clone = create_signature_node(
-        node->type, node->name, node->signature,
-        node->start_line, node->start_column,
-        node->end_line, node->end_column
-    );
+    if (!clone) return NULL;
+    clone->start_byte = node->start_byte;
+    clone->end_byte = node->end_byte;
+    return clone;
+}
+
+// Clone a signature node and its children into an arena (or the heap if NULL)
+signature_node_t* clone_signature_node_in(arena_t* arena, signature_node_t* node) {
+    if (!node) return NULL;
     
+    signature_node_t* clone = clone_single_node(arena, node);
     if (!clone) return NULL;
     
     // Clone children
     signature_node_t* child = node->children;
     while (child) {
-        signature_node_t* cloned_child = clone_signature_node(child);
+        signature_node_t* cloned_child = clone_signature_node_in(arena, child);
         if (cloned_child) {
             add_child_signature_node(clone, cloned_child);
         }
@@ -861,4 +1027,4 @@ signature_node_t* clone_signature_node(signature_node_t* node) {
     }
     
     return clone;
-}
\ No newline at end of file
+}
@@ -2,6 +2,11 @@
 #define SIGNATURE_EXTRACTOR_H
 
 #include "signature_node.h"
+#include "extractor_context.h"
+#include "language_table.h"
+#include "entity_index.h"
+#include "arena.h"
+#include "xml_writer.h"
 #include "tree_sitter/api.h"
 #include "dll_export.h"
 
@@ -9,6 +14,60 @@
 extern "C" {
 #endif
 
+// How function bodies are traversed while extracting signatures
+typedef enum {
+    EXTRACT_BODIES_SKIP = 0,         // Never look inside function bodies
+    EXTRACT_BODIES_DECLARATIONS,     // Only look inside bodies that may hold nested declarations (default)
+    EXTRACT_BODIES_ALL               // Visit every node
+} extract_body_mode_t;
+
+// State of one extraction pass over a tree
+typedef struct extract_state {
+    const char* source_code;         // Source the tree was parsed from
+    arena_t* arena;                  // Allocator of nodes, NULL for heap nodes with string copies
+    signature_builder_t scratch;     // Reused to assemble each signature
+    const language_table_t* table;   // Node kinds of the language, set by extract_state_set_language
+    extract_body_mode_t body_mode;   // Traversal of function bodies
+} extract_state_t;
+
+void extract_state_init(extract_state_t* state, const char* source_code, arena_t* arena);
+void extract_state_set_language(extract_state_t* state, const char* language);
+void extract_state_finish(extract_state_t* state);
+
+/**
+ * Set how function bodies are traversed by later extractions (EXTRACT_BODIES_DECLARATIONS by default).
+ * Cached files extracted with another mode are parsed again on their next lookup.
+ * @param mode An extract_body_mode_t value
+ */
+DLL_EXPORT void set_signature_body_mode(int mode);
+
+/**
+ * Get the traversal mode of function bodies
+ * @return Current extract_body_mode_t value
+ */
+extract_body_mode_t get_signature_body_mode(void);
+
+/**
+ * Decide whether to visit the subtree at a cursor.
+ * Function bodies are skipped unless the body mode lets them hold nested declarations.
+ * @param state Extraction state with its language set
+ * @param cursor Cursor on the root of the subtree
+ * @param in_function Whether the parent of the subtree is a function or constructor declaration
+ * @return Non-zero to visit the subtree
+ */
+int extract_should_visit(extract_state_t* state, TSTreeCursor* cursor, int in_function);
+
+/**
+ * Create the node of an entity with the signature assembled in the scratch builder of the state.
+ * Arena nodes keep slices into the source of the state, heap nodes get copies of their strings.
+ * @param state Extraction state
+ * @param type Entity type
+ * @param node Declaration node, whose text is the signature if the scratch buffer is empty
+ * @param name_node Node holding the name of the entity
+ * @return New signature node, or NULL on allocation failure
+ */
+signature_node_t* create_entity_node(extract_state_t* state, entity_type_t type, TSNode node, TSNode name_node);
+
 /**
  * Extract signatures from a Tree-sitter AST
  * @param tree Tree-sitter tree
@@ -17,11 +76,97 @@ extern "C" {
  * @return Linked list of signature nodes
  */
 DLL_EXPORT signature_node_t* extract_signatures(TSTree* tree, const char* source_code, const char* language);
+signature_node_t* extract_node_signature(extract_state_t* state, TSNode node);
+signature_node_t* traverse_and_extract(extract_state_t* state, TSNode node, const char* language, signature_node_t* parent);
+
+/**
+ * Extract the signatures declared in a subtree
+ * @param node Root of the subtree
+ * @param source_code Source code text
+ * @param language Language of the source code
+ * @param arena Arena the signatures come from, or NULL for the heap.
+ *              Arena signatures are slices of source_code, which must outlive them.
+ * @return Linked list of top-level signature nodes
+ */
+signature_node_t* extract_signatures_in_node(TSNode node, const char* source_code, const char* language, arena_t* arena);
+
+/**
+ * Use precompiled signature queries instead of walking the tree for later extractions (off by
+ * default). Languages without a query, and the EXTRACT_BODIES_SKIP mode, keep walking.
+ * @param enabled Non-zero to extract with queries
+ */
+DLL_EXPORT void set_signature_query_mode(int enabled);
+int get_signature_query_mode(void);
+
+/**
+ * Extract the signatures of a subtree with one run of the query of the state's language
+ * @param state Extraction state with its language set
+ * @param node Root of the subtree
+ * @param start_line First line of a window to restrict the query cursor to, or -1 for the whole subtree
+ * @param end_line Last line of the window, or -1
+ * @param parent Receives the top-level signatures
+ * @return 0 on success, -1 if the language has no usable query and the tree must be walked
+ */
+int query_and_extract(extract_state_t* state, TSNode node, int start_line, int end_line, signature_node_t* parent);
+
+/**
+ * Extract the signatures overlapping a range of lines, with their enclosing declarations.
+ * The query cursor never visits nodes outside the window.
+ * @param tree Tree-sitter tree
+ * @param source_code Source code text
+ * @param language Language of the source code
+ * @param start_line First line of the range, or -1 for the whole file
+ * @param end_line Last line of the range, or -1 for the whole file
+ * @return Linked list of top-level heap signature nodes
+ */
+signature_node_t* extract_signatures_in_lines(TSTree* tree, const char* source_code, const char* language,
+                                              int start_line, int end_line);
+DLL_EXPORT signature_node_t* extract_signatures_from_file_range(const char *filename, const char *language,
+                                                                int start_line, int end_line);
 DLL_EXPORT signature_node_t* extract_signatures_from_file(const char *filename, const char *language);
 DLL_EXPORT char* get_skeleton_xml(const char *filename, const char *language);
 DLL_EXPORT char* get_skeleton_xml_range(const char *filename, const char *language, int start_line, int end_line);
 DLL_EXPORT char* get_skeleton_xml_with_errors(const char *filename, const char *language, int start_line, int end_line);
 
+/**
+ * Get the XML skeleton of a file within an output budget. Entities are chosen shallowest
+ * first and in document order until the next one would not fit; the rest of each sibling
+ * list is replaced by an <elided entities=N/> line and the root gets truncated="true".
+ * Only the chosen entities are rendered. Parse errors in range are always kept.
+ * @param filename Path of the file
+ * @param language Language of the file
+ * @param start_line First line of the range, or -1 for the whole file
+ * @param end_line Last line of the range, or -1 for the whole file
+ * @param max_bytes Budget of the output in bytes (about 4 per token), 0 for no budget
+ * @return XML to be freed by the caller, or NULL on failure
+ */
+DLL_EXPORT char* get_skeleton_xml_budget(const char *filename, const char *language, int start_line, int end_line,
+                                         size_t max_bytes);
+
+/**
+ * Stream the XML skeleton of a file to a callback instead of returning one string.
+ * The output is identical to get_skeleton_xml_with_errors, delivered in chunks of
+ * about XML_WRITER_CHUNK_SIZE bytes that never split a UTF-8 sequence.
+ * @param filename Path of the file
+ * @param language Language of the file
+ * @param start_line First line of the range, or -1 for the whole file
+ * @param end_line Last line of the range, or -1 for the whole file
+ * @param callback Receives each chunk, returns non-zero to stop
+ * @param user_data Argument passed to the callback
+ * @return 0 on success, -1 on failure or if the callback stopped
+ */
+DLL_EXPORT int get_skeleton_xml_stream(const char *filename, const char *language, int start_line, int end_line,
+                                       xml_chunk_fn callback, void* user_data);
+
+/**
+ * Get the signature of the innermost entity enclosing a line, e.g. to attribute an error
+ * @param filename Path of the file
+ * @param language Language of the file
+ * @param line Line number
+ * @return Signature to be freed by the caller, or NULL if no entity encloses the line
+ */
+DLL_EXPORT char* get_enclosing_signature(const char *filename, const char *language, int line);
+
 // Java processing functions
 DLL_EXPORT signature_node_t* process_java_class(TSNode node, const char* source_code);
 DLL_EXPORT signature_node_t* process_java_method(TSNode node, const char* source_code);
@@ -32,26 +177,106 @@ DLL_EXPORT signature_node_t* process_java_enum(TSNode node, const char* source_c
 DLL_EXPORT signature_node_t* process_python_class(TSNode node, const char* source_code);
 DLL_EXPORT signature_node_t* process_python_function(TSNode node, const char* source_code);
 
+// Entity extraction with an explicit state
+signature_node_t* extract_java_class(extract_state_t* state, TSNode node);
+signature_node_t* extract_java_method(extract_state_t* state, TSNode node);
+signature_node_t* extract_java_interface(extract_state_t* state, TSNode node);
+signature_node_t* extract_java_enum(extract_state_t* state, TSNode node);
+signature_node_t* extract_python_class(extract_state_t* state, TSNode node);
+signature_node_t* extract_python_function(extract_state_t* state, TSNode node);
+
+// Entity extraction from the parts captured by a signature query
+signature_node_t* query_java_class(extract_state_t* state, TSNode node, const TSNode* parts);
+signature_node_t* query_java_interface(extract_state_t* state, TSNode node, const TSNode* parts);
+signature_node_t* query_java_enum(extract_state_t* state, TSNode node, const TSNode* parts);
+signature_node_t* query_java_method(extract_state_t* state, TSNode node, const TSNode* parts);
+signature_node_t* query_python_class(extract_state_t* state, TSNode node, const TSNode* parts);
+signature_node_t* query_python_function(extract_state_t* state, TSNode node, const TSNode* parts);
+
+// Entity extraction of registered grammars, from their "name" and "body" fields
+signature_node_t* extract_generic_class(extract_state_t* state, TSNode node);
+signature_node_t* extract_generic_interface(extract_state_t* state, TSNode node);
+signature_node_t* extract_generic_enum(extract_state_t* state, TSNode node);
+signature_node_t* extract_generic_function(extract_state_t* state, TSNode node);
+
 // Helper functions for getting signatures
 char* get_java_method_signature(TSNode node, const char* source_code);
 char* get_java_class_signature(TSNode node, const char* source_code);
 char* get_python_function_signature(TSNode node, const char* source_code);
 char* get_python_class_signature(TSNode node, const char* source_code);
+void append_java_method_signature(signature_builder_t* builder, TSNode node);
+void append_java_class_signature(signature_builder_t* builder, TSNode node);
+void append_python_function_signature(signature_builder_t* builder, TSNode node);
+void append_python_class_signature(signature_builder_t* builder, TSNode node);
+void append_java_method_parts(signature_builder_t* builder, const TSNode* parts);
+void append_java_class_parts(signature_builder_t* builder, const TSNode* parts);
+void append_python_function_parts(signature_builder_t* builder, const TSNode* parts);
+void append_python_class_parts(signature_builder_t* builder, const TSNode* parts);
 
 DLL_EXPORT TSLanguage* tree_sitter_python(void);
 DLL_EXPORT TSLanguage* tree_sitter_java(void);
 
 // Helper function for cloning signature nodes
 signature_node_t* clone_signature_node(signature_node_t* node);
+signature_node_t* clone_signature_node_in(arena_t* arena, signature_node_t* node);
 signature_node_t* clone_signature_node_with_range(signature_node_t* node, int start_line, int end_line);
 
 // Helper functions for XML generation
+char* render_skeleton_xml(const char *filename, signature_node_t* root, const entity_index_t* index,
+                          parse_error_t* errors, int error_count, int start_line, int end_line);
+int stream_skeleton_xml(const char *filename, signature_node_t* root, const entity_index_t* index,
+                        parse_error_t* errors, int error_count, int start_line, int end_line,
+                        xml_chunk_fn callback, void* user_data);
+void write_skeleton_xml(xml_writer_t* writer, const char *filename, signature_node_t* root,
+                        const entity_index_t* index, parse_error_t* errors, int error_count,
+                        int start_line, int end_line);
+char* render_skeleton_xml_budget(const char *filename, signature_node_t* root, const entity_index_t* index,
+                                 parse_error_t* errors, int error_count, int start_line, int end_line,
+                                 size_t max_bytes);
+
+// Attribute of <code-skeleton> when a budget left entities out
+#define SKELETON_TRUNCATED_ATTR "\" truncated=\"true"
+// Largest size of the <elided entities=N/> line ending a sibling list at an indent level
+#define SKELETON_ELIDED_SIZE(indent_level) ((size_t)(indent_level) * 4 + sizeof("<elided entities=/>\n") - 1 + 10)
+
+/**
+ * Size of everything a skeleton holds besides its entities: the root element and the errors
+ * @param filename Path written in the root element
+ * @param start_line First line of the range, or -1
+ * @param end_line Last line of the range, or -1
+ * @param errors Parse errors
+ * @param first_error First error in range
+ * @param last_error End of the errors in range
+ * @return Size in bytes, counting the truncated attribute
+ */
+size_t skeleton_budget_overhead(const char* filename, int start_line, int end_line,
+                                const parse_error_t* errors, int first_error, int last_error);
+
+/**
+ * Choose the entities of an index printed within a budget, see get_skeleton_xml_budget
+ * @param index Entity index
+ * @param start_line First line of the range, or -1
+ * @param end_line Last line of the range, or -1
+ * @param budget Bytes left for the entities and elision markers
+ * @param truncated Set to non-zero if an entity in range was left out
+ * @return One flag per index entry, non-zero for the chosen ones, to be freed by the caller,
+ *         or NULL on allocation failure
+ */
+uint8_t* skeleton_budget_select(const entity_index_t* index, int start_line, int end_line, size_t budget,
+                                int* truncated);
+char* escape_xml_attr(const char* input);
 size_t calculate_node_size_recursive(signature_node_t* node);
-int print_node_recursive(char* buffer, size_t buffer_size, signature_node_t* node, int offset, int indent_level);
+void print_node_recursive(xml_writer_t* writer, signature_node_t* node, int indent_level);
+void print_node_in_range(xml_writer_t* writer, signature_node_t* node, int indent_level,
+                         int start_line, int end_line);
+void print_span_in_range(xml_writer_t* writer, const entity_index_t* index, int32_t span_id, int indent_level,
+                         int start_line, int end_line);
 int print_error_node_recursive(char* buffer, size_t buffer_size, const char* source_code, TSTree* tree, int offset);
 
 // Error handling functions
 parse_error_t* extract_parse_errors(TSTree* tree, const char* source_code, int* error_count);
+parse_error_t* extract_parse_errors_in(TSTree* tree, const char* source_code, size_t source_size,
+                                       int* error_count, arena_t* arena);
 void free_parse_errors(parse_error_t* errors, int error_count);
 
 // Error context functions
@@ -59,6 +284,9 @@ void get_error_context(const char* source_code, int error_line_number,
                       char** error_line, char** above_lines, char** below_lines);
 void get_error_context_ext(const char* source_code, int error_line_number, int context_lines,
                           char** error_line, char** above_lines, char** below_lines);
+void get_error_context_in(arena_t* arena, const char* source_code, size_t source_size,
+                          int error_line_number, int context_lines,
+                          char** error_line, char** above_lines, char** below_lines);
 
 #ifdef __cplusplus
 }
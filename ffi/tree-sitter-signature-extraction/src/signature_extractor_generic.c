@@ -0,0 +1,58 @@
+#include "signature_extractor.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// Append the text of a declaration up to its body, or its first line if it has none.
+// Grammars registered at run time only have to agree on the "name" and "body" fields.
+static void append_generic_signature(extract_state_t* state, TSNode node) {
+    uint32_t start = ts_node_start_byte(node);
+    uint32_t end = ts_node_end_byte(node);
+    TSNode body = ts_node_child_by_field_name(node, "body", 4);
+    if (!ts_node_is_null(body)) {
+        end = ts_node_start_byte(body);
+    } else {
+        const char* newline = memchr(state->source_code + start, '\n', end - start);
+        if (newline) {
+            end = (uint32_t)(newline - state->source_code);
+        }
+    }
+    while (end > start && is_space(state->source_code[end - 1])) {
+        end--;
+    }
+    if (end > start) {
+        signature_builder_slice(&state->scratch, start, end - start);
+    }
+}
+
+static signature_node_t* extract_generic_entity(extract_state_t* state, TSNode node, entity_type_t type) {
+    TSNode name_node = ts_node_child_by_field_name(node, "name", 4);
+    if (ts_node_is_null(name_node)) {
+        return NULL;
+    }
+
+    signature_builder_reset(&state->scratch);
+    append_generic_signature(state, node);
+    return create_entity_node(state, type, node, name_node);
+}
+
+signature_node_t* extract_generic_class(extract_state_t* state, TSNode node) {
+    return extract_generic_entity(state, node, ENTITY_CLASS);
+}
+
+signature_node_t* extract_generic_interface(extract_state_t* state, TSNode node) {
+    return extract_generic_entity(state, node, ENTITY_INTERFACE);
+}
+
+signature_node_t* extract_generic_enum(extract_state_t* state, TSNode node) {
+    return extract_generic_entity(state, node, ENTITY_ENUM);
+}
+
+signature_node_t* extract_generic_function(extract_state_t* state, TSNode node) {
+    return extract_generic_entity(state, node, ENTITY_FUNCTION);
+}
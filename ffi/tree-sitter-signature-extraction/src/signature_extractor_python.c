@@ -5,225 +5,129 @@
 #include <stdlib.h>
 #include <string.h>
 
-// Helper function to get the signature of a Python function
-char* get_python_function_signature(TSNode node, const char* source_code) {
-    TSNode name = ts_node_child_by_field_name(node, "name", 4);
-    TSNode parameters = ts_node_child_by_field_name(node, "parameters", 10);
-    TSNode type = ts_node_child_by_field_name(node, "return_type", 11);
-    
-    // Build signature string
-    char* signature = NULL;
-    size_t sig_len = 0;
-    size_t sig_cap = 32; // Initial capacity
-    signature = malloc(sig_cap);
-    if (!signature) return NULL;
-    signature[0] = '\0';
-    
-    strcpy(signature, "def");
-    sig_len = 3;
+// Append the signature of a Python function from its parts
+void append_python_function_parts(signature_builder_t* builder, const TSNode* parts) {
+    signature_builder_literal(builder, "def");
     
-    // Add function name
-    char* name_text = get_node_text(name, source_code);
-    if (name_text) {
-        size_t name_len = strlen(name_text) + 1;
-        // Ensure enough capacity
-        while (sig_len + name_len + 1 > sig_cap) {
-            sig_cap *= 2;
-            signature = realloc(signature, sig_cap);
-            if (!signature) {
-                free(name_text);
-                return NULL;
-            }
-        }
-        strcat(signature, " ");
-        strcat(signature, name_text);
-        sig_len += name_len;
-        free(name_text);
-    }
-    
-    // Add parameters
-    if (!ts_node_is_null(parameters)) {
-        char* params_text = get_node_text(parameters, source_code);
-        if (params_text) {
-            size_t params_len = strlen(params_text);
-            // Ensure enough capacity
-            while (sig_len + params_len + 1 > sig_cap) {
-                sig_cap *= 2;
-                signature = realloc(signature, sig_cap);
-                if (!signature) {
-                    free(params_text);
-                    return NULL;
-                }
-            }
-            strcat(signature, params_text);
-            sig_len += params_len;
-            free(params_text);
-        }
-    }
+    // Add function name and parameters
+    add_prefixed_node_slice(builder, " ", parts[QUERY_PART_NAME]);
+    add_node_slice(builder, parts[QUERY_PART_PARAMETERS]);
 
     // Add return type if present
-    if (!ts_node_is_null(type)) {
-        char* type_text = get_node_text(type, source_code);
-        if (type_text) {
-            size_t type_len = strlen(type_text) + 4;
-            // Ensure enough capacity
-            while (sig_len + type_len + 5 > sig_cap) {
-                sig_cap *= 2;
-                signature = realloc(signature, sig_cap);
-                if (!signature) {
-                    free(type_text);
-                    return NULL;
-                }
-            }
-            strcat(signature, " -> ");
-            strcat(signature, type_text);
-            sig_len += type_len;
-            free(type_text);
-        }
-    }
+    add_prefixed_node_slice(builder, " -> ", parts[QUERY_PART_RETURN_TYPE]);
     
-    // Add colon
-    // Ensure enough capacity
-    while (sig_len + 2 > sig_cap) {
-        sig_cap *= 2;
-        signature = realloc(signature, sig_cap);
-        if (!signature) return NULL;
-    }
-    strcat(signature, ":");
-    sig_len += 1;
+    signature_builder_literal(builder, ":");
+}
+
+// Append the signature of a Python function
+void append_python_function_signature(signature_builder_t* builder, TSNode node) {
+    TSNode parts[QUERY_PART_COUNT];
+    memset(parts, 0, sizeof(parts));
+    parts[QUERY_PART_NAME] = ts_node_child_by_field_name(node, "name", 4);
+    parts[QUERY_PART_PARAMETERS] = ts_node_child_by_field_name(node, "parameters", 10);
+    parts[QUERY_PART_RETURN_TYPE] = ts_node_child_by_field_name(node, "return_type", 11);
+    append_python_function_parts(builder, parts);
+}
+
+// Append the signature of a Python class from its parts
+void append_python_class_parts(signature_builder_t* builder, const TSNode* parts) {
+    signature_builder_literal(builder, "class");
     
-    if (sig_len == 0) {
-        free(signature);
-        return get_node_text(node, source_code);
-    }
+    // Add class name and superclasses if present
+    add_prefixed_node_slice(builder, " ", parts[QUERY_PART_NAME]);
+    add_node_slice(builder, parts[QUERY_PART_SUPERCLASS]);
     
+    signature_builder_literal(builder, ":");
+}
+
+// Append the signature of a Python class
+void append_python_class_signature(signature_builder_t* builder, TSNode node) {
+    TSNode parts[QUERY_PART_COUNT];
+    memset(parts, 0, sizeof(parts));
+    parts[QUERY_PART_NAME] = ts_node_child_by_field_name(node, "name", 4);
+    parts[QUERY_PART_SUPERCLASS] = ts_node_child_by_field_name(node, "superclasses", 12);
+    // TSNode type_parameters = ts_node_child_by_field_name(node, "type_parameters", 15);
+    append_python_class_parts(builder, parts);
+}
+
+// Helper function to get the signature of a Python function
+char* get_python_function_signature(TSNode node, const char* source_code) {
+    signature_builder_t builder;
+    signature_builder_init(&builder, source_code);
+    append_python_function_signature(&builder, node);
+    char* signature = signature_builder_to_string(&builder, NULL);
+    signature_builder_free(&builder);
     return signature;
 }
 
 // Helper function to get the signature of a Python class
 char* get_python_class_signature(TSNode node, const char* source_code) {
-    TSNode name = ts_node_child_by_field_name(node, "name", 4);
-    TSNode superclasses = ts_node_child_by_field_name(node, "superclasses", 12);
-    // TSNode type_parameters = ts_node_child_by_field_name(node, "type_parameters", 15);
-    
-    // Build signature string
-    char* signature = NULL;
-    size_t sig_len = 0;
-    size_t sig_cap = 32; // Initial capacity
-    signature = malloc(sig_cap);
-    if (!signature) return NULL;
-    signature[0] = '\0';
-    
-    strcpy(signature, "class");
-    sig_len = 5;
-    
-    // Add class name
-    char* name_text = get_node_text(name, source_code);
-    if (name_text) {
-        size_t name_len = strlen(name_text) + 1;
-        // Ensure enough capacity
-        while (sig_len + name_len + 1 > sig_cap) {
-            sig_cap *= 2;
-            signature = realloc(signature, sig_cap);
-            if (!signature) {
-                free(name_text);
-                return NULL;
-            }
-        }
-        strcat(signature, " ");
-        strcat(signature, name_text);
-        sig_len += name_len;
-        free(name_text);
-    }
-    
-    // Add superclasses if present
-    if (!ts_node_is_null(superclasses)) {
-        char* super_text = get_node_text(superclasses, source_code);
-        if (super_text) {
-            size_t super_len = strlen(super_text);
-            // Ensure enough capacity
-            while (sig_len + super_len + 1 > sig_cap) {
-                sig_cap *= 2;
-                signature = realloc(signature, sig_cap);
-                if (!signature) {
-                    free(super_text);
-                    return NULL;
-                }
-            }
-            strcat(signature, super_text);
-            sig_len += super_len;
-            free(super_text);
-        }
-    }
-    
-    // Add colon
-    // Ensure enough capacity
-    while (sig_len + 2 > sig_cap) {
-        sig_cap *= 2;
-        signature = realloc(signature, sig_cap);
-        if (!signature) return NULL;
-    }
-    strcat(signature, ":");
-    sig_len += 1;
-    
-    if (sig_len == 0) {
-        free(signature);
-        return get_node_text(node, source_code);
-    }
-    
+    signature_builder_t builder;
+    signature_builder_init(&builder, source_code);
+    append_python_class_signature(&builder, node);
+    char* signature = signature_builder_to_string(&builder, NULL);
+    signature_builder_free(&builder);
     return signature;
 }
 
-
-// Process a Python class definition
-signature_node_t* process_python_class(TSNode node, const char* source_code) {
+signature_node_t* extract_python_class(extract_state_t* state, TSNode node) {
     TSNode name_node = ts_node_child_by_field_name(node, "name", 4);
     if (ts_node_is_null(name_node)) {
         return NULL;
     }
     
-    char* name = get_node_text(name_node, source_code);
-    char* signature = get_python_class_signature(node, source_code);
-    
-    TSPoint start_point = ts_node_start_point(node);
-    TSPoint end_point = ts_node_end_point(node);
-    
-    signature_node_t* sig_node = create_signature_node(
-        ENTITY_CLASS, name, signature,
-        start_point.row + 1, start_point.column + 1,
-        end_point.row + 1, end_point.column + 1
-    );
-    
-    if (name) free(name);
-    if (signature) free(signature);
-    
-    return sig_node;
+    signature_builder_reset(&state->scratch);
+    append_python_class_signature(&state->scratch, node);
+    return create_entity_node(state, ENTITY_CLASS, node, name_node);
 }
 
-// Process a Python function definition
-signature_node_t* process_python_function(TSNode node, const char* source_code) {
+signature_node_t* extract_python_function(extract_state_t* state, TSNode node) {
     TSNode name_node = ts_node_child_by_field_name(node, "name", 4);
     if (ts_node_is_null(name_node)) {
         return NULL;
     }
     
-    char* name = get_node_text(name_node, source_code);
-    char* signature = get_python_function_signature(node, source_code);
-    
-    TSPoint start_point = ts_node_start_point(node);
-    TSPoint end_point = ts_node_end_point(node);
-    
     // Check if it's a main function (__main__ check would be at module level)
-    entity_type_t type = ENTITY_FUNCTION;
-    
-    signature_node_t* sig_node = create_signature_node(
-        type, name, signature,
-        start_point.row + 1, start_point.column + 1,
-        end_point.row + 1, end_point.column + 1
-    );
+    signature_builder_reset(&state->scratch);
+    append_python_function_signature(&state->scratch, node);
+    return create_entity_node(state, ENTITY_FUNCTION, node, name_node);
+}
+
+// Query-based extraction, the parts come from the captures of one definition
+signature_node_t* query_python_class(extract_state_t* state, TSNode node, const TSNode* parts) {
+    if (ts_node_is_null(parts[QUERY_PART_NAME])) {
+        return NULL;
+    }
     
-    if (name) free(name);
-    if (signature) free(signature);
+    signature_builder_reset(&state->scratch);
+    append_python_class_parts(&state->scratch, parts);
+    return create_entity_node(state, ENTITY_CLASS, node, parts[QUERY_PART_NAME]);
+}
+
+signature_node_t* query_python_function(extract_state_t* state, TSNode node, const TSNode* parts) {
+    if (ts_node_is_null(parts[QUERY_PART_NAME])) {
+        return NULL;
+    }
     
+    signature_builder_reset(&state->scratch);
+    append_python_function_parts(&state->scratch, parts);
+    return create_entity_node(state, ENTITY_FUNCTION, node, parts[QUERY_PART_NAME]);
+}
+
+// Process a Python class definition
+signature_node_t* process_python_class(TSNode node, const char* source_code) {
+    extract_state_t state;
+    extract_state_init(&state, source_code, NULL);
+    signature_node_t* sig_node = extract_python_class(&state, node);
+    extract_state_finish(&state);
+    return sig_node;
+}
+
+// Process a Python function definition
+signature_node_t* process_python_function(TSNode node, const char* source_code) {
+    extract_state_t state;
+    extract_state_init(&state, source_code, NULL);
+    signature_node_t* sig_node = extract_python_function(&state, node);
+    extract_state_finish(&state);
     return sig_node;
 }
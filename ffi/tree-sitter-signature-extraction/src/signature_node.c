@@ -3,25 +3,191 @@
 signature_node_t* create_signature_node(entity_type_t type, const char* name, 
                                        const char* signature, int start_line, 
                                        int start_column, int end_line, int end_column) {
-    signature_node_t* node = (signature_node_t*)malloc(sizeof(signature_node_t));
+    return create_signature_node_in(NULL, type,
+                                    name, name ? strlen(name) : 0,
+                                    signature, signature ? strlen(signature) : 0,
+                                    start_line, start_column, end_line, end_column);
+}
+
+signature_node_t* create_signature_node_in(arena_t* arena, entity_type_t type,
+                                           const char* name, size_t name_length,
+                                           const char* signature, size_t signature_length,
+                                           int start_line, int start_column, int end_line, int end_column) {
+    signature_node_t* node = (signature_node_t*)arena_alloc(arena, sizeof(signature_node_t));
     if (!node) {
         return NULL;
     }
     
     node->type = type;
-    node->name = name ? strdup(name) : NULL;
-    node->signature = signature ? strdup(signature) : NULL;
+    node->name = name ? arena_strndup(arena, name, name_length) : NULL;
+    node->signature = signature ? arena_strndup(arena, signature, signature_length) : NULL;
     node->start_line = start_line;
     node->start_column = start_column;
     node->end_line = end_line;
     node->end_column = end_column;
+    node->start_byte = 0;
+    node->end_byte = 0;
+    node->source = NULL;
+    node->name_slice.offset = 0;
+    node->name_slice.length = 0;
+    node->parts = NULL;
+    node->part_count = 0;
     node->parent = NULL;
     node->children = NULL;
+    node->last_child = NULL;
     node->next_sibling = NULL;
     
     return node;
 }
 
+signature_node_t* create_signature_node_sliced(arena_t* arena, entity_type_t type, const char* source,
+                                               source_slice_t name, const signature_builder_t* builder,
+                                               int start_line, int start_column, int end_line, int end_column) {
+    signature_node_t* node = create_signature_node_in(arena, type, NULL, 0, NULL, 0,
+                                                      start_line, start_column, end_line, end_column);
+    if (!node) {
+        return NULL;
+    }
+    
+    node->source = source;
+    node->name_slice = name;
+    if (builder->count > 0) {
+        node->parts = (signature_part_t*)arena_alloc(arena, sizeof(signature_part_t) * builder->count);
+        if (!node->parts) {
+            return NULL;
+        }
+        memcpy(node->parts, builder->parts, sizeof(signature_part_t) * builder->count);
+        node->part_count = builder->count;
+    }
+    return node;
+}
+
+void signature_builder_init(signature_builder_t* builder, const char* source) {
+    builder->source = source;
+    builder->parts = NULL;
+    builder->count = 0;
+    builder->capacity = 0;
+    builder->length = 0;
+}
+
+void signature_builder_reset(signature_builder_t* builder) {
+    builder->count = 0;
+    builder->length = 0;
+}
+
+void signature_builder_free(signature_builder_t* builder) {
+    free(builder->parts);
+    signature_builder_init(builder, builder->source);
+}
+
+static signature_part_t* signature_builder_next(signature_builder_t* builder) {
+    if (builder->count == builder->capacity) {
+        uint32_t capacity = builder->capacity ? builder->capacity * 2 : 8;
+        signature_part_t* parts = (signature_part_t*)realloc(builder->parts, sizeof(signature_part_t) * capacity);
+        if (!parts) {
+            return NULL;
+        }
+        builder->parts = parts;
+        builder->capacity = capacity;
+    }
+    return &builder->parts[builder->count++];
+}
+
+int signature_builder_literal(signature_builder_t* builder, const char* literal) {
+    signature_part_t* part = signature_builder_next(builder);
+    if (!part) {
+        return -1;
+    }
+    part->literal = literal;
+    part->slice.offset = 0;
+    part->slice.length = (uint32_t)strlen(literal);
+    builder->length += part->slice.length;
+    return 0;
+}
+
+int signature_builder_slice(signature_builder_t* builder, uint32_t offset, uint32_t length) {
+    if (builder->count > 0) {
+        signature_part_t* last = &builder->parts[builder->count - 1];
+        if (!last->literal && last->slice.offset + last->slice.length == offset) {
+            last->slice.length += length;
+            builder->length += length;
+            return 0;
+        }
+    }
+    signature_part_t* part = signature_builder_next(builder);
+    if (!part) {
+        return -1;
+    }
+    part->literal = NULL;
+    part->slice.offset = offset;
+    part->slice.length = length;
+    builder->length += length;
+    return 0;
+}
+
+void signature_builder_truncate(signature_builder_t* builder, uint32_t count) {
+    while (builder->count > count) {
+        builder->length -= builder->parts[--builder->count].slice.length;
+    }
+}
+
+static const char* part_text(const char* source, const signature_part_t* part) {
+    return part->literal ? part->literal : source + part->slice.offset;
+}
+
+char* signature_builder_to_string(const signature_builder_t* builder, arena_t* arena) {
+    char* text = (char*)arena_alloc(arena, builder->length + 1);
+    if (!text) {
+        return NULL;
+    }
+    char* out = text;
+    for (uint32_t i = 0; i < builder->count; i++) {
+        memcpy(out, part_text(builder->source, &builder->parts[i]), builder->parts[i].slice.length);
+        out += builder->parts[i].slice.length;
+    }
+    *out = '\0';
+    return text;
+}
+
+const char* signature_node_name(const signature_node_t* node, size_t* length) {
+    if (node->name) {
+        *length = strlen(node->name);
+        return node->name;
+    }
+    if (node->source && node->name_slice.length > 0) {
+        *length = node->name_slice.length;
+        return node->source + node->name_slice.offset;
+    }
+    *length = 0;
+    return NULL;
+}
+
+int signature_node_has_signature(const signature_node_t* node) {
+    return node->signature != NULL || node->part_count > 0;
+}
+
+size_t signature_node_signature_length(const signature_node_t* node) {
+    if (node->signature) {
+        return strlen(node->signature);
+    }
+    size_t length = 0;
+    for (uint32_t i = 0; i < node->part_count; i++) {
+        length += node->parts[i].slice.length;
+    }
+    return length;
+}
+
+void signature_node_each_piece(const signature_node_t* node, void (*fn)(const char* text, size_t length, void* arg),
+                               void* arg) {
+    if (node->signature) {
+        fn(node->signature, strlen(node->signature), arg);
+        return;
+    }
+    for (uint32_t i = 0; i < node->part_count; i++) {
+        fn(part_text(node->source, &node->parts[i]), node->parts[i].slice.length, arg);
+    }
+}
+
 void free_signature_node(signature_node_t* node) {
     if (!node) {
         return;
@@ -58,13 +224,9 @@ void add_child_signature_node(signature_node_t* parent, signature_node_t* child)
         // No children yet, make this the first child
         parent->children = child;
     } else {
-        // Find the last child and add this as the next sibling
-        signature_node_t* last_child = parent->children;
-        while (last_child->next_sibling) {
-            last_child = last_child->next_sibling;
-        }
-        last_child->next_sibling = child;
+        parent->last_child->next_sibling = child;
     }
+    parent->last_child = child;
 }
 
 const char* entity_type_to_string(entity_type_t type) {
@@ -114,13 +276,19 @@ void print_signature_node(signature_node_t* node, int indent) {
         printf("  ");
     }
     
-    printf("\"name\": \"%s\",\n", node->name ? node->name : "");
+    size_t name_length;
+    const char* name = signature_node_name(node, &name_length);
+    printf("\"name\": \"%.*s\",\n", (int)name_length, name ? name : "");
     
     for (int i = 0; i < indent + 1; i++) {
         printf("  ");
     }
     
-    printf("\"signature\": \"%s\",\n", node->signature ? node->signature : "");
+    printf("\"signature\": \"");
+    for (uint32_t i = 0; node->signature == NULL && i < node->part_count; i++) {
+        printf("%.*s", (int)node->parts[i].slice.length, part_text(node->source, &node->parts[i]));
+    }
+    printf("%s\",\n", node->signature ? node->signature : "");
     
     for (int i = 0; i < indent + 1; i++) {
         printf("  ");
@@ -4,7 +4,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include "dll_export.h"
+#include "arena.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -32,6 +34,18 @@ typedef struct {
     char* code_below_error_line;
 } parse_error_t;
 
+// Byte range of a source buffer
+typedef struct {
+    uint32_t offset;
+    uint32_t length;
+} source_slice_t;
+
+// One piece of a signature: a static literal, or a slice of the source if literal is NULL
+typedef struct {
+    const char* literal;
+    source_slice_t slice;
+} signature_part_t;
+
 // Forward declaration
 typedef struct signature_node signature_node_t;
 
@@ -44,8 +58,15 @@ typedef struct signature_node {
     int start_column;                // Starting column number
     int end_line;                    // Ending line number
     int end_column;                  // Ending column number
+    uint32_t start_byte;             // Starting byte offset in the source
+    uint32_t end_byte;               // Ending byte offset in the source
+    const char* source;              // Source the slices point into, NULL if name and signature are strings
+    source_slice_t name_slice;       // Name as a slice of source, when name is NULL
+    signature_part_t* parts;         // Signature assembled at print time, when signature is NULL
+    uint32_t part_count;             // Number of signature parts
     signature_node_t* parent;        // Pointer to parent node
     signature_node_t* children;      // Pointer to first child node
+    signature_node_t* last_child;    // Pointer to last child node, so appending takes constant time
     signature_node_t* next_sibling;  // Pointer to next sibling node
 } signature_node_t;
 
@@ -64,6 +85,114 @@ DLL_EXPORT signature_node_t* create_signature_node(entity_type_t type, const cha
                                        const char* signature, int start_line, 
                                        int start_column, int end_line, int end_column);
 
+/**
+ * Create a signature node whose strings are copied from slices of known length
+ * @param arena Arena the node and its strings come from, or NULL for the heap
+ * @param type Entity type
+ * @param name Entity name, may be NULL
+ * @param name_length Length of the name
+ * @param signature Full signature, may be NULL
+ * @param signature_length Length of the signature
+ * @param start_line Starting line number
+ * @param start_column Starting column number
+ * @param end_line Ending line number
+ * @param end_column Ending column number
+ * @return Pointer to the new signature node, only to be passed to free_signature_node if arena is NULL
+ */
+signature_node_t* create_signature_node_in(arena_t* arena, entity_type_t type,
+                                           const char* name, size_t name_length,
+                                           const char* signature, size_t signature_length,
+                                           int start_line, int start_column, int end_line, int end_column);
+
+// Signature being assembled from literals and slices of a source buffer
+typedef struct {
+    const char* source;              // Source the slices point into
+    signature_part_t* parts;         // Parts so far
+    uint32_t count;                  // Number of parts
+    uint32_t capacity;               // Allocated number of parts
+    size_t length;                   // Total length of the parts in bytes
+} signature_builder_t;
+
+void signature_builder_init(signature_builder_t* builder, const char* source);
+void signature_builder_reset(signature_builder_t* builder);
+void signature_builder_free(signature_builder_t* builder);
+
+/**
+ * Append a literal, which must outlive every node built from the parts (a string constant)
+ * @param builder Builder
+ * @param literal Static string
+ * @return 0 on success, -1 on allocation failure
+ */
+int signature_builder_literal(signature_builder_t* builder, const char* literal);
+
+/**
+ * Append a slice of the source, merged with the previous part when contiguous
+ * @param builder Builder
+ * @param offset Offset of the slice in the source
+ * @param length Length of the slice
+ * @return 0 on success, -1 on allocation failure
+ */
+int signature_builder_slice(signature_builder_t* builder, uint32_t offset, uint32_t length);
+
+// Drop the parts appended after count parts had been appended
+void signature_builder_truncate(signature_builder_t* builder, uint32_t count);
+
+/**
+ * Concatenate the parts into a string
+ * @param builder Builder
+ * @param arena Arena of the string, or NULL for the heap
+ * @return NUL-terminated signature, or NULL on allocation failure
+ */
+char* signature_builder_to_string(const signature_builder_t* builder, arena_t* arena);
+
+/**
+ * Create a signature node whose name and signature are slices of a source buffer
+ * @param arena Arena the node and its parts come from
+ * @param type Entity type
+ * @param source Source buffer, which must outlive the node
+ * @param name Name of the entity as a slice of source
+ * @param builder Parts of the signature, copied into the arena
+ * @param start_line Starting line number
+ * @param start_column Starting column number
+ * @param end_line Ending line number
+ * @param end_column Ending column number
+ * @return Pointer to the new signature node, or NULL on allocation failure
+ */
+signature_node_t* create_signature_node_sliced(arena_t* arena, entity_type_t type, const char* source,
+                                               source_slice_t name, const signature_builder_t* builder,
+                                               int start_line, int start_column, int end_line, int end_column);
+
+/**
+ * Get the name of a node whether it is a string or a slice
+ * @param node Node
+ * @param length Output length of the name
+ * @return Name, not NUL-terminated for slices, or NULL if the node has none
+ */
+const char* signature_node_name(const signature_node_t* node, size_t* length);
+
+/**
+ * Whether a node has a signature to print
+ * @param node Node
+ * @return Non-zero if the node has a signature
+ */
+int signature_node_has_signature(const signature_node_t* node);
+
+/**
+ * Get the length of the signature of a node
+ * @param node Node
+ * @return Length in bytes
+ */
+size_t signature_node_signature_length(const signature_node_t* node);
+
+/**
+ * Call a function on each piece of the signature of a node, in order
+ * @param node Node
+ * @param fn Function receiving each piece and its length
+ * @param arg Argument passed to fn
+ */
+void signature_node_each_piece(const signature_node_t* node, void (*fn)(const char* text, size_t length, void* arg),
+                               void* arg);
+
 /**
  * Free a signature node and all its descendants
  * @param node Node to free
@@ -0,0 +1,255 @@
+#include "signature_extractor.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A declaration captured by a query match, with at most one of its parts
+typedef struct {
+    TSNode node;                     // Declaration
+    uint32_t start_byte;
+    uint32_t end_byte;
+    uint8_t kind;                    // node_kind_t of the declaration
+    uint8_t part;                    // query_part_t of part_node, QUERY_PART_COUNT if none
+    TSNode part_node;
+} query_hit_t;
+
+// A declaration whose signature node may still receive children
+typedef struct {
+    signature_node_t* sig_node;
+    uint32_t start_byte;
+    uint32_t end_byte;
+} open_entity_t;
+
+// Use signature queries instead of walking the tree for later extractions
+static volatile int signature_query_mode = 0;
+
+void set_signature_query_mode(int enabled) {
+    signature_query_mode = enabled != 0;
+}
+
+int get_signature_query_mode(void) {
+    return signature_query_mode;
+}
+
+// Order hits as a preorder walk would meet their declarations, the hits of one declaration adjacent
+static int compare_hits(const void* a, const void* b) {
+    const query_hit_t* x = (const query_hit_t*)a;
+    const query_hit_t* y = (const query_hit_t*)b;
+    if (x->start_byte != y->start_byte) {
+        return x->start_byte < y->start_byte ? -1 : 1;
+    }
+    if (x->end_byte != y->end_byte) {
+        return x->end_byte > y->end_byte ? -1 : 1;
+    }
+    if (x->node.id != y->node.id) {
+        return (uintptr_t)x->node.id < (uintptr_t)y->node.id ? -1 : 1;
+    }
+    return 0;
+}
+
+// Run the query and collect one hit per match, in the order of compare_hits
+static int collect_hits(const language_table_t* table, TSNode node, int start_line, int end_line,
+                        query_hit_t** hits_out, size_t* count) {
+    *hits_out = NULL;
+    *count = 0;
+    TSQueryCursor* cursor = ts_query_cursor_new();
+    if (!cursor) {
+        return -1;
+    }
+    if (start_line > 0 && end_line >= start_line) {
+        // Whole lines, so a window never splits a declaration header
+        TSPoint start = { (uint32_t)start_line - 1, 0 };
+        TSPoint end = { (uint32_t)end_line, 0 };
+        ts_query_cursor_set_point_range(cursor, start, end);
+    }
+    ts_query_cursor_exec(cursor, table->query, node);
+
+    query_hit_t* hits = NULL;
+    size_t capacity = 0;
+    int failed = 0;
+    TSQueryMatch match;
+    while (ts_query_cursor_next_match(cursor, &match)) {
+        query_hit_t hit = { .part = QUERY_PART_COUNT };
+        for (uint16_t i = 0; i < match.capture_count; i++) {
+            const TSQueryCapture* capture = &match.captures[i];
+            if (table->capture_kinds[capture->index] != NODE_KIND_OTHER) {
+                hit.node = capture->node;
+                hit.kind = table->capture_kinds[capture->index];
+            } else if (table->capture_parts[capture->index] != QUERY_PART_COUNT) {
+                hit.part = table->capture_parts[capture->index];
+                hit.part_node = capture->node;
+            }
+        }
+        if (ts_node_is_null(hit.node)) {
+            continue;
+        }
+        if (*count == capacity) {
+            size_t grown = capacity ? capacity * 2 : 64;
+            query_hit_t* resized = (query_hit_t*)realloc(hits, grown * sizeof(query_hit_t));
+            if (!resized) {
+                failed = 1;
+                break;
+            }
+            hits = resized;
+            capacity = grown;
+        }
+        hit.start_byte = ts_node_start_byte(hit.node);
+        hit.end_byte = ts_node_end_byte(hit.node);
+        hits[(*count)++] = hit;
+    }
+    ts_query_cursor_delete(cursor);
+    STATS_ADD(STATS_NODES_VISITED, *count);
+
+    if (failed) {
+        free(hits);
+        *count = 0;
+        return -1;
+    }
+    if (*count > 1) {
+        qsort(hits, *count, sizeof(query_hit_t), compare_hits);
+    }
+    *hits_out = hits;
+    return 0;
+}
+
+// Attach a signature node under the innermost open declaration containing it
+static void add_nested(open_entity_t* stack, size_t* depth, signature_node_t* parent,
+                       signature_node_t* sig_node, uint32_t start_byte, uint32_t end_byte) {
+    while (*depth > 0 && !(stack[*depth - 1].start_byte <= start_byte && end_byte <= stack[*depth - 1].end_byte)) {
+        (*depth)--;
+    }
+    add_child_signature_node(*depth > 0 ? stack[*depth - 1].sig_node : parent, sig_node);
+    stack[*depth].sig_node = sig_node;
+    stack[*depth].start_byte = start_byte;
+    stack[*depth].end_byte = end_byte;
+    (*depth)++;
+}
+
+// Count the declarations enclosing the first line of a window, their headers lie before it
+static size_t enclosing_declarations(extract_state_t* state, TSNode node, int start_line,
+                                     TSNode* ancestors, size_t capacity) {
+    if (start_line <= 1) {
+        return 0;
+    }
+    TSPoint point = { (uint32_t)start_line - 1, 0 };
+    size_t count = 0;
+    TSNode current = ts_node_descendant_for_point_range(node, point, point);
+    while (!ts_node_is_null(current) && count < capacity) {
+        if (state->table->extract[language_table_kind(state->table, current)]) {
+            ancestors[count++] = current;
+        }
+        if (ts_node_eq(current, node)) {
+            break;
+        }
+        current = ts_node_parent(current);
+    }
+    return count;
+}
+
+int query_and_extract(extract_state_t* state, TSNode node, int start_line, int end_line, signature_node_t* parent) {
+    // Queries cannot tell function bodies apart, skipping them is left to the walk
+    if (!state->table || state->body_mode == EXTRACT_BODIES_SKIP || !language_table_query(state->table)) {
+        return -1;
+    }
+
+    query_hit_t* hits;
+    size_t count;
+    if (collect_hits(state->table, node, start_line, end_line, &hits, &count) != 0) {
+        return -1;
+    }
+
+    // The stack holds the enclosing declarations found outside the window and every hit group at worst
+    TSNode ancestors[64];
+    size_t ancestor_count = enclosing_declarations(state, node, start_line, ancestors, 64);
+    open_entity_t* stack = (open_entity_t*)malloc((count + ancestor_count + 1) * sizeof(open_entity_t));
+    if (!stack) {
+        free(hits);
+        return -1;
+    }
+    size_t depth = 0;
+
+    // A window inside a declaration misses the captures of its header, build it by hand
+    for (size_t i = ancestor_count; i-- > 0;) {
+        signature_node_t* sig_node = extract_node_signature(state, ancestors[i]);
+        if (sig_node) {
+            add_nested(stack, &depth, parent, sig_node,
+                       ts_node_start_byte(ancestors[i]), ts_node_end_byte(ancestors[i]));
+        }
+    }
+
+    size_t i = 0;
+    while (i < count) {
+        // Gather the parts of one declaration
+        TSNode parts[QUERY_PART_COUNT];
+        memset(parts, 0, sizeof(parts));
+        size_t end = i;
+        while (end < count && hits[end].node.id == hits[i].node.id) {
+            if (hits[end].part != QUERY_PART_COUNT) {
+                parts[hits[end].part] = hits[end].part_node;
+            }
+            end++;
+        }
+
+        int enclosing = 0;
+        for (size_t a = 0; a < ancestor_count; a++) {
+            enclosing |= ts_node_eq(ancestors[a], hits[i].node);
+        }
+        entity_query_fn extract = state->table->query_extract[hits[i].kind];
+        signature_node_t* sig_node = !enclosing && extract ? extract(state, hits[i].node, parts) : NULL;
+        if (sig_node) {
+            add_nested(stack, &depth, parent, sig_node, hits[i].start_byte, hits[i].end_byte);
+        }
+        i = end;
+    }
+
+    free(stack);
+    free(hits);
+    return 0;
+}
+
+signature_node_t* extract_signatures_in_lines(TSTree* tree, const char* source_code, const char* language,
+                                              int start_line, int end_line) {
+    if (!tree || !source_code || !language) {
+        return NULL;
+    }
+    TSNode root = ts_tree_root_node(tree);
+    if (start_line <= 0 || end_line < start_line) {
+        return extract_signatures_in_node(root, source_code, language, NULL);
+    }
+
+    signature_node_t* root_container = create_signature_node_in(NULL, ENTITY_UNKNOWN, "root", 4, "root", 4, 0, 0, 0, 0);
+    if (!root_container) {
+        return NULL;
+    }
+    extract_state_t state;
+    extract_state_init(&state, source_code, NULL);
+    extract_state_set_language(&state, language);
+    int status = query_and_extract(&state, root, start_line, end_line, root_container);
+    extract_state_finish(&state);
+
+    if (status != 0) {
+        // No query for the language, walk everything and keep what overlaps
+        signature_node_t* all = extract_signatures_in_node(root, source_code, language, NULL);
+        while (all) {
+            signature_node_t* next = all->next_sibling;
+            all->next_sibling = NULL;
+            signature_node_t* clone = clone_signature_node_with_range(all, start_line, end_line);
+            if (clone) {
+                add_child_signature_node(root_container, clone);
+            }
+            free_signature_node(all);
+            all = next;
+        }
+    }
+
+    // Return the children of the dummy root, as extract_signatures_in_node does
+    signature_node_t* result = root_container->children;
+    root_container->children = NULL;
+    root_container->last_child = NULL;
+    for (signature_node_t* child = result; child; child = child->next_sibling) {
+        child->parent = NULL;
+    }
+    free_signature_node(root_container);
+    return result;
+}
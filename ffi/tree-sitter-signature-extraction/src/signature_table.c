@@ -0,0 +1,220 @@
+#include "signature_table.h"
+#include "parsed_file.h"
+#include "extractor_stats.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// One walk over the entities of a range, counting them and their text, then again filling the table
+typedef struct {
+    signature_table_t* table;        // Table being filled, NULL while counting
+    char* text;                      // Text of the table being filled
+    uint32_t count;                  // Entities so far
+    size_t text_length;              // Bytes of text so far
+    int start_line;
+    int end_line;
+} table_builder_t;
+
+static void copy_piece(const char* text, size_t length, void* arg) {
+    table_builder_t* builder = (table_builder_t*)arg;
+    memcpy(builder->text + builder->text_length, text, length);
+    builder->text_length += length;
+}
+
+// Append a NUL-terminated string to the text of the table
+static source_slice_t add_text(table_builder_t* builder, const char* text, size_t length) {
+    source_slice_t slice = { (uint32_t)builder->text_length, (uint32_t)length };
+    copy_piece(text, length, builder);
+    builder->text[builder->text_length++] = '\0';
+    return slice;
+}
+
+// Add an entity after the entity previous of the same parent, -1 if it is the first child
+static int32_t add_entity(table_builder_t* builder, const signature_node_t* node, int32_t parent, int32_t previous) {
+    int32_t id = (int32_t)builder->count++;
+    size_t name_length = 0;
+    const char* name = signature_node_name(node, &name_length);
+    if (!name) {
+        name = "";
+        name_length = 0;
+    }
+
+    signature_table_t* table = builder->table;
+    if (!table) {
+        builder->text_length += name_length + signature_node_signature_length(node) + 2;
+        return id;
+    }
+
+    table->types[id] = (uint8_t)node->type;
+    table->start_lines[id] = node->start_line;
+    table->start_columns[id] = node->start_column;
+    table->end_lines[id] = node->end_line;
+    table->end_columns[id] = node->end_column;
+    table->parents[id] = parent;
+    table->first_children[id] = -1;
+    table->next_siblings[id] = -1;
+    table->depths[id] = parent >= 0 ? (uint16_t)(table->depths[parent] + 1) : 0;
+    if (previous >= 0) {
+        table->next_siblings[previous] = id;
+    } else if (parent >= 0) {
+        table->first_children[parent] = id;
+    }
+
+    table->names[id] = add_text(builder, name, name_length);
+    table->signatures[id].offset = (uint32_t)builder->text_length;
+    signature_node_each_piece(node, copy_piece, builder);
+    table->signatures[id].length = (uint32_t)(builder->text_length - table->signatures[id].offset);
+    builder->text[builder->text_length++] = '\0';
+    return id;
+}
+
+static void finish_entity(table_builder_t* builder, int32_t id) {
+    if (builder->table) {
+        builder->table->subtree_ends[id] = builder->count;
+    }
+}
+
+// Add the entities of a sibling list overlapping the range, in document order
+static void walk_forest(table_builder_t* builder, const signature_node_t* node, int32_t parent) {
+    int32_t previous = -1;
+    for (; node; node = node->next_sibling) {
+        if (node->end_line < builder->start_line || node->start_line > builder->end_line ||
+            !signature_node_has_signature(node)) {
+            continue;
+        }
+        int32_t id = add_entity(builder, node, parent, previous);
+        walk_forest(builder, node->children, id);
+        finish_entity(builder, id);
+        previous = id;
+    }
+}
+
+// Same as walk_forest, visiting only the overlapping entries of each level of the index
+static void walk_span(table_builder_t* builder, const entity_index_t* index, int32_t span_id, int32_t parent) {
+    const entity_span_t* span = &index->spans[span_id];
+    uint32_t span_end = span->first + span->count;
+    int32_t previous = -1;
+    for (uint32_t i = entity_span_lower_bound(index, span_id, builder->start_line);
+         i < span_end && index->entries[i].start_line <= builder->end_line; i++) {
+        const entity_entry_t* entry = &index->entries[i];
+        if (entry->end_line < builder->start_line || !signature_node_has_signature(entry->node)) {
+            continue;
+        }
+        int32_t id = add_entity(builder, entry->node, parent, previous);
+        if (entry->children >= 0) {
+            walk_span(builder, index, entry->children, id);
+        }
+        finish_entity(builder, id);
+        previous = id;
+    }
+}
+
+static void walk_entities(table_builder_t* builder, const signature_node_t* root, const entity_index_t* index) {
+    builder->count = 0;
+    builder->text_length = 0;
+    if (index && index->span_count > 0) {
+        walk_span(builder, index, 0, -1);
+    } else {
+        walk_forest(builder, root, -1);
+    }
+}
+
+// Reserve an array of the table block, keeping every array 8-byte aligned
+static size_t reserve(size_t* size, size_t bytes) {
+    size_t offset = *size;
+    *size += (bytes + 7) & ~(size_t)7;
+    return offset;
+}
+
+signature_table_t* signature_table_build(const signature_node_t* root, const entity_index_t* index,
+                                         int start_line, int end_line) {
+    if (start_line == -1 || end_line == -1) {
+        start_line = INT_MIN;
+        end_line = INT_MAX;
+    }
+
+    table_builder_t builder = { NULL, NULL, 0, 0, start_line, end_line };
+    walk_entities(&builder, root, index);
+    size_t count = builder.count;
+    if (builder.text_length > UINT32_MAX) {
+        fprintf(stderr, "Signature table text too large: %zu bytes\n", builder.text_length);
+        return NULL;
+    }
+
+    size_t size = 0;
+    reserve(&size, sizeof(signature_table_t));
+    size_t types = reserve(&size, count * sizeof(uint8_t));
+    size_t start_lines = reserve(&size, count * sizeof(int32_t));
+    size_t start_columns = reserve(&size, count * sizeof(int32_t));
+    size_t end_lines = reserve(&size, count * sizeof(int32_t));
+    size_t end_columns = reserve(&size, count * sizeof(int32_t));
+    size_t parents = reserve(&size, count * sizeof(int32_t));
+    size_t first_children = reserve(&size, count * sizeof(int32_t));
+    size_t next_siblings = reserve(&size, count * sizeof(int32_t));
+    size_t subtree_ends = reserve(&size, count * sizeof(uint32_t));
+    size_t depths = reserve(&size, count * sizeof(uint16_t));
+    size_t names = reserve(&size, count * sizeof(source_slice_t));
+    size_t signatures = reserve(&size, count * sizeof(source_slice_t));
+    size_t text = reserve(&size, builder.text_length);
+
+    char* block = (char*)malloc(size);
+    if (!block) {
+        return NULL;
+    }
+    signature_table_t* table = (signature_table_t*)block;
+    table->count = (uint32_t)count;
+    table->types = (uint8_t*)(block + types);
+    table->start_lines = (int32_t*)(block + start_lines);
+    table->start_columns = (int32_t*)(block + start_columns);
+    table->end_lines = (int32_t*)(block + end_lines);
+    table->end_columns = (int32_t*)(block + end_columns);
+    table->parents = (int32_t*)(block + parents);
+    table->first_children = (int32_t*)(block + first_children);
+    table->next_siblings = (int32_t*)(block + next_siblings);
+    table->subtree_ends = (uint32_t*)(block + subtree_ends);
+    table->depths = (uint16_t*)(block + depths);
+    table->names = (source_slice_t*)(block + names);
+    table->signatures = (source_slice_t*)(block + signatures);
+    table->text = block + text;
+    table->text_length = builder.text_length;
+    table->size = size;
+
+    builder.table = table;
+    builder.text = block + text;
+    walk_entities(&builder, root, index);
+    return table;
+}
+
+signature_table_t* get_signature_table(const char* filename, const char* language, int start_line, int end_line) {
+    return ctx_get_signature_table(extractor_ctx_default(), filename, language, start_line, end_line);
+}
+
+signature_table_t* ctx_get_signature_table(extractor_ctx_t* ctx, const char* filename, const char* language,
+                                           int start_line, int end_line) {
+    extractor_language_t lang = extractor_language_from_name(language);
+    if (lang == EXTRACTOR_LANG_UNKNOWN) {
+        fprintf(stderr, "Unsupported language: %s\n", language ? language : "(null)");
+        return NULL;
+    }
+
+    parsed_file_t* file = extractor_ctx_acquire_file(ctx, filename, lang);
+    if (!file) {
+        return NULL;
+    }
+
+    STATS_PHASE_BEGIN(render);
+    signature_table_t* table = signature_table_build(file->forest, file->entities, start_line, end_line);
+    STATS_PHASE_END(STATS_PHASE_RENDER, render);
+    if (table) {
+        STATS_ADD(STATS_OUTPUT_BYTES, table->size);
+    }
+
+    extractor_ctx_release_file(ctx, file);
+    return table;
+}
+
+void free_signature_table(signature_table_t* table) {
+    free(table);
+}
@@ -0,0 +1,73 @@
+#ifndef SIGNATURE_TABLE_H
+#define SIGNATURE_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "dll_export.h"
+#include "signature_node.h"
+#include "entity_index.h"
+#include "extractor_context.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A signature forest as parallel arrays, one element per entity in pre-order (document order),
+// so a subtree is the contiguous run from an entity to its subtree_end. Everything lives in one
+// allocation that callers read in place; links are entity indices, -1 where there is none.
+typedef struct {
+    uint32_t count;                  // Number of entities
+    uint8_t* types;                  // entity_type_t of each entity
+    int32_t* start_lines;
+    int32_t* start_columns;
+    int32_t* end_lines;
+    int32_t* end_columns;
+    int32_t* parents;                // Parent entity, -1 at top level
+    int32_t* first_children;         // First child, -1 if there are none
+    int32_t* next_siblings;          // Next sibling, -1 for the last one
+    uint32_t* subtree_ends;          // One past the last descendant
+    uint16_t* depths;                // Nesting depth, 0 at top level
+    source_slice_t* names;           // Name of each entity in text, empty if it has none
+    source_slice_t* signatures;      // Signature of each entity in text
+    const char* text;                // Names and signatures, each followed by a NUL
+    size_t text_length;              // Length of text including the NULs
+    size_t size;                     // Bytes of the whole allocation
+} signature_table_t;
+
+/**
+ * Flatten the entities of a forest overlapping a line range. Entities without a signature are
+ * left out with their descendants, as in the skeleton.
+ * @param root Top-level signature nodes
+ * @param index Interval index of the forest, or NULL to walk the forest
+ * @param start_line First line of the range, or -1 for the whole file
+ * @param end_line Last line of the range, or -1 for the whole file
+ * @return New table to be freed with free_signature_table, or NULL on allocation failure
+ */
+signature_table_t* signature_table_build(const signature_node_t* root, const entity_index_t* index,
+                                         int start_line, int end_line);
+
+/**
+ * Get the signature table of a file, from the skeleton cache when possible
+ * @param filename Path of the file
+ * @param language Language of the file
+ * @param start_line First line of the range, or -1 for the whole file
+ * @param end_line Last line of the range, or -1 for the whole file
+ * @return New table to be freed with free_signature_table, or NULL on failure
+ */
+DLL_EXPORT signature_table_t* get_signature_table(const char* filename, const char* language,
+                                                  int start_line, int end_line);
+
+DLL_EXPORT signature_table_t* ctx_get_signature_table(extractor_ctx_t* ctx, const char* filename,
+                                                      const char* language, int start_line, int end_line);
+
+/**
+ * Free a signature table
+ * @param table Table, may be NULL
+ */
+DLL_EXPORT void free_signature_table(signature_table_t* table);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SIGNATURE_TABLE_H
@@ -0,0 +1,356 @@
+#include "skeleton_batch.h"
+#include "signature_extractor.h"
+#include "extractor_context.h"
+#include "skeleton_service.h"
+#include "platform.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Work shared by the stages of one batch
+typedef struct {
+    const char** paths;
+    const char** languages;
+    int count;
+    char** results;
+    uint8_t* done;                   // Whether each result is in, guarded by lock
+    platform_mutex_t lock;
+    platform_cond_t changed;         // Broadcast whenever a stage moves forward
+    int next;                        // Next file to hand out, guarded by lock
+    int prefetched;                  // Files handed to the read stage, guarded by lock
+    int finished;                    // Results in, guarded by lock
+    int written;                     // Results taken by the output stage, guarded by lock
+    int read_ahead;                  // Most files prefetched - next may reach
+    int output_ahead;                // Most files next - written may reach, 0 without an output stage
+    skeleton_batch_stats_t metrics;  // Guarded by lock
+    extractor_stats_t* stats;        // Stats of the calling context, guarded by lock
+} batch_job_t;
+
+static platform_mutex_t last_metrics_lock = PLATFORM_MUTEX_INITIALIZER;
+static skeleton_batch_stats_t last_metrics;
+
+static void raise_max(uint64_t* max, int value) {
+    if ((uint64_t)value > *max) {
+        *max = (uint64_t)value;
+    }
+}
+
+// Wait for the job to change, adding the time waited to a stall counter. Called with the lock held.
+static void wait_changed(batch_job_t* job, uint64_t* wait_ns) {
+    uint64_t start_ns = platform_monotonic_ns();
+    platform_cond_wait(&job->changed, &job->lock);
+    *wait_ns += platform_monotonic_ns() - start_ns;
+}
+
+// Read stage: ask for the files the workers will take next to be read ahead, no more than
+// read_ahead of them at a time
+static void prefetch_worker(void* arg) {
+    batch_job_t* job = (batch_job_t*)arg;
+    platform_mutex_lock(&job->lock);
+    for (;;) {
+        // Files the workers already took are not worth reading ahead
+        if (job->prefetched < job->next) {
+            job->prefetched = job->next;
+        }
+        if (job->prefetched >= job->count) {
+            break;
+        }
+        if (job->prefetched - job->next >= job->read_ahead) {
+            wait_changed(job, &job->metrics.read_wait_ns);
+            continue;
+        }
+        int index = job->prefetched++;
+        platform_mutex_unlock(&job->lock);
+
+        int prefetched = job->paths[index] && platform_file_prefetch(job->paths[index]) == 0;
+
+        platform_mutex_lock(&job->lock);
+        if (prefetched) {
+            job->metrics.prefetched++;
+        }
+        raise_max(&job->metrics.max_read_depth, job->prefetched - job->next);
+    }
+    platform_mutex_unlock(&job->lock);
+}
+
+static int next_file(batch_job_t* job) {
+    platform_mutex_lock(&job->lock);
+    while (job->output_ahead > 0 && job->next < job->count && job->next - job->written >= job->output_ahead) {
+        wait_changed(job, &job->metrics.parse_wait_ns);
+    }
+    int index = job->next < job->count ? job->next++ : -1;
+    if (index >= 0) {
+        raise_max(&job->metrics.max_parse_depth, job->next - job->finished);
+        platform_cond_broadcast(&job->changed);
+    }
+    platform_mutex_unlock(&job->lock);
+    return index;
+}
+
+static void finish_file(batch_job_t* job, int index, char* result) {
+    platform_mutex_lock(&job->lock);
+    job->results[index] = result;
+    job->done[index] = 1;
+    job->finished++;
+    if (job->output_ahead > 0) {
+        raise_max(&job->metrics.max_output_depth, job->finished - job->written);
+    }
+    platform_cond_broadcast(&job->changed);
+    platform_mutex_unlock(&job->lock);
+}
+
+static void batch_worker(void* arg) {
+    batch_job_t* job = (batch_job_t*)arg;
+    extractor_ctx_t* ctx = extractor_ctx_create();
+    if (!ctx) {
+        return;
+    }
+
+    int index;
+    while ((index = next_file(job)) >= 0) {
+        const char* path = job->paths[index];
+        char* result = NULL;
+        if (path) {
+            const char* language = job->languages ? job->languages[index]
+                                                 : extractor_language_name(extractor_language_from_path(path));
+            result = ctx_get_skeleton_xml_with_errors(ctx, path, language, -1, -1);
+        }
+        finish_file(job, index, result);
+    }
+
+    // What the workers did counts for the context that asked for the batch
+    extractor_stats_t* stats = extractor_ctx_stats(ctx);
+    if (stats && job->stats) {
+        platform_mutex_lock(&job->lock);
+        extractor_stats_merge(job->stats, stats);
+        platform_mutex_unlock(&job->lock);
+    }
+    extractor_ctx_destroy(ctx);
+}
+
+// Threads of a running batch
+typedef struct {
+    platform_thread_t* workers;
+    int started;
+    platform_thread_t prefetcher;
+    int prefetching;
+} batch_threads_t;
+
+static int batch_init(batch_job_t* job, const char** paths, const char** languages, int count) {
+    memset(job, 0, sizeof(batch_job_t));
+    job->paths = paths;
+    job->languages = languages;
+    job->count = count;
+    job->stats = extractor_ctx_stats(extractor_ctx_default());
+    job->metrics.files = (uint64_t)count;
+    job->results = (char**)calloc(count, sizeof(char*));
+    job->done = (uint8_t*)calloc(count, 1);
+    if (!job->results || !job->done) {
+        free(job->results);
+        free(job->done);
+        return -1;
+    }
+    platform_mutex_init(&job->lock);
+    platform_cond_init(&job->changed);
+    return 0;
+}
+
+// Start the read stage and the worker threads. Without an output stage the calling thread
+// is one of the workers, otherwise it is left free to write the output.
+static void batch_start(batch_job_t* job, batch_threads_t* threads, int workers, int output_stage) {
+    int spawn = output_stage ? workers : workers - 1;
+    job->read_ahead = SKELETON_BATCH_READ_AHEAD * workers;
+    job->output_ahead = output_stage ? SKELETON_BATCH_OUTPUT_AHEAD * workers : 0;
+    threads->prefetching = platform_thread_create(&threads->prefetcher, prefetch_worker, job) == 0;
+    threads->started = 0;
+    threads->workers = spawn > 0 ? (platform_thread_t*)malloc(sizeof(platform_thread_t) * spawn) : NULL;
+    for (int i = 0; threads->workers && i < spawn; i++) {
+        if (platform_thread_create(&threads->workers[threads->started], batch_worker, job) != 0) {
+            break;
+        }
+        threads->started++;
+    }
+    if (output_stage && threads->started == 0) {
+        // Nobody else parses, so the calling thread does it all before writing anything
+        platform_mutex_lock(&job->lock);
+        job->output_ahead = 0;
+        platform_mutex_unlock(&job->lock);
+        batch_worker(job);
+    }
+}
+
+static void batch_join(batch_job_t* job, batch_threads_t* threads) {
+    for (int i = 0; i < threads->started; i++) {
+        platform_thread_join(threads->workers[i]);
+    }
+    free(threads->workers);
+    if (threads->prefetching) {
+        platform_thread_join(threads->prefetcher);
+    }
+
+    // A calling worker left its own context active
+    extractor_ctx_stats(extractor_ctx_default());
+    platform_mutex_lock(&last_metrics_lock);
+    last_metrics = job->metrics;
+    platform_mutex_unlock(&last_metrics_lock);
+    platform_cond_destroy(&job->changed);
+    platform_mutex_destroy(&job->lock);
+    free(job->done);
+}
+
+static int worker_count(int threads, int count) {
+    if (threads <= 0) {
+        threads = platform_cpu_count();
+    }
+    return threads > count ? count : threads;
+}
+
+// Extract skeletons on a pool of workers, the calling thread being one of them, so the batch
+// completes even if no thread starts
+static char** run_batch(const char** paths, const char** languages, int count, int threads) {
+    batch_job_t job;
+    if (batch_init(&job, paths, languages, count) != 0) {
+        return NULL;
+    }
+    batch_threads_t pool;
+    batch_start(&job, &pool, worker_count(threads, count), 0);
+    batch_worker(&job);
+    batch_join(&job, &pool);
+    return job.results;
+}
+
+// Extract in process the skeletons the service failed to produce or was not sent, as a batch
+// of their own so they still spread over the workers
+static void fill_unserved(const char** paths, const char** languages, int count, int threads, char** served) {
+    int missing = 0;
+    for (int i = 0; i < count; i++) {
+        missing += !served[i] && paths[i];
+    }
+    if (missing == 0) {
+        return;
+    }
+
+    int* indices = (int*)malloc(sizeof(int) * missing);
+    const char** missing_paths = (const char**)malloc(sizeof(char*) * missing);
+    const char** missing_languages = languages ? (const char**)malloc(sizeof(char*) * missing) : NULL;
+    char** results = NULL;
+    if (indices && missing_paths && (!languages || missing_languages)) {
+        int n = 0;
+        for (int i = 0; i < count; i++) {
+            if (!served[i] && paths[i]) {
+                indices[n] = i;
+                missing_paths[n] = paths[i];
+                if (missing_languages) {
+                    missing_languages[n] = languages[i];
+                }
+                n++;
+            }
+        }
+        results = run_batch(missing_paths, missing_languages, missing, threads);
+    }
+    for (int j = 0; results && j < missing; j++) {
+        served[indices[j]] = results[j];
+    }
+    free(results);
+    free(indices);
+    free(missing_paths);
+    free(missing_languages);
+}
+
+char** get_skeleton_xml_batch_array(const char** paths, const char** languages, int count, int threads) {
+    if (!paths || count <= 0) {
+        return NULL;
+    }
+
+    // A running skeleton service answers from its shared cache
+    char** served = (char**)calloc(count, sizeof(char*));
+    if (served && skeleton_service_batch(paths, languages, count, served) == 0) {
+        fill_unserved(paths, languages, count, threads, served);
+        return served;
+    }
+    free(served);
+    return run_batch(paths, languages, count, threads);
+}
+
+// Write one skeleton of the batch document
+static void write_batch_entry(xml_writer_t* writer, const char* path, const char* result) {
+    if (result) {
+        xml_writer_puts(writer, result);
+    } else if (path) {
+        xml_writer_puts(writer, "<code-skeleton path=\"");
+        xml_writer_escaped(writer, path, strlen(path));
+        xml_writer_puts(writer, "\" failed=\"true\"/>");
+    } else {
+        return;
+    }
+    xml_writer_write(writer, "\n", 1);
+}
+
+char* get_skeleton_xml_batch(const char** paths, const char** languages, int count, int threads) {
+    if (!paths && count > 0) {
+        return NULL;
+    }
+
+    xml_writer_t writer;
+    xml_writer_init(&writer, 0);
+    xml_writer_puts(&writer, "<code-skeletons>\n");
+    char** served = count > 0 ? (char**)calloc(count, sizeof(char*)) : NULL;
+    if (served && skeleton_service_batch(paths, languages, count, served) == 0) {
+        fill_unserved(paths, languages, count, threads, served);
+        for (int i = 0; i < count; i++) {
+            write_batch_entry(&writer, paths[i], served[i]);
+        }
+        free_skeleton_xml_batch(served, count);
+    } else if (count > 0) {
+        free(served);
+        batch_job_t job;
+        if (batch_init(&job, paths, languages, count) != 0) {
+            free(xml_writer_finish(&writer));
+            return NULL;
+        }
+
+        // The calling thread is the output stage, writing each skeleton as soon as the ones
+        // before it are written, so only the skeletons in flight are held at once
+        batch_threads_t pool;
+        batch_start(&job, &pool, worker_count(threads, count), 1);
+        for (int i = 0; i < count; i++) {
+            platform_mutex_lock(&job.lock);
+            while (!job.done[i]) {
+                wait_changed(&job, &job.metrics.output_wait_ns);
+            }
+            char* result = job.results[i];
+            job.results[i] = NULL;
+            job.written = i + 1;
+            platform_cond_broadcast(&job.changed);
+            platform_mutex_unlock(&job.lock);
+
+            write_batch_entry(&writer, paths[i], result);
+            free(result);
+        }
+        batch_join(&job, &pool);
+        free(job.results);
+    }
+    xml_writer_puts(&writer, "</code-skeletons>");
+    return xml_writer_finish(&writer);
+}
+
+void get_skeleton_batch_stats(skeleton_batch_stats_t* stats) {
+    if (!stats) {
+        return;
+    }
+    platform_mutex_lock(&last_metrics_lock);
+    *stats = last_metrics;
+    platform_mutex_unlock(&last_metrics_lock);
+}
+
+void free_skeleton_xml_batch(char** results, int count) {
+    if (!results) {
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        free(results[i]);
+    }
+    free(results);
+}
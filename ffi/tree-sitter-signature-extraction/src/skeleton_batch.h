@@ -0,0 +1,73 @@
+#ifndef SKELETON_BATCH_H
+#define SKELETON_BATCH_H
+
+#include "dll_export.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Files the read stage may run ahead of the workers, and files the workers may run ahead of
+// the output stage, for each worker
+#define SKELETON_BATCH_READ_AHEAD 4
+#define SKELETON_BATCH_OUTPUT_AHEAD 4
+
+// Queue depths and stalls of the stages of the last batch. A batch runs as a pipeline: a read
+// stage asking the system to read the next files ahead, workers parsing and rendering them,
+// and for get_skeleton_xml_batch an output stage writing the skeletons in input order.
+typedef struct {
+    uint64_t files;             // Files in the batch
+    uint64_t prefetched;        // Files read ahead by the read stage
+    uint64_t max_read_depth;    // Most files read ahead and not yet taken by a worker
+    uint64_t max_parse_depth;   // Most files being parsed at once
+    uint64_t max_output_depth;  // Most skeletons finished and waiting for the output stage
+    uint64_t read_wait_ns;      // Time the read stage waited for the workers to catch up
+    uint64_t parse_wait_ns;     // Time the workers waited for the output stage to catch up
+    uint64_t output_wait_ns;    // Time the output stage waited for the next skeleton
+} skeleton_batch_stats_t;
+
+/**
+ * Get the XML skeletons of many files, spread across a pool of worker threads.
+ * Each worker keeps its own extraction context, so parsers are reused across files.
+ * @param paths Paths of the files
+ * @param languages Language of each file ("java" or "python"), or NULL to infer them from the extensions
+ * @param count Number of files
+ * @param threads Number of worker threads, or 0 for one per processor
+ * @return Array of count skeletons in input order, NULL entries for files that failed;
+ *         free with free_skeleton_xml_batch
+ */
+DLL_EXPORT char** get_skeleton_xml_batch_array(const char** paths, const char** languages, int count, int threads);
+
+/**
+ * Get the XML skeletons of many files as a single document.
+ * The skeletons are wrapped in a <code-skeletons> element in input order; a file that
+ * failed is reported as an empty <code-skeleton> element with failed="true". Skeletons are
+ * written as soon as the ones before them are, so only those in flight are held at once.
+ * @param paths Paths of the files
+ * @param languages Language of each file, or NULL to infer them from the extensions
+ * @param count Number of files
+ * @param threads Number of worker threads, or 0 for one per processor
+ * @return XML document (caller must free), or NULL on allocation failure
+ */
+DLL_EXPORT char* get_skeleton_xml_batch(const char** paths, const char** languages, int count, int threads);
+
+/**
+ * Free the result of get_skeleton_xml_batch_array
+ * @param results Array of skeletons
+ * @param count Number of entries
+ */
+DLL_EXPORT void free_skeleton_xml_batch(char** results, int count);
+
+/**
+ * Read the queue depths and stalls of the last batch that completed
+ * @param stats Output stats
+ */
+DLL_EXPORT void get_skeleton_batch_stats(skeleton_batch_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SKELETON_BATCH_H
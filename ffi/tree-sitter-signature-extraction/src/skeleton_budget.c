@@ -0,0 +1,164 @@
+#include "signature_extractor.h"
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+// An entity waiting for its turn in the budget, at the indent level it would be printed at
+typedef struct {
+    uint32_t entry;
+    int indent_level;
+} budget_item_t;
+
+// The sizes below mirror what write_skeleton_xml and print_span_in_range write
+
+static size_t int_length(int value) {
+    size_t length = value < 0 ? 2 : 1;
+    long long magnitude = value < 0 ? -(long long)value : value;
+    while (magnitude >= 10) {
+        magnitude /= 10;
+        length++;
+    }
+    return length;
+}
+
+static void count_escaped_piece(const char* text, size_t length, void* arg) {
+    *(size_t*)arg += xml_escaped_length(text, length);
+}
+
+static size_t entity_size(const signature_node_t* node, int indent_level) {
+    size_t size = (size_t)indent_level * 4 + strlen("<code-entity start=") + int_length(node->start_line) +
+                  strlen(" end=") + int_length(node->end_line) + strlen(">\n");
+    size += (size_t)(indent_level + 1) * 4 + strlen("<signature>") + strlen("</signature>\n");
+    size += (size_t)indent_level * 4 + strlen("</code-entity>\n");
+    signature_node_each_piece(node, count_escaped_piece, &size);
+    return size;
+}
+
+// The <member> element of an entity and the elision marker it may end with
+static size_t members_size(int indent_level) {
+    return (size_t)(indent_level + 1) * 4 * 2 + strlen("<member>\n") + strlen("</member>\n") +
+           SKELETON_ELIDED_SIZE(indent_level + 2);
+}
+
+static size_t error_field_size(const char* tag, const char* text) {
+    return strlen("      <") + strlen(tag) * 2 + strlen("></") + strlen(">\n") +
+           (text ? xml_escaped_length(text, strlen(text)) : 0);
+}
+
+size_t skeleton_budget_overhead(const char* filename, int start_line, int end_line,
+                                const parse_error_t* errors, int first_error, int last_error) {
+    size_t size = strlen("<code-skeleton path=\"") + strlen(SKELETON_TRUNCATED_ATTR) + strlen("\">\n") +
+                  strlen("</code-skeleton>");
+    if (filename) {
+        size += xml_escaped_length(filename, strlen(filename));
+    }
+    if (start_line != -1 && end_line != -1) {
+        size += strlen("\" range=\"") + int_length(start_line) + 1 + int_length(end_line);
+    }
+    if (last_error > first_error) {
+        size += strlen("  <code-errors>\n") + strlen("  </code-errors>\n");
+        for (int e = first_error; e < last_error; e++) {
+            const parse_error_t* error = &errors[e];
+            size += strlen("    <error line=") + int_length(error->line) + strlen(">\n") + strlen("    </error>\n");
+            size += error_field_size("message", error->message);
+            if (error->error_line) {
+                size += error_field_size("error-line", error->error_line);
+            }
+            if (error->code_above_error_line) {
+                size += error_field_size("code-above-error-line", error->code_above_error_line);
+            }
+            if (error->code_below_error_line) {
+                size += error_field_size("code-below-error-line", error->code_below_error_line);
+            }
+        }
+    }
+    return size;
+}
+
+// Whether an entry is printed for a range, as print_span_in_range decides it
+static int entry_in_range(const entity_entry_t* entry, int start_line) {
+    return entry->end_line >= start_line && signature_node_has_signature(entry->node);
+}
+
+// Whether any child of a span overlaps the range, so the parent prints a <member> element
+static int span_has_members(const entity_index_t* index, int32_t span_id, int start_line, int end_line) {
+    const entity_span_t* span = &index->spans[span_id];
+    for (uint32_t c = entity_span_lower_bound(index, span_id, start_line);
+         c < span->first + span->count && index->entries[c].start_line <= end_line; c++) {
+        if (index->entries[c].end_line >= start_line) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Queue the entries of a span overlapping the range, in document order
+static size_t enqueue_span(const entity_index_t* index, int32_t span_id, int indent_level,
+                           int start_line, int end_line, budget_item_t* queue, size_t tail) {
+    const entity_span_t* span = &index->spans[span_id];
+    for (uint32_t i = entity_span_lower_bound(index, span_id, start_line);
+         i < span->first + span->count && index->entries[i].start_line <= end_line; i++) {
+        if (entry_in_range(&index->entries[i], start_line)) {
+            queue[tail].entry = i;
+            queue[tail].indent_level = indent_level;
+            tail++;
+        }
+    }
+    return tail;
+}
+
+// Choose entities breadth first, so every entity of a level is shown before any of the next one,
+// and siblings in document order. The first entity that does not fit ends the selection, what is
+// left out of each sibling list is then a tail of it. Returns non-zero if everything fit.
+static int select_breadth_first(const entity_index_t* index, int start_line, int end_line, size_t budget,
+                                int reserve_markers, uint8_t* selected, budget_item_t* queue) {
+    size_t used = reserve_markers ? SKELETON_ELIDED_SIZE(1) : 0;
+    size_t head = 0;
+    size_t tail = index->span_count > 0 ? enqueue_span(index, 0, 1, start_line, end_line, queue, 0) : 0;
+    while (head < tail) {
+        budget_item_t item = queue[head];
+        const entity_entry_t* entry = &index->entries[item.entry];
+        int has_members = entry->children >= 0 && span_has_members(index, entry->children, start_line, end_line);
+        size_t cost = entity_size(entry->node, item.indent_level);
+        if (has_members) {
+            cost += members_size(item.indent_level) - (reserve_markers ? 0 : SKELETON_ELIDED_SIZE(item.indent_level + 2));
+        }
+        if (used + cost > budget) {
+            return 0;
+        }
+        used += cost;
+        selected[item.entry] = 1;
+        head++;
+        if (has_members) {
+            tail = enqueue_span(index, entry->children, item.indent_level + 2, start_line, end_line, queue, tail);
+        }
+    }
+    return 1;
+}
+
+uint8_t* skeleton_budget_select(const entity_index_t* index, int start_line, int end_line, size_t budget,
+                                int* truncated) {
+    if (start_line == -1 || end_line == -1) {
+        start_line = INT_MIN;
+        end_line = INT_MAX;
+    }
+    size_t count = index->entry_count ? index->entry_count : 1;
+    uint8_t* selected = (uint8_t*)calloc(count, 1);
+    budget_item_t* queue = (budget_item_t*)malloc(count * sizeof(budget_item_t));
+    if (!selected || !queue) {
+        free(selected);
+        free(queue);
+        return NULL;
+    }
+
+    // A skeleton that fits whole needs neither markers nor the truncated attribute
+    *truncated = !select_breadth_first(index, start_line, end_line, budget + strlen(SKELETON_TRUNCATED_ATTR), 0,
+                                       selected, queue);
+    if (*truncated) {
+        memset(selected, 0, count);
+        select_breadth_first(index, start_line, end_line, budget, 1, selected, queue);
+    }
+    free(queue);
+    return selected;
+}
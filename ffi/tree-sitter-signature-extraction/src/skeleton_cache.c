@@ -0,0 +1,379 @@
+#include "skeleton_cache.h"
+#include "signature_extractor.h"
+#include "skeleton_store.h"
+#include "symbol_table.h"
+#include "platform.h"
+#include "utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_BUCKET_COUNT 64
+
+// A cached file, linked into a hash bucket and the LRU list
+typedef struct cache_entry {
+    char* path;                      // Path of the file
+    extractor_language_t lang;       // Language the file was parsed as
+    int64_t mtime_ns;                // Modification time when parsed
+    uint64_t size;                   // Size when parsed
+    parsed_file_t* file;             // Parsed file, the cache holds one reference
+    struct cache_entry* hash_next;   // Next entry in the same bucket
+    struct cache_entry* lru_prev;    // More recently used entry
+    struct cache_entry* lru_next;    // Less recently used entry
+} cache_entry_t;
+
+struct skeleton_cache {
+    platform_mutex_t lock;
+    cache_entry_t** buckets;
+    size_t bucket_count;
+    cache_entry_t* lru_head;         // Most recently used
+    cache_entry_t* lru_tail;         // Least recently used
+    uint64_t budget_bytes;
+    uint64_t bytes_used;
+    uint64_t entries;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    int verify_hash;
+    int map_files;
+};
+
+static skeleton_cache_t global_cache = {
+    .lock = PLATFORM_MUTEX_INITIALIZER,
+    .budget_bytes = SKELETON_CACHE_DEFAULT_BUDGET,
+};
+
+skeleton_cache_t* skeleton_cache_global(void) {
+    return &global_cache;
+}
+
+static size_t bucket_index(const skeleton_cache_t* cache, const char* path, extractor_language_t lang) {
+    uint64_t hash = content_hash(path, strlen(path)) ^ (uint64_t)lang;
+    return (size_t)(hash & (cache->bucket_count - 1));
+}
+
+static cache_entry_t* find_entry(skeleton_cache_t* cache, const char* path, extractor_language_t lang) {
+    if (!cache->buckets) {
+        return NULL;
+    }
+    cache_entry_t* entry = cache->buckets[bucket_index(cache, path, lang)];
+    while (entry) {
+        if (entry->lang == lang && strcmp(entry->path, path) == 0) {
+            return entry;
+        }
+        entry = entry->hash_next;
+    }
+    return NULL;
+}
+
+// Drop one reference to a parsed file, called with the lock held
+static void release_locked(parsed_file_t* file) {
+    if (--file->ref_count == 0) {
+        parsed_file_free(file);
+    }
+}
+
+static void lru_unlink(skeleton_cache_t* cache, cache_entry_t* entry) {
+    if (entry->lru_prev) entry->lru_prev->lru_next = entry->lru_next;
+    else cache->lru_head = entry->lru_next;
+    if (entry->lru_next) entry->lru_next->lru_prev = entry->lru_prev;
+    else cache->lru_tail = entry->lru_prev;
+    entry->lru_prev = NULL;
+    entry->lru_next = NULL;
+}
+
+static void lru_push_front(skeleton_cache_t* cache, cache_entry_t* entry) {
+    entry->lru_prev = NULL;
+    entry->lru_next = cache->lru_head;
+    if (cache->lru_head) cache->lru_head->lru_prev = entry;
+    cache->lru_head = entry;
+    if (!cache->lru_tail) cache->lru_tail = entry;
+}
+
+// Remove an entry from the cache and drop its reference, called with the lock held
+static void remove_entry(skeleton_cache_t* cache, cache_entry_t* entry) {
+    cache_entry_t** link = &cache->buckets[bucket_index(cache, entry->path, entry->lang)];
+    while (*link && *link != entry) {
+        link = &(*link)->hash_next;
+    }
+    if (*link) {
+        *link = entry->hash_next;
+    }
+    lru_unlink(cache, entry);
+
+    cache->bytes_used -= entry->file->memory_size;
+    cache->entries--;
+    entry->file->cache = NULL;
+    release_locked(entry->file);
+    free(entry->path);
+    free(entry);
+}
+
+// Evict least recently used entries until the budget is met, keeping keep
+static void evict_locked(skeleton_cache_t* cache, cache_entry_t* keep) {
+    while (cache->bytes_used > cache->budget_bytes && cache->lru_tail && cache->lru_tail != keep) {
+        remove_entry(cache, cache->lru_tail);
+        cache->evictions++;
+    }
+}
+
+static int grow_buckets(skeleton_cache_t* cache) {
+    size_t new_count = cache->bucket_count ? cache->bucket_count * 2 : INITIAL_BUCKET_COUNT;
+    cache_entry_t** new_buckets = (cache_entry_t**)calloc(new_count, sizeof(cache_entry_t*));
+    if (!new_buckets) {
+        return -1;
+    }
+
+    cache_entry_t** old_buckets = cache->buckets;
+    size_t old_count = cache->bucket_count;
+    cache->buckets = new_buckets;
+    cache->bucket_count = new_count;
+
+    for (size_t i = 0; i < old_count; i++) {
+        cache_entry_t* entry = old_buckets[i];
+        while (entry) {
+            cache_entry_t* next = entry->hash_next;
+            size_t index = bucket_index(cache, entry->path, entry->lang);
+            entry->hash_next = new_buckets[index];
+            new_buckets[index] = entry;
+            entry = next;
+        }
+    }
+    free(old_buckets);
+    return 0;
+}
+
+// Insert a freshly parsed file, replacing any stale entry for the same key
+static void insert_locked(skeleton_cache_t* cache, const char* path, int64_t mtime_ns, uint64_t size,
+                          parsed_file_t* file) {
+    cache_entry_t* stale = find_entry(cache, path, file->lang);
+    if (stale) {
+        remove_entry(cache, stale);
+    }
+
+    if (file->memory_size > cache->budget_bytes) {
+        return; // Too large to cache, the caller keeps the only reference
+    }
+    if (cache->entries + 1 > cache->bucket_count && grow_buckets(cache) != 0) {
+        return;
+    }
+
+    cache_entry_t* entry = (cache_entry_t*)calloc(1, sizeof(cache_entry_t));
+    if (!entry) {
+        return;
+    }
+    entry->path = strdup(path);
+    if (!entry->path) {
+        free(entry);
+        return;
+    }
+    entry->lang = file->lang;
+    entry->mtime_ns = mtime_ns;
+    entry->size = size;
+    entry->file = file;
+
+    size_t index = bucket_index(cache, path, file->lang);
+    entry->hash_next = cache->buckets[index];
+    cache->buckets[index] = entry;
+    lru_push_front(cache, entry);
+
+    file->cache = cache;
+    file->ref_count++;
+    cache->bytes_used += file->memory_size;
+    cache->entries++;
+
+    evict_locked(cache, entry);
+}
+
+parsed_file_t* skeleton_cache_acquire(skeleton_cache_t* cache, TSParser* parser,
+                                      const char* path, extractor_language_t lang) {
+    int64_t mtime_ns;
+    uint64_t size;
+    if (platform_file_stat(path, &mtime_ns, &size) != 0) {
+        perror("Error opening file");
+        return NULL;
+    }
+
+    char* source = NULL;
+    size_t source_size = 0;
+    mapped_file_t* mapping = NULL;
+
+    platform_mutex_lock(&cache->lock);
+    int map_files = cache->map_files;
+    int verify_hash = cache->verify_hash;
+    int body_mode = get_signature_body_mode();
+    cache_entry_t* entry = find_entry(cache, path, lang);
+    if (entry && entry->mtime_ns == mtime_ns && entry->size == size && entry->file->body_mode == body_mode) {
+        if (verify_hash) {
+            // Hash the current contents outside the lock, then look the entry up again
+            uint64_t expected_hash = entry->file->content_hash;
+            platform_mutex_unlock(&cache->lock);
+            mapping = map_files ? mapped_file_map(path) : NULL;
+            if (!mapping) {
+                source = read_file(path, &source_size);
+                if (!source) {
+                    return NULL;
+                }
+            }
+            uint64_t hash = mapping ? content_hash(mapping->data, mapping->size)
+                                    : content_hash(source, source_size);
+            platform_mutex_lock(&cache->lock);
+            entry = find_entry(cache, path, lang);
+            // Files cached before verification was turned on were never hashed
+            if (hash != expected_hash || !entry || !entry->file->hashed || entry->file->content_hash != hash) {
+                entry = NULL;
+            }
+        }
+        if (entry) {
+            cache->hits++;
+            STATS_ADD(STATS_CACHE_HITS, 1);
+            lru_unlink(cache, entry);
+            lru_push_front(cache, entry);
+            parsed_file_t* file = entry->file;
+            file->ref_count++;
+            platform_mutex_unlock(&cache->lock);
+            free(source);
+            mapped_file_close(mapping);
+            return file;
+        }
+    }
+    cache->misses++;
+    STATS_ADD(STATS_CACHE_MISSES, 1);
+
+    // A stale entry of the same file is the base of an incremental reparse
+    parsed_file_t* previous = NULL;
+    entry = find_entry(cache, path, lang);
+    if (entry && entry->file->tree && entry->file->body_mode == body_mode) {
+        previous = entry->file;
+        previous->ref_count++;
+    }
+    platform_mutex_unlock(&cache->lock);
+
+    // A skeleton persisted by an earlier session skips the parse, and while the
+    // modification time still matches the file is not even read
+    skeleton_store_t* store = skeleton_store_global();
+    int use_store = !previous && skeleton_store_enabled(store);
+    parsed_file_t* file = NULL;
+    if (use_store && !source && !mapping) {
+        file = skeleton_store_load(store, path, lang, body_mode, mtime_ns, size, NULL, 0);
+    }
+
+    // Parse outside the lock so other threads are not serialized behind us
+    if (!file && !source && !mapping && map_files) {
+        mapping = mapped_file_map(path);
+    }
+    if (!file && !source && !mapping) {
+        source = read_file(path, &source_size);
+    }
+    if (!file && use_store && (source || mapping)) {
+        file = mapping ? skeleton_store_load(store, path, lang, body_mode, mtime_ns, size, mapping->data, mapping->size)
+                       : skeleton_store_load(store, path, lang, body_mode, mtime_ns, size, source, source_size);
+    }
+    if (file) {
+        free(source);
+        mapped_file_close(mapping);
+    } else {
+        if (mapping) {
+            file = previous ? parsed_file_reparse_mapped(parser, previous, mapping)
+                            : parsed_file_create_mapped(parser, lang, mapping);
+        } else if (source) {
+            file = previous ? parsed_file_reparse(parser, previous, source, source_size, 1, NULL, 0)
+                            : parsed_file_create(parser, lang, source, source_size, 1);
+        }
+        if (verify_hash || skeleton_store_enabled(store)) {
+            parsed_file_hash(file);
+        }
+        skeleton_store_save(store, path, mtime_ns, size, file);
+    }
+    if (previous) {
+        skeleton_cache_release(cache, previous);
+    }
+    if (!file) {
+        return NULL;
+    }
+    file->ref_count = 1;
+    symbol_table_update(symbol_table_global(), path, file->forest);
+
+    platform_mutex_lock(&cache->lock);
+    insert_locked(cache, path, mtime_ns, size, file);
+    platform_mutex_unlock(&cache->lock);
+
+    return file;
+}
+
+parsed_file_t* skeleton_cache_lookup(skeleton_cache_t* cache, const char* path, extractor_language_t lang,
+                                     int64_t mtime_ns, uint64_t size) {
+    platform_mutex_lock(&cache->lock);
+    cache_entry_t* entry = cache->verify_hash ? NULL : find_entry(cache, path, lang);
+    parsed_file_t* file = NULL;
+    if (entry && entry->mtime_ns == mtime_ns && entry->size == size) {
+        cache->hits++;
+        STATS_ADD(STATS_CACHE_HITS, 1);
+        lru_unlink(cache, entry);
+        lru_push_front(cache, entry);
+        file = entry->file;
+        file->ref_count++;
+    }
+    platform_mutex_unlock(&cache->lock);
+    return file;
+}
+
+void skeleton_cache_release(skeleton_cache_t* cache, parsed_file_t* file) {
+    if (!file) {
+        return;
+    }
+    if (!cache) {
+        parsed_file_free(file);
+        return;
+    }
+    platform_mutex_lock(&cache->lock);
+    release_locked(file);
+    platform_mutex_unlock(&cache->lock);
+}
+
+void set_skeleton_cache_budget(uint64_t budget_bytes) {
+    skeleton_cache_t* cache = skeleton_cache_global();
+    platform_mutex_lock(&cache->lock);
+    cache->budget_bytes = budget_bytes;
+    evict_locked(cache, NULL);
+    platform_mutex_unlock(&cache->lock);
+}
+
+void set_skeleton_cache_verify_hash(int enabled) {
+    skeleton_cache_t* cache = skeleton_cache_global();
+    platform_mutex_lock(&cache->lock);
+    cache->verify_hash = enabled;
+    platform_mutex_unlock(&cache->lock);
+}
+
+void set_skeleton_cache_map_files(int enabled) {
+    skeleton_cache_t* cache = skeleton_cache_global();
+    platform_mutex_lock(&cache->lock);
+    cache->map_files = enabled;
+    platform_mutex_unlock(&cache->lock);
+}
+
+void get_skeleton_cache_stats(skeleton_cache_stats_t* stats) {
+    if (!stats) {
+        return;
+    }
+    skeleton_cache_t* cache = skeleton_cache_global();
+    platform_mutex_lock(&cache->lock);
+    stats->hits = cache->hits;
+    stats->misses = cache->misses;
+    stats->evictions = cache->evictions;
+    stats->entries = cache->entries;
+    stats->bytes_used = cache->bytes_used;
+    stats->budget_bytes = cache->budget_bytes;
+    platform_mutex_unlock(&cache->lock);
+}
+
+void clear_skeleton_cache(void) {
+    skeleton_cache_t* cache = skeleton_cache_global();
+    platform_mutex_lock(&cache->lock);
+    while (cache->lru_head) {
+        remove_entry(cache, cache->lru_head);
+    }
+    platform_mutex_unlock(&cache->lock);
+}
@@ -0,0 +1,101 @@
+#ifndef SKELETON_CACHE_H
+#define SKELETON_CACHE_H
+
+#include "parsed_file.h"
+#include "dll_export.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Default memory budget of the skeleton cache
+#define SKELETON_CACHE_DEFAULT_BUDGET (256u * 1024u * 1024u)
+
+// Counters reported by the skeleton cache
+typedef struct {
+    uint64_t hits;          // Lookups served from the cache
+    uint64_t misses;        // Lookups that had to parse the file
+    uint64_t evictions;     // Entries dropped to stay within the budget
+    uint64_t entries;       // Entries currently cached
+    uint64_t bytes_used;    // Approximate memory held by cached entries
+    uint64_t budget_bytes;  // Memory budget
+} skeleton_cache_stats_t;
+
+/**
+ * Get the process-wide skeleton cache
+ * @return Shared cache, safe to use from any thread
+ */
+skeleton_cache_t* skeleton_cache_global(void);
+
+/**
+ * Get the parsed form of a file, parsing it only when the cached copy is stale.
+ * Entries are keyed on path, language, modification time and size, plus the
+ * content hash when hash verification is enabled.
+ * @param cache Cache
+ * @param parser Parser configured for the language, used on a miss
+ * @param path Path of the file
+ * @param lang Language of the file
+ * @return Parsed file to be released with skeleton_cache_release, or NULL on failure
+ */
+parsed_file_t* skeleton_cache_acquire(skeleton_cache_t* cache, TSParser* parser,
+                                      const char* path, extractor_language_t lang);
+
+/**
+ * Get the cached parsed file of a file only if the entry is current, without reading or parsing
+ * the file. Entries of any body mode match, and none do while hash verification is enabled.
+ * @param cache Cache
+ * @param path Path of the file
+ * @param lang Language of the file
+ * @param mtime_ns Current modification time of the file
+ * @param size Current size of the file
+ * @return Parsed file to be released with skeleton_cache_release, or NULL if there is no current entry
+ */
+parsed_file_t* skeleton_cache_lookup(skeleton_cache_t* cache, const char* path, extractor_language_t lang,
+                                     int64_t mtime_ns, uint64_t size);
+
+/**
+ * Release a parsed file returned by skeleton_cache_acquire
+ * @param cache Cache
+ * @param file Parsed file
+ */
+void skeleton_cache_release(skeleton_cache_t* cache, parsed_file_t* file);
+
+/**
+ * Set the memory budget of the global cache, evicting least recently used entries if needed
+ * @param budget_bytes Budget in bytes, 0 disables caching
+ */
+DLL_EXPORT void set_skeleton_cache_budget(uint64_t budget_bytes);
+
+/**
+ * Also compare content hashes on a path/mtime/size match
+ * @param enabled Non-zero to verify hashes
+ */
+DLL_EXPORT void set_skeleton_cache_verify_hash(int enabled);
+
+/**
+ * Parse large files of the global cache from a memory mapping instead of a heap copy
+ * (disabled by default). Cached entries then keep their mapping, so files must be
+ * replaced atomically (written elsewhere and renamed), never truncated or rewritten
+ * in place, while they are cached.
+ * @param enabled Non-zero to map files of at least MAPPED_FILE_MIN_SIZE bytes
+ */
+DLL_EXPORT void set_skeleton_cache_map_files(int enabled);
+
+/**
+ * Read the counters of the global cache
+ * @param stats Output counters
+ */
+DLL_EXPORT void get_skeleton_cache_stats(skeleton_cache_stats_t* stats);
+
+/**
+ * Drop every entry of the global cache
+ */
+DLL_EXPORT void clear_skeleton_cache(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SKELETON_CACHE_H
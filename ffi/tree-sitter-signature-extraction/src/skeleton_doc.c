@@ -0,0 +1,134 @@
+#include "skeleton_doc.h"
+#include "signature_extractor.h"
+#include "parsed_file.h"
+#include "utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct skeleton_doc {
+    char* filename;          // Path of the file, NULL for in-memory sources
+    parsed_file_t* file;     // Current version
+};
+
+static char* copy_source(const char* source, size_t source_size) {
+    char* copy = (char*)malloc(source_size + 1);
+    if (!copy) {
+        return NULL;
+    }
+    memcpy(copy, source, source_size);
+    copy[source_size] = '\0';
+    return copy;
+}
+
+static skeleton_doc_t* doc_open(extractor_ctx_t* ctx, const char* filename, char* source, size_t source_size,
+                                const char* language) {
+    extractor_language_t lang = extractor_language_from_name(language);
+    TSParser* parser = extractor_ctx_parser(ctx, lang);
+    if (!parser) {
+        fprintf(stderr, "Unsupported language: %s\n", language ? language : "(null)");
+        free(source);
+        return NULL;
+    }
+
+    skeleton_doc_t* doc = (skeleton_doc_t*)calloc(1, sizeof(skeleton_doc_t));
+    if (!doc) {
+        free(source);
+        return NULL;
+    }
+    if (filename && !(doc->filename = strdup(filename))) {
+        free(source);
+        free(doc);
+        return NULL;
+    }
+
+    doc->file = parsed_file_create(parser, lang, source, source_size, 1);
+    if (!doc->file) {
+        skeleton_doc_close(doc);
+        return NULL;
+    }
+    return doc;
+}
+
+skeleton_doc_t* skeleton_doc_open(extractor_ctx_t* ctx, const char* filename, const char* language) {
+    size_t source_size;
+    char* source = read_file(filename, &source_size);
+    if (!source) {
+        return NULL;
+    }
+    return doc_open(ctx, filename, source, source_size, language);
+}
+
+skeleton_doc_t* skeleton_doc_open_source(extractor_ctx_t* ctx, const char* source, size_t source_size,
+                                         const char* language) {
+    char* copy = copy_source(source, source_size);
+    if (!copy) {
+        return NULL;
+    }
+    return doc_open(ctx, NULL, copy, source_size, language);
+}
+
+// Swap in a new version parsed incrementally from the current one
+static int doc_update(extractor_ctx_t* ctx, skeleton_doc_t* doc, char* source, size_t source_size,
+                      const TSInputEdit* edits, uint32_t edit_count) {
+    TSParser* parser = extractor_ctx_parser(ctx, doc->file->lang);
+    if (!parser) {
+        free(source);
+        return -1;
+    }
+
+    parsed_file_t* file = parsed_file_reparse(parser, doc->file, source, source_size, 1, edits, edit_count);
+    if (!file) {
+        return -1;
+    }
+    parsed_file_free(doc->file);
+    doc->file = file;
+    return 0;
+}
+
+int skeleton_doc_apply_edits(extractor_ctx_t* ctx, skeleton_doc_t* doc,
+                             const char* source, size_t source_size,
+                             const TSInputEdit* edits, uint32_t edit_count) {
+    if (!doc || !source) {
+        return -1;
+    }
+    char* copy = copy_source(source, source_size);
+    if (!copy) {
+        return -1;
+    }
+    return doc_update(ctx, doc, copy, source_size, edits, edit_count);
+}
+
+int skeleton_doc_reload(extractor_ctx_t* ctx, skeleton_doc_t* doc) {
+    if (!doc || !doc->filename) {
+        return -1;
+    }
+    size_t source_size;
+    char* source = read_file(doc->filename, &source_size);
+    if (!source) {
+        return -1;
+    }
+    return doc_update(ctx, doc, source, source_size, NULL, 0);
+}
+
+char* skeleton_doc_get_skeleton_xml(skeleton_doc_t* doc, int start_line, int end_line) {
+    if (!doc) {
+        return NULL;
+    }
+    return render_skeleton_xml(doc->filename ? doc->filename : "", doc->file->forest, doc->file->entities,
+                               doc->file->errors, doc->file->error_count, start_line, end_line);
+}
+
+const TSTree* skeleton_doc_tree(skeleton_doc_t* doc) {
+    return doc ? doc->file->tree : NULL;
+}
+
+void skeleton_doc_close(skeleton_doc_t* doc) {
+    if (!doc) {
+        return;
+    }
+    parsed_file_free(doc->file);
+    free(doc->filename);
+    free(doc);
+}
@@ -0,0 +1,83 @@
+#ifndef SKELETON_DOC_H
+#define SKELETON_DOC_H
+
+#include "extractor_context.h"
+#include "tree_sitter/api.h"
+#include "dll_export.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Opaque handle to a document kept parsed between edits
+typedef struct skeleton_doc skeleton_doc_t;
+
+/**
+ * Parse a file into a document that can be updated incrementally
+ * @param ctx Context whose parser is used
+ * @param filename Path of the file
+ * @param language Language of the file ("java" or "python")
+ * @return New document, or NULL on failure
+ */
+DLL_EXPORT skeleton_doc_t* skeleton_doc_open(extractor_ctx_t* ctx, const char* filename, const char* language);
+
+/**
+ * Parse a source buffer into a document that can be updated incrementally
+ * @param ctx Context whose parser is used
+ * @param source Source code, copied by the document
+ * @param source_size Size of the source in bytes
+ * @param language Language of the source ("java" or "python")
+ * @return New document, or NULL on failure
+ */
+DLL_EXPORT skeleton_doc_t* skeleton_doc_open_source(extractor_ctx_t* ctx, const char* source, size_t source_size,
+                                                    const char* language);
+
+/**
+ * Replace the contents of a document, reparsing incrementally.
+ * @param ctx Context whose parser is used
+ * @param doc Document
+ * @param source New source code, copied by the document
+ * @param source_size Size of the new source in bytes
+ * @param edits Byte/point edits turning the old contents into the new ones, or NULL to diff them
+ * @param edit_count Number of edits
+ * @return 0 on success, -1 on failure (the document keeps its old contents)
+ */
+DLL_EXPORT int skeleton_doc_apply_edits(extractor_ctx_t* ctx, skeleton_doc_t* doc,
+                                        const char* source, size_t source_size,
+                                        const TSInputEdit* edits, uint32_t edit_count);
+
+/**
+ * Re-read the file of a document and reparse it incrementally against the previous contents
+ * @param ctx Context whose parser is used
+ * @param doc Document opened with skeleton_doc_open
+ * @return 0 on success, -1 on failure
+ */
+DLL_EXPORT int skeleton_doc_reload(extractor_ctx_t* ctx, skeleton_doc_t* doc);
+
+/**
+ * Render the XML skeleton with errors of a document
+ * @param doc Document
+ * @param start_line First line of the range, or -1 for the whole document
+ * @param end_line Last line of the range, or -1 for the whole document
+ * @return XML string to be freed by the caller, or NULL on failure
+ */
+DLL_EXPORT char* skeleton_doc_get_skeleton_xml(skeleton_doc_t* doc, int start_line, int end_line);
+
+/**
+ * Get the Tree-sitter tree of a document, valid until the next update
+ * @param doc Document
+ * @return Tree owned by the document
+ */
+DLL_EXPORT const TSTree* skeleton_doc_tree(skeleton_doc_t* doc);
+
+/**
+ * Close a document and free everything it holds
+ * @param doc Document
+ */
+DLL_EXPORT void skeleton_doc_close(skeleton_doc_t* doc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SKELETON_DOC_H
@@ -0,0 +1,284 @@
+#include "skeleton_format.h"
+#include "signature_table.h"
+#include "signature_extractor.h"
+#include "parsed_file.h"
+#include "xml_writer.h"
+#include "skeleton_service.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void put_u32(xml_writer_t* writer, uint32_t value) {
+    char bytes[4] = {
+        (char)(value & 0xFF), (char)((value >> 8) & 0xFF),
+        (char)((value >> 16) & 0xFF), (char)((value >> 24) & 0xFF)
+    };
+    xml_writer_write(writer, bytes, sizeof(bytes));
+}
+
+// Write a JSON string body, copying runs that need no escaping in bulk
+static void json_escaped(xml_writer_t* writer, const char* text, size_t length) {
+    size_t run = 0;
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = (unsigned char)text[i];
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        xml_writer_write(writer, text + run, i - run);
+        run = i + 1;
+        switch (c) {
+            case '"': xml_writer_puts(writer, "\\\""); break;
+            case '\\': xml_writer_puts(writer, "\\\\"); break;
+            case '\n': xml_writer_puts(writer, "\\n"); break;
+            case '\r': xml_writer_puts(writer, "\\r"); break;
+            case '\t': xml_writer_puts(writer, "\\t"); break;
+            default: {
+                char escape[8];
+                snprintf(escape, sizeof(escape), "\\u%04x", c);
+                xml_writer_puts(writer, escape);
+                break;
+            }
+        }
+    }
+    xml_writer_write(writer, text + run, length - run);
+}
+
+// Write a "key":"value" member, null for a missing value
+static void json_string_field(xml_writer_t* writer, const char* key, const char* text, size_t length) {
+    xml_writer_puts(writer, ",\"");
+    xml_writer_puts(writer, key);
+    if (!text) {
+        xml_writer_puts(writer, "\":null");
+        return;
+    }
+    xml_writer_puts(writer, "\":\"");
+    json_escaped(writer, text, length);
+    xml_writer_puts(writer, "\"");
+}
+
+static void json_int_field(xml_writer_t* writer, const char* key, int value) {
+    xml_writer_puts(writer, ",\"");
+    xml_writer_puts(writer, key);
+    xml_writer_puts(writer, "\":");
+    xml_writer_int(writer, value);
+}
+
+static void put_string_ref(xml_writer_t* out, size_t offset, size_t length) {
+    put_u32(out, (uint32_t)offset);
+    put_u32(out, (uint32_t)length);
+}
+
+static void put_record_header(xml_writer_t* out, skeleton_record_kind_t kind, entity_type_t type, int depth,
+                              int start_line, int start_column, int end_line, int end_column, int32_t parent) {
+    char head[4] = {
+        (char)kind, (char)type, (char)(depth & 0xFF), (char)((depth >> 8) & 0xFF)
+    };
+    xml_writer_write(out, head, sizeof(head));
+    put_u32(out, (uint32_t)start_line);
+    put_u32(out, (uint32_t)start_column);
+    put_u32(out, (uint32_t)end_line);
+    put_u32(out, (uint32_t)end_column);
+    put_u32(out, (uint32_t)parent);
+}
+
+static size_t safe_length(const char* text) {
+    return text ? strlen(text) : 0;
+}
+
+// Write the JSON line of an entity of a table
+static void write_entity_json(xml_writer_t* out, const signature_table_t* table, uint32_t id) {
+    const source_slice_t* name = &table->names[id];
+    const source_slice_t* signature = &table->signatures[id];
+    xml_writer_puts(out, "{\"kind\":\"entity\"");
+    json_int_field(out, "id", (int)id);
+    json_int_field(out, "parent", table->parents[id]);
+    json_int_field(out, "depth", table->depths[id]);
+    xml_writer_puts(out, ",\"type\":\"");
+    xml_writer_puts(out, entity_type_to_string((entity_type_t)table->types[id]));
+    xml_writer_puts(out, "\"");
+    json_int_field(out, "start_line", table->start_lines[id]);
+    json_int_field(out, "start_column", table->start_columns[id]);
+    json_int_field(out, "end_line", table->end_lines[id]);
+    json_int_field(out, "end_column", table->end_columns[id]);
+    json_string_field(out, "name", name->length > 0 ? table->text + name->offset : NULL, name->length);
+    xml_writer_puts(out, ",\"signature\":\"");
+    json_escaped(out, table->text + signature->offset, signature->length);
+    xml_writer_puts(out, "\"}\n");
+}
+
+static void write_error_json(xml_writer_t* out, const parse_error_t* error) {
+    xml_writer_puts(out, "{\"kind\":\"error\"");
+    json_int_field(out, "line", error->line);
+    json_string_field(out, "message", error->message, safe_length(error->message));
+    json_string_field(out, "error_line", error->error_line, safe_length(error->error_line));
+    json_string_field(out, "code_above", error->code_above_error_line, safe_length(error->code_above_error_line));
+    json_string_field(out, "code_below", error->code_below_error_line, safe_length(error->code_below_error_line));
+    xml_writer_puts(out, "}\n");
+}
+
+// The strings of an error record, in the order of its string refs
+static void error_strings(const parse_error_t* error, const char* strings[SKELETON_RECORD_STRINGS]) {
+    strings[0] = error->message;
+    strings[1] = error->error_line;
+    strings[2] = error->code_above_error_line;
+    strings[3] = error->code_below_error_line;
+}
+
+// Write the binary format. The string table starts with the text of the table as is, so the
+// name and signature slices of the entities are their string refs, and the error strings follow.
+static void write_binary(xml_writer_t* out, const signature_table_t* table, const parse_error_t* errors,
+                         int first_error, int last_error, size_t error_text) {
+    uint32_t record_count = table->count + (uint32_t)(last_error - first_error);
+    xml_writer_write(out, SKELETON_BINARY_MAGIC, 4);
+    put_u32(out, record_count);
+    put_u32(out, (uint32_t)(table->text_length + error_text));
+    put_u32(out, 0);
+
+    for (uint32_t id = 0; id < table->count; id++) {
+        put_record_header(out, SKELETON_RECORD_ENTITY, (entity_type_t)table->types[id], table->depths[id],
+                          table->start_lines[id], table->start_columns[id], table->end_lines[id],
+                          table->end_columns[id], table->parents[id]);
+        put_string_ref(out, table->names[id].offset, table->names[id].length);
+        put_string_ref(out, table->signatures[id].offset, table->signatures[id].length);
+        put_string_ref(out, 0, 0);
+        put_string_ref(out, 0, 0);
+    }
+
+    size_t offset = table->text_length;
+    for (int e = first_error; e < last_error; e++) {
+        const char* strings[SKELETON_RECORD_STRINGS];
+        error_strings(&errors[e], strings);
+        put_record_header(out, SKELETON_RECORD_ERROR, ENTITY_UNKNOWN, 0, errors[e].line, 0, errors[e].line, 0, -1);
+        for (int s = 0; s < SKELETON_RECORD_STRINGS; s++) {
+            size_t length = safe_length(strings[s]);
+            put_string_ref(out, offset, length);
+            offset += length;
+        }
+    }
+
+    xml_writer_write(out, table->text, table->text_length);
+    for (int e = first_error; e < last_error; e++) {
+        const char* strings[SKELETON_RECORD_STRINGS];
+        error_strings(&errors[e], strings);
+        for (int s = 0; s < SKELETON_RECORD_STRINGS; s++) {
+            if (strings[s]) {
+                xml_writer_write(out, strings[s], strlen(strings[s]));
+            }
+        }
+    }
+}
+
+char* render_skeleton_format(skeleton_format_t format, const char* filename, signature_node_t* root,
+                             const entity_index_t* index, parse_error_t* errors, int error_count,
+                             int start_line, int end_line, size_t* length) {
+    if (format == SKELETON_FORMAT_XML) {
+        char* xml = render_skeleton_xml(filename, root, index, errors, error_count, start_line, end_line);
+        if (length) {
+            *length = xml ? strlen(xml) : 0;
+        }
+        return xml;
+    }
+    if (format != SKELETON_FORMAT_JSONL && format != SKELETON_FORMAT_BINARY) {
+        fprintf(stderr, "Unsupported skeleton format: %d\n", (int)format);
+        return NULL;
+    }
+
+    STATS_PHASE_BEGIN(render);
+    // The entities of the range are flattened once, then written by a scan over the table
+    signature_table_t* table = signature_table_build(root, index, start_line, end_line);
+    if (!table) {
+        return NULL;
+    }
+    if (start_line == -1 || end_line == -1) {
+        start_line = INT_MIN;
+        end_line = INT_MAX;
+    }
+
+    // Errors are sorted by line, those in range are a contiguous run
+    int first_error = 0;
+    int last_error = errors ? error_count : 0;
+    while (first_error < last_error && errors[first_error].line < start_line) {
+        first_error++;
+    }
+    while (last_error > first_error && errors[last_error - 1].line > end_line) {
+        last_error--;
+    }
+    size_t error_text = 0;
+    for (int e = first_error; e < last_error; e++) {
+        const char* strings[SKELETON_RECORD_STRINGS];
+        error_strings(&errors[e], strings);
+        for (int s = 0; s < SKELETON_RECORD_STRINGS; s++) {
+            error_text += safe_length(strings[s]);
+        }
+    }
+
+    // The binary format is sized exactly from the table, JSON lines roughly
+    size_t records = (size_t)table->count + (size_t)(last_error - first_error);
+    xml_writer_t out;
+    if (format == SKELETON_FORMAT_BINARY) {
+        if (table->text_length + error_text > UINT32_MAX) {
+            fprintf(stderr, "Skeleton string table too large: %zu bytes\n", table->text_length + error_text);
+            free_signature_table(table);
+            return NULL;
+        }
+        xml_writer_init(&out, SKELETON_BINARY_HEADER_SIZE + records * SKELETON_RECORD_SIZE +
+                              table->text_length + error_text);
+        write_binary(&out, table, errors, first_error, last_error, error_text);
+    } else {
+        xml_writer_init(&out, records * 192 + table->text_length + error_text);
+        for (uint32_t id = 0; id < table->count; id++) {
+            write_entity_json(&out, table, id);
+        }
+        for (int e = first_error; e < last_error; e++) {
+            write_error_json(&out, &errors[e]);
+        }
+    }
+    free_signature_table(table);
+
+    size_t out_length = out.length;
+    int failed = out.failed;
+    char* result = xml_writer_finish(&out);
+    STATS_PHASE_END(STATS_PHASE_RENDER, render);
+    if (failed) {
+        free(result);
+        return NULL;
+    }
+    STATS_ADD(STATS_OUTPUT_BYTES, out_length);
+    if (length) {
+        *length = out_length;
+    }
+    return result;
+}
+
+char* get_skeleton_records(const char* filename, const char* language, int start_line, int end_line,
+                           int format, size_t* length) {
+    char* result;
+    if (skeleton_service_skeleton(SERVICE_SKELETON_RECORDS, filename, language, start_line, end_line,
+                                  (uint64_t)format, &result, length) == 0) {
+        return result;
+    }
+    return ctx_get_skeleton_records(extractor_ctx_default(), filename, language, start_line, end_line,
+                                    format, length);
+}
+
+char* ctx_get_skeleton_records(extractor_ctx_t* ctx, const char* filename, const char* language,
+                               int start_line, int end_line, int format, size_t* length) {
+    extractor_language_t lang = extractor_language_from_name(language);
+    if (lang == EXTRACTOR_LANG_UNKNOWN) {
+        fprintf(stderr, "Unsupported language: %s\n", language ? language : "(null)");
+        return NULL;
+    }
+
+    parsed_file_t* file = extractor_ctx_acquire_file(ctx, filename, lang);
+    if (!file) {
+        return NULL;
+    }
+
+    char* result = render_skeleton_format((skeleton_format_t)format, filename, file->forest, file->entities,
+                                          file->errors, file->error_count, start_line, end_line, length);
+
+    extractor_ctx_release_file(ctx, file);
+    return result;
+}
@@ -0,0 +1,77 @@
+#ifndef SKELETON_FORMAT_H
+#define SKELETON_FORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "dll_export.h"
+#include "signature_node.h"
+#include "entity_index.h"
+#include "extractor_context.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Output formats of a skeleton
+typedef enum {
+    SKELETON_FORMAT_XML = 0,         // The <code-skeleton> document
+    SKELETON_FORMAT_JSONL = 1,       // One JSON object per entity or error, one per line
+    SKELETON_FORMAT_BINARY = 2       // Packed records followed by a string table
+} skeleton_format_t;
+
+// Binary format, all integers little-endian:
+//   header   magic "SKB1", u32 record count, u32 string table size, u32 reserved
+//   records  record count records of SKELETON_RECORD_SIZE bytes, in document order
+//   strings  string table, referenced by (u32 offset, u32 length) pairs
+// A record is: u8 kind, u8 entity type, u16 depth, i32 start line, i32 start column,
+// i32 end line, i32 end column, i32 parent record (-1 at top level), then four string refs:
+// name and signature for entities; message, error line, code above and code below for errors.
+#define SKELETON_BINARY_MAGIC "SKB1"
+#define SKELETON_BINARY_HEADER_SIZE 16
+#define SKELETON_RECORD_SIZE 56
+#define SKELETON_RECORD_STRINGS 4
+
+// Kinds of records
+typedef enum {
+    SKELETON_RECORD_ENTITY = 0,
+    SKELETON_RECORD_ERROR = 1
+} skeleton_record_kind_t;
+
+/**
+ * Render the entities and errors of a parsed forest overlapping a line range
+ * @param format Output format
+ * @param filename Path of the file, only used by the XML format
+ * @param root Top-level signature nodes
+ * @param index Interval index of the forest, or NULL
+ * @param errors Parse errors sorted by line
+ * @param error_count Number of parse errors
+ * @param start_line First line of the range, or -1 for the whole file
+ * @param end_line Last line of the range, or -1 for the whole file
+ * @param length Output length of the result in bytes, may be NULL
+ * @return Result to be freed by the caller (NUL-terminated except for the binary format), or NULL on failure
+ */
+char* render_skeleton_format(skeleton_format_t format, const char* filename, signature_node_t* root,
+                             const entity_index_t* index, parse_error_t* errors, int error_count,
+                             int start_line, int end_line, size_t* length);
+
+/**
+ * Get the skeleton of a file in a given format, from the skeleton cache when possible
+ * @param filename Path of the file
+ * @param language Language of the file
+ * @param start_line First line of the range, or -1 for the whole file
+ * @param end_line Last line of the range, or -1 for the whole file
+ * @param format A skeleton_format_t
+ * @param length Output length of the result in bytes
+ * @return Result to be freed by the caller, or NULL on failure
+ */
+DLL_EXPORT char* get_skeleton_records(const char* filename, const char* language, int start_line, int end_line,
+                                      int format, size_t* length);
+
+char* ctx_get_skeleton_records(extractor_ctx_t* ctx, const char* filename, const char* language,
+                               int start_line, int end_line, int format, size_t* length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SKELETON_FORMAT_H
@@ -0,0 +1,134 @@
+#include "skeleton_prefetch.h"
+#include "extractor_context.h"
+#include "skeleton_service.h"
+#include "platform.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Files waiting to be prefetched, in the order queued
+typedef struct {
+    char* path;
+    extractor_language_t lang;
+    int64_t min_size;
+} prefetch_item_t;
+
+static platform_mutex_t prefetch_lock = PLATFORM_MUTEX_INITIALIZER;
+static platform_cond_t prefetch_queued = PLATFORM_COND_INITIALIZER;
+static prefetch_item_t prefetch_queue[SKELETON_PREFETCH_QUEUE];  // Ring buffer, guarded by prefetch_lock
+static int prefetch_head;                                        // First waiting file, guarded by prefetch_lock
+static int prefetch_count;                                       // Waiting files, guarded by prefetch_lock
+static char* prefetch_current;                                   // File being parsed, guarded by prefetch_lock
+static int prefetch_started;                                     // Whether the worker runs, guarded by prefetch_lock
+static platform_thread_t prefetch_thread;
+
+// Whether a path is waiting or being parsed. Called with the lock held.
+static int is_pending(const char* path) {
+    if (prefetch_current && strcmp(prefetch_current, path) == 0) {
+        return 1;
+    }
+    for (int i = 0; i < prefetch_count; i++) {
+        if (strcmp(prefetch_queue[(prefetch_head + i) % SKELETON_PREFETCH_QUEUE].path, path) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void prefetch_file(extractor_ctx_t* ctx, const prefetch_item_t* item) {
+    // Small files are cheap to parse on demand, and missing ones are not worth a parse
+    int64_t mtime_ns;
+    uint64_t size;
+    if (platform_file_stat(item->path, &mtime_ns, &size) != 0 || size <= (uint64_t)item->min_size) {
+        return;
+    }
+    const char* path = item->path;
+    extractor_language_t lang = item->lang;
+    // A service parses the file into its own cache, without rendering a reply
+    const char* language = extractor_language_name(lang);
+    if (skeleton_service_warm(&path, &language, 1) == 0) {
+        return;
+    }
+    parsed_file_t* file = extractor_ctx_acquire_file(ctx, path, lang);
+    if (file) {
+        extractor_ctx_release_file(ctx, file);
+    }
+}
+
+// Runs for the lifetime of the process, sleeping while the queue is empty
+static void prefetch_worker(void* arg) {
+    (void)arg;
+    platform_thread_set_background();
+    extractor_ctx_t* ctx = extractor_ctx_create();
+
+    platform_mutex_lock(&prefetch_lock);
+    for (;;) {
+        while (prefetch_count == 0) {
+            platform_cond_wait(&prefetch_queued, &prefetch_lock);
+        }
+        prefetch_item_t item = prefetch_queue[prefetch_head];
+        prefetch_head = (prefetch_head + 1) % SKELETON_PREFETCH_QUEUE;
+        prefetch_count--;
+        prefetch_current = item.path;
+        platform_mutex_unlock(&prefetch_lock);
+
+        if (ctx) {
+            prefetch_file(ctx, &item);
+        }
+
+        platform_mutex_lock(&prefetch_lock);
+        prefetch_current = NULL;
+        free(item.path);
+    }
+}
+
+int prefetch_skeletons(const char** paths, int count, int64_t min_size) {
+    if (!paths || count <= 0) {
+        return 0;
+    }
+
+    platform_mutex_lock(&prefetch_lock);
+    if (!prefetch_started) {
+        if (platform_thread_create(&prefetch_thread, prefetch_worker, NULL) != 0) {
+            platform_mutex_unlock(&prefetch_lock);
+            return -1;
+        }
+        prefetch_started = 1;
+    }
+
+    int queued = 0;
+    for (int i = 0; i < count && prefetch_count < SKELETON_PREFETCH_QUEUE; i++) {
+        if (!paths[i]) {
+            continue;
+        }
+        extractor_language_t lang = extractor_language_from_path(paths[i]);
+        if (lang == EXTRACTOR_LANG_UNKNOWN || is_pending(paths[i])) {
+            continue;
+        }
+        char* path = strdup(paths[i]);
+        if (!path) {
+            break;
+        }
+        prefetch_item_t* item = &prefetch_queue[(prefetch_head + prefetch_count) % SKELETON_PREFETCH_QUEUE];
+        item->path = path;
+        item->lang = lang;
+        item->min_size = min_size > 0 ? min_size : 0;
+        prefetch_count++;
+        queued++;
+    }
+    if (queued > 0) {
+        platform_cond_broadcast(&prefetch_queued);
+    }
+    platform_mutex_unlock(&prefetch_lock);
+    return queued;
+}
+
+void cancel_skeleton_prefetch(void) {
+    platform_mutex_lock(&prefetch_lock);
+    for (int i = 0; i < prefetch_count; i++) {
+        free(prefetch_queue[(prefetch_head + i) % SKELETON_PREFETCH_QUEUE].path);
+    }
+    prefetch_head = 0;
+    prefetch_count = 0;
+    platform_mutex_unlock(&prefetch_lock);
+}
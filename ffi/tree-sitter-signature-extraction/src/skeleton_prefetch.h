@@ -0,0 +1,37 @@
+#ifndef SKELETON_PREFETCH_H
+#define SKELETON_PREFETCH_H
+
+#include <stdint.h>
+#include "dll_export.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Most files waiting to be prefetched, paths beyond it are dropped
+#define SKELETON_PREFETCH_QUEUE 256
+
+/**
+ * Parse files into the skeleton cache ahead of the requests expected for them, on a worker thread
+ * of background priority, so those requests find the skeleton already cached. Files are handled
+ * in the order queued; ones already queued, of an unsupported language, or beyond
+ * SKELETON_PREFETCH_QUEUE waiting files are skipped. The worker stats each file and skips
+ * the ones of at most min_size bytes, so the caller need not touch them. With a skeleton
+ * service configured, the service parses them into its own cache instead.
+ * @param paths Paths of the files
+ * @param count Number of files
+ * @param min_size Size a file must exceed to be parsed, 0 for any
+ * @return Number of files queued, or -1 if the worker cannot be started
+ */
+DLL_EXPORT int prefetch_skeletons(const char** paths, int count, int64_t min_size);
+
+/**
+ * Drop the files waiting to be prefetched. The file being parsed, if any, is still finished.
+ */
+DLL_EXPORT void cancel_skeleton_prefetch(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SKELETON_PREFETCH_H
@@ -0,0 +1,784 @@
+#if defined(__linux__)
+#define _GNU_SOURCE // memfd_create
+#endif
+
+#include "skeleton_service.h"
+#include "signature_extractor.h"
+#include "skeleton_batch.h"
+#include "skeleton_format.h"
+#include "symbol_table.h"
+#include "extractor_context.h"
+#include "platform.h"
+#include "xml_writer.h"
+#include "byte_buffer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Wire format, integers in host byte order since both ends run on the same machine:
+//   request  u32 magic, u32 op, u32 count, u32 payload size, u32 body mode, then the payload
+//            skeletons: count times (string path, string language, i32 start line, i32 end line,
+//                       u32 kind, u64 argument)
+//            symbols:   string query, i32 mode, i32 limit
+//            warm:      count times (string path, string language), answered with count NULL results
+//            a string is a u32 length, SERVICE_NO_STRING for NULL, and its bytes
+//   reply    u32 status, u32 reserved, u64 size on the socket, and if the status is 0, a shared
+//            memory file of that size passed along with it holding u32 count, count u32 lengths
+//            (SERVICE_NO_STRING for a failed result) and the results, each followed by a NUL
+// A request made in another body mode than the one of the service is refused, so the client
+// extracts in process and never gets signatures of a mode it did not ask for.
+#define SERVICE_MAGIC 0x32565353u    // "SSV2"
+#define SERVICE_OP_SKELETONS 1u
+#define SERVICE_OP_SYMBOLS 2u
+#define SERVICE_OP_WARM 3u
+#define SERVICE_NO_STRING UINT32_MAX
+#define SERVICE_MAX_PAYLOAD (64u * 1024u * 1024u)
+#define SERVICE_REPLY_SIZE 16
+
+// After failing to reach the service, requests run in process this long before it is tried again
+#define SERVICE_RETRY_NS 1000000000ULL
+// A service that has not replied by then is given up on and the request runs in process
+#define SERVICE_TIMEOUT_SECONDS 60
+
+// Client configuration, guarded by service_lock
+static platform_mutex_t service_lock = PLATFORM_MUTEX_INITIALIZER;
+static char* service_path = NULL;
+static int service_configured = 0;   // Whether service_path is set, or SKELETON_SERVICE_SOCKET was read
+static uint64_t service_retry_ns = 0;
+
+void set_skeleton_service_path(const char* socket_path) {
+    platform_mutex_lock(&service_lock);
+    free(service_path);
+    service_path = socket_path && *socket_path ? strdup(socket_path) : NULL;
+    service_configured = 1;
+    service_retry_ns = 0;
+    platform_mutex_unlock(&service_lock);
+}
+
+#if defined(_WIN32) || defined(__CYGWIN__)
+
+int run_skeleton_service(const char* socket_path, int threads) {
+    (void)socket_path;
+    (void)threads;
+    fprintf(stderr, "The skeleton service is not supported on this platform\n");
+    return -1;
+}
+
+int skeleton_service_skeleton(service_skeleton_kind_t kind, const char* filename, const char* language,
+                              int start_line, int end_line, uint64_t arg, char** result, size_t* length) {
+    (void)kind;
+    (void)filename;
+    (void)language;
+    (void)start_line;
+    (void)end_line;
+    (void)arg;
+    (void)result;
+    (void)length;
+    return -1;
+}
+
+int skeleton_service_batch(const char** paths, const char** languages, int count, char** results) {
+    (void)paths;
+    (void)languages;
+    (void)count;
+    (void)results;
+    return -1;
+}
+
+int skeleton_service_warm(const char** paths, const char** languages, int count) {
+    (void)paths;
+    (void)languages;
+    (void)count;
+    return -1;
+}
+
+int skeleton_service_find_symbols(const char* query, int mode, int limit, char** result) {
+    (void)query;
+    (void)mode;
+    (void)limit;
+    (void)result;
+    return -1;
+}
+
+#else
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#if defined(MSG_NOSIGNAL)
+  #define SERVICE_SEND_FLAGS MSG_NOSIGNAL
+#else
+  #define SERVICE_SEND_FLAGS 0
+#endif
+
+// Read a length-prefixed string into a NUL-terminated copy, NULL for a missing one
+static char* read_string(byte_reader_t* reader, int* missing) {
+    uint32_t length = byte_reader_u32(reader);
+    *missing = length == SERVICE_NO_STRING;
+    if (reader->failed || *missing) {
+        return NULL;
+    }
+    const char* bytes = byte_reader_bytes(reader, length);
+    char* copy = bytes ? (char*)malloc((size_t)length + 1) : NULL;
+    if (!copy) {
+        reader->failed = 1;
+        return NULL;
+    }
+    memcpy(copy, bytes, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+static void write_string(xml_writer_t* writer, const char* text) {
+    if (!text) {
+        byte_writer_u32(writer, SERVICE_NO_STRING);
+        return;
+    }
+    size_t length = strlen(text);
+    byte_writer_u32(writer, (uint32_t)length);
+    xml_writer_write(writer, text, length);
+}
+
+// Write to a socket or a file, a socket closed by its peer is an error rather than a SIGPIPE
+static int write_all(int fd, const void* data, size_t size, int is_socket) {
+    const char* bytes = (const char*)data;
+    while (size > 0) {
+        ssize_t written = is_socket ? send(fd, bytes, size, SERVICE_SEND_FLAGS) : write(fd, bytes, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        bytes += written;
+        size -= (size_t)written;
+    }
+    return 0;
+}
+
+static int read_all(int fd, void* data, size_t size) {
+    char* bytes = (char*)data;
+    while (size > 0) {
+        ssize_t got = read(fd, bytes, size);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            return -1;
+        }
+        bytes += got;
+        size -= (size_t)got;
+    }
+    return 0;
+}
+
+static int socket_address(const char* path, struct sockaddr_un* address) {
+    if (strlen(path) >= sizeof(address->sun_path)) {
+        fprintf(stderr, "Skeleton service socket path too long: %s\n", path);
+        return -1;
+    }
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    strcpy(address->sun_path, path);
+    return 0;
+}
+
+static int connect_socket(const char* path) {
+    struct sockaddr_un address;
+    if (socket_address(path, &address) != 0) {
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+#if defined(SO_NOSIGPIPE)
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+    if (connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Anonymous shared memory file for a reply
+static int create_shared_memory(void) {
+#if defined(__linux__)
+  #if defined(MFD_CLOEXEC)
+    int fd = memfd_create("skeleton-reply", MFD_CLOEXEC);
+    if (fd >= 0) {
+        return fd;
+    }
+  #endif
+    // Kernels without memfd: a file in the memory-backed /dev/shm, only the descriptor is needed
+    char path[] = "/dev/shm/skeleton-reply-XXXXXX";
+    int file = mkstemp(path);
+    if (file >= 0) {
+        unlink(path);
+    }
+    return file;
+#else
+    static platform_mutex_t name_lock = PLATFORM_MUTEX_INITIALIZER;
+    static unsigned long name_counter = 0;
+    platform_mutex_lock(&name_lock);
+    unsigned long counter = name_counter++;
+    platform_mutex_unlock(&name_lock);
+
+    char name[64];
+    snprintf(name, sizeof(name), "/skeleton-reply-%ld-%lu", (long)getpid(), counter);
+    int shm = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (shm >= 0) {
+        // Only the descriptor is needed from here on
+        shm_unlink(name);
+    }
+    return shm;
+#endif
+}
+
+// ---- Client ----
+
+// Connect to the configured service, -1 if there is none or it cannot be reached for now
+static int connect_service(void) {
+    char path[sizeof(((struct sockaddr_un*)0)->sun_path)];
+    platform_mutex_lock(&service_lock);
+    if (!service_configured) {
+        const char* env = getenv(SKELETON_SERVICE_ENV);
+        service_path = env && *env ? strdup(env) : NULL;
+        service_configured = 1;
+    }
+    int usable = service_path && strlen(service_path) < sizeof(path) &&
+                 (service_retry_ns == 0 || platform_monotonic_ns() >= service_retry_ns);
+    if (usable) {
+        strcpy(path, service_path);
+    }
+    platform_mutex_unlock(&service_lock);
+    if (!usable) {
+        return -1;
+    }
+
+    int fd = connect_socket(path);
+    platform_mutex_lock(&service_lock);
+    service_retry_ns = fd < 0 ? platform_monotonic_ns() + SERVICE_RETRY_NS : 0;
+    platform_mutex_unlock(&service_lock);
+    return fd;
+}
+
+// Receive the reply header and the shared memory passed with it
+static int receive_reply(int socket_fd, uint32_t* status, uint64_t* size, int* memory_fd) {
+    char header[SERVICE_REPLY_SIZE];
+    union {
+        struct cmsghdr align;
+        char buffer[CMSG_SPACE(sizeof(int))];
+    } control;
+    struct iovec iov = { header, sizeof(header) };
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control.buffer;
+    message.msg_controllen = sizeof(control.buffer);
+
+    ssize_t got;
+    do {
+        got = recvmsg(socket_fd, &message, 0);
+    } while (got < 0 && errno == EINTR);
+    if (got <= 0) {
+        return -1;
+    }
+
+    *memory_fd = -1;
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&message); cmsg; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            memcpy(memory_fd, CMSG_DATA(cmsg), sizeof(int));
+        }
+    }
+    if ((size_t)got < sizeof(header) && read_all(socket_fd, header + got, sizeof(header) - (size_t)got) != 0) {
+        if (*memory_fd >= 0) {
+            close(*memory_fd);
+        }
+        return -1;
+    }
+    memcpy(status, header, sizeof(*status));
+    memcpy(size, header + 8, sizeof(*size));
+    return 0;
+}
+
+// Send a request and copy the count results of its reply out of the shared memory
+static int call_service(uint32_t op, uint32_t count, xml_writer_t* payload, char** results, size_t* lengths) {
+    if (payload->failed || payload->length > SERVICE_MAX_PAYLOAD) {
+        return -1;
+    }
+    int fd = connect_service();
+    if (fd < 0) {
+        return -1;
+    }
+    struct timeval timeout = { SERVICE_TIMEOUT_SECONDS, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    uint32_t header[5] = { SERVICE_MAGIC, op, count, (uint32_t)payload->length,
+                           (uint32_t)get_signature_body_mode() };
+    uint32_t status = 1;
+    uint64_t size = 0;
+    int memory_fd = -1;
+    int failed = write_all(fd, header, sizeof(header), 1) != 0 ||
+                 write_all(fd, payload->data, payload->length, 1) != 0 ||
+                 receive_reply(fd, &status, &size, &memory_fd) != 0;
+    close(fd);
+    if (failed || status != 0 || memory_fd < 0 || size < sizeof(uint32_t) || size > SIZE_MAX) {
+        if (memory_fd >= 0) {
+            close(memory_fd);
+        }
+        return -1;
+    }
+
+    void* mapping = mmap(NULL, (size_t)size, PROT_READ, MAP_SHARED, memory_fd, 0);
+    close(memory_fd);
+    if (mapping == MAP_FAILED) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        results[i] = NULL;
+    }
+    // The lengths come first, then the results they measure
+    byte_reader_t reader = { (const char*)mapping, (const char*)mapping + size, 0 };
+    int ok = byte_reader_u32(&reader) == count;
+    byte_reader_t lengths_reader = reader;
+    byte_reader_bytes(&reader, (size_t)count * sizeof(uint32_t));
+    for (uint32_t i = 0; ok && i < count; i++) {
+        uint32_t length = byte_reader_u32(&lengths_reader);
+        if (length == SERVICE_NO_STRING) {
+            continue;
+        }
+        const char* bytes = byte_reader_bytes(&reader, (size_t)length + 1);
+        results[i] = bytes ? (char*)malloc((size_t)length + 1) : NULL;
+        if (!results[i]) {
+            ok = 0;
+            break;
+        }
+        memcpy(results[i], bytes, (size_t)length + 1);
+        if (lengths) {
+            lengths[i] = length;
+        }
+    }
+    munmap(mapping, (size_t)size);
+    if (!ok || reader.failed) {
+        for (uint32_t i = 0; i < count; i++) {
+            free(results[i]);
+            results[i] = NULL;
+        }
+        return -1;
+    }
+    return 0;
+}
+
+// The service runs in its own working directory, so only absolute paths mean the same file there
+static const char* service_path_of(const char* path) {
+    return path && path[0] == '/' ? path : NULL;
+}
+
+static void write_skeleton_request(xml_writer_t* payload, const char* path, const char* language,
+                                   int start_line, int end_line, uint32_t kind, uint64_t arg) {
+    write_string(payload, path);
+    write_string(payload, language);
+    byte_writer_u32(payload, (uint32_t)start_line);
+    byte_writer_u32(payload, (uint32_t)end_line);
+    byte_writer_u32(payload, kind);
+    byte_writer_u64(payload, arg);
+}
+
+int skeleton_service_skeleton(service_skeleton_kind_t kind, const char* filename, const char* language,
+                              int start_line, int end_line, uint64_t arg, char** result, size_t* length) {
+    if (!service_path_of(filename) || !language) {
+        return -1;
+    }
+    xml_writer_t payload;
+    xml_writer_init(&payload, 256);
+    write_skeleton_request(&payload, filename, language, start_line, end_line, (uint32_t)kind, arg);
+    size_t result_length = 0;
+    int status = call_service(SERVICE_OP_SKELETONS, 1, &payload, result, &result_length);
+    free(xml_writer_finish(&payload));
+    // A skeleton the service failed to produce is tried again in process
+    if (status != 0 || !*result) {
+        return -1;
+    }
+    if (length) {
+        *length = result_length;
+    }
+    return 0;
+}
+
+int skeleton_service_batch(const char** paths, const char** languages, int count, char** results) {
+    if (!paths || count <= 0) {
+        return -1;
+    }
+    xml_writer_t payload;
+    xml_writer_init(&payload, (size_t)count * 128);
+    for (int i = 0; i < count; i++) {
+        const char* language = languages ? languages[i]
+                                         : paths[i] ? extractor_language_name(extractor_language_from_path(paths[i]))
+                                                    : NULL;
+        write_skeleton_request(&payload, service_path_of(paths[i]), language, -1, -1, SERVICE_SKELETON_XML, 0);
+    }
+    int status = call_service(SERVICE_OP_SKELETONS, (uint32_t)count, &payload, results, NULL);
+    free(xml_writer_finish(&payload));
+    return status;
+}
+
+int skeleton_service_warm(const char** paths, const char** languages, int count) {
+    if (!paths || !languages || count <= 0) {
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        if (!service_path_of(paths[i])) {
+            return -1;
+        }
+    }
+    xml_writer_t payload;
+    xml_writer_init(&payload, (size_t)count * 128);
+    for (int i = 0; i < count; i++) {
+        write_string(&payload, paths[i]);
+        write_string(&payload, languages[i]);
+    }
+    char** results = (char**)calloc((size_t)count, sizeof(char*));
+    int status = results ? call_service(SERVICE_OP_WARM, (uint32_t)count, &payload, results, NULL) : -1;
+    for (int i = 0; results && i < count; i++) {
+        free(results[i]);
+    }
+    free(results);
+    free(xml_writer_finish(&payload));
+    return status;
+}
+
+int skeleton_service_find_symbols(const char* query, int mode, int limit, char** result) {
+    if (!query) {
+        return -1;
+    }
+    xml_writer_t payload;
+    xml_writer_init(&payload, 64);
+    write_string(&payload, query);
+    byte_writer_u32(&payload, (uint32_t)mode);
+    byte_writer_u32(&payload, (uint32_t)limit);
+    int status = call_service(SERVICE_OP_SYMBOLS, 1, &payload, result, NULL);
+    free(xml_writer_finish(&payload));
+    return status == 0 && *result ? 0 : -1;
+}
+
+// ---- Service ----
+
+// A request being answered, its results written to shared memory once all are in
+typedef struct {
+    uint32_t count;
+    char** results;
+    size_t* lengths;
+} service_reply_t;
+
+static int reply_init(service_reply_t* reply, uint32_t count) {
+    reply->count = count;
+    reply->results = (char**)calloc(count ? count : 1, sizeof(char*));
+    reply->lengths = (size_t*)calloc(count ? count : 1, sizeof(size_t));
+    return reply->results && reply->lengths ? 0 : -1;
+}
+
+static void reply_free(service_reply_t* reply) {
+    for (uint32_t i = 0; reply->results && i < reply->count; i++) {
+        free(reply->results[i]);
+    }
+    free(reply->results);
+    free(reply->lengths);
+}
+
+// Answer the skeletons of a request. A batch of whole files goes through the batch pipeline.
+static int serve_skeletons(extractor_ctx_t* ctx, byte_reader_t* reader, service_reply_t* reply) {
+    uint32_t count = reply->count;
+    char** paths = (char**)calloc(count ? count : 1, sizeof(char*));
+    char** languages = (char**)calloc(count ? count : 1, sizeof(char*));
+    int* ranges = (int*)malloc(sizeof(int) * 2 * (count ? count : 1));
+    uint32_t* kinds = (uint32_t*)malloc(sizeof(uint32_t) * (count ? count : 1));
+    uint64_t* args = (uint64_t*)malloc(sizeof(uint64_t) * (count ? count : 1));
+    int failed = !paths || !languages || !ranges || !kinds || !args;
+    int whole_files = 1;
+    for (uint32_t i = 0; !failed && i < count; i++) {
+        int missing;
+        paths[i] = read_string(reader, &missing);
+        languages[i] = read_string(reader, &missing);
+        ranges[i * 2] = (int)byte_reader_u32(reader);
+        ranges[i * 2 + 1] = (int)byte_reader_u32(reader);
+        kinds[i] = byte_reader_u32(reader);
+        args[i] = byte_reader_u64(reader);
+        failed = reader->failed;
+        whole_files = whole_files && kinds[i] == SERVICE_SKELETON_XML && args[i] == 0 &&
+                      ranges[i * 2] == -1 && ranges[i * 2 + 1] == -1;
+    }
+
+    if (!failed && count > 1 && whole_files) {
+        char** results = get_skeleton_xml_batch_array((const char**)paths, (const char**)languages, (int)count, 0);
+        for (uint32_t i = 0; results && i < count; i++) {
+            reply->results[i] = results[i];
+            reply->lengths[i] = results[i] ? strlen(results[i]) : 0;
+        }
+        free(results);
+    } else {
+        for (uint32_t i = 0; !failed && i < count; i++) {
+            if (!paths[i] || !languages[i]) {
+                continue;
+            }
+            if (kinds[i] == SERVICE_SKELETON_RECORDS) {
+                reply->results[i] = ctx_get_skeleton_records(ctx, paths[i], languages[i], ranges[i * 2],
+                                                             ranges[i * 2 + 1], (int)args[i], &reply->lengths[i]);
+            } else {
+                reply->results[i] = ctx_get_skeleton_xml_budget(ctx, paths[i], languages[i], ranges[i * 2],
+                                                                ranges[i * 2 + 1], (size_t)args[i]);
+                reply->lengths[i] = reply->results[i] ? strlen(reply->results[i]) : 0;
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < count && paths && languages; i++) {
+        free(paths[i]);
+        free(languages[i]);
+    }
+    free(paths);
+    free(languages);
+    free(ranges);
+    free(kinds);
+    free(args);
+    return failed ? -1 : 0;
+}
+
+// Parse files into the shared cache, leaving every result NULL
+static int serve_warm(extractor_ctx_t* ctx, byte_reader_t* reader, service_reply_t* reply) {
+    for (uint32_t i = 0; i < reply->count; i++) {
+        int missing;
+        char* path = read_string(reader, &missing);
+        char* language = read_string(reader, &missing);
+        extractor_language_t lang = language ? extractor_language_from_name(language) : EXTRACTOR_LANG_UNKNOWN;
+        if (!reader->failed && path && lang != EXTRACTOR_LANG_UNKNOWN) {
+            parsed_file_t* file = extractor_ctx_acquire_file(ctx, path, lang);
+            if (file) {
+                extractor_ctx_release_file(ctx, file);
+            }
+        }
+        free(path);
+        free(language);
+        if (reader->failed) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int serve_symbols(byte_reader_t* reader, service_reply_t* reply) {
+    int missing;
+    char* query = read_string(reader, &missing);
+    int mode = (int)byte_reader_u32(reader);
+    int limit = (int)byte_reader_u32(reader);
+    if (reader->failed || !query || reply->count != 1) {
+        free(query);
+        return -1;
+    }
+    reply->results[0] = find_symbols(query, mode, limit);
+    reply->lengths[0] = reply->results[0] ? strlen(reply->results[0]) : 0;
+    free(query);
+    return 0;
+}
+
+// Write the results to shared memory and pass it to the client
+static int send_reply(int fd, const service_reply_t* reply, uint32_t status) {
+    int memory_fd = -1;
+    uint64_t size = 0;
+    if (status == 0) {
+        memory_fd = create_shared_memory();
+        status = memory_fd < 0;
+    }
+    if (status == 0) {
+        size = sizeof(uint32_t) * ((uint64_t)reply->count + 1);
+        for (uint32_t i = 0; i < reply->count; i++) {
+            size += reply->results[i] ? reply->lengths[i] + 1 : 0;
+        }
+        int failed = ftruncate(memory_fd, (off_t)size) != 0 || write_all(memory_fd, &reply->count, sizeof(uint32_t), 0) != 0;
+        for (uint32_t i = 0; !failed && i < reply->count; i++) {
+            uint32_t length = reply->results[i] ? (uint32_t)reply->lengths[i] : SERVICE_NO_STRING;
+            failed = write_all(memory_fd, &length, sizeof(length), 0) != 0;
+        }
+        // Binary records are not NUL-terminated themselves
+        for (uint32_t i = 0; !failed && i < reply->count; i++) {
+            failed = reply->results[i] && (write_all(memory_fd, reply->results[i], reply->lengths[i], 0) != 0 ||
+                                           write_all(memory_fd, "", 1, 0) != 0);
+        }
+        if (failed) {
+            close(memory_fd);
+            memory_fd = -1;
+            status = 1;
+            size = 0;
+        }
+    }
+
+    char header[SERVICE_REPLY_SIZE] = { 0 };
+    memcpy(header, &status, sizeof(status));
+    memcpy(header + 8, &size, sizeof(size));
+    union {
+        struct cmsghdr align;
+        char buffer[CMSG_SPACE(sizeof(int))];
+    } control;
+    struct iovec iov = { header, sizeof(header) };
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    if (memory_fd >= 0) {
+        memset(&control, 0, sizeof(control));
+        message.msg_control = control.buffer;
+        message.msg_controllen = sizeof(control.buffer);
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&message);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &memory_fd, sizeof(int));
+    }
+
+    ssize_t sent;
+    do {
+        sent = sendmsg(fd, &message, SERVICE_SEND_FLAGS);
+    } while (sent < 0 && errno == EINTR);
+    if (memory_fd >= 0) {
+        close(memory_fd);
+    }
+    if (sent < 0) {
+        return -1;
+    }
+    return write_all(fd, header + sent, sizeof(header) - (size_t)sent, 1);
+}
+
+// Answer the requests of a connection until the client closes it
+static void serve_connection(extractor_ctx_t* ctx, int fd) {
+    for (;;) {
+        uint32_t header[5];
+        if (read_all(fd, header, sizeof(header)) != 0) {
+            return;
+        }
+        uint32_t op = header[1];
+        uint32_t count = header[2];
+        uint32_t size = header[3];
+        if (header[0] != SERVICE_MAGIC || size > SERVICE_MAX_PAYLOAD || count > size) {
+            fprintf(stderr, "Skeleton service: malformed request\n");
+            return;
+        }
+        char* payload = (char*)malloc(size ? size : 1);
+        if (!payload || read_all(fd, payload, size) != 0) {
+            free(payload);
+            return;
+        }
+
+        byte_reader_t reader = { payload, payload + size, 0 };
+        service_reply_t reply;
+        int status = reply_init(&reply, count);
+        // Signatures of another body mode than the one of the client are refused, it extracts them itself
+        if (status == 0 && header[4] != (uint32_t)get_signature_body_mode()) {
+            status = -1;
+        } else if (status == 0) {
+            status = op == SERVICE_OP_SKELETONS ? serve_skeletons(ctx, &reader, &reply)
+                   : op == SERVICE_OP_SYMBOLS ? serve_symbols(&reader, &reply)
+                   : op == SERVICE_OP_WARM ? serve_warm(ctx, &reader, &reply)
+                   : -1;
+        }
+        free(payload);
+        int sent = send_reply(fd, &reply, status == 0 ? 0 : 1);
+        reply_free(&reply);
+        if (sent != 0) {
+            return;
+        }
+    }
+}
+
+// Threads accept connections from the shared listening socket in turn
+static void service_worker(void* arg) {
+    int listen_fd = *(int*)arg;
+    extractor_ctx_t* ctx = extractor_ctx_create();
+    if (!ctx) {
+        return;
+    }
+    for (;;) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            perror("Skeleton service: accept");
+            break;
+        }
+#if defined(SO_NOSIGPIPE)
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+        serve_connection(ctx, fd);
+        close(fd);
+    }
+    extractor_ctx_destroy(ctx);
+}
+
+int run_skeleton_service(const char* socket_path, int threads) {
+    struct sockaddr_un address;
+    if (!socket_path || socket_address(socket_path, &address) != 0) {
+        return -1;
+    }
+
+    // Requests of the service itself always run here
+    set_skeleton_service_path(NULL);
+
+    int running = connect_socket(socket_path);
+    if (running >= 0) {
+        close(running);
+        fprintf(stderr, "A skeleton service is already running on %s\n", socket_path);
+        return -1;
+    }
+    unlink(socket_path);
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        perror("Skeleton service: socket");
+        return -1;
+    }
+    fcntl(listen_fd, F_SETFD, FD_CLOEXEC);
+    // The socket is created owner-only rather than changed after bind, when others could connect.
+    // The service has started no thread yet, so the process-wide mask is safe to change.
+    mode_t mask = umask(0177);
+    int bound = bind(listen_fd, (struct sockaddr*)&address, sizeof(address));
+    umask(mask);
+    if (bound != 0 || listen(listen_fd, 64) != 0) {
+        perror("Skeleton service: bind");
+        close(listen_fd);
+        return -1;
+    }
+
+    if (threads <= 0) {
+        threads = platform_cpu_count();
+    }
+    platform_thread_t* workers = (platform_thread_t*)malloc(sizeof(platform_thread_t) * (size_t)threads);
+    int started = 0;
+    for (int i = 0; workers && i < threads - 1; i++) {
+        if (platform_thread_create(&workers[started], service_worker, &listen_fd) != 0) {
+            break;
+        }
+        started++;
+    }
+    service_worker(&listen_fd);
+    for (int i = 0; i < started; i++) {
+        platform_thread_join(workers[i]);
+    }
+    free(workers);
+    close(listen_fd);
+    unlink(socket_path);
+    return -1;
+}
+
+#endif
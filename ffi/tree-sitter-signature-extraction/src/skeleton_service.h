@@ -0,0 +1,90 @@
+#ifndef SKELETON_SERVICE_H
+#define SKELETON_SERVICE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "dll_export.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Environment variable naming the socket of a running service, read on first use
+#define SKELETON_SERVICE_ENV "SKELETON_SERVICE_SOCKET"
+
+// Kinds of skeleton a client asks the service for
+typedef enum {
+    SERVICE_SKELETON_XML = 0,        // get_skeleton_xml_budget, the argument is the budget, 0 for none
+    SERVICE_SKELETON_RECORDS = 1     // get_skeleton_records, the argument is the format
+} service_skeleton_kind_t;
+
+/**
+ * Serve skeleton and symbol requests of other processes on a Unix domain socket until the process
+ * exits. A pool of threads, each with its own extraction context, shares the skeleton cache and
+ * symbol table of this process, and replies are handed over in shared memory.
+ * @param socket_path Path of the socket, replaced if no service answers on it
+ * @param threads Number of threads serving connections, or 0 for one per processor
+ * @return -1 if the socket cannot be set up or another service is running on it
+ */
+DLL_EXPORT int run_skeleton_service(const char* socket_path, int threads);
+
+/**
+ * Send the skeleton and symbol requests of this process to the service listening on a socket.
+ * Without a path, the one in SKELETON_SERVICE_SOCKET is used. Requests run in process whenever
+ * the service cannot be reached, and when the body mode of this process differs from the one of
+ * the service.
+ * @param socket_path Path of the socket, or NULL to always run in process
+ */
+DLL_EXPORT void set_skeleton_service_path(const char* socket_path);
+
+/**
+ * Ask the service for one skeleton
+ * @param kind A service_skeleton_kind_t
+ * @param filename Path of the file
+ * @param language Language of the file
+ * @param start_line First line of the range, or -1 for the whole file
+ * @param end_line Last line of the range, or -1 for the whole file
+ * @param arg Budget or format, depending on kind
+ * @param result Output skeleton to be freed by the caller
+ * @param length Output length of the skeleton, may be NULL
+ * @return 0 if the service produced the skeleton, -1 to run the request in process, also for a
+ *         relative path, which the service would resolve against its own working directory
+ */
+int skeleton_service_skeleton(service_skeleton_kind_t kind, const char* filename, const char* language,
+                              int start_line, int end_line, uint64_t arg, char** result, size_t* length);
+
+/**
+ * Ask the service for the XML skeletons of many files, as get_skeleton_xml_batch_array
+ * @param paths Paths of the files
+ * @param languages Language of each file, or NULL to infer them from the extensions
+ * @param count Number of files
+ * @param results Output array of count skeletons, NULL entries for files that failed or have a
+ *                relative path, which the caller is left to extract in process
+ * @return 0 if the service answered, -1 to run the request in process
+ */
+int skeleton_service_batch(const char** paths, const char** languages, int count, char** results);
+
+/**
+ * Ask the service to parse files into its skeleton cache without rendering anything
+ * @param paths Paths of the files
+ * @param languages Language of each file
+ * @param count Number of files
+ * @return 0 if the service answered, -1 to parse them in process, also if a path is relative
+ */
+int skeleton_service_warm(const char** paths, const char** languages, int count);
+
+/**
+ * Ask the service to look symbols up, as find_symbols
+ * @param query Name to look for
+ * @param mode A symbol_match_mode_t
+ * @param limit Largest number of matches
+ * @param result Output matches to be freed by the caller
+ * @return 0 if the service produced the matches, -1 to run the request in process
+ */
+int skeleton_service_find_symbols(const char* query, int mode, int limit, char** result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SKELETON_SERVICE_H
@@ -0,0 +1,882 @@
+#include "skeleton_store.h"
+#include "parsed_file.h"
+#include "mapped_file.h"
+#include "platform.h"
+#include "utils.h"
+#include "xml_writer.h"
+#include "byte_buffer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STORE_HEADER_SIZE 16
+#define STORE_BYTE_ORDER 0x01020304u
+#define STORE_RECORD_PREFIX 12          // Record size and checksum
+#define STORE_RECORD_FIXED 32           // Content hash up to the path length
+#define STORE_NODE_FIXED 40             // Fixed part of a serialized node
+#define STORE_ERROR_FIXED 20            // Fixed part of a serialized error
+#define STORE_NO_STRING UINT32_MAX      // Length of a missing string
+#define STORE_COMPACT_MIN_BYTES (1024 * 1024)
+#define INITIAL_BUCKET_COUNT 64
+
+// Persisted skeleton of a file, pointing at its latest record
+typedef struct store_entry {
+    char* path;                      // Path of the file
+    extractor_language_t lang;       // Language the file was parsed as
+    int body_mode;                   // extract_body_mode_t of the forest
+    int64_t mtime_ns;                // Modification time when saved
+    uint64_t size;                   // Size when saved
+    uint64_t content_hash;           // Hash of the contents when saved
+    const char* record;              // Whole record, in the loaded index or owned_record
+    uint32_t record_size;            // Size of the record
+    char* owned_record;              // Record saved during this session, NULL if loaded
+    struct store_entry* next;        // Next entry in the same bucket
+} store_entry_t;
+
+// Record waiting for the background writer
+typedef struct pending_record {
+    char* data;
+    uint32_t size;
+    struct pending_record* next;
+} pending_record_t;
+
+struct skeleton_store {
+    platform_mutex_t lock;
+    platform_cond_t wake;            // Signals the writer of new records or of shutdown
+    platform_cond_t drained;         // Signals flushers once the writer is idle
+    char* path;                      // Index file, NULL when disabled
+    int loaded;                      // Whether the index file has been read
+    mapped_file_t* mapping;          // Index file as loaded, when mapped
+    char* contents;                  // Index file as loaded, when read
+    int compact;                     // Rewrite the index file before appending to it
+    uint64_t live_bytes;             // Bytes of the records entries point at
+    uint64_t dead_bytes;             // Bytes of replaced or dropped records
+    store_entry_t** buckets;
+    size_t bucket_count;
+    size_t entry_count;
+    pending_record_t* queue_head;
+    pending_record_t* queue_tail;
+    int writer_running;              // Whether the writer thread has been started
+    int writer_busy;                 // Whether the writer is writing a batch
+    int stopping;                    // Asks the writer to drain the queue and exit
+    platform_thread_t writer;
+};
+
+static skeleton_store_t global_store = {
+    .lock = PLATFORM_MUTEX_INITIALIZER,
+    .wake = PLATFORM_COND_INITIALIZER,
+    .drained = PLATFORM_COND_INITIALIZER,
+};
+
+skeleton_store_t* skeleton_store_global(void) {
+    return &global_store;
+}
+
+// Read a length-prefixed string, NULL for a missing one
+static const char* read_string(byte_reader_t* reader, uint32_t length) {
+    if (length == STORE_NO_STRING) {
+        return NULL;
+    }
+    return byte_reader_bytes(reader, length);
+}
+
+static void write_piece(const char* text, size_t length, void* arg) {
+    xml_writer_write((xml_writer_t*)arg, text, length);
+}
+
+// Serialize a node and its descendants in preorder, returning the number of nodes written
+static uint32_t write_node(xml_writer_t* writer, const signature_node_t* node) {
+    uint32_t child_count = 0;
+    for (const signature_node_t* child = node->children; child; child = child->next_sibling) {
+        child_count++;
+    }
+    size_t name_length = 0;
+    const char* name = signature_node_name(node, &name_length);
+    int has_signature = signature_node_has_signature(node);
+
+    char head[4] = { (char)node->type, 0, 0, 0 };
+    xml_writer_write(writer, head, sizeof(head));
+    byte_writer_u32(writer, (uint32_t)node->start_line);
+    byte_writer_u32(writer, (uint32_t)node->start_column);
+    byte_writer_u32(writer, (uint32_t)node->end_line);
+    byte_writer_u32(writer, (uint32_t)node->end_column);
+    byte_writer_u32(writer, node->start_byte);
+    byte_writer_u32(writer, node->end_byte);
+    byte_writer_u32(writer, child_count);
+    byte_writer_u32(writer, name ? (uint32_t)name_length : STORE_NO_STRING);
+    byte_writer_u32(writer, has_signature ? (uint32_t)signature_node_signature_length(node) : STORE_NO_STRING);
+    if (name) {
+        xml_writer_write(writer, name, name_length);
+    }
+    if (has_signature) {
+        signature_node_each_piece(node, write_piece, writer);
+    }
+
+    uint32_t count = 1;
+    for (const signature_node_t* child = node->children; child; child = child->next_sibling) {
+        count += write_node(writer, child);
+    }
+    return count;
+}
+
+static void write_nullable(xml_writer_t* writer, const char* text) {
+    if (text) {
+        xml_writer_write(writer, text, strlen(text));
+    }
+}
+
+// Serialize the record of a parsed file, returning it with its size or NULL on failure
+static char* serialize_record(const char* path, int64_t mtime_ns, uint64_t size,
+                              const parsed_file_t* file, uint32_t* record_size) {
+    xml_writer_t writer;
+    xml_writer_init(&writer, 4096);
+
+    // Size and checksum are patched in at the end
+    byte_writer_u32(&writer, 0);
+    byte_writer_u64(&writer, 0);
+    byte_writer_u64(&writer, file->content_hash);
+    byte_writer_u64(&writer, (uint64_t)mtime_ns);
+    byte_writer_u64(&writer, size);
+    char head[4] = { (char)file->lang, (char)file->body_mode, 0, 0 };
+    xml_writer_write(&writer, head, sizeof(head));
+    size_t path_length = strlen(path);
+    byte_writer_u32(&writer, (uint32_t)path_length);
+    xml_writer_write(&writer, path, path_length);
+
+    size_t counts_at = writer.length;
+    byte_writer_u32(&writer, 0);
+    byte_writer_u32(&writer, (uint32_t)file->error_count);
+    uint32_t node_count = 0;
+    for (const signature_node_t* node = file->forest; node; node = node->next_sibling) {
+        node_count += write_node(&writer, node);
+    }
+    for (int i = 0; file->errors && i < file->error_count; i++) {
+        const parse_error_t* error = &file->errors[i];
+        const char* strings[4] = { error->message, error->error_line,
+                                   error->code_above_error_line, error->code_below_error_line };
+        byte_writer_u32(&writer, (uint32_t)error->line);
+        for (int s = 0; s < 4; s++) {
+            byte_writer_u32(&writer, strings[s] ? (uint32_t)strlen(strings[s]) : STORE_NO_STRING);
+        }
+        for (int s = 0; s < 4; s++) {
+            write_nullable(&writer, strings[s]);
+        }
+    }
+
+    if (writer.failed || writer.length > UINT32_MAX) {
+        free(xml_writer_finish(&writer));
+        return NULL;
+    }
+    uint32_t total = (uint32_t)writer.length;
+    memcpy(writer.data, &total, sizeof(total));
+    memcpy(writer.data + counts_at, &node_count, sizeof(node_count));
+    uint64_t checksum = content_hash(writer.data + STORE_RECORD_PREFIX, total - STORE_RECORD_PREFIX);
+    memcpy(writer.data + 4, &checksum, sizeof(checksum));
+
+    *record_size = total;
+    return xml_writer_finish(&writer);
+}
+
+// Decode a node and its descendants, appending it to the children of parent or to the top level
+static int decode_node(byte_reader_t* reader, arena_t* arena, signature_node_t* parent,
+                       signature_node_t*** tail, uint32_t* remaining) {
+    if (*remaining == 0) {
+        return -1;
+    }
+    (*remaining)--;
+
+    const char* head = byte_reader_bytes(reader, 4);
+    int start_line = (int)byte_reader_u32(reader);
+    int start_column = (int)byte_reader_u32(reader);
+    int end_line = (int)byte_reader_u32(reader);
+    int end_column = (int)byte_reader_u32(reader);
+    uint32_t start_byte = byte_reader_u32(reader);
+    uint32_t end_byte = byte_reader_u32(reader);
+    uint32_t child_count = byte_reader_u32(reader);
+    uint32_t name_length = byte_reader_u32(reader);
+    uint32_t signature_length = byte_reader_u32(reader);
+    const char* name = read_string(reader, name_length);
+    const char* signature = read_string(reader, signature_length);
+    if (reader->failed) {
+        return -1;
+    }
+
+    signature_node_t* node = create_signature_node_in(arena, (entity_type_t)(unsigned char)head[0],
+                                                      name, name ? name_length : 0,
+                                                      signature, signature ? signature_length : 0,
+                                                      start_line, start_column, end_line, end_column);
+    if (!node) {
+        return -1;
+    }
+    node->start_byte = start_byte;
+    node->end_byte = end_byte;
+    node->parent = parent;
+    if (parent) {
+        parent->last_child = node;
+    }
+    **tail = node;
+    *tail = &node->next_sibling;
+
+    signature_node_t** child_tail = &node->children;
+    for (uint32_t i = 0; i < child_count; i++) {
+        if (decode_node(reader, arena, node, &child_tail, remaining) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int skeleton_store_decode(const char* data, size_t size, arena_t* arena, signature_node_t** forest,
+                          parse_error_t** errors, int* error_count) {
+    byte_reader_t reader = { data, data + size, 0 };
+    uint32_t node_count = byte_reader_u32(&reader);
+    uint32_t count = byte_reader_u32(&reader);
+    if (reader.failed || count > size / STORE_ERROR_FIXED) {
+        return -1;
+    }
+
+    *forest = NULL;
+    signature_node_t** tail = forest;
+    uint32_t remaining = node_count;
+    while (remaining > 0) {
+        if (decode_node(&reader, arena, NULL, &tail, &remaining) != 0) {
+            return -1;
+        }
+    }
+
+    *errors = NULL;
+    *error_count = 0;
+    if (count == 0) {
+        return 0;
+    }
+    parse_error_t* decoded = (parse_error_t*)arena_alloc(arena, sizeof(parse_error_t) * count);
+    if (!decoded) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        decoded[i].line = (int)byte_reader_u32(&reader);
+        uint32_t lengths[4];
+        for (int s = 0; s < 4; s++) {
+            lengths[s] = byte_reader_u32(&reader);
+        }
+        char** fields[4] = { &decoded[i].message, &decoded[i].error_line,
+                             &decoded[i].code_above_error_line, &decoded[i].code_below_error_line };
+        for (int s = 0; s < 4; s++) {
+            const char* text = read_string(&reader, lengths[s]);
+            *fields[s] = text ? arena_strndup(arena, text, lengths[s]) : NULL;
+        }
+        if (reader.failed) {
+            return -1;
+        }
+    }
+    *errors = decoded;
+    *error_count = (int)count;
+    return 0;
+}
+
+static size_t bucket_index(const skeleton_store_t* store, const char* path, extractor_language_t lang) {
+    uint64_t hash = content_hash(path, strlen(path)) ^ (uint64_t)lang;
+    return (size_t)(hash & (store->bucket_count - 1));
+}
+
+static store_entry_t** find_link(skeleton_store_t* store, const char* path, extractor_language_t lang) {
+    if (!store->buckets) {
+        return NULL;
+    }
+    store_entry_t** link = &store->buckets[bucket_index(store, path, lang)];
+    while (*link && ((*link)->lang != lang || strcmp((*link)->path, path) != 0)) {
+        link = &(*link)->next;
+    }
+    return link;
+}
+
+static void free_entry(store_entry_t* entry) {
+    free(entry->path);
+    free(entry->owned_record);
+    free(entry);
+}
+
+// Unlink and free the entry at link, its record becomes dead
+static void drop_entry(skeleton_store_t* store, store_entry_t** link) {
+    store_entry_t* entry = *link;
+    *link = entry->next;
+    store->live_bytes -= entry->record_size;
+    store->dead_bytes += entry->record_size;
+    store->entry_count--;
+    free_entry(entry);
+}
+
+static int grow_buckets(skeleton_store_t* store) {
+    size_t new_count = store->bucket_count ? store->bucket_count * 2 : INITIAL_BUCKET_COUNT;
+    store_entry_t** new_buckets = (store_entry_t**)calloc(new_count, sizeof(store_entry_t*));
+    if (!new_buckets) {
+        return -1;
+    }
+
+    store_entry_t** old_buckets = store->buckets;
+    size_t old_count = store->bucket_count;
+    store->buckets = new_buckets;
+    store->bucket_count = new_count;
+    for (size_t i = 0; i < old_count; i++) {
+        store_entry_t* entry = old_buckets[i];
+        while (entry) {
+            store_entry_t* next = entry->next;
+            size_t index = bucket_index(store, entry->path, entry->lang);
+            entry->next = new_buckets[index];
+            new_buckets[index] = entry;
+            entry = next;
+        }
+    }
+    free(old_buckets);
+    return 0;
+}
+
+// Point the entry of a path at a record, replacing any previous one. Takes ownership of owned_record.
+static int put_entry(skeleton_store_t* store, const char* path, size_t path_length, extractor_language_t lang,
+                     int body_mode, int64_t mtime_ns, uint64_t size, uint64_t hash,
+                     const char* record, uint32_t record_size, char* owned_record) {
+    store_entry_t* entry = (store_entry_t*)calloc(1, sizeof(store_entry_t));
+    if (!entry || !(entry->path = (char*)malloc(path_length + 1))) {
+        free(entry);
+        free(owned_record);
+        return -1;
+    }
+    memcpy(entry->path, path, path_length);
+    entry->path[path_length] = '\0';
+
+    store_entry_t** link = find_link(store, entry->path, lang);
+    if (link && *link) {
+        drop_entry(store, link);
+    }
+    if (store->entry_count + 1 > store->bucket_count && grow_buckets(store) != 0) {
+        free(entry->path);
+        free(entry);
+        free(owned_record);
+        return -1;
+    }
+
+    entry->lang = lang;
+    entry->body_mode = body_mode;
+    entry->mtime_ns = mtime_ns;
+    entry->size = size;
+    entry->content_hash = hash;
+    entry->record = record;
+    entry->record_size = record_size;
+    entry->owned_record = owned_record;
+    size_t index = bucket_index(store, entry->path, lang);
+    entry->next = store->buckets[index];
+    store->buckets[index] = entry;
+    store->entry_count++;
+    store->live_bytes += record_size;
+    return 0;
+}
+
+// Index the records of the loaded file, returning whether some of it is unreadable.
+// A record failing its checksum is skipped by its size, a size running past the end is a torn tail.
+static int index_records(skeleton_store_t* store, const char* data, size_t size) {
+    size_t offset = STORE_HEADER_SIZE;
+    int damaged = 0;
+    while (size - offset >= STORE_RECORD_PREFIX + STORE_RECORD_FIXED) {
+        uint32_t record_size;
+        uint64_t checksum;
+        memcpy(&record_size, data + offset, sizeof(record_size));
+        memcpy(&checksum, data + offset + 4, sizeof(checksum));
+        if (record_size < STORE_RECORD_PREFIX + STORE_RECORD_FIXED || record_size > size - offset) {
+            break; // Torn tail, left to compaction
+        }
+        if (content_hash(data + offset + STORE_RECORD_PREFIX, record_size - STORE_RECORD_PREFIX) != checksum) {
+            store->dead_bytes += record_size;
+            damaged = 1;
+            offset += record_size;
+            continue;
+        }
+
+        const char* record = data + offset;
+        byte_reader_t reader = { record + STORE_RECORD_PREFIX, record + record_size, 0 };
+        uint64_t hash = byte_reader_u64(&reader);
+        int64_t mtime_ns = (int64_t)byte_reader_u64(&reader);
+        uint64_t file_size = byte_reader_u64(&reader);
+        const char* head = byte_reader_bytes(&reader, 4);
+        uint32_t path_length = byte_reader_u32(&reader);
+        const char* path = byte_reader_bytes(&reader, path_length);
+        if (reader.failed || (unsigned char)head[0] >= EXTRACTOR_LANG_COUNT) {
+            store->dead_bytes += record_size;
+            damaged = 1;
+            offset += record_size;
+            continue;
+        }
+        if (put_entry(store, path, path_length, (extractor_language_t)(unsigned char)head[0],
+                      (unsigned char)head[1], mtime_ns, file_size, hash, record, record_size, NULL) != 0) {
+            return 1;
+        }
+        offset += record_size;
+    }
+    return damaged || offset < size;
+}
+
+// Read the index file on first use, called with the lock held
+static void load_locked(skeleton_store_t* store) {
+    if (store->loaded) {
+        return;
+    }
+    store->loaded = 1;
+    store->compact = 1; // Until a valid index file proves otherwise
+
+    int64_t mtime_ns;
+    uint64_t size;
+    if (platform_file_stat(store->path, &mtime_ns, &size) != 0 || size < STORE_HEADER_SIZE) {
+        return;
+    }
+
+    // Mapped where possible; Windows cannot replace a mapped file, so the index is read there
+    const char* data = NULL;
+    size_t data_size = 0;
+#if !defined(_WIN32) && !defined(__CYGWIN__)
+    store->mapping = mapped_file_map(store->path);
+#endif
+    if (store->mapping) {
+        data = store->mapping->data;
+        data_size = store->mapping->size;
+    } else {
+        store->contents = read_file(store->path, &data_size);
+        data = store->contents;
+    }
+    if (!data || data_size < STORE_HEADER_SIZE) {
+        return;
+    }
+
+    uint32_t version, byte_order;
+    memcpy(&version, data + 4, sizeof(version));
+    memcpy(&byte_order, data + 8, sizeof(byte_order));
+    if (memcmp(data, SKELETON_STORE_MAGIC, 4) != 0 || version != SKELETON_STORE_VERSION ||
+        byte_order != STORE_BYTE_ORDER) {
+        return;
+    }
+
+    int damaged = index_records(store, data, data_size);
+    store->compact = damaged ||
+                     (store->dead_bytes > store->live_bytes && store->dead_bytes > STORE_COMPACT_MIN_BYTES);
+}
+
+// Forget the loaded index, called with the lock held and the writer stopped
+static void unload_locked(skeleton_store_t* store) {
+    for (size_t i = 0; i < store->bucket_count; i++) {
+        store_entry_t* entry = store->buckets[i];
+        while (entry) {
+            store_entry_t* next = entry->next;
+            free_entry(entry);
+            entry = next;
+        }
+    }
+    free(store->buckets);
+    store->buckets = NULL;
+    store->bucket_count = 0;
+    store->entry_count = 0;
+    store->live_bytes = 0;
+    store->dead_bytes = 0;
+    mapped_file_close(store->mapping);
+    store->mapping = NULL;
+    free(store->contents);
+    store->contents = NULL;
+    store->loaded = 0;
+    store->compact = 0;
+}
+
+static int write_header(FILE* out) {
+    char header[STORE_HEADER_SIZE] = { 0 };
+    uint32_t version = SKELETON_STORE_VERSION;
+    uint32_t byte_order = STORE_BYTE_ORDER;
+    memcpy(header, SKELETON_STORE_MAGIC, 4);
+    memcpy(header + 4, &version, sizeof(version));
+    memcpy(header + 8, &byte_order, sizeof(byte_order));
+    return fwrite(header, 1, sizeof(header), out) == sizeof(header) ? 0 : -1;
+}
+
+// Live records to rewrite the index file with, taken under the lock and written outside it.
+// Records of the loaded index stay put until unload_locked, which waits for the writer;
+// records saved during this session are freed when replaced, so they are copied.
+typedef struct {
+    const char** records;
+    uint32_t* sizes;
+    size_t count;
+    char* copies;                    // Records saved during this session, back to back
+    uint64_t dead_bytes;             // Dead bytes the rewrite gets rid of
+} store_snapshot_t;
+
+static void free_snapshot(store_snapshot_t* snapshot) {
+    free(snapshot->records);
+    free(snapshot->sizes);
+    free(snapshot->copies);
+    memset(snapshot, 0, sizeof(*snapshot));
+}
+
+// Take the live records, called with the lock held
+static int snapshot_locked(skeleton_store_t* store, store_snapshot_t* snapshot) {
+    memset(snapshot, 0, sizeof(*snapshot));
+    size_t copied_bytes = 0;
+    for (size_t i = 0; i < store->bucket_count; i++) {
+        for (store_entry_t* entry = store->buckets[i]; entry; entry = entry->next) {
+            if (entry->owned_record) {
+                copied_bytes += entry->record_size;
+            }
+        }
+    }
+    size_t count = store->entry_count > 0 ? store->entry_count : 1;
+    snapshot->records = (const char**)malloc(count * sizeof(const char*));
+    snapshot->sizes = (uint32_t*)malloc(count * sizeof(uint32_t));
+    snapshot->copies = copied_bytes > 0 ? (char*)malloc(copied_bytes) : NULL;
+    if (!snapshot->records || !snapshot->sizes || (copied_bytes > 0 && !snapshot->copies)) {
+        free_snapshot(snapshot);
+        return -1;
+    }
+
+    char* copy = snapshot->copies;
+    for (size_t i = 0; i < store->bucket_count; i++) {
+        for (store_entry_t* entry = store->buckets[i]; entry; entry = entry->next) {
+            const char* record = entry->record;
+            if (entry->owned_record) {
+                memcpy(copy, entry->record, entry->record_size);
+                record = copy;
+                copy += entry->record_size;
+            }
+            snapshot->records[snapshot->count] = record;
+            snapshot->sizes[snapshot->count] = entry->record_size;
+            snapshot->count++;
+        }
+    }
+    snapshot->dead_bytes = store->dead_bytes;
+    return 0;
+}
+
+// Rewrite the index file with the records of a snapshot, through a file of a unique name
+static int write_snapshot(const char* path, const store_snapshot_t* snapshot) {
+    char* temp_path = NULL;
+    FILE* out = platform_temp_file(path, &temp_path);
+    if (!out) {
+        return -1;
+    }
+    int status = write_header(out);
+    for (size_t i = 0; status == 0 && i < snapshot->count; i++) {
+        if (fwrite(snapshot->records[i], 1, snapshot->sizes[i], out) != snapshot->sizes[i]) {
+            status = -1;
+        }
+    }
+    if (fclose(out) != 0) {
+        status = -1;
+    }
+    if (status == 0 && platform_file_replace(temp_path, path) != 0) {
+        status = -1;
+    }
+    if (status != 0) {
+        remove(temp_path);
+    }
+    free(temp_path);
+    return status;
+}
+
+// Lock the index file against the writers of other processes, through a lock file next to it
+// that compaction does not replace
+static int lock_index(const char* path, platform_file_lock_t* lock) {
+    size_t path_length = strlen(path);
+    char* lock_path = (char*)malloc(path_length + 6);
+    if (!lock_path) {
+        return -1;
+    }
+    memcpy(lock_path, path, path_length);
+    memcpy(lock_path + path_length, ".lock", 6);
+    int status = platform_file_lock(lock_path, lock);
+    free(lock_path);
+    return status;
+}
+
+static void free_pending(pending_record_t* record) {
+    while (record) {
+        pending_record_t* next = record->next;
+        free(record->data);
+        free(record);
+        record = next;
+    }
+}
+
+// Background writer appending queued records to the index file
+static void writer_main(void* arg) {
+    skeleton_store_t* store = (skeleton_store_t*)arg;
+    platform_mutex_lock(&store->lock);
+    for (;;) {
+        while (!store->queue_head && !store->stopping) {
+            platform_cond_wait(&store->wake, &store->lock);
+        }
+        if (!store->queue_head) {
+            break;
+        }
+
+        pending_record_t* batch = store->queue_head;
+        store->queue_head = store->queue_tail = NULL;
+        store->writer_busy = 1;
+
+        // A compacted file already holds every live record, the batch included
+        store_snapshot_t snapshot = { 0 };
+        int compact = store->compact && snapshot_locked(store, &snapshot) == 0;
+        store->compact = 0;
+        char* path = strdup(store->path);
+        platform_mutex_unlock(&store->lock);
+
+        // Without the lock file, for instance in a read-only directory, the index is written unlocked
+        platform_file_lock_t file_lock;
+        int locked = path && lock_index(path, &file_lock) == 0;
+        int compacted = 0;
+        if (compact && path) {
+            if (write_snapshot(path, &snapshot) == 0) {
+                compacted = 1;
+                free_pending(batch);
+                batch = NULL;
+            } else {
+                fprintf(stderr, "Failed to rewrite skeleton index %s\n", path);
+            }
+        }
+        FILE* out = path && batch ? fopen(path, "ab") : NULL;
+        for (pending_record_t* record = batch; out && record; record = record->next) {
+            if (fwrite(record->data, 1, record->size, out) != record->size) {
+                break;
+            }
+        }
+        if (out) {
+            fclose(out);
+        }
+        if (locked) {
+            platform_file_unlock(file_lock);
+        }
+        free_pending(batch);
+        free(path);
+
+        platform_mutex_lock(&store->lock);
+        if (compacted) {
+            // Records replaced meanwhile were still written, and stay dead in the new file
+            store->dead_bytes -= snapshot.dead_bytes;
+        }
+        free_snapshot(&snapshot);
+        store->writer_busy = 0;
+        platform_cond_broadcast(&store->drained);
+    }
+    platform_cond_broadcast(&store->drained);
+    platform_mutex_unlock(&store->lock);
+}
+
+// Queue a copy of a record for the writer, called with the lock held
+static void enqueue_locked(skeleton_store_t* store, const char* data, uint32_t size) {
+    if (store->stopping) {
+        return;
+    }
+    pending_record_t* record = (pending_record_t*)malloc(sizeof(pending_record_t));
+    if (!record || !(record->data = (char*)malloc(size))) {
+        free(record);
+        return;
+    }
+    memcpy(record->data, data, size);
+    record->size = size;
+    record->next = NULL;
+    if (store->queue_tail) {
+        store->queue_tail->next = record;
+    } else {
+        store->queue_head = record;
+    }
+    store->queue_tail = record;
+
+    if (!store->writer_running) {
+        if (platform_thread_create(&store->writer, writer_main, store) != 0) {
+            store->queue_head = store->queue_tail = NULL;
+            free_pending(record);
+            return;
+        }
+        store->writer_running = 1;
+    }
+    platform_cond_broadcast(&store->wake);
+}
+
+// Stop the writer once it has drained the queue
+static void stop_writer(skeleton_store_t* store) {
+    platform_mutex_lock(&store->lock);
+    int running = store->writer_running;
+    store->stopping = 1;
+    platform_cond_broadcast(&store->wake);
+    platform_mutex_unlock(&store->lock);
+
+    if (running) {
+        platform_thread_join(store->writer);
+    }
+
+    platform_mutex_lock(&store->lock);
+    store->writer_running = 0;
+    store->stopping = 0;
+    platform_mutex_unlock(&store->lock);
+}
+
+int skeleton_store_enabled(skeleton_store_t* store) {
+    platform_mutex_lock(&store->lock);
+    int enabled = store->path != NULL;
+    platform_mutex_unlock(&store->lock);
+    return enabled;
+}
+
+// Offset of the forest within a record
+static size_t forest_offset(const store_entry_t* entry) {
+    uint32_t path_length;
+    memcpy(&path_length, entry->record + STORE_RECORD_PREFIX + STORE_RECORD_FIXED - 4, sizeof(path_length));
+    return STORE_RECORD_PREFIX + STORE_RECORD_FIXED + path_length;
+}
+
+// Keep an entry whose file was touched but not changed, so the next session trusts the new time again
+static void refresh_entry_locked(skeleton_store_t* store, store_entry_t* entry, int64_t mtime_ns) {
+    char* record = (char*)malloc(entry->record_size);
+    if (!record) {
+        return;
+    }
+    memcpy(record, entry->record, entry->record_size);
+    memcpy(record + STORE_RECORD_PREFIX + 8, &mtime_ns, sizeof(mtime_ns));
+    uint64_t checksum = content_hash(record + STORE_RECORD_PREFIX, entry->record_size - STORE_RECORD_PREFIX);
+    memcpy(record + 4, &checksum, sizeof(checksum));
+
+    store->dead_bytes += entry->record_size;
+    free(entry->owned_record);
+    entry->owned_record = record;
+    entry->record = record;
+    entry->mtime_ns = mtime_ns;
+    enqueue_locked(store, record, entry->record_size);
+}
+
+parsed_file_t* skeleton_store_load(skeleton_store_t* store, const char* path, extractor_language_t lang,
+                                   int body_mode, int64_t mtime_ns, uint64_t size,
+                                   const char* data, size_t data_size) {
+    platform_mutex_lock(&store->lock);
+    if (!store->path) {
+        platform_mutex_unlock(&store->lock);
+        return NULL;
+    }
+    load_locked(store);
+    store_entry_t** link = find_link(store, path, lang);
+    store_entry_t* entry = link ? *link : NULL;
+    if (!entry || entry->body_mode != body_mode) {
+        platform_mutex_unlock(&store->lock);
+        return NULL;
+    }
+
+    if (entry->mtime_ns != mtime_ns || entry->size != size) {
+        if (!data || data_size != entry->size) {
+            if (data) {
+                drop_entry(store, link);
+            }
+            platform_mutex_unlock(&store->lock);
+            return NULL;
+        }
+
+        // Hash the contents outside the lock, then look the entry up again
+        uint64_t expected_hash = entry->content_hash;
+        platform_mutex_unlock(&store->lock);
+        uint64_t hash = content_hash(data, data_size);
+        platform_mutex_lock(&store->lock);
+        link = find_link(store, path, lang);
+        entry = link ? *link : NULL;
+        if (!entry || entry->content_hash != expected_hash) {
+            platform_mutex_unlock(&store->lock);
+            return NULL;
+        }
+        if (hash != expected_hash) {
+            drop_entry(store, link);
+            platform_mutex_unlock(&store->lock);
+            return NULL;
+        }
+        refresh_entry_locked(store, entry, mtime_ns);
+    }
+
+    // Records were validated when indexed, the forest follows the path
+    size_t offset = forest_offset(entry);
+    parsed_file_t* file = parsed_file_restore(lang, body_mode, entry->content_hash,
+                                              entry->record + offset, entry->record_size - offset);
+    if (!file) {
+        link = find_link(store, path, lang);
+        drop_entry(store, link);
+    }
+    platform_mutex_unlock(&store->lock);
+    return file;
+}
+
+void skeleton_store_save(skeleton_store_t* store, const char* path, int64_t mtime_ns, uint64_t size,
+                         const parsed_file_t* file) {
+    if (!file || !file->hashed || !skeleton_store_enabled(store)) {
+        return;
+    }
+    uint32_t record_size = 0;
+    char* record = serialize_record(path, mtime_ns, size, file, &record_size);
+    if (!record) {
+        return;
+    }
+
+    platform_mutex_lock(&store->lock);
+    if (store->path) {
+        load_locked(store);
+        if (put_entry(store, path, strlen(path), file->lang, file->body_mode, mtime_ns, size,
+                      file->content_hash, record, record_size, record) == 0) {
+            enqueue_locked(store, record, record_size);
+        }
+    } else {
+        free(record);
+    }
+    platform_mutex_unlock(&store->lock);
+}
+
+void skeleton_store_each(skeleton_store_t* store,
+                         void (*fn)(const char* path, const signature_node_t* forest, void* arg), void* arg) {
+    platform_mutex_lock(&store->lock);
+    if (store->path) {
+        load_locked(store);
+    }
+    for (size_t i = 0; i < store->bucket_count; i++) {
+        for (store_entry_t* entry = store->buckets[i]; entry; entry = entry->next) {
+            arena_t arena;
+            arena_init(&arena);
+            signature_node_t* forest;
+            parse_error_t* errors;
+            int error_count;
+            size_t offset = forest_offset(entry);
+            if (skeleton_store_decode(entry->record + offset, entry->record_size - offset, &arena,
+                                      &forest, &errors, &error_count) == 0) {
+                fn(entry->path, forest, arg);
+            }
+            arena_release(&arena);
+        }
+    }
+    platform_mutex_unlock(&store->lock);
+}
+
+int set_skeleton_index_path(const char* path) {
+    skeleton_store_t* store = skeleton_store_global();
+    platform_mutex_lock(&store->lock);
+    int unchanged = (!path && !store->path) || (path && store->path && strcmp(path, store->path) == 0);
+    platform_mutex_unlock(&store->lock);
+    if (unchanged) {
+        return 0;
+    }
+
+    char* copy = path ? strdup(path) : NULL;
+    if (path && !copy) {
+        return -1;
+    }
+    stop_writer(store);
+
+    platform_mutex_lock(&store->lock);
+    unload_locked(store);
+    free(store->path);
+    store->path = copy;
+    platform_mutex_unlock(&store->lock);
+    return 0;
+}
+
+void flush_skeleton_index(void) {
+    skeleton_store_t* store = skeleton_store_global();
+    platform_mutex_lock(&store->lock);
+    while (store->writer_running && (store->queue_head || store->writer_busy)) {
+        platform_cond_wait(&store->drained, &store->lock);
+    }
+    platform_mutex_unlock(&store->lock);
+}
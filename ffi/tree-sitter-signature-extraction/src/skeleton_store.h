@@ -0,0 +1,111 @@
+#ifndef SKELETON_STORE_H
+#define SKELETON_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "dll_export.h"
+#include "extractor_context.h"
+#include "signature_node.h"
+#include "arena.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Forward declarations
+typedef struct parsed_file parsed_file_t;
+typedef struct skeleton_store skeleton_store_t;
+
+// Index file layout, integers in host byte order (the index is a local cache):
+//   header   magic "MSKI", u32 version, u32 byte order mark 0x01020304, u32 reserved
+//   records  appended one after the other, a later record of a path replaces the earlier ones
+// A record is: u32 record size, u64 FNV-1a checksum of the rest of the record, u64 content hash,
+// i64 mtime, u64 file size, u8 language, u8 body mode, u16 reserved, u32 path length, path,
+// u32 node count, u32 error count, the nodes in preorder, then the errors.
+#define SKELETON_STORE_MAGIC "MSKI"
+#define SKELETON_STORE_VERSION 1
+
+/**
+ * Get the process-wide skeleton store
+ * @return Store, disabled until set_skeleton_index_path is called
+ */
+skeleton_store_t* skeleton_store_global(void);
+
+/**
+ * Load the persisted skeleton of a file. An entry is reused if the file still has the
+ * modification time and size it had when saved, or, when data is given, if the contents
+ * still hash the same; an entry whose contents changed is dropped.
+ * @param store Store
+ * @param path Path of the file
+ * @param lang Language of the file
+ * @param body_mode extract_body_mode_t the skeleton must have been extracted with
+ * @param mtime_ns Current modification time of the file
+ * @param size Current size of the file
+ * @param data Current contents of the file, or NULL to only compare the modification time and size
+ * @param data_size Size of data
+ * @return New parsed file without a tree, or NULL if there is no usable entry
+ */
+parsed_file_t* skeleton_store_load(skeleton_store_t* store, const char* path, extractor_language_t lang,
+                                   int body_mode, int64_t mtime_ns, uint64_t size,
+                                   const char* data, size_t data_size);
+
+/**
+ * Persist the skeleton of a parsed file. The record is serialized right away and
+ * appended to the index file by a background writer.
+ * @param store Store
+ * @param path Path of the file
+ * @param mtime_ns Modification time of the file that was parsed
+ * @param size Size of the file that was parsed
+ * @param file Parsed file, skipped unless hashed with parsed_file_hash
+ */
+void skeleton_store_save(skeleton_store_t* store, const char* path, int64_t mtime_ns, uint64_t size,
+                         const parsed_file_t* file);
+
+/**
+ * Whether the store has an index file
+ * @param store Store
+ * @return Non-zero if enabled
+ */
+int skeleton_store_enabled(skeleton_store_t* store);
+
+/**
+ * Call a function on the forest of every entry, e.g. to index symbols without reading any source.
+ * The store lock is held during the calls.
+ * @param store Store
+ * @param fn Function receiving the path and the forest of an entry, only valid during the call
+ * @param arg Argument passed to fn
+ */
+void skeleton_store_each(skeleton_store_t* store,
+                         void (*fn)(const char* path, const signature_node_t* forest, void* arg), void* arg);
+
+/**
+ * Decode the forest of a record into an arena
+ * @param data Forest part of a record
+ * @param size Size of data
+ * @param arena Arena of the nodes and errors
+ * @param forest Output top-level nodes
+ * @param errors Output errors
+ * @param error_count Output number of errors
+ * @return 0 on success, -1 if the data is malformed
+ */
+int skeleton_store_decode(const char* data, size_t size, arena_t* arena, signature_node_t** forest,
+                          parse_error_t** errors, int* error_count);
+
+/**
+ * Enable the on-disk index, typically <project>/.magic-cli/skeleton-index.bin. The index is
+ * read lazily on the first lookup; passing NULL flushes and disables it.
+ * @param path Path of the index file, its directory must exist
+ * @return 0 on success, -1 on failure
+ */
+DLL_EXPORT int set_skeleton_index_path(const char* path);
+
+/**
+ * Wait until every pending record has been written to the index file
+ */
+DLL_EXPORT void flush_skeleton_index(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SKELETON_STORE_H
@@ -0,0 +1,557 @@
+#include "symbol_table.h"
+#include "parsed_file.h"
+#include "skeleton_store.h"
+#include "skeleton_service.h"
+#include "platform.h"
+#include "xml_writer.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define NO_NAME UINT32_MAX
+#define DEAD_FILE UINT32_MAX
+#define INITIAL_SLOT_COUNT 1024
+#define COMPACT_MIN_DEAD 4096
+#define DEFAULT_FIND_LIMIT 100
+
+// A definition, its strings are offsets into the pool
+typedef struct {
+    uint32_t name;                   // Name of the entity
+    uint32_t container;              // Name of the enclosing entity, NO_NAME at top level
+    uint32_t file;                   // Index of the file, DEAD_FILE once replaced
+    int32_t start_line;
+    int32_t end_line;
+    uint8_t type;                    // entity_type_t
+} symbol_t;
+
+// A file and the contiguous run of its current symbols
+typedef struct {
+    uint32_t path;                   // Path in the pool
+    uint32_t first;                  // First symbol
+    uint32_t count;                  // Number of symbols
+} symbol_file_t;
+
+struct symbol_table {
+    platform_mutex_t lock;
+    int seeded;                      // Whether the on-disk index has been read
+    char* pool;                      // Interned NUL-terminated strings
+    size_t pool_length;
+    size_t pool_capacity;
+    uint32_t* strings;               // Open-addressing set of pool offsets + 1, 0 when free
+    size_t string_slots;
+    size_t string_count;
+    uint32_t* file_slots;            // Open-addressing map of path offsets to file index + 1
+    size_t file_slot_count;
+    symbol_t* symbols;
+    uint32_t symbol_count;
+    uint32_t symbol_capacity;
+    uint32_t dead_count;             // Replaced symbols not compacted yet
+    symbol_file_t* files;
+    uint32_t file_count;
+    uint32_t file_capacity;
+    uint32_t* order;                 // Live symbols sorted by name
+    uint32_t order_count;
+};
+
+static symbol_table_t global_table = {
+    .lock = PLATFORM_MUTEX_INITIALIZER,
+};
+
+symbol_table_t* symbol_table_global(void) {
+    return &global_table;
+}
+
+void symbol_table_lock(symbol_table_t* table) {
+    platform_mutex_lock(&table->lock);
+}
+
+void symbol_table_unlock(symbol_table_t* table) {
+    platform_mutex_unlock(&table->lock);
+}
+
+static int grow_array(void** data, uint32_t* capacity, uint32_t needed, size_t item_size) {
+    if (needed <= *capacity) {
+        return 0;
+    }
+    uint32_t new_capacity = *capacity ? *capacity : 256;
+    while (new_capacity < needed) {
+        new_capacity *= 2;
+    }
+    void* grown = realloc(*data, (size_t)new_capacity * item_size);
+    if (!grown) {
+        return -1;
+    }
+    *data = grown;
+    *capacity = new_capacity;
+    return 0;
+}
+
+static char fold(char c) {
+    return (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+}
+
+// Order names ignoring ASCII case, then by bytes
+static int compare_names(const char* a, const char* b) {
+    const char* x = a;
+    const char* y = b;
+    while (*x && fold(*x) == fold(*y)) {
+        x++;
+        y++;
+    }
+    int folded = (unsigned char)fold(*x) - (unsigned char)fold(*y);
+    return folded ? folded : strcmp(a, b);
+}
+
+// Compare the folded start of a name with a folded prefix: 0 if name starts with it
+static int compare_prefix(const char* name, const char* prefix, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        unsigned char n = (unsigned char)fold(name[i]);
+        unsigned char p = (unsigned char)fold(prefix[i]);
+        if (n != p || !n) {
+            return (int)n - (int)p;
+        }
+    }
+    return 0;
+}
+
+static int rehash_strings(symbol_table_t* table) {
+    size_t new_slots = table->string_slots ? table->string_slots * 2 : INITIAL_SLOT_COUNT;
+    uint32_t* slots = (uint32_t*)calloc(new_slots, sizeof(uint32_t));
+    if (!slots) {
+        return -1;
+    }
+    for (size_t i = 0; i < table->string_slots; i++) {
+        uint32_t entry = table->strings[i];
+        if (entry) {
+            const char* text = table->pool + entry - 1;
+            size_t slot = (size_t)content_hash(text, strlen(text)) & (new_slots - 1);
+            while (slots[slot]) slot = (slot + 1) & (new_slots - 1);
+            slots[slot] = entry;
+        }
+    }
+    free(table->strings);
+    table->strings = slots;
+    table->string_slots = new_slots;
+    return 0;
+}
+
+// Intern a string, returning its offset in the pool or NO_NAME on failure
+static uint32_t intern(symbol_table_t* table, const char* text, size_t length) {
+    if ((table->string_count + 1) * 2 > table->string_slots && rehash_strings(table) != 0) {
+        return NO_NAME;
+    }
+    size_t mask = table->string_slots - 1;
+    size_t slot = (size_t)content_hash(text, length) & mask;
+    for (uint32_t entry; (entry = table->strings[slot]) != 0; slot = (slot + 1) & mask) {
+        const char* existing = table->pool + entry - 1;
+        if (strncmp(existing, text, length) == 0 && existing[length] == '\0') {
+            return entry - 1;
+        }
+    }
+
+    if (table->pool_length + length + 1 >= NO_NAME) {
+        return NO_NAME;
+    }
+    if (table->pool_length + length + 1 > table->pool_capacity) {
+        size_t capacity = table->pool_capacity ? table->pool_capacity : 64 * 1024;
+        while (capacity < table->pool_length + length + 1) {
+            capacity *= 2;
+        }
+        char* pool = (char*)realloc(table->pool, capacity);
+        if (!pool) {
+            return NO_NAME;
+        }
+        table->pool = pool;
+        table->pool_capacity = capacity;
+    }
+    uint32_t offset = (uint32_t)table->pool_length;
+    memcpy(table->pool + offset, text, length);
+    table->pool[offset + length] = '\0';
+    table->pool_length += length + 1;
+    table->strings[slot] = offset + 1;
+    table->string_count++;
+    return offset;
+}
+
+static size_t file_slot(const symbol_table_t* table, uint32_t path) {
+    return ((size_t)path * 2654435761u) & (table->file_slot_count - 1);
+}
+
+// Find, or add if create is set, the file of an interned path; DEAD_FILE if absent or on failure
+static uint32_t file_index(symbol_table_t* table, uint32_t path, int create) {
+    if (!create && table->file_slot_count == 0) {
+        return DEAD_FILE;
+    }
+    if (create && (table->file_count + 1) * 2 > table->file_slot_count) {
+        size_t new_count = table->file_slot_count ? table->file_slot_count * 2 : INITIAL_SLOT_COUNT;
+        uint32_t* slots = (uint32_t*)calloc(new_count, sizeof(uint32_t));
+        if (!slots) {
+            return DEAD_FILE;
+        }
+        free(table->file_slots);
+        table->file_slots = slots;
+        table->file_slot_count = new_count;
+        for (uint32_t i = 0; i < table->file_count; i++) {
+            size_t slot = file_slot(table, table->files[i].path);
+            while (slots[slot]) slot = (slot + 1) & (new_count - 1);
+            slots[slot] = i + 1;
+        }
+    }
+
+    size_t mask = table->file_slot_count - 1;
+    size_t slot = file_slot(table, path);
+    for (uint32_t entry; (entry = table->file_slots[slot]) != 0; slot = (slot + 1) & mask) {
+        if (table->files[entry - 1].path == path) {
+            return entry - 1;
+        }
+    }
+    if (!create) {
+        return DEAD_FILE;
+    }
+    if (grow_array((void**)&table->files, &table->file_capacity, table->file_count + 1, sizeof(symbol_file_t)) != 0) {
+        return DEAD_FILE;
+    }
+    uint32_t index = table->file_count++;
+    table->files[index].path = path;
+    table->files[index].first = 0;
+    table->files[index].count = 0;
+    table->file_slots[slot] = index + 1;
+    return index;
+}
+
+// Append the symbols of a sibling list and their descendants
+static int add_symbols(symbol_table_t* table, const signature_node_t* node, uint32_t file, uint32_t container) {
+    for (; node; node = node->next_sibling) {
+        size_t length = 0;
+        const char* name = signature_node_name(node, &length);
+        uint32_t name_offset = name && length > 0 ? intern(table, name, length) : NO_NAME;
+        if (name_offset != NO_NAME) {
+            if (grow_array((void**)&table->symbols, &table->symbol_capacity, table->symbol_count + 1,
+                           sizeof(symbol_t)) != 0) {
+                return -1;
+            }
+            symbol_t* symbol = &table->symbols[table->symbol_count++];
+            symbol->name = name_offset;
+            symbol->container = container;
+            symbol->file = file;
+            symbol->start_line = node->start_line;
+            symbol->end_line = node->end_line;
+            symbol->type = (uint8_t)node->type;
+        }
+        if (add_symbols(table, node->children, file, name_offset != NO_NAME ? name_offset : container) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+typedef struct {
+    const char* name;
+    uint32_t id;
+} sort_key_t;
+
+static int compare_keys(const void* a, const void* b) {
+    const sort_key_t* left = (const sort_key_t*)a;
+    const sort_key_t* right = (const sort_key_t*)b;
+    int order = compare_names(left->name, right->name);
+    return order ? order : (left->id > right->id) - (left->id < right->id);
+}
+
+// Merge the new symbols [first, symbol_count) into the order, dropping the dead ones
+static int merge_order(symbol_table_t* table, uint32_t first) {
+    uint32_t added = table->symbol_count - first;
+    sort_key_t* keys = (sort_key_t*)malloc(sizeof(sort_key_t) * (added ? added : 1));
+    uint32_t* merged = (uint32_t*)malloc(sizeof(uint32_t) * (table->order_count + added + 1));
+    if (!keys || !merged) {
+        free(keys);
+        free(merged);
+        return -1;
+    }
+    for (uint32_t i = 0; i < added; i++) {
+        keys[i].name = table->pool + table->symbols[first + i].name;
+        keys[i].id = first + i;
+    }
+    qsort(keys, added, sizeof(sort_key_t), compare_keys);
+
+    uint32_t count = 0;
+    uint32_t k = 0;
+    for (uint32_t i = 0; i < table->order_count; i++) {
+        uint32_t id = table->order[i];
+        if (table->symbols[id].file == DEAD_FILE) {
+            continue;
+        }
+        const char* name = table->pool + table->symbols[id].name;
+        while (k < added && compare_names(keys[k].name, name) < 0) {
+            merged[count++] = keys[k++].id;
+        }
+        merged[count++] = id;
+    }
+    while (k < added) {
+        merged[count++] = keys[k++].id;
+    }
+    free(keys);
+    free(table->order);
+    table->order = merged;
+    table->order_count = count;
+    return 0;
+}
+
+// Drop dead symbols once they outnumber the live ones, the order keeps its sort
+static void compact_symbols(symbol_table_t* table) {
+    if (table->dead_count < COMPACT_MIN_DEAD || table->dead_count * 2 < table->symbol_count) {
+        return;
+    }
+    uint32_t* remap = (uint32_t*)malloc(sizeof(uint32_t) * (table->symbol_count + 1));
+    if (!remap) {
+        return;
+    }
+    uint32_t live = 0;
+    for (uint32_t i = 0; i < table->symbol_count; i++) {
+        if (table->symbols[i].file != DEAD_FILE) {
+            table->symbols[live] = table->symbols[i];
+            remap[i] = live++;
+        }
+    }
+    for (uint32_t f = 0; f < table->file_count; f++) {
+        if (table->files[f].count > 0) {
+            table->files[f].first = remap[table->files[f].first];
+        }
+    }
+    for (uint32_t i = 0; i < table->order_count; i++) {
+        table->order[i] = remap[table->order[i]];
+    }
+    free(remap);
+    table->symbol_count = live;
+    table->dead_count = 0;
+}
+
+static void update_locked(symbol_table_t* table, const char* path, const signature_node_t* forest) {
+    uint32_t path_offset = intern(table, path, strlen(path));
+    uint32_t file = path_offset != NO_NAME ? file_index(table, path_offset, 1) : DEAD_FILE;
+    if (file == DEAD_FILE) {
+        return;
+    }
+
+    // Symbols of the previous version are appended again as a new run, the old run dies
+    symbol_file_t* entry = &table->files[file];
+    for (uint32_t i = 0; i < entry->count; i++) {
+        table->symbols[entry->first + i].file = DEAD_FILE;
+    }
+    table->dead_count += entry->count;
+
+    uint32_t first = table->symbol_count;
+    if (add_symbols(table, forest, file, NO_NAME) != 0 || merge_order(table, first) != 0) {
+        // Keep the table consistent without this file
+        for (uint32_t i = first; i < table->symbol_count; i++) {
+            table->symbols[i].file = DEAD_FILE;
+        }
+        table->dead_count += table->symbol_count - first;
+        merge_order(table, table->symbol_count);
+        table->files[file].count = 0;
+        return;
+    }
+    table->files[file].first = first;
+    table->files[file].count = table->symbol_count - first;
+    compact_symbols(table);
+}
+
+void symbol_table_update(symbol_table_t* table, const char* path, const signature_node_t* forest) {
+    if (!table || !path) {
+        return;
+    }
+    platform_mutex_lock(&table->lock);
+    update_locked(table, path, forest);
+    platform_mutex_unlock(&table->lock);
+}
+
+// First position in the order whose name is not before the folded query
+static uint32_t lower_bound(const symbol_table_t* table, const char* query, size_t length) {
+    uint32_t low = 0;
+    uint32_t high = table->order_count;
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        if (compare_prefix(table->pool + table->symbols[table->order[mid]].name, query, length) < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+// Levenshtein distance ignoring ASCII case, or max + 1 once it is known to exceed max
+static int bounded_distance(const char* a, size_t a_length, const char* b, size_t b_length, int max, int* rows) {
+    if ((a_length > b_length ? a_length - b_length : b_length - a_length) > (size_t)max) {
+        return max + 1;
+    }
+    int* previous = rows;
+    int* current = rows + b_length + 1;
+    for (size_t j = 0; j <= b_length; j++) {
+        previous[j] = (int)j;
+    }
+    for (size_t i = 1; i <= a_length; i++) {
+        current[0] = (int)i;
+        int row_min = current[0];
+        for (size_t j = 1; j <= b_length; j++) {
+            int cost = fold(a[i - 1]) == fold(b[j - 1]) ? 0 : 1;
+            int best = previous[j - 1] + cost;
+            if (previous[j] + 1 < best) best = previous[j] + 1;
+            if (current[j - 1] + 1 < best) best = current[j - 1] + 1;
+            current[j] = best;
+            if (best < row_min) row_min = best;
+        }
+        if (row_min > max) {
+            return max + 1;
+        }
+        int* swap = previous;
+        previous = current;
+        current = swap;
+    }
+    return previous[b_length];
+}
+
+static void fill_match(const symbol_table_t* table, uint32_t id, int distance, symbol_match_t* match) {
+    const symbol_t* symbol = &table->symbols[id];
+    match->name = table->pool + symbol->name;
+    match->container = symbol->container != NO_NAME ? table->pool + symbol->container : NULL;
+    match->path = table->pool + table->files[symbol->file].path;
+    match->type = (entity_type_t)symbol->type;
+    match->start_line = symbol->start_line;
+    match->end_line = symbol->end_line;
+    match->distance = distance;
+}
+
+static int find_fuzzy(const symbol_table_t* table, const char* query, size_t length,
+                      symbol_match_t* matches, int limit) {
+    int max = length <= 4 ? 1 : 2;
+    int* rows = (int*)malloc(sizeof(int) * 2 * (length + 1));
+    uint32_t* candidates = (uint32_t*)malloc(sizeof(uint32_t) * (table->order_count + 1));
+    uint8_t* distances = (uint8_t*)malloc(table->order_count + 1);
+    if (!rows || !candidates || !distances) {
+        free(rows);
+        free(candidates);
+        free(distances);
+        return 0;
+    }
+
+    // Equal names are adjacent in the order and share one pool offset, so each is scored once
+    uint32_t candidate_count = 0;
+    uint32_t last_name = NO_NAME;
+    int last_distance = max + 1;
+    for (uint32_t i = 0; i < table->order_count; i++) {
+        uint32_t id = table->order[i];
+        uint32_t name = table->symbols[id].name;
+        if (table->symbols[id].file == DEAD_FILE) {
+            continue;
+        }
+        if (name != last_name) {
+            const char* text = table->pool + name;
+            last_distance = bounded_distance(text, strlen(text), query, length, max, rows);
+            last_name = name;
+        }
+        if (last_distance <= max) {
+            candidates[candidate_count] = id;
+            distances[candidate_count++] = (uint8_t)last_distance;
+        }
+    }
+
+    int count = 0;
+    for (int d = 0; d <= max && count < limit; d++) {
+        for (uint32_t i = 0; i < candidate_count && count < limit; i++) {
+            if (distances[i] == d) {
+                fill_match(table, candidates[i], d, &matches[count++]);
+            }
+        }
+    }
+    free(rows);
+    free(candidates);
+    free(distances);
+    return count;
+}
+
+int symbol_table_find(symbol_table_t* table, const char* query, symbol_match_mode_t mode,
+                      symbol_match_t* matches, int limit) {
+    if (!table || !query || !matches || limit <= 0) {
+        return 0;
+    }
+    size_t length = strlen(query);
+    if (mode == SYMBOL_MATCH_FUZZY) {
+        return find_fuzzy(table, query, length, matches, limit);
+    }
+
+    int count = 0;
+    for (uint32_t i = lower_bound(table, query, length); i < table->order_count && count < limit; i++) {
+        uint32_t id = table->order[i];
+        const char* name = table->pool + table->symbols[id].name;
+        if (compare_prefix(name, query, length) != 0) {
+            break;
+        }
+        if (table->symbols[id].file == DEAD_FILE || (mode == SYMBOL_MATCH_EXACT && strcmp(name, query) != 0)) {
+            continue;
+        }
+        fill_match(table, id, 0, &matches[count++]);
+    }
+    return count;
+}
+
+// Add a file of the on-disk index, unless the cache has seen a newer version already
+static void seed_file(const char* path, const signature_node_t* forest, void* arg) {
+    symbol_table_t* table = (symbol_table_t*)arg;
+    uint32_t path_offset = intern(table, path, strlen(path));
+    if (path_offset != NO_NAME && file_index(table, path_offset, 0) == DEAD_FILE) {
+        update_locked(table, path, forest);
+    }
+}
+
+static void write_field(xml_writer_t* writer, const char* text) {
+    if (text) {
+        xml_writer_puts(writer, text);
+    }
+    xml_writer_puts(writer, "\t");
+}
+
+char* find_symbols(const char* query, int mode, int limit) {
+    if (!query) {
+        return NULL;
+    }
+    if (limit <= 0) {
+        limit = DEFAULT_FIND_LIMIT;
+    }
+    char* served;
+    if (skeleton_service_find_symbols(query, mode, limit, &served) == 0) {
+        return served;
+    }
+    symbol_match_t* matches = (symbol_match_t*)malloc(sizeof(symbol_match_t) * (size_t)limit);
+    if (!matches) {
+        return NULL;
+    }
+
+    symbol_table_t* table = symbol_table_global();
+    platform_mutex_lock(&table->lock);
+    // Files of earlier sessions are known from the on-disk index without reading them
+    if (!table->seeded) {
+        table->seeded = 1;
+        skeleton_store_each(skeleton_store_global(), seed_file, table);
+    }
+
+    int count = symbol_table_find(table, query, (symbol_match_mode_t)mode, matches, limit);
+    xml_writer_t writer;
+    xml_writer_init(&writer, (size_t)count * 96);
+    for (int i = 0; i < count; i++) {
+        write_field(&writer, matches[i].name);
+        write_field(&writer, entity_type_to_string(matches[i].type));
+        write_field(&writer, matches[i].path);
+        xml_writer_int(&writer, matches[i].start_line);
+        xml_writer_puts(&writer, "\t");
+        xml_writer_int(&writer, matches[i].end_line);
+        xml_writer_puts(&writer, "\t");
+        if (matches[i].container) {
+            xml_writer_puts(&writer, matches[i].container);
+        }
+        xml_writer_puts(&writer, "\n");
+    }
+    platform_mutex_unlock(&table->lock);
+
+    free(matches);
+    return xml_writer_finish(&writer);
+}
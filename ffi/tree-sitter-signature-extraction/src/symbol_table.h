@@ -0,0 +1,77 @@
+#ifndef SYMBOL_TABLE_H
+#define SYMBOL_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "dll_export.h"
+#include "signature_node.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct symbol_table symbol_table_t;
+
+// How a query is matched against symbol names
+typedef enum {
+    SYMBOL_MATCH_EXACT = 0,          // Same name, case-sensitive
+    SYMBOL_MATCH_PREFIX = 1,         // Names starting with the query, ignoring ASCII case
+    SYMBOL_MATCH_FUZZY = 2           // Names within a small edit distance of the query, ignoring ASCII case
+} symbol_match_mode_t;
+
+// A symbol found by a lookup, its strings belong to the table and stay valid until it is next updated
+typedef struct {
+    const char* name;                // Name of the entity
+    const char* container;           // Name of the enclosing entity, NULL at top level
+    const char* path;                // File the entity is defined in
+    entity_type_t type;              // Type of the entity
+    int start_line;                  // First line of the entity
+    int end_line;                    // Last line of the entity
+    int distance;                    // Edit distance to the query, 0 unless fuzzy
+} symbol_match_t;
+
+/**
+ * Get the process-wide symbol table, fed by the skeleton cache
+ * @return Symbol table
+ */
+symbol_table_t* symbol_table_global(void);
+
+/**
+ * Replace the symbols of a file with the entities of its forest
+ * @param table Symbol table
+ * @param path Path of the file
+ * @param forest Top-level signature nodes, NULL to remove the file
+ */
+void symbol_table_update(symbol_table_t* table, const char* path, const signature_node_t* forest);
+
+/**
+ * Look symbols up by name. Exact and prefix matches come in name order, fuzzy
+ * matches by increasing distance.
+ * @param table Symbol table
+ * @param query Name or prefix to look up
+ * @param mode A symbol_match_mode_t
+ * @param matches Output array of at most limit matches
+ * @param limit Capacity of matches
+ * @return Number of matches written, valid while the table lock is held (see symbol_table_lock)
+ */
+int symbol_table_find(symbol_table_t* table, const char* query, symbol_match_mode_t mode,
+                      symbol_match_t* matches, int limit);
+
+void symbol_table_lock(symbol_table_t* table);
+void symbol_table_unlock(symbol_table_t* table);
+
+/**
+ * Find where symbols are defined across every file seen by the skeleton cache or the on-disk index
+ * @param query Name or prefix to look up
+ * @param mode A symbol_match_mode_t
+ * @param limit Maximum number of results, 0 for a default of 100
+ * @return One line per symbol: name, type, path, start line, end line and container separated by
+ *         tabs (empty container at top level); to be freed by the caller, NULL on failure
+ */
+DLL_EXPORT char* find_symbols(const char* query, int mode, int limit);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SYMBOL_TABLE_H
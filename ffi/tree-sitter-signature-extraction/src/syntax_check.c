@@ -0,0 +1,190 @@
+#include "syntax_check.h"
+#include "signature_extractor.h"
+#include "parsed_file.h"
+#include "platform.h"
+#include "arena.h"
+#include "utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void syntax_check_state_clear(syntax_check_state_t* state) {
+    free(state->path);
+    free(state->source);
+    if (state->tree) {
+        ts_tree_delete(state->tree);
+    }
+    memset(state, 0, sizeof(*state));
+}
+
+// Write lines of context numbered from first_line, marking the error line
+static void write_lines(xml_writer_t* writer, const char* text, int first_line, int error_line) {
+    if (!text || !*text) {
+        return;
+    }
+    const char* end = text + strlen(text);
+    // A trailing newline ends the last line rather than starting another one
+    if (end > text && end[-1] == '\n') {
+        end--;
+    }
+    int line = first_line;
+    const char* start = text;
+    for (;;) {
+        const char* newline = (const char*)memchr(start, '\n', (size_t)(end - start));
+        const char* line_end = newline ? newline : end;
+        xml_writer_puts(writer, line == error_line ? "> " : "  ");
+        xml_writer_int(writer, line);
+        xml_writer_puts(writer, " | ");
+        xml_writer_write(writer, start, (size_t)(line_end - start));
+        xml_writer_puts(writer, "\n");
+        if (!newline) {
+            break;
+        }
+        start = newline + 1;
+        line++;
+    }
+}
+
+static int count_lines(const char* text) {
+    int lines = 1;
+    for (const char* c = text; *c; c++) {
+        if (*c == '\n') {
+            lines++;
+        }
+    }
+    return lines;
+}
+
+static char* format_errors(const parse_error_t* errors, int error_count) {
+    xml_writer_t writer;
+    xml_writer_init(&writer, (size_t)error_count * 256);
+    for (int i = 0; i < error_count; i++) {
+        const parse_error_t* error = &errors[i];
+        xml_writer_int(&writer, error->line);
+        xml_writer_puts(&writer, ": ");
+        xml_writer_puts(&writer, error->message ? error->message : "Syntax error detected");
+        xml_writer_puts(&writer, "\n");
+        if (error->code_above_error_line) {
+            int above = count_lines(error->code_above_error_line);
+            write_lines(&writer, error->code_above_error_line, error->line - above, error->line);
+        }
+        write_lines(&writer, error->error_line, error->line, error->line);
+        write_lines(&writer, error->code_below_error_line, error->line + 1, error->line);
+    }
+    return xml_writer_finish(&writer);
+}
+
+// Collect the errors of the checked tree, only walking it when the root says there are some
+static int report_errors(const syntax_check_state_t* state, char** result) {
+    if (!ts_node_has_error(ts_tree_root_node(state->tree))) {
+        return 0;
+    }
+
+    arena_t arena;
+    arena_init(&arena);
+    int error_count = 0;
+    parse_error_t* errors = extract_parse_errors_in(state->tree, state->source, state->source_size,
+                                                    &error_count, &arena);
+    if (error_count > 0) {
+        *result = format_errors(errors, error_count);
+    }
+    arena_release(&arena);
+    if (error_count > 0 && !*result) {
+        return -1;
+    }
+    return error_count;
+}
+
+int check_syntax_errors(const char* filename, const char* language, char** result) {
+    return ctx_check_syntax_errors(extractor_ctx_default(), filename, language, result);
+}
+
+int ctx_check_syntax_errors(extractor_ctx_t* ctx, const char* filename, const char* language, char** result) {
+    *result = NULL;
+    extractor_language_t lang = extractor_language_from_name(language);
+    if (lang == EXTRACTOR_LANG_UNKNOWN) {
+        fprintf(stderr, "Unsupported language: %s\n", language ? language : "(null)");
+        return -1;
+    }
+    int64_t mtime_ns;
+    uint64_t size;
+    if (platform_file_stat(filename, &mtime_ns, &size) != 0) {
+        perror("Error opening file");
+        return -1;
+    }
+
+    // Unchanged since the last check, the tree is still good
+    syntax_check_state_t* state = extractor_ctx_check_state(ctx);
+    if (!state) {
+        return -1;
+    }
+    int same_file = state->path && state->lang == lang && strcmp(state->path, filename) == 0;
+    if (same_file && state->tree && state->mtime_ns == mtime_ns && state->size == size) {
+        return report_errors(state, result);
+    }
+
+    // A current skeleton already holds the errors of the file
+    parsed_file_t* cached = extractor_ctx_lookup_file(ctx, filename, lang, mtime_ns, size);
+    if (cached) {
+        int error_count = cached->error_count;
+        if (error_count > 0) {
+            *result = format_errors(cached->errors, error_count);
+        }
+        extractor_ctx_release_file(ctx, cached);
+        return error_count > 0 && !*result ? -1 : error_count;
+    }
+
+    TSParser* parser = extractor_ctx_parser(ctx, lang);
+    if (!parser) {
+        return -1;
+    }
+    STATS_PHASE_BEGIN(read);
+    size_t source_size = 0;
+    char* source = read_file(filename, &source_size);
+    STATS_PHASE_END(STATS_PHASE_READ, read);
+    if (!source) {
+        return -1;
+    }
+
+    // Edit the tree of the previous check into a base for the new parse
+    TSTree* old_tree = NULL;
+    if (same_file && state->tree) {
+        TSInputEdit edit;
+        old_tree = state->tree;
+        if (compute_source_edit(state->source, state->source_size, source, source_size, &edit)) {
+            ts_tree_edit(old_tree, &edit);
+        }
+    }
+    STATS_PHASE_BEGIN(parse);
+    TSTree* tree = ts_parser_parse_string(parser, old_tree, source, (uint32_t)source_size);
+    STATS_PHASE_END(STATS_PHASE_PARSE, parse);
+    if (!tree) {
+        free(source);
+        syntax_check_state_clear(state);
+        return -1;
+    }
+
+    if (same_file) {
+        char* path = state->path;
+        state->path = NULL;
+        syntax_check_state_clear(state);
+        state->path = path;
+    } else {
+        syntax_check_state_clear(state);
+        state->path = (char*)malloc(strlen(filename) + 1);
+        if (!state->path) {
+            ts_tree_delete(tree);
+            free(source);
+            return -1;
+        }
+        strcpy(state->path, filename);
+    }
+    state->lang = lang;
+    state->mtime_ns = mtime_ns;
+    state->size = size;
+    state->source = source;
+    state->source_size = source_size;
+    state->tree = tree;
+    return report_errors(state, result);
+}
@@ -0,0 +1,51 @@
+#ifndef SYNTAX_CHECK_H
+#define SYNTAX_CHECK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "dll_export.h"
+#include "extractor_context.h"
+#include "tree_sitter/api.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Last file checked with a context, so the next check of the same file reparses incrementally
+struct syntax_check_state {
+    char* path;                      // Path of the file, NULL before the first check
+    extractor_language_t lang;
+    int64_t mtime_ns;                // Modification time when checked
+    uint64_t size;                   // Size when checked
+    char* source;                    // Contents when checked
+    size_t source_size;
+    TSTree* tree;                    // Tree of the contents
+};
+
+/**
+ * Free what a check state holds and reset it
+ * @param state State of a context
+ */
+void syntax_check_state_clear(syntax_check_state_t* state);
+
+/**
+ * Check whether a file parses, without extracting signatures. A file unchanged since it was
+ * cached or last checked is not parsed again, an edited one is reparsed incrementally from the
+ * last check, and nothing is allocated when the file has no errors.
+ * @param filename Path of the file
+ * @param language Language of the file
+ * @param result Output errors to be freed by the caller, NULL when there are none: for each error
+ *        a "LINE: MESSAGE" line, then the error line and up to two lines around it, each as
+ *        "LINE | TEXT" with the error line marked by a leading '>'
+ * @return Number of errors, or -1 on failure
+ */
+DLL_EXPORT int check_syntax_errors(const char* filename, const char* language, char** result);
+
+DLL_EXPORT int ctx_check_syntax_errors(extractor_ctx_t* ctx, const char* filename, const char* language,
+                                       char** result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SYNTAX_CHECK_H
@@ -0,0 +1,271 @@
+#include "text_scan.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+  #define TEXT_SCAN_SSE2
+  #include <emmintrin.h>
+  #if defined(__GNUC__)
+    // Compiled for AVX2 function by function, and only called where the CPU has it
+    #define TEXT_SCAN_AVX2
+    #include <immintrin.h>
+  #endif
+#elif defined(__ARM_NEON)
+  #define TEXT_SCAN_NEON
+  #include <arm_neon.h>
+#endif
+
+#if defined(_MSC_VER)
+  #include <intrin.h>
+#endif
+
+// ASCII characters escaped in XML output, the same as the entities of xml_writer.c
+static const uint8_t xml_escaped[128] = {
+    ['&'] = 1, ['<'] = 1, ['>'] = 1, ['"'] = 1, ['\''] = 1, ['\n'] = 1, ['\r'] = 1, ['\t'] = 1,
+};
+
+static size_t scan_xml_scalar(const char* text, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        unsigned char byte = (unsigned char)text[i];
+        if (byte >= 0x80 || xml_escaped[byte]) {
+            return i;
+        }
+    }
+    return length;
+}
+
+static size_t scan_ascii_scalar(const char* text, size_t length) {
+    size_t i = 0;
+    // Eight bytes at a time where there is no vector unit
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        memcpy(&word, text + i, 8);
+        if (word & 0x8080808080808080ULL) {
+            break;
+        }
+    }
+    for (; i < length; i++) {
+        if ((unsigned char)text[i] >= 0x80) {
+            return i;
+        }
+    }
+    return length;
+}
+
+#if defined(TEXT_SCAN_SSE2) || defined(TEXT_SCAN_AVX2)
+
+// Index of the lowest set bit of a non-zero movemask
+static inline unsigned first_bit(unsigned mask) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (unsigned)index;
+#else
+    return (unsigned)__builtin_ctz(mask);
+#endif
+}
+
+#endif
+
+#if defined(TEXT_SCAN_SSE2)
+
+static size_t scan_xml_sse2(const char* text, size_t length) {
+    const __m128i amp = _mm_set1_epi8('&'), lt = _mm_set1_epi8('<'), gt = _mm_set1_epi8('>');
+    const __m128i quot = _mm_set1_epi8('"'), apos = _mm_set1_epi8('\'');
+    const __m128i nl = _mm_set1_epi8('\n'), cr = _mm_set1_epi8('\r'), tab = _mm_set1_epi8('\t');
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(text + i));
+        __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, amp), _mm_cmpeq_epi8(v, lt)),
+                                   _mm_or_si128(_mm_cmpeq_epi8(v, gt), _mm_cmpeq_epi8(v, quot)));
+        hit = _mm_or_si128(hit, _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, apos), _mm_cmpeq_epi8(v, nl)),
+                                             _mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, tab))));
+        // The sign bit of a byte is set for non-ASCII
+        unsigned mask = (unsigned)_mm_movemask_epi8(hit) | (unsigned)_mm_movemask_epi8(v);
+        if (mask) {
+            return i + first_bit(mask);
+        }
+    }
+    return i + scan_xml_scalar(text + i, length - i);
+}
+
+static size_t scan_ascii_sse2(const char* text, size_t length) {
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(text + i)));
+        if (mask) {
+            return i + first_bit(mask);
+        }
+    }
+    return i + scan_ascii_scalar(text + i, length - i);
+}
+
+#endif
+
+#if defined(TEXT_SCAN_AVX2)
+
+__attribute__((target("avx2")))
+static size_t scan_xml_avx2(const char* text, size_t length) {
+    const __m256i amp = _mm256_set1_epi8('&'), lt = _mm256_set1_epi8('<'), gt = _mm256_set1_epi8('>');
+    const __m256i quot = _mm256_set1_epi8('"'), apos = _mm256_set1_epi8('\'');
+    const __m256i nl = _mm256_set1_epi8('\n'), cr = _mm256_set1_epi8('\r'), tab = _mm256_set1_epi8('\t');
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(text + i));
+        __m256i hit = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, amp), _mm256_cmpeq_epi8(v, lt)),
+                                      _mm256_or_si256(_mm256_cmpeq_epi8(v, gt), _mm256_cmpeq_epi8(v, quot)));
+        hit = _mm256_or_si256(hit,
+                              _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, apos), _mm256_cmpeq_epi8(v, nl)),
+                                              _mm256_or_si256(_mm256_cmpeq_epi8(v, cr), _mm256_cmpeq_epi8(v, tab))));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(hit) | (unsigned)_mm256_movemask_epi8(v);
+        if (mask) {
+            return i + first_bit(mask);
+        }
+    }
+    return i + scan_xml_sse2(text + i, length - i);
+}
+
+__attribute__((target("avx2")))
+static size_t scan_ascii_avx2(const char* text, size_t length) {
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i*)(text + i)));
+        if (mask) {
+            return i + first_bit(mask);
+        }
+    }
+    return i + scan_ascii_sse2(text + i, length - i);
+}
+
+// Reads the CPU model libgcc fills in at startup, cheap enough to ask on every call
+static inline int cpu_has_avx2(void) {
+    return __builtin_cpu_supports("avx2");
+}
+
+#endif
+
+#if defined(TEXT_SCAN_NEON)
+
+static inline int neon_any(uint8x16_t hit) {
+    uint64x2_t words = vreinterpretq_u64_u8(hit);
+    return (vgetq_lane_u64(words, 0) | vgetq_lane_u64(words, 1)) != 0;
+}
+
+static size_t scan_xml_neon(const char* text, size_t length) {
+    const uint8x16_t amp = vdupq_n_u8('&'), lt = vdupq_n_u8('<'), gt = vdupq_n_u8('>');
+    const uint8x16_t quot = vdupq_n_u8('"'), apos = vdupq_n_u8('\'');
+    const uint8x16_t nl = vdupq_n_u8('\n'), cr = vdupq_n_u8('\r'), tab = vdupq_n_u8('\t');
+    const uint8x16_t high = vdupq_n_u8(0x80);
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        uint8x16_t v = vld1q_u8((const uint8_t*)text + i);
+        uint8x16_t hit = vorrq_u8(vorrq_u8(vceqq_u8(v, amp), vceqq_u8(v, lt)), vorrq_u8(vceqq_u8(v, gt), vceqq_u8(v, quot)));
+        hit = vorrq_u8(hit, vorrq_u8(vorrq_u8(vceqq_u8(v, apos), vceqq_u8(v, nl)), vorrq_u8(vceqq_u8(v, cr), vceqq_u8(v, tab))));
+        hit = vorrq_u8(hit, vcgeq_u8(v, high));
+        if (neon_any(hit)) {
+            break; // Located within the block by the scalar loop
+        }
+    }
+    return i + scan_xml_scalar(text + i, length - i);
+}
+
+static size_t scan_ascii_neon(const char* text, size_t length) {
+    const uint8x16_t high = vdupq_n_u8(0x80);
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        if (neon_any(vcgeq_u8(vld1q_u8((const uint8_t*)text + i), high))) {
+            break;
+        }
+    }
+    return i + scan_ascii_scalar(text + i, length - i);
+}
+
+#endif
+
+size_t text_scan_xml(const char* text, size_t length) {
+    if (length < 16) {
+        return scan_xml_scalar(text, length);
+    }
+#if defined(TEXT_SCAN_AVX2)
+    if (length >= 32 && cpu_has_avx2()) {
+        return scan_xml_avx2(text, length);
+    }
+#endif
+#if defined(TEXT_SCAN_SSE2)
+    return scan_xml_sse2(text, length);
+#elif defined(TEXT_SCAN_NEON)
+    return scan_xml_neon(text, length);
+#else
+    return scan_xml_scalar(text, length);
+#endif
+}
+
+size_t text_scan_ascii(const char* text, size_t length) {
+    if (length < 16) {
+        return scan_ascii_scalar(text, length);
+    }
+#if defined(TEXT_SCAN_AVX2)
+    if (length >= 32 && cpu_has_avx2()) {
+        return scan_ascii_avx2(text, length);
+    }
+#endif
+#if defined(TEXT_SCAN_SSE2)
+    return scan_ascii_sse2(text, length);
+#elif defined(TEXT_SCAN_NEON)
+    return scan_ascii_neon(text, length);
+#else
+    return scan_ascii_scalar(text, length);
+#endif
+}
+
+size_t utf8_sequence_length(const char* text, size_t length) {
+    const unsigned char* s = (const unsigned char*)text;
+    unsigned char lead = s[0];
+    if (lead < 0x80) {
+        return 1;
+    }
+    if (lead >= 0xC2 && lead <= 0xDF) {
+        return length >= 2 && (s[1] & 0xC0) == 0x80 ? 2 : 0;
+    }
+    if (lead >= 0xE0 && lead <= 0xEF) {
+        // No overlong forms after E0, no surrogates after ED
+        unsigned char low = lead == 0xE0 ? 0xA0 : 0x80;
+        unsigned char high = lead == 0xED ? 0x9F : 0xBF;
+        return length >= 3 && s[1] >= low && s[1] <= high && (s[2] & 0xC0) == 0x80 ? 3 : 0;
+    }
+    if (lead >= 0xF0 && lead <= 0xF4) {
+        // No overlong forms after F0, nothing above U+10FFFF after F4
+        unsigned char low = lead == 0xF0 ? 0x90 : 0x80;
+        unsigned char high = lead == 0xF4 ? 0x8F : 0xBF;
+        return length >= 4 && s[1] >= low && s[1] <= high && (s[2] & 0xC0) == 0x80 && (s[3] & 0xC0) == 0x80 ? 4 : 0;
+    }
+    return 0;
+}
+
+size_t utf8_valid_prefix(const char* text, size_t length) {
+    size_t i = 0;
+    while ((i += text_scan_ascii(text + i, length - i)) < length) {
+        size_t sequence = utf8_sequence_length(text + i, length - i);
+        if (sequence == 0) {
+            return i;
+        }
+        i += sequence;
+    }
+    return length;
+}
+
+const char* text_scan_kernel(void) {
+#if defined(TEXT_SCAN_AVX2)
+    if (cpu_has_avx2()) {
+        return "avx2";
+    }
+#endif
+#if defined(TEXT_SCAN_SSE2)
+    return "sse2";
+#elif defined(TEXT_SCAN_NEON)
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
@@ -0,0 +1,57 @@
+#ifndef TEXT_SCAN_H
+#define TEXT_SCAN_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Vector kernels scanning text 16 or 32 bytes at a time for the bytes that need more than a copy.
+// The widest of AVX2, SSE2 and NEON the CPU runs is chosen at runtime, with a scalar fallback.
+
+/**
+ * Find the first byte that XML output cannot copy as is: a character escaped by
+ * xml_writer_escaped, or a non-ASCII byte to be checked as UTF-8
+ * @param text Text
+ * @param length Size of the text in bytes
+ * @return Offset of that byte, or length if there is none
+ */
+size_t text_scan_xml(const char* text, size_t length);
+
+/**
+ * Find the first non-ASCII byte
+ * @param text Text
+ * @param length Size of the text in bytes
+ * @return Offset of that byte, or length if the text is all ASCII
+ */
+size_t text_scan_ascii(const char* text, size_t length);
+
+/**
+ * Get the length of a well-formed UTF-8 sequence, rejecting overlong forms,
+ * surrogates and code points above U+10FFFF
+ * @param text Start of the sequence
+ * @param length Bytes available from text, at least 1
+ * @return Length of the sequence, 0 if it is malformed or cut short
+ */
+size_t utf8_sequence_length(const char* text, size_t length);
+
+/**
+ * Get the length of the longest prefix of text that is valid UTF-8
+ * @param text Text
+ * @param length Size of the text in bytes
+ * @return Size of the valid prefix, length if the whole text is valid
+ */
+size_t utf8_valid_prefix(const char* text, size_t length);
+
+/**
+ * Get the name of the kernel text_scan_xml and text_scan_ascii run on this CPU
+ * @return "avx2", "sse2", "neon" or "scalar"
+ */
+const char* text_scan_kernel(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TEXT_SCAN_H
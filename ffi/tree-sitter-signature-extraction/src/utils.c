@@ -1,5 +1,6 @@
 #include "signature_extractor.h"
 #include "utils.h"
+#include "extractor_stats.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -30,170 +31,178 @@ char* get_node_text(TSNode node, const char* source_code) {
     return text;
 }
 
-char* get_modifiers_text(TSNode node, const char* source_code) {
+// Add the text of a node as a slice, returns its length
+uint32_t add_node_slice(signature_builder_t* builder, TSNode node) {
+    if (ts_node_is_null(node)) {
+        return 0;
+    }
+    
+    uint32_t start_byte = ts_node_start_byte(node);
+    uint32_t length = ts_node_end_byte(node) - start_byte;
+    if (length == 0 || signature_builder_slice(builder, start_byte, length) != 0) {
+        return 0;
+    }
+    return length;
+}
+
+// Add a literal prefix followed by the text of a node, or nothing if the node has no text
+uint32_t add_prefixed_node_slice(signature_builder_t* builder, const char* prefix, TSNode node) {
+    uint32_t mark = builder->count;
+    signature_builder_literal(builder, prefix);
+    uint32_t length = add_node_slice(builder, node);
+    if (length == 0) {
+        signature_builder_truncate(builder, mark);
+    }
+    return length;
+}
+
+// Find the modifiers child of a declaration
+TSNode get_modifiers_node(TSNode node) {
     uint32_t child_count = ts_node_child_count(node);
     TSNode modifiers_node = {0}; // Initialize to null node
-    bool found_modifier = false;
 
     for (uint32_t i = 0; i < child_count; i++) {
         const char* field_name = ts_node_field_name_for_child(node, i);
         // Check both by field name (if available) and by node type
         if (field_name && strcmp(field_name, "modifiers") == 0) {
-            modifiers_node = ts_node_child(node, i);
-            found_modifier = true;
-            break;
+            return ts_node_child(node, i);
         }
         // If field name is not found, check the node type
         TSNode potential_child = ts_node_child(node, i);
         if (strcmp(ts_node_type(potential_child), "modifiers") == 0) {
-            modifiers_node = potential_child;
-            found_modifier = true;
-            break;
+            return potential_child;
         }
     }
-    
-    // Check if we found a modifiers node
-    if (!found_modifier) {
-        return NULL;
-    }
-    
+    return modifiers_node;
+}
+
+// Add the modifiers of a declaration, returns 0 if it has none
+int add_modifiers(signature_builder_t* builder, TSNode node) {
+    return add_modifier_list(builder, get_modifiers_node(node));
+}
+
+// Add the children of a modifiers node, returns 0 if there are none
+int add_modifier_list(signature_builder_t* builder, TSNode modifiers_node) {
     // Check if the modifiers node is valid
     if (ts_node_is_null(modifiers_node)) {
-        return NULL;
+        return 0;
     }
     
     uint32_t modifier_count = ts_node_child_count(modifiers_node);
     
-    if (modifier_count == 0) return NULL;
-
-    // Now check if we found the modifiers_node and iterate through its children
-    char *rst = NULL;
-    size_t sig_len = 0;
-    size_t sig_cap = 64; // Initial capacity
-    rst = malloc(sig_cap);
-    if (!rst) {
-        return NULL;
-    }
-    rst[0] = '\0';
+    if (modifier_count == 0) return 0;
+
     for (uint32_t j = 0; j < modifier_count; j++) {
         TSNode mod_node = ts_node_child(modifiers_node, j);
-        char* mod_text = get_node_text(mod_node, source_code);
-        if (mod_text) {
-            size_t mod_len = strlen(mod_text) + 1;
-            // Ensure enough capacity
-            while (sig_len + mod_len + 1 > sig_cap) {
-                sig_cap *= 2;
-                char* temp = realloc(rst, sig_cap);
-                if (!temp) {
-                    free(mod_text);
-                    free(rst);
-                    return NULL;
-                }
-                rst = temp;
-            }
-            strcat(rst, mod_text);
-            if (mod_text[0] == '@') strcat(rst, "\n");
-            else if (j < modifier_count - 1) strcat(rst, " ");
-            sig_len += mod_len;
-            free(mod_text);
+        if (add_node_slice(builder, mod_node) > 0) {
+            // Annotations go on their own line
+            if (builder->source[ts_node_start_byte(mod_node)] == '@') signature_builder_literal(builder, "\n");
+            else if (j < modifier_count - 1) signature_builder_literal(builder, " ");
         }
     }
-    return rst;
+    return 1;
+}
+
+char* get_modifiers_text(TSNode node, const char* source_code) {
+    signature_builder_t builder;
+    signature_builder_init(&builder, source_code);
+    char* text = add_modifiers(&builder, node) ? signature_builder_to_string(&builder, NULL) : NULL;
+    signature_builder_free(&builder);
+    return text;
 }
 
 char *read_file(const char *filename, size_t *size) {
+    char *buffer = NULL;
+    size_t capacity = 0;
+    if (read_file_into(filename, &buffer, &capacity, size) != 0) {
+        free(buffer);
+        return NULL;
+    }
+    return buffer;
+}
+
+// Grow a buffer by doubling until it holds at least needed bytes
+static int reserve_buffer(char **buffer, size_t *capacity, size_t needed) {
+    if (*buffer && *capacity >= needed) {
+        return 0;
+    }
+    size_t new_capacity = *capacity ? *capacity : 4096;
+    while (new_capacity < needed) {
+        new_capacity *= 2;
+    }
+    char *temp = realloc(*buffer, new_capacity);
+    if (!temp) {
+        fprintf(stderr, "Error allocating memory\n");
+        return -1;
+    }
+    STATS_ADD(STATS_ALLOCATIONS, 1);
+    *buffer = temp;
+    *capacity = new_capacity;
+    return 0;
+}
+
+// Read a file into a caller-owned buffer, growing it only when the file does not fit.
+// The file is read until end of file, so pipes and devices work like regular files.
+int read_file_into(const char *filename, char **buffer, size_t *capacity, size_t *size) {
+    STATS_PHASE_BEGIN(read);
     FILE *file = fopen(filename, "rb");
     if (!file) {
         perror("Error opening file");
-        return NULL;
+        return -1;
     }
 
-    fseek(file, 0, SEEK_END);
-    *size = ftell(file);
-    fseek(file, 0, SEEK_SET);
+    // Seekable files size the buffer up front, streams grow it as they go
+    size_t hint = 0;
+    if (fseek(file, 0, SEEK_END) == 0) {
+        long file_size = ftell(file);
+        if (file_size > 0) {
+            hint = (size_t)file_size;
+        }
+        fseek(file, 0, SEEK_SET);
+    }
+    clearerr(file);
 
-    char *buffer = malloc(*size + 1);
-    if (!buffer) {
+    size_t length = 0;
+    for (;;) {
+        size_t needed = (hint > length ? hint : length + 4096) + 1;
+        if (reserve_buffer(buffer, capacity, needed) != 0) {
+            fclose(file);
+            return -1;
+        }
+        size_t wanted = *capacity - length - 1;
+        size_t got = fread(*buffer + length, 1, wanted, file);
+        length += got;
+        if (got < wanted) {
+            break;
+        }
+        // A file that filled the buffer exactly need not grow it to see the end
+        int next = fgetc(file);
+        if (next == EOF) {
+            break;
+        }
+        ungetc(next, file);
+    }
+    if (ferror(file)) {
+        perror("Error reading file");
         fclose(file);
-        fprintf(stderr, "Error allocating memory\n");
-        return NULL;
+        return -1;
     }
 
-    fread(buffer, 1, *size, file);
-    buffer[*size] = '\0';
-
+    (*buffer)[length] = '\0';
+    *size = length;
     fclose(file);
-    return buffer;
+    STATS_ADD(STATS_BYTES_READ, length);
+    STATS_PHASE_END(STATS_PHASE_READ, read);
+    return 0;
 }
 
-// Helper function to escape XML special characters
+// Helper function to escape XML special characters, the kernel of xml_writer_escaped
 char* escape_xml(const char* input) {
     if (!input) return NULL;
-    
-    // Calculate the length needed for the escaped string
+
     size_t len = strlen(input);
-    size_t escaped_len = len;
-    
-    for (size_t i = 0; i < len; i++) {
-        switch (input[i]) {
-            case '&':  escaped_len += 5; break;  // &amp;
-            case '<':  escaped_len += 4; break;  // &lt;
-            case '>':  escaped_len += 4; break;  // &gt;
-            case '"':  escaped_len += 6; break;  // &quot;
-            case '\'': escaped_len += 6; break;  // &apos;
-            case '\n': escaped_len += 5; break;  // &#10;
-            case '\r': escaped_len += 5; break;  // &#13;
-            case '\t': escaped_len += 4; break;  // &#9;
-            default:   break;
-        }
-    }
-    
-    // Allocate memory for the escaped string
-    char* escaped = (char*)malloc(escaped_len + 1);
-    if (!escaped) return NULL;
-    
-    // Perform the escaping
-    size_t j = 0;
-    for (size_t i = 0; i < len; i++) {
-        switch (input[i]) {
-            case '&':
-                strcpy(escaped + j, "&amp;");
-                j += 5;
-                break;
-            case '<':
-                strcpy(escaped + j, "&lt;");
-                j += 4;
-                break;
-            case '>':
-                strcpy(escaped + j, "&gt;");
-                j += 4;
-                break;
-            case '"':
-                strcpy(escaped + j, "&quot;");
-                j += 6;
-                break;
-            case '\'':
-                strcpy(escaped + j, "&apos;");
-                j += 6;
-                break;
-            case '\n':
-                strcpy(escaped + j, "&#10;");
-                j += 5;
-                break;
-            case '\r':
-                strcpy(escaped + j, "&#13;");
-                j += 5;
-                break;
-            case '\t':
-                strcpy(escaped + j, "&#9;");
-                j += 4;
-                break;
-            default:
-                escaped[j++] = input[i];
-                break;
-        }
-    }
-    
-    escaped[j] = '\0';
-    return escaped;
+    xml_writer_t writer;
+    xml_writer_init(&writer, xml_escaped_length(input, len));
+    xml_writer_escaped(&writer, input, len);
+    return xml_writer_finish(&writer);
 }
@@ -3,6 +3,7 @@
 
 #include "tree_sitter/api.h"
 #include "dll_export.h"
+#include "signature_node.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -10,7 +11,13 @@ extern "C" {
 
 DLL_EXPORT char* get_node_text(TSNode node, const char* source_code);
 DLL_EXPORT char* get_modifiers_text(TSNode node, const char* source_code);
+uint32_t add_node_slice(signature_builder_t* builder, TSNode node);
+uint32_t add_prefixed_node_slice(signature_builder_t* builder, const char* prefix, TSNode node);
+int add_modifiers(signature_builder_t* builder, TSNode node);
+int add_modifier_list(signature_builder_t* builder, TSNode modifiers_node);
+TSNode get_modifiers_node(TSNode node);
 DLL_EXPORT char *read_file(const char *filename, size_t *size);
+int read_file_into(const char *filename, char **buffer, size_t *capacity, size_t *size);
 DLL_EXPORT char* escape_xml(const char* input);
 
 #ifdef __cplusplus
@@ -0,0 +1,254 @@
+#include "xml_writer.h"
+#include "extractor_stats.h"
+#include "text_scan.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Entities of the characters escaped in XML text and attributes, NULL for plain characters.
+// text_scan_xml stops at the same characters.
+static const char* const xml_entities[256] = {
+    ['&'] = "&amp;",
+    ['<'] = "&lt;",
+    ['>'] = "&gt;",
+    ['"'] = "&quot;",
+    ['\''] = "&apos;",
+    ['\n'] = "&#10;",
+    ['\r'] = "&#13;",
+    ['\t'] = "&#9;",
+};
+
+// Written in place of each byte of malformed UTF-8
+static const char replacement_character[] = "\xEF\xBF\xBD";
+
+static const char indent_spaces[] = "                                                                ";
+
+void xml_writer_init(xml_writer_t* writer, size_t size_hint) {
+    memset(writer, 0, sizeof(xml_writer_t));
+    if (size_hint > 0) {
+        writer->data = (char*)malloc(size_hint + 1);
+        writer->capacity = writer->data ? size_hint + 1 : 0;
+        STATS_ADD(STATS_ALLOCATIONS, 1);
+    }
+}
+
+void xml_writer_init_stream(xml_writer_t* writer, xml_chunk_fn sink, void* user_data) {
+    memset(writer, 0, sizeof(xml_writer_t));
+    writer->sink = sink;
+    writer->sink_arg = user_data;
+    writer->data = (char*)malloc(XML_WRITER_CHUNK_SIZE);
+    STATS_ADD(STATS_ALLOCATIONS, 1);
+    if (writer->data) {
+        writer->capacity = XML_WRITER_CHUNK_SIZE;
+    } else {
+        writer->failed = 1;
+    }
+}
+
+// Grow a buffered writer geometrically to hold at least needed bytes
+static int grow(xml_writer_t* writer, size_t needed) {
+    size_t new_capacity = writer->capacity ? writer->capacity : 4096;
+    while (new_capacity < needed) {
+        new_capacity *= 2;
+    }
+    char* data = (char*)realloc(writer->data, new_capacity);
+    if (!data) {
+        fprintf(stderr, "Error allocating memory\n");
+        writer->failed = 1;
+        return -1;
+    }
+    writer->data = data;
+    writer->capacity = new_capacity;
+    STATS_ADD(STATS_ALLOCATIONS, 1);
+    return 0;
+}
+
+// Length of the longest prefix that does not end inside a UTF-8 sequence
+static size_t utf8_boundary(const char* data, size_t length) {
+    // Skip back over continuation bytes to the lead byte of the last sequence
+    size_t lead = length;
+    while (lead > 0 && length - lead < 3 && ((unsigned char)data[lead - 1] & 0xC0) == 0x80) {
+        lead--;
+    }
+    if (lead == 0) {
+        return length;
+    }
+    unsigned char byte = (unsigned char)data[lead - 1];
+    if (byte < 0xC0) {
+        return length; // ASCII, or a stray continuation byte that no chunking can fix
+    }
+    size_t sequence = byte >= 0xF0 ? 4 : byte >= 0xE0 ? 3 : 2;
+    return length - (lead - 1) >= sequence ? length : lead - 1;
+}
+
+// Hand the pending output of a streaming writer to its callback, keeping a split sequence back
+static void flush_chunk(xml_writer_t* writer) {
+    if (writer->failed || writer->length == 0) {
+        return;
+    }
+    size_t cut = utf8_boundary(writer->data, writer->length);
+    if (cut == 0) {
+        cut = writer->length;
+    }
+    if (writer->sink(writer->data, cut, writer->sink_arg) != 0) {
+        writer->failed = 1;
+        return;
+    }
+    memmove(writer->data, writer->data + cut, writer->length - cut);
+    writer->length -= cut;
+    writer->flushed += cut;
+}
+
+// Room for length contiguous bytes at the end of the output, or NULL if it cannot be made
+static char* reserve(xml_writer_t* writer, size_t length) {
+    if (writer->failed) {
+        return NULL;
+    }
+    if (!writer->sink) {
+        // Keep a byte for the terminating NUL
+        if (writer->length + length + 1 > writer->capacity && grow(writer, writer->length + length + 1) != 0) {
+            return NULL;
+        }
+    } else if (writer->length + length > writer->capacity) {
+        flush_chunk(writer);
+        if (writer->failed || writer->length + length > writer->capacity) {
+            return NULL;
+        }
+    }
+    return writer->data + writer->length;
+}
+
+void xml_writer_write(xml_writer_t* writer, const char* text, size_t length) {
+    if (writer->failed || length == 0) {
+        return;
+    }
+    if (!writer->sink) {
+        char* out = reserve(writer, length);
+        if (out) {
+            memcpy(out, text, length);
+            writer->length += length;
+        }
+        return;
+    }
+
+    // A streaming writer fills and flushes chunks as it goes
+    while (length > 0 && !writer->failed) {
+        size_t space = writer->capacity - writer->length;
+        if (space == 0) {
+            flush_chunk(writer);
+            continue;
+        }
+        size_t count = length < space ? length : space;
+        memcpy(writer->data + writer->length, text, count);
+        writer->length += count;
+        text += count;
+        length -= count;
+    }
+}
+
+void xml_writer_puts(xml_writer_t* writer, const char* text) {
+    if (text) {
+        xml_writer_write(writer, text, strlen(text));
+    }
+}
+
+void xml_writer_int(xml_writer_t* writer, int value) {
+    char digits[16];
+    int length = snprintf(digits, sizeof(digits), "%d", value);
+    xml_writer_write(writer, digits, (size_t)length);
+}
+
+void xml_writer_indent(xml_writer_t* writer, int level) {
+    if (level <= 0) {
+        return;
+    }
+    size_t length = (size_t)level * 4;
+    char* out = reserve(writer, length);
+    if (out) {
+        memset(out, ' ', length);
+        writer->length += length;
+        return;
+    }
+    while (length > 0 && !writer->failed) {
+        size_t count = length < sizeof(indent_spaces) - 1 ? length : sizeof(indent_spaces) - 1;
+        xml_writer_write(writer, indent_spaces, count);
+        length -= count;
+    }
+}
+
+void xml_writer_escaped(xml_writer_t* writer, const char* text, size_t length) {
+    if (!text) {
+        return;
+    }
+    // Runs of plain text and well-formed UTF-8 are found by the vector scan and copied whole
+    size_t run_start = 0;
+    size_t i = 0;
+    while ((i += text_scan_xml(text + i, length - i)) < length) {
+        unsigned char byte = (unsigned char)text[i];
+        if (byte >= 0x80) {
+            size_t sequence = utf8_sequence_length(text + i, length - i);
+            if (sequence > 0) {
+                i += sequence;
+                continue;
+            }
+            xml_writer_write(writer, text + run_start, i - run_start);
+            xml_writer_write(writer, replacement_character, sizeof(replacement_character) - 1);
+        } else {
+            xml_writer_write(writer, text + run_start, i - run_start);
+            xml_writer_puts(writer, xml_entities[byte]);
+        }
+        i++;
+        run_start = i;
+    }
+    xml_writer_write(writer, text + run_start, length - run_start);
+}
+
+size_t xml_escaped_length(const char* text, size_t length) {
+    if (!text) {
+        return 0;
+    }
+    size_t escaped = length;
+    size_t i = 0;
+    while ((i += text_scan_xml(text + i, length - i)) < length) {
+        unsigned char byte = (unsigned char)text[i];
+        if (byte >= 0x80) {
+            size_t sequence = utf8_sequence_length(text + i, length - i);
+            if (sequence > 0) {
+                i += sequence;
+                continue;
+            }
+            escaped += sizeof(replacement_character) - 2;
+        } else {
+            escaped += strlen(xml_entities[byte]) - 1;
+        }
+        i++;
+    }
+    return escaped;
+}
+
+char* xml_writer_finish(xml_writer_t* writer) {
+    char* out = reserve(writer, 0);
+    if (!out) {
+        free(writer->data);
+        writer->data = NULL;
+        return NULL;
+    }
+    *out = '\0';
+    char* data = writer->data;
+    writer->data = NULL;
+    writer->length = writer->capacity = 0;
+    return data;
+}
+
+int xml_writer_finish_stream(xml_writer_t* writer) {
+    // The last chunk goes out whole, there is nothing left to complete a split sequence
+    if (!writer->failed && writer->length > 0 &&
+        writer->sink(writer->data, writer->length, writer->sink_arg) != 0) {
+        writer->failed = 1;
+    }
+    free(writer->data);
+    writer->data = NULL;
+    writer->length = writer->capacity = 0;
+    return writer->failed ? -1 : 0;
+}
@@ -0,0 +1,114 @@
+#ifndef XML_WRITER_H
+#define XML_WRITER_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Receives a chunk of streamed output. Chunks never split a UTF-8 sequence.
+ * @param data Chunk, not NUL-terminated and only valid during the call
+ * @param length Size of the chunk in bytes
+ * @param user_data Argument given to the writer
+ * @return 0 to continue, non-zero to stop writing
+ */
+typedef int (*xml_chunk_fn)(const char* data, size_t length, void* user_data);
+
+// Output buffer for XML text. A buffered writer grows geometrically and hands its
+// text over with xml_writer_finish; a streaming writer hands full chunks to a callback.
+typedef struct {
+    char* data;                      // Pending output
+    size_t length;                   // Bytes pending in data
+    size_t capacity;                 // Capacity of data
+    size_t flushed;                  // Bytes already handed to the callback
+    xml_chunk_fn sink;               // Chunk callback, NULL for a buffered writer
+    void* sink_arg;                  // Argument of the callback
+    int failed;                      // Set on allocation failure or when the callback stops
+} xml_writer_t;
+
+// Chunk size of streaming writers
+#define XML_WRITER_CHUNK_SIZE (64 * 1024)
+
+/**
+ * Initialize a buffered writer
+ * @param writer Writer
+ * @param size_hint Expected size of the output, 0 if unknown
+ */
+void xml_writer_init(xml_writer_t* writer, size_t size_hint);
+
+/**
+ * Initialize a writer streaming chunks of about XML_WRITER_CHUNK_SIZE bytes to a callback
+ * @param writer Writer
+ * @param sink Chunk callback
+ * @param user_data Argument passed to the callback
+ */
+void xml_writer_init_stream(xml_writer_t* writer, xml_chunk_fn sink, void* user_data);
+
+/**
+ * Append raw bytes
+ * @param writer Writer
+ * @param text Bytes to append
+ * @param length Number of bytes
+ */
+void xml_writer_write(xml_writer_t* writer, const char* text, size_t length);
+
+/**
+ * Append a NUL-terminated string
+ * @param writer Writer
+ * @param text String to append
+ */
+void xml_writer_puts(xml_writer_t* writer, const char* text);
+
+/**
+ * Append a decimal integer
+ * @param writer Writer
+ * @param value Value to append
+ */
+void xml_writer_int(xml_writer_t* writer, int value);
+
+/**
+ * Append four spaces per indentation level
+ * @param writer Writer
+ * @param level Indentation level
+ */
+void xml_writer_indent(xml_writer_t* writer, int level);
+
+/**
+ * Append text with XML special characters and control whitespace escaped, and each byte
+ * of malformed UTF-8 replaced with U+FFFD, so the output is always valid UTF-8.
+ * Runs of plain characters are found with text_scan_xml and copied in bulk.
+ * @param writer Writer
+ * @param text Text to escape, may be NULL
+ * @param length Size of the text in bytes
+ */
+void xml_writer_escaped(xml_writer_t* writer, const char* text, size_t length);
+
+/**
+ * Get the size of text once escaped by xml_writer_escaped
+ * @param text Text, may be NULL
+ * @param length Size of the text in bytes
+ * @return Size of the escaped text in bytes
+ */
+size_t xml_escaped_length(const char* text, size_t length);
+
+/**
+ * Finish a buffered writer and take its output
+ * @param writer Writer, released by this call
+ * @return NUL-terminated output to be freed by the caller, or NULL on failure
+ */
+char* xml_writer_finish(xml_writer_t* writer);
+
+/**
+ * Finish a streaming writer, flushing the remaining output
+ * @param writer Writer, released by this call
+ * @return 0 if every chunk was delivered, -1 on failure or if the callback stopped
+ */
+int xml_writer_finish_stream(xml_writer_t* writer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // XML_WRITER_H